@@ -0,0 +1,88 @@
+#pragma once
+
+// CIC (cascaded integrator-comb) decimator for the pressure channels.
+// Plain C++ with no Arduino/IDF dependencies so the same filter can be built
+// and benchmarked on a Linux host against recorded or synthetic sample streams.
+
+#include <stdint.h>
+#include <stddef.h>
+
+// N-stage CIC decimator with a differential delay of 1.
+// The integrators and combs use wrapping uint32_t arithmetic, which is exact as
+// long as inputBits + STAGES * log2(ratio) <= 32 (12-bit ADC, 3 stages, R=64 -> 30 bits).
+template <uint8_t STAGES>
+class CicDecimator {
+ public:
+  static_assert(STAGES >= 1 && STAGES <= 4, "CIC stage count must be 1..4");
+
+  explicit CicDecimator(uint16_t ratio = 64) { reset(ratio); }
+
+  void reset(uint16_t ratio) {
+    _ratio = ratio ? ratio : 1;
+    _phase = 0;
+    _gain = 1.0f;
+    for (uint8_t i = 0; i < STAGES; i++) {
+      _integ[i] = 0;
+      _comb[i] = 0;
+      _gain *= (float)_ratio;
+    }
+    _output = 0.0f;
+    _primed = 0;
+  }
+
+  // Push one input sample. Returns true when a new decimated output is ready.
+  inline bool push(uint32_t x) {
+    _integ[0] += x;
+    for (uint8_t i = 1; i < STAGES; i++) {
+      _integ[i] += _integ[i - 1];
+    }
+
+    if (++_phase < _ratio) return false;
+    _phase = 0;
+
+    uint32_t y = _integ[STAGES - 1];
+    for (uint8_t i = 0; i < STAGES; i++) {
+      uint32_t prev = _comb[i];
+      _comb[i] = y;
+      y -= prev;
+    }
+
+    // The first STAGES outputs still contain the filter's start-up transient
+    if (_primed < STAGES) {
+      _primed++;
+      return false;
+    }
+
+    _output = (float)y / _gain;
+    return true;
+  }
+
+  // Decimated output in input units (the CIC gain R^N is divided out)
+  float output() const { return _output; }
+  uint16_t ratio() const { return _ratio; }
+
+ private:
+  uint32_t _integ[STAGES];
+  uint32_t _comb[STAGES];
+  uint16_t _ratio;
+  uint16_t _phase;
+  float _gain;
+  float _output;
+  uint8_t _primed;
+};
+
+// Per-channel acquisition statistics (shared by the firmware and host benchmarks)
+struct AdcChannelStats {
+  uint32_t rawSamples = 0;       // Samples pushed into the decimator
+  uint32_t decimatedSamples = 0; // Outputs produced
+  uint16_t lastRaw = 0;
+  uint16_t minRaw = 0xFFFF;
+  uint16_t maxRaw = 0;
+
+  inline void record(uint16_t raw) {
+    rawSamples++;
+    lastRaw = raw;
+    if (raw < minRaw) minRaw = raw;
+    if (raw > maxRaw) maxRaw = raw;
+  }
+};
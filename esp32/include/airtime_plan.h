@@ -0,0 +1,120 @@
+#pragma once
+
+// Airtime plan shared by ESP-NOW and BLE. Mesh time (time_sync.h) is cut into
+// superframes of frameUs, starting at its multiples, and each is laid out the same:
+//
+//   | hub | slot 0 | slot 1 | ... | slot n-1 |            BLE window            |
+//   |<------------- ESP-NOW ------------->|
+//
+// The hub sends its beacons and its own reports in the hub slot, each slave its
+// reports and relay forwards in its own slot, and nobody starts a scheduled ESP-NOW
+// frame in the BLE window, which belongs to advertising and connection events (and
+// is idle air when there are none). Every node still has one radio for both stacks,
+// so it also tells the coexistence arbiter which to favor: Wi-Fi through the
+// ESP-NOW part, so slot traffic is heard, Bluetooth through the window.
+//
+// Slots come from the hub: its beacons list the last two MAC bytes of the slaves
+// it hears in slot order (TLV_AIRTIME_SLOTS). Slaves not listed yet share a few
+// spare slots after those, picked by the same two bytes (frameTailSlot), the way
+// weigh-now hands out reply slots. A node that isn't on the mesh clock runs the plan
+// alone on its own clock, in the hub slot.
+//
+// A frame starts a guard time into its slot, so clocks a little apart don't step
+// on the neighbor's slot, and only if it ends before the slot does; otherwise it
+// waits for the next superframe.
+//
+// Times in microseconds. Not thread-safe. Host-buildable.
+
+#include <stdint.h>
+#include "espnow_frame.h"
+
+#define AIRTIME_HUB_SLOT 0xFF
+
+// ESP-NOW frame of 'len' payload bytes at the 1 Mbps it is sent at: long preamble
+// plus 43 bytes of 802.11 header, ESP-NOW vendor element and FCS around the payload
+static inline uint32_t espnowAirUs(size_t len) { return 192 + (uint32_t)(43 + len) * 8; }
+
+enum AirtimePhase : uint8_t {
+  AIRTIME_ESPNOW,             // Hub slot and slave slots
+  AIRTIME_BLE
+};
+
+struct AirtimeConfig {
+  uint32_t frameUs;           // Superframe
+  uint32_t hubSlotUs;
+  uint32_t slotUs;            // Per slave
+  uint32_t guardUs;           // Start of a slot no frame uses
+  uint8_t maxSlots;           // Listed + spare slaves never exceed this
+  uint8_t spareSlots;
+};
+
+class AirtimePlan {
+ public:
+  explicit AirtimePlan(const AirtimeConfig& c)
+      : _c(c), _slots(c.spareSlots), _slot(AIRTIME_HUB_SLOT), _listed(false) {}
+
+  // A beacon's slot list, 'tail' our last two MAC bytes
+  void assign(const uint8_t* tails, uint8_t listed, uint16_t tail) {
+    _slots = slotsFor(listed);
+    if (listed > _slots - _c.spareSlots) listed = (uint8_t)(_slots - _c.spareSlots);
+    _slot = frameTailSlot(tails, listed, _slots, tail);
+    _listed = _slot < listed;
+  }
+
+  // The hub (or a node on its own), with 'listed' slaves behind it
+  void assignHub(uint8_t listed) {
+    _slots = slotsFor(listed);
+    _slot = AIRTIME_HUB_SLOT;
+    _listed = false;
+  }
+
+  uint8_t slots() const { return _slots; }
+  uint8_t slot() const { return _slot; }
+  bool listed() const { return _listed; }
+  uint32_t frameUs() const { return _c.frameUs; }
+  uint32_t espnowUs() const { return _c.hubSlotUs + (uint32_t)_slots * _c.slotUs; }
+
+  AirtimePhase phase(int64_t t) const { return offset(t) < espnowUs() ? AIRTIME_ESPNOW : AIRTIME_BLE; }
+
+  // First phase change after t
+  int64_t nextPhaseChange(int64_t t) const {
+    uint32_t off = offset(t);
+    int64_t frame = t - off;
+    return off < espnowUs() ? frame + espnowUs() : frame + _c.frameUs;
+  }
+
+  // Earliest time at or after t a frame of airUs can start in our slot. One longer
+  // than the slot starts at its opening and overruns it.
+  int64_t txAt(int64_t t, uint32_t airUs) const {
+    uint32_t off = offset(t);
+    int64_t frame = t - off;
+    uint32_t open = slotStart() + _c.guardUs;
+    uint32_t close = slotStart() + slotLength();
+    if (off < open) return frame + open;
+    if (off + airUs <= close || (off == open && open + airUs > close)) return t;
+    return frame + _c.frameUs + open;
+  }
+
+  bool inSlot(int64_t t, uint32_t airUs) const { return txAt(t, airUs) == t; }
+
+ private:
+  uint8_t slotsFor(uint8_t listed) const {
+    uint16_t n = (uint16_t)listed + _c.spareSlots;
+    return (uint8_t)(n > _c.maxSlots ? _c.maxSlots : n);
+  }
+
+  uint32_t slotStart() const {
+    return _slot == AIRTIME_HUB_SLOT ? 0 : _c.hubSlotUs + (uint32_t)_slot * _c.slotUs;
+  }
+  uint32_t slotLength() const { return _slot == AIRTIME_HUB_SLOT ? _c.hubSlotUs : _c.slotUs; }
+
+  uint32_t offset(int64_t t) const {
+    int64_t off = t % (int64_t)_c.frameUs;
+    return (uint32_t)(off < 0 ? off + _c.frameUs : off);
+  }
+
+  AirtimeConfig _c;
+  uint8_t _slots;             // Slave slots, listed + spare
+  uint8_t _slot;              // Ours, AIRTIME_HUB_SLOT for the hub
+  bool _listed;               // The hub listed us (not sharing a spare slot)
+};
@@ -0,0 +1,145 @@
+#pragma once
+
+// Fleet frame: the hub's BLE sensor notification. Packs as many device records as
+// fit into one notification of the negotiated MTU, so a whole fleet refresh is a
+// handful of notifications instead of one per device.
+//
+//   header (12 bytes)
+//     u8  magic        BLE_FLEET_MAGIC (old BLESensorPacket started 0/1, JSON '{')
+//     u8  version
+//     u8  refresh      Refresh counter; all frames of one refresh share it
+//     u8  index        Frame number within the refresh
+//     u8  flags        BLE_FLEET_LAST on the final frame of a refresh; BLE_FLEET_DELTA
+//                      when only changed records (plus the hub) are included
+//     u8  count        Records in this frame
+//     u8  recordSize   Bytes per record; readers skip fields they don't know
+//     u8  devices      Active devices in the fleet, hub included
+//     f32 fleetTotal   Fleet total weight (lbs), FLEET_REC_IN_TOTAL records only
+//   records, recordSize bytes each (first record of frame 0 is the hub):
+//     u8  flags        FLEET_REC_* bits
+//     u8  mac[6]
+//     u16 ch1/ch2 air pressure 0.01 psi, u16 ambient 0.001 psi, i16 temperature 0.01 °F
+//     i32 ch1/ch2 weight 0.1 lb, u16 ch1/ch2 std dev 0.1 lb
+//     u8  battery % (BATTERY_LEVEL_UNKNOWN: no reading), i8 ESP-NOW RSSI (EWMA of its
+//         packets), u8 fw major/minor/patch
+//     u16 age of the reading, 0.1 s
+//     i16 sample time - the fleet total's reference time, ms (mesh timebase;
+//         BLE_FLEET_SKEW_UNKNOWN for FLEET_REC_UNALIGNED records)
+//     u8  link loss, 0.5 % (EWMA from sequence gaps; BLE_FLEET_LINK_UNKNOWN for the hub
+//         and devices only heard through a relay)
+//     u8  link jitter, ms (interarrival jitter, capped at 254; BLE_FLEET_LINK_UNKNOWN likewise)
+//
+// Little endian, same quantization as the ESP-NOW sensor frame. Host-buildable.
+
+#include <stdint.h>
+#include <stddef.h>
+#include "espnow_frame.h"
+
+#define BLE_FLEET_MAGIC        0xF1
+#define BLE_FLEET_VERSION      1
+#define BLE_FLEET_HEADER_SIZE  12
+#define BLE_FLEET_RECORD_SIZE  38
+#define BLE_FLEET_RECORD_V1_SIZE 34    // Before the skew field
+#define BLE_FLEET_RECORD_V2_SIZE 36    // Before the link fields
+#define BLE_FLEET_LAST         0x01
+#define BLE_FLEET_DELTA        0x02
+#define BLE_FLEET_MAX_FRAME    244     // 247 MTU - 3 byte ATT header
+
+#define FLEET_REC_HUB          0x01
+#define FLEET_REC_CH1_SETTLED  0x02
+#define FLEET_REC_CH2_SETTLED  0x04
+#define FLEET_REC_CHANGED      0x08   // Moved past the deadband since its last notification
+#define FLEET_REC_IN_TOTAL     0x10   // Sample inside the coherence window, counted in fleetTotal
+#define FLEET_REC_UNALIGNED    0x20   // No sample time of its own (legacy or unsynced): counted as is
+
+#define BLE_FLEET_SKEW_UNKNOWN (-32768)
+#define BLE_FLEET_LINK_UNKNOWN 255
+
+struct FleetRecord {
+  uint8_t flags;
+  uint8_t mac[6];
+  float ch1AirPressure;
+  float ch2AirPressure;
+  float atmosphericPressure;
+  float temperature;
+  float ch1Weight;
+  float ch2Weight;
+  float ch1WeightStdDev;
+  float ch2WeightStdDev;
+  uint8_t batteryLevel;
+  int8_t rssi;
+  uint8_t fw[3];
+  uint32_t ageMs;
+  int16_t skewMs;
+  float linkLoss;          // 0..1, < 0 = unknown
+  float linkJitterMs;      // < 0 = unknown
+};
+
+static inline size_t fleetFrameBegin(uint8_t* out, uint8_t refresh, uint8_t index,
+                                     uint8_t devices, float fleetTotal) {
+  out[0] = BLE_FLEET_MAGIC;
+  out[1] = BLE_FLEET_VERSION;
+  out[2] = refresh;
+  out[3] = index;
+  out[4] = 0;
+  out[5] = 0;
+  out[6] = BLE_FLEET_RECORD_SIZE;
+  out[7] = devices;
+  framePutF32(out + 8, fleetTotal);
+  return BLE_FLEET_HEADER_SIZE;
+}
+
+static inline void fleetFrameSetFlags(uint8_t* frame, uint8_t flags) { frame[4] |= flags; }
+
+// Append one record to a frame of len bytes; returns the new length, or 0 if the
+// record doesn't fit in cap
+static inline size_t fleetFrameAppend(uint8_t* frame, size_t len, size_t cap, const FleetRecord& r) {
+  if (len + BLE_FLEET_RECORD_SIZE > cap || frame[5] == 255) return 0;
+  uint8_t* p = frame + len;
+  p[0] = r.flags;
+  memcpy(p + 1, r.mac, 6);
+  framePutU16(p + 7, (uint16_t)frameQuantize(r.ch1AirPressure, 100.0f, 0, 65535));
+  framePutU16(p + 9, (uint16_t)frameQuantize(r.ch2AirPressure, 100.0f, 0, 65535));
+  framePutU16(p + 11, (uint16_t)frameQuantize(r.atmosphericPressure, 1000.0f, 0, 65535));
+  framePutU16(p + 13, (uint16_t)(int16_t)frameQuantize(r.temperature, 100.0f, -32768, 32767));
+  framePutU32(p + 15, (uint32_t)frameQuantize(r.ch1Weight, 10.0f, -2000000000, 2000000000));
+  framePutU32(p + 19, (uint32_t)frameQuantize(r.ch2Weight, 10.0f, -2000000000, 2000000000));
+  framePutU16(p + 23, (uint16_t)frameQuantize(r.ch1WeightStdDev, 10.0f, 0, 65535));
+  framePutU16(p + 25, (uint16_t)frameQuantize(r.ch2WeightStdDev, 10.0f, 0, 65535));
+  p[27] = r.batteryLevel;
+  p[28] = (uint8_t)r.rssi;
+  memcpy(p + 29, r.fw, 3);
+  framePutU16(p + 32, (uint16_t)(r.ageMs / 100 < 65535 ? r.ageMs / 100 : 65535));
+  framePutU16(p + 34, (uint16_t)r.skewMs);
+  p[36] = r.linkLoss < 0.0f ? BLE_FLEET_LINK_UNKNOWN : (uint8_t)frameQuantize(r.linkLoss, 200.0f, 0, 200);
+  p[37] = r.linkJitterMs < 0.0f ? BLE_FLEET_LINK_UNKNOWN : (uint8_t)frameQuantize(r.linkJitterMs, 1.0f, 0, 254);
+  frame[5]++;
+  return len + BLE_FLEET_RECORD_SIZE;
+}
+
+// Record i of a frame, mirroring the parser in webapp ble.js. False if out of range.
+static inline bool fleetFrameRecord(const uint8_t* frame, size_t len, uint8_t i, FleetRecord& r) {
+  if (len < BLE_FLEET_HEADER_SIZE || frame[0] != BLE_FLEET_MAGIC || i >= frame[5]) return false;
+  size_t size = frame[6];
+  if (size < BLE_FLEET_RECORD_V1_SIZE || BLE_FLEET_HEADER_SIZE + (i + 1) * size > len) return false;
+  const uint8_t* p = frame + BLE_FLEET_HEADER_SIZE + i * size;
+  r.flags = p[0];
+  memcpy(r.mac, p + 1, 6);
+  r.ch1AirPressure = frameGetU16(p + 7) / 100.0f;
+  r.ch2AirPressure = frameGetU16(p + 9) / 100.0f;
+  r.atmosphericPressure = frameGetU16(p + 11) / 1000.0f;
+  r.temperature = (int16_t)frameGetU16(p + 13) / 100.0f;
+  r.ch1Weight = (int32_t)frameGetU32(p + 15) / 10.0f;
+  r.ch2Weight = (int32_t)frameGetU32(p + 19) / 10.0f;
+  r.ch1WeightStdDev = frameGetU16(p + 23) / 10.0f;
+  r.ch2WeightStdDev = frameGetU16(p + 25) / 10.0f;
+  r.batteryLevel = p[27];
+  r.rssi = (int8_t)p[28];
+  memcpy(r.fw, p + 29, 3);
+  r.ageMs = frameGetU16(p + 32) * 100u;
+  r.skewMs = size >= BLE_FLEET_RECORD_V2_SIZE ? (int16_t)frameGetU16(p + 34) : (int16_t)BLE_FLEET_SKEW_UNKNOWN;
+  bool link = size >= BLE_FLEET_RECORD_SIZE;
+  r.linkLoss = link && p[36] != BLE_FLEET_LINK_UNKNOWN ? p[36] / 200.0f : -1.0f;
+  r.linkJitterMs = link && p[37] != BLE_FLEET_LINK_UNKNOWN ? (float)p[37] : -1.0f;
+  return true;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+// Change-driven ESP-NOW broadcasts. Instead of a fixed timer, a node reports as
+// soon as a channel moved past its deadband since the last broadcast, every
+// fastUs while a channel is moving faster than the rate threshold (loading), and
+// otherwise sends heartbeats that back off exponentially from heartbeatMinUs to
+// heartbeatMaxUs while nothing changes. Since every move past the deadband goes
+// out at once, a steady node's last report holds until its next one.
+//
+// The scheduler only decides why and how often; the radio task places the
+// heartbeats on the mesh time grid and adds jitter. Feed it every decimated
+// sample. Not thread-safe. Host-buildable.
+
+#include <stdint.h>
+#include <math.h>
+
+enum BroadcastReason : uint8_t {
+  BROADCAST_NONE,
+  BROADCAST_CHANGE,           // A channel moved past its deadband
+  BROADCAST_LOADING,          // A channel is moving faster than the rate threshold
+  BROADCAST_HEARTBEAT
+};
+
+struct BroadcastPolicyConfig {
+  float deadband[2];          // lbs, per channel
+  float rateLbsPerSec;        // Loading above this; it ends below half of it
+  uint32_t rateWindowUs;      // Rate is measured across this much time, so sample noise averages out
+  uint32_t fastUs;            // Interval while loading, and floor between change reports
+  uint32_t heartbeatMinUs;    // First heartbeat after a change
+  uint32_t heartbeatMaxUs;    // Backoff cap
+};
+
+class BroadcastScheduler {
+ public:
+  explicit BroadcastScheduler(const BroadcastPolicyConfig& c)
+      : _c(c), _heartbeatUs(c.heartbeatMinUs), _anchorUs(0), _rate(0.0f), _loading(false), _haveSample(false),
+        _haveSent(false) {
+    _last[0] = _last[1] = 0.0f;
+    _sent[0] = _sent[1] = 0.0f;
+    _anchor[0] = _anchor[1] = 0.0f;
+  }
+
+  void sample(float ch1, float ch2, int64_t nowUs) {
+    _last[0] = ch1;
+    _last[1] = ch2;
+    if (!_haveSample || nowUs < _anchorUs) {
+      anchor(nowUs);
+      _haveSample = true;
+    } else if (nowUs - _anchorUs >= (int64_t)_c.rateWindowUs) {
+      float dt = (float)(nowUs - _anchorUs) / 1e6f;
+      float r1 = fabsf(ch1 - _anchor[0]) / dt;
+      float r2 = fabsf(ch2 - _anchor[1]) / dt;
+      _rate = r1 > r2 ? r1 : r2;
+      anchor(nowUs);
+    }
+    if (_rate >= _c.rateLbsPerSec) _loading = true;
+    else if (_rate < _c.rateLbsPerSec / 2) _loading = false;
+  }
+
+  // Why the newest sample should go out as soon as the floor allows, BROADCAST_NONE
+  // if it can wait for the heartbeat
+  BroadcastReason pending() const {
+    if (!_haveSample) return BROADCAST_NONE;
+    if (!_haveSent || exceeds(_last[0] - _sent[0], _c.deadband[0]) || exceeds(_last[1] - _sent[1], _c.deadband[1])) {
+      return BROADCAST_CHANGE;
+    }
+    return _loading ? BROADCAST_LOADING : BROADCAST_NONE;
+  }
+
+  // A broadcast of the newest sample went out. Changes restart the backoff; each
+  // heartbeat doubles it.
+  void sent(BroadcastReason reason) {
+    _sent[0] = _last[0];
+    _sent[1] = _last[1];
+    _haveSent = true;
+    if (reason == BROADCAST_HEARTBEAT) {
+      _heartbeatUs = _heartbeatUs >= _c.heartbeatMaxUs / 2 ? _c.heartbeatMaxUs : _heartbeatUs * 2;
+    } else {
+      _heartbeatUs = _c.heartbeatMinUs;
+    }
+  }
+
+  uint32_t heartbeatUs() const { return _heartbeatUs; }
+  uint32_t fastUs() const { return _c.fastUs; }
+  float rate() const { return _rate; }
+  bool loading() const { return _loading; }
+
+ private:
+  void anchor(int64_t nowUs) {
+    _anchor[0] = _last[0];
+    _anchor[1] = _last[1];
+    _anchorUs = nowUs;
+  }
+
+  static bool exceeds(float delta, float deadband) {
+    return deadband > 0.0f ? fabsf(delta) >= deadband : delta != 0.0f;
+  }
+
+  BroadcastPolicyConfig _c;
+  uint32_t _heartbeatUs;
+  int64_t _anchorUs;          // Start of the current rate window
+  float _anchor[2];
+  float _last[2];
+  float _sent[2];
+  float _rate;                // lbs/s, fastest channel
+  bool _loading;
+  bool _haveSample;
+  bool _haveSent;
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+// Fixed pool of equally sized buffers with a lock-free free-list (one atomic bitmap),
+// so radio callbacks can grab a buffer without malloc or a mutex. Any task may
+// acquire or release. Host-buildable.
+
+#include <stdint.h>
+#include <atomic>
+
+template <uint8_t COUNT, uint16_t SIZE>
+class BufferPool {
+ public:
+  static_assert(COUNT >= 1 && COUNT <= 32, "pool holds 1..32 buffers");
+
+  BufferPool() : _free(COUNT == 32 ? 0xFFFFFFFFu : ((1u << COUNT) - 1)) {}
+
+  // Returns a slot index, or -1 when every buffer is in use
+  int acquire() {
+    uint32_t f = _free.load(std::memory_order_acquire);
+    while (f) {
+      uint32_t bit = f & (~f + 1);  // Lowest free slot
+      if (_free.compare_exchange_weak(f, f & ~bit, std::memory_order_acq_rel)) {
+        uint32_t used = COUNT - __builtin_popcount(f & ~bit);
+        uint32_t peak = _peak.load(std::memory_order_relaxed);
+        while (used > peak && !_peak.compare_exchange_weak(peak, used, std::memory_order_relaxed)) {}
+        return __builtin_ctz(bit);
+      }
+    }
+    return -1;
+  }
+
+  void release(int slot) {
+    if (slot >= 0 && slot < COUNT) _free.fetch_or(1u << slot, std::memory_order_release);
+  }
+
+  uint8_t* data(int slot) { return _buf[slot]; }
+  uint32_t available() const { return __builtin_popcount(_free.load(std::memory_order_relaxed)); }
+  uint32_t peakInUse() const { return _peak.load(std::memory_order_relaxed); }
+  static constexpr uint8_t count() { return COUNT; }
+  static constexpr uint16_t bufferSize() { return SIZE; }
+
+ private:
+  alignas(4) uint8_t _buf[COUNT][SIZE];
+  std::atomic<uint32_t> _free;
+  std::atomic<uint32_t> _peak{0};
+};
@@ -0,0 +1,147 @@
+#pragma once
+
+// Binary batch of calibration records written by the app to the batch coefficient
+// characteristic, and the per-record status the hub notifies back. One batch may
+// span several writes (chunks); it is acted on when the chunk flagged
+// COEFF_BATCH_LAST arrives.
+//
+//   write (little endian)
+//     u8  op           COEFF_BATCH_OP_RECORDS
+//     u8  batchId      Chosen by the app; a new id discards a partial batch
+//     u8  flags        COEFF_BATCH_FIRST on the first chunk (discards a partial
+//                      batch, whatever its id), COEFF_BATCH_LAST on the final one
+//     u8  count        Records in this chunk
+//     records, COEFF_BATCH_RECORD_SIZE bytes each:
+//       u8  mac[6]     Target; all zero = the hub itself
+//       u8  channel    1 or 2
+//       f32 intercept, airPressureCoeff, ambientPressureCoeff, airTempCoeff
+//       u32 version    0 = assigned by the hub
+//
+//   status notification, split over as many as the MTU needs
+//     u8  batchId
+//     u8  flags        COEFF_BATCH_LAST once no record is still in progress
+//     u8  count        Records in the batch
+//     u8  first        Index of the first record in this notification
+//     per record from there: u8 status (CoeffRecordStatus), u32 version
+//
+// Host-buildable.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "espnow_frame.h"
+#include "mac_index.h"
+
+#define COEFF_BATCH_OP_RECORDS     0x01
+#define COEFF_BATCH_LAST           0x01
+#define COEFF_BATCH_FIRST          0x02
+#define COEFF_BATCH_HEADER_SIZE    4
+#define COEFF_BATCH_RECORD_SIZE    27
+#define COEFF_BATCH_STATUS_HEADER_SIZE 4
+#define COEFF_BATCH_STATUS_SIZE    5
+#define COEFF_BATCH_MAX            32    // 16 trailers, both channels
+
+enum CoeffRecordStatus : uint8_t {
+  COEFF_REC_APPLIED = 0,     // Hub's own record, stored
+  COEFF_REC_QUEUED = 1,      // Delivery to the slave in progress
+  COEFF_REC_DELIVERED = 2,   // Slave acknowledged
+  COEFF_REC_FAILED = 3,      // Slave never acknowledged
+  COEFF_REC_SENT = 4,        // Legacy node: sent, it can't acknowledge
+  COEFF_REC_INVALID = 5,     // Bad channel; for hub records, none of the hub's were applied
+  COEFF_REC_DROPPED = 6,     // Hub out of room (delivery table or radio queue)
+  COEFF_REC_SUPERSEDED = 7,  // A later record for the same device and channel replaced it
+};
+
+enum CoeffBatchFeed : uint8_t {
+  COEFF_BATCH_PARTIAL,       // More chunks expected
+  COEFF_BATCH_COMPLETE,
+  COEFF_BATCH_MALFORMED,     // Chunk ignored
+};
+
+struct CoeffBatchRecord {
+  MacKey target;             // 0 = hub
+  uint8_t channel;
+  float intercept;
+  float airPressureCoeff;
+  float ambientPressureCoeff;
+  float airTempCoeff;
+  uint32_t version;
+  uint8_t status;
+};
+
+struct CoeffBatch {
+  uint8_t id;
+  uint8_t count;
+  CoeffBatchRecord records[COEFF_BATCH_MAX];
+
+  void clear() {
+    id = 0;
+    count = 0;
+  }
+
+  // Append one written chunk
+  CoeffBatchFeed feed(const uint8_t* in, size_t len) {
+    if (len < COEFF_BATCH_HEADER_SIZE || in[0] != COEFF_BATCH_OP_RECORDS) return COEFF_BATCH_MALFORMED;
+    uint8_t n = in[3];
+    if (len < COEFF_BATCH_HEADER_SIZE + (size_t)n * COEFF_BATCH_RECORD_SIZE) return COEFF_BATCH_MALFORMED;
+    if (in[1] != id || (in[2] & COEFF_BATCH_FIRST)) {
+      id = in[1];
+      count = 0;
+    }
+    if (count + n > COEFF_BATCH_MAX) {
+      count = 0;
+      return COEFF_BATCH_MALFORMED;
+    }
+
+    const uint8_t* p = in + COEFF_BATCH_HEADER_SIZE;
+    for (uint8_t i = 0; i < n; i++, p += COEFF_BATCH_RECORD_SIZE) {
+      CoeffBatchRecord& r = records[count++];
+      r.target = macKeyFromBytes(p);
+      r.channel = p[6];
+      r.intercept = frameGetF32(p + 7);
+      r.airPressureCoeff = frameGetF32(p + 11);
+      r.ambientPressureCoeff = frameGetF32(p + 15);
+      r.airTempCoeff = frameGetF32(p + 19);
+      r.version = frameGetU32(p + 23);
+      r.status = COEFF_REC_QUEUED;
+    }
+    return (in[2] & COEFF_BATCH_LAST) ? COEFF_BATCH_COMPLETE : COEFF_BATCH_PARTIAL;
+  }
+
+  // Settle an in-progress record; false if no record matches
+  bool settle(MacKey target, uint8_t channel, uint32_t version, uint8_t status) {
+    for (uint8_t i = 0; i < count; i++) {
+      CoeffBatchRecord& r = records[i];
+      if (r.status == COEFF_REC_QUEUED && r.target == target && r.channel == channel && r.version == version) {
+        r.status = status;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool inProgress() const {
+    for (uint8_t i = 0; i < count; i++) {
+      if (records[i].status == COEFF_REC_QUEUED) return true;
+    }
+    return false;
+  }
+
+  // One status notification: the records from 'next' on that fit in cap, advancing
+  // next. Done once next reaches count; 0 if cap can't hold a record.
+  size_t encodeStatus(uint8_t* out, size_t cap, uint8_t& next) const {
+    if (cap < COEFF_BATCH_STATUS_HEADER_SIZE + COEFF_BATCH_STATUS_SIZE) return 0;
+    out[0] = id;
+    out[1] = inProgress() ? 0 : COEFF_BATCH_LAST;
+    out[2] = count;
+    out[3] = next;
+    size_t len = COEFF_BATCH_STATUS_HEADER_SIZE;
+    while (next < count && len + COEFF_BATCH_STATUS_SIZE <= cap) {
+      out[len] = records[next].status;
+      framePutU32(out + len + 1, records[next].version);
+      len += COEFF_BATCH_STATUS_SIZE;
+      next++;
+    }
+    return len;
+  }
+};
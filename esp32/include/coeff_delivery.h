@@ -0,0 +1,196 @@
+#pragma once
+
+// Acknowledged coefficient delivery from the hub to its slaves. Each queued set
+// is sent as a FRAME_COEFFS unicast and retransmitted with exponential backoff
+// until the slave answers with a FRAME_COEFFS_ACK for that channel and version,
+// or maxAttempts sends went unanswered. At most 'window' deliveries are in flight
+// at once (each one holds a unicast peer), the rest wait in FIFO order.
+//
+// A batch is everything queued while the table was non-empty: the time from the
+// first enqueue until the table drains is the fleet push time. Worst case for a
+// batch of n sets is about ceil(n / window) * the sum of all backoff intervals.
+//
+// Times are microseconds on one monotonic clock. Not thread-safe: the radio task
+// owns it. Host-buildable.
+
+#include <stdint.h>
+#include "mac_index.h"
+#include "espnow_frame.h"
+
+enum CoeffDeliveryState : uint8_t {
+  DELIVERY_FREE,
+  DELIVERY_QUEUED,
+  DELIVERY_IN_FLIGHT,
+};
+
+struct CoeffDelivery {
+  MacKey target;
+  CoeffsReport coeffs;
+  uint8_t state;
+  uint8_t attempts;     // Sends so far
+  int64_t enqueuedUs;
+  int64_t nextTxUs;     // Retransmit (or give up) at
+};
+
+struct CoeffBatchResult {
+  uint32_t delivered;
+  uint32_t failed;
+  int64_t durationUs;
+};
+
+template <uint16_t N>
+class CoeffDeliveryQueue {
+ public:
+  CoeffDeliveryQueue(uint32_t baseBackoffUs, uint32_t maxBackoffUs, uint8_t maxAttempts, uint8_t window)
+      : _baseBackoffUs(baseBackoffUs), _maxBackoffUs(maxBackoffUs), _maxAttempts(maxAttempts), _window(window),
+        _pending(0), _inFlight(0), _delivered(0), _failed(0), _retransmits(0),
+        _batchStartUs(0), _batchDone(false) {
+    for (uint16_t i = 0; i < N; i++) _items[i].state = DELIVERY_FREE;
+    _batch.delivered = _batch.failed = 0;
+    _batch.durationUs = 0;
+  }
+
+  // Queue a set. A newer set for the same target and channel replaces the old one
+  // (in flight: it is resent right away with a fresh attempt count) and its version
+  // goes to 'superseded' (0 otherwise). False if full.
+  bool enqueue(MacKey target, const CoeffsReport& coeffs, int64_t nowUs, uint32_t* superseded = nullptr) {
+    if (superseded) *superseded = 0;
+    CoeffDelivery* slot = nullptr;
+    for (uint16_t i = 0; i < N; i++) {
+      CoeffDelivery& d = _items[i];
+      if (d.state != DELIVERY_FREE && d.target == target && d.coeffs.channel == coeffs.channel) {
+        if (superseded) *superseded = d.coeffs.version;
+        d.coeffs = coeffs;
+        d.attempts = 0;
+        d.nextTxUs = nowUs;
+        return true;
+      }
+      if (!slot && d.state == DELIVERY_FREE) slot = &d;
+    }
+    if (!slot) return false;
+
+    if (_pending == 0) {
+      _batchStartUs = nowUs;
+      _batch.delivered = _batch.failed = 0;
+    }
+    slot->target = target;
+    slot->coeffs = coeffs;
+    slot->state = DELIVERY_QUEUED;
+    slot->attempts = 0;
+    slot->enqueuedUs = nowUs;
+    slot->nextTxUs = nowUs;
+    _pending++;
+    return true;
+  }
+
+  // A delivery to send now: an in-flight one whose retransmit is due, else the
+  // oldest queued one if the window has room (still DELIVERY_QUEUED - the caller
+  // registers the peer, then calls sent()). Null when nothing is due.
+  CoeffDelivery* nextDue(int64_t nowUs) {
+    CoeffDelivery* oldest = nullptr;
+    for (uint16_t i = 0; i < N; i++) {
+      CoeffDelivery& d = _items[i];
+      if (d.state == DELIVERY_IN_FLIGHT && d.attempts < _maxAttempts && d.nextTxUs <= nowUs) return &d;
+      if (d.state == DELIVERY_QUEUED && (!oldest || d.enqueuedUs < oldest->enqueuedUs)) oldest = &d;
+    }
+    return _inFlight < _window ? oldest : nullptr;
+  }
+
+  // An in-flight delivery that used up its attempts without an ack
+  CoeffDelivery* nextExpired(int64_t nowUs) {
+    for (uint16_t i = 0; i < N; i++) {
+      CoeffDelivery& d = _items[i];
+      if (d.state == DELIVERY_IN_FLIGHT && d.attempts >= _maxAttempts && d.nextTxUs <= nowUs) return &d;
+    }
+    return nullptr;
+  }
+
+  // Record a send and arm the next retransmit
+  void sent(CoeffDelivery* d, int64_t nowUs, uint32_t jitterUs = 0) {
+    if (d->state == DELIVERY_QUEUED) {
+      d->state = DELIVERY_IN_FLIGHT;
+      _inFlight++;
+    } else {
+      _retransmits++;
+    }
+    d->attempts++;
+    d->nextTxUs = nowUs + backoffUs(d->attempts) + jitterUs;
+  }
+
+  // In-flight delivery an ack answers, or null (late/duplicate ack, superseded version)
+  CoeffDelivery* findInFlight(MacKey target, uint8_t channel, uint32_t version) {
+    for (uint16_t i = 0; i < N; i++) {
+      CoeffDelivery& d = _items[i];
+      if (d.state == DELIVERY_IN_FLIGHT && d.target == target &&
+          d.coeffs.channel == channel && d.coeffs.version == version) {
+        return &d;
+      }
+    }
+    return nullptr;
+  }
+
+  // Retire a delivery; returns its enqueue-to-finish time
+  int64_t finish(CoeffDelivery* d, bool delivered, int64_t nowUs) {
+    if (d->state == DELIVERY_IN_FLIGHT) _inFlight--;
+    d->state = DELIVERY_FREE;
+    _pending--;
+    if (delivered) {
+      _delivered++;
+      _batch.delivered++;
+    } else {
+      _failed++;
+      _batch.failed++;
+    }
+    if (_pending == 0) {
+      _batch.durationUs = nowUs - _batchStartUs;
+      _batchDone = true;
+    }
+    return nowUs - d->enqueuedUs;
+  }
+
+  // Once per drained batch
+  bool takeBatchResult(CoeffBatchResult& out) {
+    if (!_batchDone) return false;
+    _batchDone = false;
+    out = _batch;
+    return true;
+  }
+
+  // When the owner must next call nextDue()/nextExpired(), INT64_MAX if idle
+  int64_t nextDeadline(int64_t nowUs) const {
+    int64_t next = INT64_MAX;
+    for (uint16_t i = 0; i < N; i++) {
+      const CoeffDelivery& d = _items[i];
+      if (d.state == DELIVERY_IN_FLIGHT && d.nextTxUs < next) next = d.nextTxUs;
+      if (d.state == DELIVERY_QUEUED && _inFlight < _window) return nowUs;
+    }
+    return next;
+  }
+
+  uint16_t pending() const { return _pending; }
+  uint16_t inFlight() const { return _inFlight; }
+  uint32_t delivered() const { return _delivered; }
+  uint32_t failed() const { return _failed; }
+  uint32_t retransmits() const { return _retransmits; }
+
+ private:
+  uint32_t backoffUs(uint8_t attempts) const {
+    uint32_t us = _baseBackoffUs;
+    for (uint8_t i = 1; i < attempts && us < _maxBackoffUs; i++) us *= 2;
+    return us < _maxBackoffUs ? us : _maxBackoffUs;
+  }
+
+  CoeffDelivery _items[N];
+  uint32_t _baseBackoffUs;
+  uint32_t _maxBackoffUs;
+  uint8_t _maxAttempts;
+  uint8_t _window;
+  uint16_t _pending;
+  uint16_t _inFlight;
+  uint32_t _delivered;
+  uint32_t _failed;
+  uint32_t _retransmits;
+  int64_t _batchStartUs;
+  bool _batchDone;
+  CoeffBatchResult _batch;
+};
@@ -0,0 +1,157 @@
+#pragma once
+
+// Delta firmware update: a patch that turns the app the device runs into the new
+// one, so an update changing a little code costs a little more than that to send
+// (bsdiff's approach). The phone makes it against the exact running build, named
+// by the SHA-256 esp_partition_get_sha256() gives for the running partition (the
+// digest esptool appends to the image), and sends it LZSS-compressed in an OTA
+// container (ota_image.h, OTA_CODEC_DELTA).
+//
+//   header, DELTA_PATCH_HEADER_SIZE bytes (little endian)
+//     u32 magic        DELTA_PATCH_MAGIC ("ASP1")
+//     u32 baseSize     Running image bytes the patch may read
+//     u8  baseSha256[32]
+//   records, until the new image is complete
+//     u32 diffLen      New bytes that are base bytes plus these (mod 256), read from the base position on
+//     u32 extraLen     New bytes as they are
+//     i32 seek         Base position moves on by diffLen, then by this
+//     diffLen bytes, then extraLen bytes
+//
+// Code that only moved lines up with the base under a diff of mostly zeros, which
+// the LZSS around the patch all but removes.
+//
+// DeltaPatcher applies it as a stream. Base bytes are read through a callback
+// straight into the output buffer and the diff added in place, so it keeps nothing
+// but a record header. Not thread-safe. Host-buildable.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define DELTA_PATCH_MAGIC        0x31505341u  // "ASP1"
+#define DELTA_PATCH_HEADER_SIZE  40
+#define DELTA_PATCH_RECORD_SIZE  12
+
+class DeltaPatcher {
+ public:
+  // Read base[offset, offset + len) into out
+  typedef bool (*ReadBase)(void* ctx, uint32_t offset, uint8_t* out, size_t len);
+
+  DeltaPatcher() : _read(nullptr), _ctx(nullptr) { begin(nullptr, nullptr); }
+
+  void begin(ReadBase read, void* ctx) {
+    _read = read;
+    _ctx = ctx;
+    _phase = HEADER;
+    _have = 0;
+    _left = 0;
+    _extraLen = 0;
+    _seek = 0;
+    _basePos = 0;
+    _baseSize = 0;
+    _failed = false;
+  }
+
+  // Patch bytes in[0..inLen) into out[0..outLen). Returns the input used;
+  // 'produced' is the output written. Returns as soon as the header is in, so the
+  // caller can check baseSha256() before a base byte is read.
+  size_t apply(const uint8_t* in, size_t inLen, uint8_t* out, size_t outLen, size_t& produced) {
+    size_t used = 0;
+    produced = 0;
+    while (!_failed && used < inLen) {
+      if (_phase == HEADER || _phase == RECORD) {
+        size_t want = _phase == HEADER ? DELTA_PATCH_HEADER_SIZE : DELTA_PATCH_RECORD_SIZE;
+        size_t n = want - _have < inLen - used ? want - _have : inLen - used;
+        memcpy(_buf + _have, in + used, n);
+        _have += n;
+        used += n;
+        if (_have < want) break;
+        _have = 0;
+        if (_phase == HEADER) {
+          readHeader();
+          break;
+        }
+        readRecord();
+        continue;
+      }
+
+      if (produced == outLen) break;
+      size_t n = _left;
+      if (n > inLen - used) n = inLen - used;
+      if (n > outLen - produced) n = outLen - produced;
+      if (_phase == DIFF) {
+        if (!_read(_ctx, (uint32_t)_basePos, out + produced, n)) {
+          _failed = true;
+          break;
+        }
+        for (size_t i = 0; i < n; i++) out[produced + i] += in[used + i];
+        _basePos += n;
+      } else {
+        memcpy(out + produced, in + used, n);
+      }
+      used += n;
+      produced += n;
+      _left -= (uint32_t)n;
+      if (_left == 0) advance();
+    }
+    return used;
+  }
+
+  bool ready() const { return _phase != HEADER; }  // Header in
+  uint32_t baseSize() const { return _baseSize; }
+  const uint8_t* baseSha256() const { return _baseSha256; }
+  bool failed() const { return _failed; }
+  // Between records: a patch ending anywhere else is cut short
+  bool atBoundary() const { return _phase == RECORD && _have == 0; }
+
+ private:
+  enum Phase : uint8_t { HEADER, RECORD, DIFF, EXTRA };
+
+  static uint32_t le32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+  }
+
+  void readHeader() {
+    if (le32(_buf) != DELTA_PATCH_MAGIC) _failed = true;
+    _baseSize = le32(_buf + 4);
+    memcpy(_baseSha256, _buf + 8, sizeof(_baseSha256));
+    _phase = RECORD;
+  }
+
+  // A diff reads base[_basePos, _basePos + diffLen); only then does the base
+  // position have to be in range
+  void readRecord() {
+    uint32_t diffLen = le32(_buf);
+    _extraLen = le32(_buf + 4);
+    _seek = (int32_t)le32(_buf + 8);
+    if (diffLen > 0 && (_basePos < 0 || _basePos + diffLen > (int64_t)_baseSize)) _failed = true;
+    _phase = DIFF;
+    _left = diffLen;
+    advance();
+  }
+
+  // On past the phases that are done (or empty)
+  void advance() {
+    if (_phase == DIFF && _left == 0) {
+      _phase = EXTRA;
+      _left = _extraLen;
+    }
+    if (_phase == EXTRA && _left == 0) {
+      _basePos += _seek;
+      _phase = RECORD;
+    }
+  }
+
+  ReadBase _read;
+  void* _ctx;
+  uint8_t _phase;
+  uint8_t _have;              // Header or record bytes gathered in _buf
+  uint8_t _buf[DELTA_PATCH_HEADER_SIZE];
+  uint32_t _left;             // Of the diff or extra being copied
+  uint32_t _extraLen;
+  int32_t _seek;
+  int64_t _basePos;
+  uint32_t _baseSize;
+  uint8_t _baseSha256[32];
+  bool _failed;
+};
@@ -0,0 +1,601 @@
+#pragma once
+
+// Compact versioned ESP-NOW frame format. Replaces sending the raw ESPNowData
+// struct (104 bytes, with an ASCII MAC and a device name in every packet).
+//
+//   header (7 bytes)
+//     u8  magic        ESPNOW_FRAME_MAGIC, never a legal first byte of ESPNowData
+//     u8  version      Format version of the sender
+//     u8  type         FRAME_*
+//     u16 seq          Per-sender sequence number (loss accounting)
+//     u8  length       Bytes after the header (fixed fields + TLVs)
+//     u8  fixedLength  Bytes of fixed fields; TLV extensions follow
+//   fixed fields       Quantized fixed point, little endian, per type
+//   TLVs               u8 type, u8 len, value; unknown types are skipped
+//
+// Compatibility rules: fixed fields are only ever appended in new versions, so a
+// receiver reads the ones it knows and zero-fills those the sender didn't have;
+// new optional data goes into TLVs. The sender's MAC is not in the frame, the
+// radio reports it. All encoding is explicit byte by byte. Host-buildable.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+#define ESPNOW_FRAME_MAGIC       0xA5
+#define ESPNOW_FRAME_VERSION     1
+#define ESPNOW_FRAME_HEADER_SIZE 7
+#define ESPNOW_FRAME_MAX         250   // ESP-NOW payload limit
+
+enum FrameType : uint8_t {
+  FRAME_SENSOR = 1,
+  FRAME_COEFFS = 2,       // Unicast hub -> slave, answered with FRAME_COEFFS_ACK
+  FRAME_COEFFS_ACK = 3,
+  FRAME_TIME_SYNC = 4,    // Hub broadcast: mesh time beacon (see time_sync.h)
+  FRAME_WEIGH_TRIGGER = 5,  // Hub broadcast: weigh now (see weigh_now.h)
+  FRAME_WEIGH_REPLY = 6,  // Unicast slave -> hub, in the slot the trigger gave it
+  FRAME_RELAY = 7,        // Unicast hop by hop: another node's frame (see mesh_relay.h)
+  FRAME_OTA_OFFER = 8,    // Hub broadcast: firmware for the slaves listed (see mesh_ota.h)
+  FRAME_OTA_DATA = 9,     // Hub broadcast: one chunk of it
+  FRAME_OTA_POLL = 10,    // Hub broadcast: listed slaves report the chunks they lack
+  FRAME_OTA_STATUS = 11,  // Unicast slave -> hub, in the slot the offer gave it
+};
+
+enum FrameTlvType : uint8_t {
+  TLV_DEVICE_NAME = 1,    // UTF-8, not terminated
+  TLV_COEFF_VERSIONS = 2, // u32 CH1, u32 CH2: coefficient versions the node has applied
+  TLV_SAMPLE_TIME = 3,    // u64 mesh time of the sample (us); only sent while synced
+  TLV_WEIGH_SLOTS = 4,    // u16 per slave asked (last two MAC bytes), in reply slot order
+  TLV_HUB_ROUTE = 5,      // Sender's route: hub MAC, u8 hops (0 = it is the hub), u8 cost (ETX x10)
+  TLV_RELAY_PAYLOAD = 6,  // The relayed frame, whole
+  TLV_AIRTIME_SLOTS = 7,  // On beacons: u16 per slave (last two MAC bytes), in airtime slot order (see airtime_plan.h)
+  TLV_FIRMWARE = 8,       // u8 major, minor, patch, u8 image[8]: leading bytes of the running image's SHA-256
+  TLV_OTA_TARGETS = 9,    // On offers: MAC per slave, in status slot order
+  TLV_OTA_CHUNK = 10,     // On data frames: the image bytes
+};
+
+struct FrameHeader {
+  uint8_t version;
+  uint8_t type;
+  uint16_t seq;
+  uint8_t length;
+  uint8_t fixedLength;
+};
+
+// Sensor broadcast, decoded. Quantization on the wire:
+//   pressures 0.01 psi (u16), ambient 0.001 psi (u16), temperature 0.01 °F (i16),
+//   elevation 1 ft (i16), weights 0.1 lb (i32), std devs 0.1 lb (u16)
+struct SensorReport {
+  float ch1AirPressure;
+  float ch2AirPressure;
+  float atmosphericPressure;
+  float temperature;
+  float elevation;
+  float ch1Weight;
+  float ch2Weight;
+  float ch1WeightStdDev;
+  float ch2WeightStdDev;
+  uint32_t timestamp;
+  uint8_t batteryLevel;  // Percent, or BATTERY_LEVEL_UNKNOWN
+  uint8_t settledFlags;  // Low bits as in ESPNowData
+  bool isCharging;
+};
+
+#define SENSOR_FIXED_SIZE 30
+#define BATTERY_LEVEL_UNKNOWN 0xFF  // No battery reading on this node
+
+// Calibration for one channel. 'version' is assigned by the hub per push; the CRC
+// covers everything before it, so a corrupted set is never applied.
+struct CoeffsReport {
+  uint8_t channel;
+  float intercept;
+  float airPressureCoeff;
+  float ambientPressureCoeff;
+  float airTempCoeff;
+  uint32_t version;
+};
+
+#define COEFFS_FIXED_SIZE 23
+
+enum CoeffsAckStatus : uint8_t {
+  COEFFS_APPLIED = 0,     // Applied now or already at this version
+  COEFFS_BAD_CRC = 1,     // Corrupted - please resend
+};
+
+struct CoeffsAck {
+  uint8_t channel;
+  uint32_t version;
+  uint8_t status;
+};
+
+#define COEFFS_ACK_FIXED_SIZE 6
+
+// Mesh time beacon: the master's clock right before the send
+#define TIME_SYNC_FIXED_SIZE 8
+
+// Weigh now: every slave takes its weights at sampleAtUs (mesh time) and replies in
+// its slot, replyAfterMs + slot * slotUs after that. masterUs is the hub's clock at
+// the send, so a slave that isn't synced can still place the instant.
+struct WeighTrigger {
+  uint8_t id;
+  int64_t masterUs;
+  int64_t sampleAtUs;
+  uint16_t replyAfterMs;
+  uint16_t slotUs;
+  uint8_t slots;          // Slots in the round, listed slaves first
+};
+
+#define WEIGH_TRIGGER_FIXED_SIZE 22
+
+// Weights at the trigger's instant; same quantization as the sensor frame
+struct WeighReply {
+  uint8_t id;
+  float ch1Weight;
+  float ch2Weight;
+  float ch1WeightStdDev;
+  float ch2WeightStdDev;
+  uint8_t flags;          // SETTLED_CH1 | SETTLED_CH2 | WEIGH_REPLY_*
+};
+
+#define WEIGH_REPLY_FIXED_SIZE 14
+#define WEIGH_REPLY_SYNCED     0x04   // Instant placed on the fitted mesh clock, not the trigger's stamp
+#define WEIGH_REPLY_STALE      0x08   // No sample close to the instant: the nearest one was used
+
+// Relay envelope. The origin's frame rides in TLV_RELAY_PAYLOAD; 'seq' is the
+// origin's relay sequence (duplicate suppression), not the header's per-hop one.
+struct RelayHeader {
+  uint8_t origin[6];
+  uint8_t target[6];      // Final destination
+  uint16_t seq;
+  uint8_t ttl;            // Hops left
+  uint8_t hops;           // Hops taken
+};
+
+#define RELAY_FIXED_SIZE 16
+#define RELAY_MAX_PAYLOAD (ESPNOW_FRAME_MAX - ESPNOW_FRAME_HEADER_SIZE - RELAY_FIXED_SIZE - 2)
+#define HUB_ROUTE_TLV_SIZE 8
+#define FIRMWARE_TLV_SIZE 11
+#define FIRMWARE_IMAGE_ID_SIZE 8
+
+// Mesh firmware update (mesh_ota.h). 'session' tells one push from the next; chunk
+// n of the image starts at n * chunkSize, and window w is chunks w * windowChunks on.
+struct OtaOffer {
+  uint16_t session;
+  uint32_t imageSize;
+  uint8_t chunkSize;
+  uint8_t windowChunks;   // At most OTA_STATUS_BITMAP_SIZE * 8
+  uint16_t slotUs;        // Status slots, counted from the poll
+  uint8_t sha256[32];     // Image digest, as esp_partition_get_sha256() gives it
+  uint8_t firmware[3];    // Its version (major, minor, patch); slaves refuse older than their own
+};
+
+#define OTA_OFFER_FIXED_SIZE 45
+#define OTA_DATA_FIXED_SIZE 4
+#define OTA_CHUNK_MAX (ESPNOW_FRAME_MAX - ESPNOW_FRAME_HEADER_SIZE - OTA_DATA_FIXED_SIZE - 2)
+
+struct OtaPoll {
+  uint16_t session;
+  uint16_t window;        // The image's window count: report the verified image
+};
+
+#define OTA_POLL_FIXED_SIZE 4
+#define OTA_STATUS_BITMAP_SIZE 16
+
+struct OtaStatus {
+  uint16_t session;
+  uint16_t window;        // Being received; the window count once all of it is in
+  uint8_t state;          // MeshOtaState
+  uint8_t error;          // OtaError when FAILED
+  uint8_t missing[OTA_STATUS_BITMAP_SIZE];  // Chunks of the window still to come, LSB first
+};
+
+#define OTA_STATUS_FIXED_SIZE 22
+
+// ------------------------------------------------------------
+// Byte helpers
+// ------------------------------------------------------------
+
+static inline void framePutU16(uint8_t* p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static inline void framePutU32(uint8_t* p, uint32_t v) {
+  p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+static inline uint16_t frameGetU16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static inline uint32_t frameGetU32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+static inline void framePutU64(uint8_t* p, uint64_t v) {
+  framePutU32(p, (uint32_t)v);
+  framePutU32(p + 4, (uint32_t)(v >> 32));
+}
+static inline uint64_t frameGetU64(const uint8_t* p) {
+  return (uint64_t)frameGetU32(p) | ((uint64_t)frameGetU32(p + 4) << 32);
+}
+static inline void framePutF32(uint8_t* p, float v) {
+  uint32_t bits;
+  memcpy(&bits, &v, 4);
+  framePutU32(p, bits);
+}
+static inline float frameGetF32(const uint8_t* p) {
+  uint32_t bits = frameGetU32(p);
+  float v;
+  memcpy(&v, &bits, 4);
+  return v;
+}
+
+// CRC-16/CCITT-FALSE
+static inline uint16_t frameCrc16(const uint8_t* data, size_t len) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (int b = 0; b < 8; b++) crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+  }
+  return crc;
+}
+
+// Round to the nearest step and saturate to [lo, hi]; NaN maps to 0
+static inline int32_t frameQuantize(float value, float scale, int32_t lo, int32_t hi) {
+  if (isnan(value)) return 0;
+  float q = value * scale;
+  if (q <= (float)lo) return lo;
+  if (q >= (float)hi) return hi;
+  return (int32_t)lroundf(q);
+}
+
+// Slot of the node whose MAC ends in 'tail' in a list of 'listed' tails (u16 each,
+// slot order). Nodes not listed share the slots after the list, picked by the tail.
+static inline uint8_t frameTailSlot(const uint8_t* tails, uint8_t listed, uint8_t slots, uint16_t tail) {
+  for (uint8_t i = 0; i < listed; i++) {
+    if (frameGetU16(tails + 2 * i) == tail) return i;
+  }
+  uint8_t spare = slots > listed ? (uint8_t)(slots - listed) : 1;
+  return (uint8_t)(listed + tail % spare);
+}
+
+// ------------------------------------------------------------
+// Encoding
+// ------------------------------------------------------------
+
+static inline size_t frameBegin(uint8_t* out, uint8_t type, uint16_t seq, uint8_t fixedLength) {
+  out[0] = ESPNOW_FRAME_MAGIC;
+  out[1] = ESPNOW_FRAME_VERSION;
+  out[2] = type;
+  framePutU16(out + 3, seq);
+  out[5] = fixedLength;
+  out[6] = fixedLength;
+  return ESPNOW_FRAME_HEADER_SIZE + fixedLength;
+}
+
+// Append one TLV to a frame of frameLen bytes. Returns the new length, or 0 if it
+// doesn't fit in cap (the frame is left unchanged).
+static inline size_t frameAppendTlv(uint8_t* frame, size_t frameLen, size_t cap,
+                                    uint8_t type, const void* value, uint8_t valueLen) {
+  if (frameLen + 2 + valueLen > cap || frameLen + 2 + valueLen > ESPNOW_FRAME_MAX) return 0;
+  frame[frameLen] = type;
+  frame[frameLen + 1] = valueLen;
+  memcpy(frame + frameLen + 2, value, valueLen);
+  frameLen += 2 + valueLen;
+  frame[5] = (uint8_t)(frameLen - ESPNOW_FRAME_HEADER_SIZE);
+  return frameLen;
+}
+
+static inline size_t encodeSensorFrame(uint8_t* out, size_t cap, uint16_t seq, const SensorReport& r) {
+  if (cap < ESPNOW_FRAME_HEADER_SIZE + SENSOR_FIXED_SIZE) return 0;
+  size_t len = frameBegin(out, FRAME_SENSOR, seq, SENSOR_FIXED_SIZE);
+  uint8_t* p = out + ESPNOW_FRAME_HEADER_SIZE;
+  framePutU16(p + 0, (uint16_t)frameQuantize(r.ch1AirPressure, 100.0f, 0, 65535));
+  framePutU16(p + 2, (uint16_t)frameQuantize(r.ch2AirPressure, 100.0f, 0, 65535));
+  framePutU16(p + 4, (uint16_t)frameQuantize(r.atmosphericPressure, 1000.0f, 0, 65535));
+  framePutU16(p + 6, (uint16_t)(int16_t)frameQuantize(r.temperature, 100.0f, -32768, 32767));
+  framePutU16(p + 8, (uint16_t)(int16_t)frameQuantize(r.elevation, 1.0f, -32768, 32767));
+  framePutU32(p + 10, (uint32_t)frameQuantize(r.ch1Weight, 10.0f, -2000000000, 2000000000));
+  framePutU32(p + 14, (uint32_t)frameQuantize(r.ch2Weight, 10.0f, -2000000000, 2000000000));
+  framePutU16(p + 18, (uint16_t)frameQuantize(r.ch1WeightStdDev, 10.0f, 0, 65535));
+  framePutU16(p + 20, (uint16_t)frameQuantize(r.ch2WeightStdDev, 10.0f, 0, 65535));
+  framePutU32(p + 22, r.timestamp);
+  p[26] = r.batteryLevel;
+  p[27] = (uint8_t)((r.settledFlags & 0x7F) | (r.isCharging ? 0x80 : 0));
+  framePutU16(p + 28, 0);  // Reserved
+  return len;
+}
+
+static inline size_t encodeCoeffsFrame(uint8_t* out, size_t cap, uint16_t seq, const CoeffsReport& c) {
+  if (cap < ESPNOW_FRAME_HEADER_SIZE + COEFFS_FIXED_SIZE) return 0;
+  size_t len = frameBegin(out, FRAME_COEFFS, seq, COEFFS_FIXED_SIZE);
+  uint8_t* p = out + ESPNOW_FRAME_HEADER_SIZE;
+  // Coefficients keep full float precision - they multiply raw readings
+  p[0] = c.channel;
+  framePutF32(p + 1, c.intercept);
+  framePutF32(p + 5, c.airPressureCoeff);
+  framePutF32(p + 9, c.ambientPressureCoeff);
+  framePutF32(p + 13, c.airTempCoeff);
+  framePutU32(p + 17, c.version);
+  framePutU16(p + 21, frameCrc16(p, 21));
+  return len;
+}
+
+static inline size_t encodeCoeffsAckFrame(uint8_t* out, size_t cap, uint16_t seq, const CoeffsAck& a) {
+  if (cap < ESPNOW_FRAME_HEADER_SIZE + COEFFS_ACK_FIXED_SIZE) return 0;
+  size_t len = frameBegin(out, FRAME_COEFFS_ACK, seq, COEFFS_ACK_FIXED_SIZE);
+  uint8_t* p = out + ESPNOW_FRAME_HEADER_SIZE;
+  p[0] = a.channel;
+  framePutU32(p + 1, a.version);
+  p[5] = a.status;
+  return len;
+}
+
+static inline size_t encodeTimeSyncFrame(uint8_t* out, size_t cap, uint16_t seq, int64_t masterUs) {
+  if (cap < ESPNOW_FRAME_HEADER_SIZE + TIME_SYNC_FIXED_SIZE) return 0;
+  size_t len = frameBegin(out, FRAME_TIME_SYNC, seq, TIME_SYNC_FIXED_SIZE);
+  framePutU64(out + ESPNOW_FRAME_HEADER_SIZE, (uint64_t)masterUs);
+  return len;
+}
+
+static inline size_t encodeWeighTriggerFrame(uint8_t* out, size_t cap, uint16_t seq, const WeighTrigger& t) {
+  if (cap < ESPNOW_FRAME_HEADER_SIZE + WEIGH_TRIGGER_FIXED_SIZE) return 0;
+  size_t len = frameBegin(out, FRAME_WEIGH_TRIGGER, seq, WEIGH_TRIGGER_FIXED_SIZE);
+  uint8_t* p = out + ESPNOW_FRAME_HEADER_SIZE;
+  p[0] = t.id;
+  framePutU64(p + 1, (uint64_t)t.masterUs);
+  framePutU64(p + 9, (uint64_t)t.sampleAtUs);
+  framePutU16(p + 17, t.replyAfterMs);
+  framePutU16(p + 19, t.slotUs);
+  p[21] = t.slots;
+  return len;
+}
+
+static inline size_t encodeWeighReplyFrame(uint8_t* out, size_t cap, uint16_t seq, const WeighReply& r) {
+  if (cap < ESPNOW_FRAME_HEADER_SIZE + WEIGH_REPLY_FIXED_SIZE) return 0;
+  size_t len = frameBegin(out, FRAME_WEIGH_REPLY, seq, WEIGH_REPLY_FIXED_SIZE);
+  uint8_t* p = out + ESPNOW_FRAME_HEADER_SIZE;
+  p[0] = r.id;
+  framePutU32(p + 1, (uint32_t)frameQuantize(r.ch1Weight, 10.0f, -2000000000, 2000000000));
+  framePutU32(p + 5, (uint32_t)frameQuantize(r.ch2Weight, 10.0f, -2000000000, 2000000000));
+  framePutU16(p + 9, (uint16_t)frameQuantize(r.ch1WeightStdDev, 10.0f, 0, 65535));
+  framePutU16(p + 11, (uint16_t)frameQuantize(r.ch2WeightStdDev, 10.0f, 0, 65535));
+  p[13] = r.flags;
+  return len;
+}
+
+// 0 if the payload doesn't fit a relay frame
+static inline size_t encodeRelayFrame(uint8_t* out, size_t cap, uint16_t seq, const RelayHeader& r,
+                                      const uint8_t* payload, size_t payloadLen) {
+  if (payloadLen > RELAY_MAX_PAYLOAD || cap < ESPNOW_FRAME_HEADER_SIZE + RELAY_FIXED_SIZE) return 0;
+  size_t len = frameBegin(out, FRAME_RELAY, seq, RELAY_FIXED_SIZE);
+  uint8_t* p = out + ESPNOW_FRAME_HEADER_SIZE;
+  memcpy(p, r.origin, 6);
+  memcpy(p + 6, r.target, 6);
+  framePutU16(p + 12, r.seq);
+  p[14] = r.ttl;
+  p[15] = r.hops;
+  return frameAppendTlv(out, len, cap, TLV_RELAY_PAYLOAD, payload, (uint8_t)payloadLen);
+}
+
+// A relay frame about to be passed on: one hop less to live, one more taken
+static inline void relayFrameStep(uint8_t* frame) {
+  uint8_t* p = frame + ESPNOW_FRAME_HEADER_SIZE;
+  if (p[14] > 0) p[14]--;
+  p[15]++;
+}
+
+static inline size_t encodeOtaOfferFrame(uint8_t* out, size_t cap, uint16_t seq, const OtaOffer& o) {
+  if (cap < ESPNOW_FRAME_HEADER_SIZE + OTA_OFFER_FIXED_SIZE) return 0;
+  size_t len = frameBegin(out, FRAME_OTA_OFFER, seq, OTA_OFFER_FIXED_SIZE);
+  uint8_t* p = out + ESPNOW_FRAME_HEADER_SIZE;
+  framePutU16(p, o.session);
+  framePutU32(p + 2, o.imageSize);
+  p[6] = o.chunkSize;
+  p[7] = o.windowChunks;
+  framePutU16(p + 8, o.slotUs);
+  memcpy(p + 10, o.sha256, 32);
+  memcpy(p + 42, o.firmware, 3);
+  return len;
+}
+
+// 0 if the chunk doesn't fit a frame
+static inline size_t encodeOtaDataFrame(uint8_t* out, size_t cap, uint16_t seq, uint16_t session, uint16_t chunk,
+                                        const uint8_t* data, size_t dataLen) {
+  if (dataLen > OTA_CHUNK_MAX || cap < ESPNOW_FRAME_HEADER_SIZE + OTA_DATA_FIXED_SIZE) return 0;
+  size_t len = frameBegin(out, FRAME_OTA_DATA, seq, OTA_DATA_FIXED_SIZE);
+  uint8_t* p = out + ESPNOW_FRAME_HEADER_SIZE;
+  framePutU16(p, session);
+  framePutU16(p + 2, chunk);
+  return frameAppendTlv(out, len, cap, TLV_OTA_CHUNK, data, (uint8_t)dataLen);
+}
+
+static inline size_t encodeOtaPollFrame(uint8_t* out, size_t cap, uint16_t seq, const OtaPoll& poll) {
+  if (cap < ESPNOW_FRAME_HEADER_SIZE + OTA_POLL_FIXED_SIZE) return 0;
+  size_t len = frameBegin(out, FRAME_OTA_POLL, seq, OTA_POLL_FIXED_SIZE);
+  uint8_t* p = out + ESPNOW_FRAME_HEADER_SIZE;
+  framePutU16(p, poll.session);
+  framePutU16(p + 2, poll.window);
+  return len;
+}
+
+static inline size_t encodeOtaStatusFrame(uint8_t* out, size_t cap, uint16_t seq, const OtaStatus& s) {
+  if (cap < ESPNOW_FRAME_HEADER_SIZE + OTA_STATUS_FIXED_SIZE) return 0;
+  size_t len = frameBegin(out, FRAME_OTA_STATUS, seq, OTA_STATUS_FIXED_SIZE);
+  uint8_t* p = out + ESPNOW_FRAME_HEADER_SIZE;
+  framePutU16(p, s.session);
+  framePutU16(p + 2, s.window);
+  p[4] = s.state;
+  p[5] = s.error;
+  memcpy(p + 6, s.missing, OTA_STATUS_BITMAP_SIZE);
+  return len;
+}
+
+// ------------------------------------------------------------
+// Decoding
+// ------------------------------------------------------------
+
+static inline bool isCompactFrame(const uint8_t* in, size_t len) {
+  return len >= ESPNOW_FRAME_HEADER_SIZE && in[0] == ESPNOW_FRAME_MAGIC;
+}
+
+// Validates magic and lengths. Any version is accepted (see compatibility rules).
+static inline bool decodeFrameHeader(const uint8_t* in, size_t len, FrameHeader& h) {
+  if (!isCompactFrame(in, len)) return false;
+  h.version = in[1];
+  h.type = in[2];
+  h.seq = frameGetU16(in + 3);
+  h.length = in[5];
+  h.fixedLength = in[6];
+  if (h.version == 0) return false;
+  if ((size_t)ESPNOW_FRAME_HEADER_SIZE + h.length > len) return false;  // Truncated
+  if (h.fixedLength > h.length) return false;
+  return true;
+}
+
+// Copy of the fixed fields, zero-filled past what the sender provided
+static inline void frameFixedFields(const uint8_t* in, const FrameHeader& h, uint8_t* out, size_t known) {
+  memset(out, 0, known);
+  memcpy(out, in + ESPNOW_FRAME_HEADER_SIZE, h.fixedLength < known ? h.fixedLength : known);
+}
+
+static inline bool decodeSensorFrame(const uint8_t* in, const FrameHeader& h, SensorReport& r) {
+  if (h.type != FRAME_SENSOR) return false;
+  uint8_t p[SENSOR_FIXED_SIZE];
+  frameFixedFields(in, h, p, sizeof(p));
+  r.ch1AirPressure = frameGetU16(p + 0) / 100.0f;
+  r.ch2AirPressure = frameGetU16(p + 2) / 100.0f;
+  r.atmosphericPressure = frameGetU16(p + 4) / 1000.0f;
+  r.temperature = (int16_t)frameGetU16(p + 6) / 100.0f;
+  r.elevation = (int16_t)frameGetU16(p + 8);
+  r.ch1Weight = (int32_t)frameGetU32(p + 10) / 10.0f;
+  r.ch2Weight = (int32_t)frameGetU32(p + 14) / 10.0f;
+  r.ch1WeightStdDev = frameGetU16(p + 18) / 10.0f;
+  r.ch2WeightStdDev = frameGetU16(p + 20) / 10.0f;
+  r.timestamp = frameGetU32(p + 22);
+  r.batteryLevel = p[26];
+  r.settledFlags = p[27] & 0x7F;
+  r.isCharging = (p[27] & 0x80) != 0;
+  return true;
+}
+
+// False for short frames; crcOk tells whether the set may be applied
+static inline bool decodeCoeffsFrame(const uint8_t* in, const FrameHeader& h, CoeffsReport& c, bool& crcOk) {
+  if (h.type != FRAME_COEFFS || h.fixedLength < COEFFS_FIXED_SIZE) return false;  // No partial coefficients
+  const uint8_t* p = in + ESPNOW_FRAME_HEADER_SIZE;
+  c.channel = p[0];
+  c.intercept = frameGetF32(p + 1);
+  c.airPressureCoeff = frameGetF32(p + 5);
+  c.ambientPressureCoeff = frameGetF32(p + 9);
+  c.airTempCoeff = frameGetF32(p + 13);
+  c.version = frameGetU32(p + 17);
+  crcOk = frameGetU16(p + 21) == frameCrc16(p, 21);
+  return true;
+}
+
+static inline bool decodeCoeffsAckFrame(const uint8_t* in, const FrameHeader& h, CoeffsAck& a) {
+  if (h.type != FRAME_COEFFS_ACK || h.fixedLength < COEFFS_ACK_FIXED_SIZE) return false;
+  const uint8_t* p = in + ESPNOW_FRAME_HEADER_SIZE;
+  a.channel = p[0];
+  a.version = frameGetU32(p + 1);
+  a.status = p[5];
+  return true;
+}
+
+static inline bool decodeTimeSyncFrame(const uint8_t* in, const FrameHeader& h, int64_t& masterUs) {
+  if (h.type != FRAME_TIME_SYNC || h.fixedLength < TIME_SYNC_FIXED_SIZE) return false;
+  masterUs = (int64_t)frameGetU64(in + ESPNOW_FRAME_HEADER_SIZE);
+  return true;
+}
+
+static inline bool decodeWeighTriggerFrame(const uint8_t* in, const FrameHeader& h, WeighTrigger& t) {
+  if (h.type != FRAME_WEIGH_TRIGGER || h.fixedLength < WEIGH_TRIGGER_FIXED_SIZE) return false;
+  const uint8_t* p = in + ESPNOW_FRAME_HEADER_SIZE;
+  t.id = p[0];
+  t.masterUs = (int64_t)frameGetU64(p + 1);
+  t.sampleAtUs = (int64_t)frameGetU64(p + 9);
+  t.replyAfterMs = frameGetU16(p + 17);
+  t.slotUs = frameGetU16(p + 19);
+  t.slots = p[21];
+  return true;
+}
+
+static inline bool decodeWeighReplyFrame(const uint8_t* in, const FrameHeader& h, WeighReply& r) {
+  if (h.type != FRAME_WEIGH_REPLY || h.fixedLength < WEIGH_REPLY_FIXED_SIZE) return false;
+  const uint8_t* p = in + ESPNOW_FRAME_HEADER_SIZE;
+  r.id = p[0];
+  r.ch1Weight = (int32_t)frameGetU32(p + 1) / 10.0f;
+  r.ch2Weight = (int32_t)frameGetU32(p + 5) / 10.0f;
+  r.ch1WeightStdDev = frameGetU16(p + 9) / 10.0f;
+  r.ch2WeightStdDev = frameGetU16(p + 11) / 10.0f;
+  r.flags = p[13];
+  return true;
+}
+
+static inline bool findFrameTlv(const uint8_t* in, const FrameHeader& h, uint8_t type,
+                                const uint8_t** value, uint8_t* valueLen);
+
+static inline bool decodeRelayFrame(const uint8_t* in, const FrameHeader& h, RelayHeader& r,
+                                    const uint8_t** payload, uint8_t* payloadLen) {
+  if (h.type != FRAME_RELAY || h.fixedLength < RELAY_FIXED_SIZE) return false;
+  const uint8_t* p = in + ESPNOW_FRAME_HEADER_SIZE;
+  memcpy(r.origin, p, 6);
+  memcpy(r.target, p + 6, 6);
+  r.seq = frameGetU16(p + 12);
+  r.ttl = p[14];
+  r.hops = p[15];
+  return findFrameTlv(in, h, TLV_RELAY_PAYLOAD, payload, payloadLen);
+}
+
+static inline bool decodeOtaOfferFrame(const uint8_t* in, const FrameHeader& h, OtaOffer& o) {
+  if (h.type != FRAME_OTA_OFFER || h.fixedLength < OTA_OFFER_FIXED_SIZE) return false;
+  const uint8_t* p = in + ESPNOW_FRAME_HEADER_SIZE;
+  o.session = frameGetU16(p);
+  o.imageSize = frameGetU32(p + 2);
+  o.chunkSize = p[6];
+  o.windowChunks = p[7];
+  o.slotUs = frameGetU16(p + 8);
+  memcpy(o.sha256, p + 10, 32);
+  memcpy(o.firmware, p + 42, 3);
+  return true;
+}
+
+static inline bool decodeOtaDataFrame(const uint8_t* in, const FrameHeader& h, uint16_t& session, uint16_t& chunk,
+                                      const uint8_t** data, uint8_t* dataLen) {
+  if (h.type != FRAME_OTA_DATA || h.fixedLength < OTA_DATA_FIXED_SIZE) return false;
+  const uint8_t* p = in + ESPNOW_FRAME_HEADER_SIZE;
+  session = frameGetU16(p);
+  chunk = frameGetU16(p + 2);
+  return findFrameTlv(in, h, TLV_OTA_CHUNK, data, dataLen);
+}
+
+static inline bool decodeOtaPollFrame(const uint8_t* in, const FrameHeader& h, OtaPoll& poll) {
+  if (h.type != FRAME_OTA_POLL || h.fixedLength < OTA_POLL_FIXED_SIZE) return false;
+  const uint8_t* p = in + ESPNOW_FRAME_HEADER_SIZE;
+  poll.session = frameGetU16(p);
+  poll.window = frameGetU16(p + 2);
+  return true;
+}
+
+static inline bool decodeOtaStatusFrame(const uint8_t* in, const FrameHeader& h, OtaStatus& s) {
+  if (h.type != FRAME_OTA_STATUS || h.fixedLength < OTA_STATUS_FIXED_SIZE) return false;
+  const uint8_t* p = in + ESPNOW_FRAME_HEADER_SIZE;
+  s.session = frameGetU16(p);
+  s.window = frameGetU16(p + 2);
+  s.state = p[4];
+  s.error = p[5];
+  memcpy(s.missing, p + 6, OTA_STATUS_BITMAP_SIZE);
+  return true;
+}
+
+// Find a TLV by type. On success points value at it (not terminated) and sets valueLen.
+static inline bool findFrameTlv(const uint8_t* in, const FrameHeader& h, uint8_t type,
+                                const uint8_t** value, uint8_t* valueLen) {
+  size_t pos = ESPNOW_FRAME_HEADER_SIZE + h.fixedLength;
+  size_t end = ESPNOW_FRAME_HEADER_SIZE + h.length;
+  while (pos + 2 <= end) {
+    uint8_t t = in[pos];
+    uint8_t l = in[pos + 1];
+    if (pos + 2 + l > end) return false;  // Malformed tail
+    if (t == type) {
+      *value = in + pos + 2;
+      *valueLen = l;
+      return true;
+    }
+    pos += 2 + l;
+  }
+  return false;
+}
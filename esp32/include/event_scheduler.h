@@ -0,0 +1,117 @@
+#pragma once
+
+// Deadline scheduler for the housekeeping task. Jobs are registered once with a
+// callback and either a period (periodic) or no period (one-shot, re-armed by
+// schedule()). runDue() dispatches every job whose deadline has passed, earliest
+// deadline first; nextDeadline() tells the owning task how long it may block.
+// Times are microseconds on one monotonic clock (esp_timer_get_time() on target).
+//
+// Not thread-safe: only the owning task may call into it. Other tasks signal that
+// task (task notification) and let it re-arm jobs. With a dozen jobs a linear scan
+// beats a timing wheel or heap, and keeps the table trivially inspectable.
+// Host-buildable.
+
+#include <stdint.h>
+
+#define SCHEDULER_NEVER INT64_MAX
+
+template <uint8_t N>
+class EventScheduler {
+ public:
+  typedef void (*Callback)(void* arg);
+
+  struct Job {
+    const char* name;
+    Callback fn;
+    void* arg;
+    int64_t deadlineUs;     // SCHEDULER_NEVER = disarmed
+    uint32_t periodUs;      // 0 = one-shot
+    uint32_t runs;
+    int64_t maxLatenessUs;  // Worst dispatch time past the deadline
+  };
+
+  EventScheduler() : _count(0), _dispatched(0) {}
+
+  // Returns the job id, or -1 when the table is full. firstDeadlineUs may be
+  // SCHEDULER_NEVER to register a one-shot that is armed later.
+  int add(const char* name, Callback fn, void* arg, int64_t firstDeadlineUs, uint32_t periodUs = 0) {
+    if (_count >= N || !fn) return -1;
+    Job& job = _jobs[_count];
+    job.name = name;
+    job.fn = fn;
+    job.arg = arg;
+    job.deadlineUs = firstDeadlineUs;
+    job.periodUs = periodUs;
+    job.runs = 0;
+    job.maxLatenessUs = 0;
+    return _count++;
+  }
+
+  // (Re)arm a job at an absolute deadline; periodic jobs continue from there
+  void schedule(int id, int64_t deadlineUs) {
+    if (valid(id)) _jobs[id].deadlineUs = deadlineUs;
+  }
+
+  // Arm a job only if that moves it earlier
+  void scheduleNoLater(int id, int64_t deadlineUs) {
+    if (valid(id) && deadlineUs < _jobs[id].deadlineUs) _jobs[id].deadlineUs = deadlineUs;
+  }
+
+  void cancel(int id) {
+    if (valid(id)) _jobs[id].deadlineUs = SCHEDULER_NEVER;
+  }
+
+  bool armed(int id) const { return valid(id) && _jobs[id].deadlineUs != SCHEDULER_NEVER; }
+
+  int64_t nextDeadline() const {
+    int64_t next = SCHEDULER_NEVER;
+    for (uint8_t i = 0; i < _count; i++) {
+      if (_jobs[i].deadlineUs < next) next = _jobs[i].deadlineUs;
+    }
+    return next;
+  }
+
+  // Dispatch all jobs due at nowUs in deadline order. A periodic job is re-armed
+  // one period after its deadline before its callback runs (so the callback may
+  // cancel or move it); if it fell more than a period behind it restarts from now
+  // instead of bursting to catch up. Returns the number of callbacks run.
+  uint32_t runDue(int64_t nowUs) {
+    uint32_t ran = 0;
+    // Bound the pass so a callback that keeps re-arming itself in the past can't spin
+    for (uint32_t guard = 0; guard < 4u * N; guard++) {
+      int due = -1;
+      for (uint8_t i = 0; i < _count; i++) {
+        if (_jobs[i].deadlineUs <= nowUs && (due < 0 || _jobs[i].deadlineUs < _jobs[due].deadlineUs)) {
+          due = i;
+        }
+      }
+      if (due < 0) break;
+
+      Job& job = _jobs[due];
+      int64_t lateness = nowUs - job.deadlineUs;
+      if (lateness > job.maxLatenessUs) job.maxLatenessUs = lateness;
+      if (job.periodUs > 0) {
+        job.deadlineUs += job.periodUs;
+        if (job.deadlineUs <= nowUs) job.deadlineUs = nowUs + job.periodUs;
+      } else {
+        job.deadlineUs = SCHEDULER_NEVER;
+      }
+      job.runs++;
+      _dispatched++;
+      ran++;
+      job.fn(job.arg);
+    }
+    return ran;
+  }
+
+  uint8_t count() const { return _count; }
+  const Job& job(int id) const { return _jobs[id]; }
+  uint32_t dispatched() const { return _dispatched; }
+
+ private:
+  bool valid(int id) const { return id >= 0 && id < _count; }
+
+  Job _jobs[N];
+  uint8_t _count;
+  uint32_t _dispatched;
+};
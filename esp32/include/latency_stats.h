@@ -0,0 +1,52 @@
+#pragma once
+
+// Running latency statistics in microseconds: min/max/mean and standard deviation
+// (Welford), plus a power-of-two histogram for percentiles. Plain C++ so the same
+// numbers can be produced by host replays.
+
+#include <stdint.h>
+#include <math.h>
+
+#define LATENCY_BUCKETS 24  // Bucket i holds samples in [2^(i-1), 2^i) us, bucket 0 holds 0
+
+struct LatencyStats {
+  uint32_t count = 0;
+  int64_t minUs = 0;
+  int64_t maxUs = 0;
+  int64_t lastUs = 0;
+  double mean = 0.0;
+  double m2 = 0.0;
+  uint32_t buckets[LATENCY_BUCKETS] = {};
+
+  void reset() { *this = LatencyStats(); }
+
+  void record(int64_t us) {
+    if (us < 0) us = 0;
+    if (count == 0 || us < minUs) minUs = us;
+    if (count == 0 || us > maxUs) maxUs = us;
+    lastUs = us;
+    count++;
+    double delta = (double)us - mean;
+    mean += delta / count;
+    m2 += delta * ((double)us - mean);
+
+    uint8_t b = 0;
+    while (b < LATENCY_BUCKETS - 1 && (us >> b) != 0) b++;
+    buckets[b]++;
+  }
+
+  // Jitter: standard deviation of the recorded values
+  double stdDev() const { return count > 1 ? sqrt(m2 / (count - 1)) : 0.0; }
+
+  // Upper bound (bucket edge) below which fraction p of the samples fall
+  int64_t percentile(double p) const {
+    if (count == 0) return 0;
+    uint32_t target = (uint32_t)ceil(p * count);
+    uint32_t seen = 0;
+    for (uint8_t b = 0; b < LATENCY_BUCKETS; b++) {
+      seen += buckets[b];
+      if (seen >= target) return b == 0 ? 0 : ((int64_t)1 << b);
+    }
+    return maxUs;
+  }
+};
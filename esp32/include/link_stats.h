@@ -0,0 +1,72 @@
+#pragma once
+
+// Per-sender ESP-NOW link statistics, fed from each frame heard directly:
+//   rssi      EWMA of the RSSI the radio reported for the sender's own packets
+//   loss      EWMA of the fraction of its frames missed, from sequence gaps
+//   jitter    Interarrival jitter (RFC 3550): how much the spacing of arrivals
+//             differs from the spacing of the sender's timestamps, smoothed 1/16
+//   lastRxUs  When it was last heard
+//
+// Sequence gaps of LINK_REBOOT_GAP or more are taken as a restart, not loss.
+// Not thread-safe. Host-buildable.
+
+#include <stdint.h>
+
+#define LINK_RSSI_ALPHA   0.125f
+#define LINK_LOSS_ALPHA   0.0625f
+#define LINK_REBOOT_GAP   1000
+#define LINK_RSSI_NONE    (-127)
+
+struct LinkStats {
+  float rssi;                 // dBm, LINK_RSSI_NONE until a reading
+  float loss;                 // 0..1
+  uint32_t jitterUs;
+  int64_t lastRxUs;           // 0 = never
+  uint32_t lastSenderMs;      // Sender's timestamp of the last frame
+  uint16_t lastSeq;
+  bool haveSeq;
+  uint32_t received;
+  uint32_t lost;
+};
+
+static inline void linkStatsReset(LinkStats& s) {
+  s.rssi = LINK_RSSI_NONE;
+  s.loss = 0.0f;
+  s.jitterUs = 0;
+  s.lastRxUs = 0;
+  s.lastSenderMs = 0;
+  s.lastSeq = 0;
+  s.haveSeq = false;
+  s.received = 0;
+  s.lost = 0;
+}
+
+// One frame from the sender. rssi LINK_RSSI_NONE when the radio didn't say;
+// hasSeq false for frames without a sequence number (legacy).
+static inline void linkStatsUpdate(LinkStats& s, int8_t rssi, bool hasSeq, uint16_t seq, uint32_t senderMs,
+                                   int64_t rxUs) {
+  if (rssi != LINK_RSSI_NONE) {
+    s.rssi = s.rssi == LINK_RSSI_NONE ? rssi : s.rssi + LINK_RSSI_ALPHA * (rssi - s.rssi);
+  }
+
+  if (hasSeq) {
+    uint16_t gap = (uint16_t)(seq - s.lastSeq - 1);
+    if (s.haveSeq && gap == 0xFFFF) return;  // Same frame again (relayed copy, retransmit)
+    if (s.haveSeq && gap < LINK_REBOOT_GAP) {
+      s.lost += gap;
+      for (uint16_t i = 0; i < gap && s.loss < 0.999f; i++) s.loss += LINK_LOSS_ALPHA * (1.0f - s.loss);
+    }
+    s.loss -= LINK_LOSS_ALPHA * s.loss;
+    s.lastSeq = seq;
+    s.haveSeq = true;
+  }
+
+  if (s.lastRxUs != 0) {
+    int64_t d = (rxUs - s.lastRxUs) - ((int64_t)(int32_t)(senderMs - s.lastSenderMs)) * 1000;
+    if (d < 0) d = -d;
+    s.jitterUs = (uint32_t)((int64_t)s.jitterUs + (d - (int64_t)s.jitterUs) / 16);
+  }
+  s.lastRxUs = rxUs;
+  s.lastSenderMs = senderMs;
+  s.received++;
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+// Open-addressing hash index from a packed 48-bit MAC to a slot number in a
+// fixed-size table (the device registry). Linear probing at <= 50% load, with
+// backward-shift deletion so no tombstones accumulate as devices come and go.
+// Not thread-safe: the registry serializes its writers. Host-buildable.
+
+#include <stdint.h>
+
+typedef uint64_t MacKey;  // 48-bit MAC in the low bytes, 0 = none
+
+static inline MacKey macKeyFromBytes(const uint8_t* mac) {
+  MacKey key = 0;
+  for (int i = 0; i < 6; i++) key = (key << 8) | mac[i];
+  return key;
+}
+
+static inline void macKeyToBytes(MacKey key, uint8_t* mac) {
+  for (int i = 5; i >= 0; i--) {
+    mac[i] = (uint8_t)key;
+    key >>= 8;
+  }
+}
+
+static inline int macHexNibble(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// "AA:BB:CC:DD:EE:FF" (either case) -> key, 0 if malformed
+static inline MacKey macKeyFromString(const char* str) {
+  if (!str) return 0;
+  MacKey key = 0;
+  for (int i = 0; i < 6; i++) {
+    int hi = macHexNibble(str[0]);
+    int lo = hi < 0 ? -1 : macHexNibble(str[1]);
+    if (lo < 0) return 0;
+    key = (key << 8) | (MacKey)(hi << 4 | lo);
+    str += 2;
+    if (i < 5) {
+      if (*str != ':') return 0;
+      str++;
+    }
+  }
+  return key;
+}
+
+static constexpr uint32_t macIndexBuckets(uint32_t n, uint32_t p = 1) {
+  return p >= n ? p : macIndexBuckets(n, p * 2);
+}
+
+template <uint16_t SLOTS>
+class MacIndex {
+ public:
+  static const uint32_t BUCKETS = macIndexBuckets(SLOTS * 2u);
+  static const uint16_t EMPTY = 0xFFFF;
+
+  MacIndex() { clear(); }
+
+  void clear() {
+    for (uint32_t i = 0; i < BUCKETS; i++) _buckets[i].slot = EMPTY;
+    _size = 0;
+    _probes = 0;
+    _lookups = 0;
+  }
+
+  // Slot for key, or -1
+  int find(MacKey key) const {
+    _lookups++;
+    for (uint32_t i = home(key);; i = (i + 1) & (BUCKETS - 1)) {
+      _probes++;
+      if (_buckets[i].slot == EMPTY) return -1;
+      if (_buckets[i].key == key) return _buckets[i].slot;
+    }
+  }
+
+  // Adds or replaces the mapping. False only if the index is full.
+  bool insert(MacKey key, uint16_t slot) {
+    for (uint32_t i = home(key);; i = (i + 1) & (BUCKETS - 1)) {
+      if (_buckets[i].slot == EMPTY) {
+        if (_size >= SLOTS) return false;
+        _buckets[i].key = key;
+        _buckets[i].slot = slot;
+        _size++;
+        return true;
+      }
+      if (_buckets[i].key == key) {
+        _buckets[i].slot = slot;
+        return true;
+      }
+    }
+  }
+
+  bool erase(MacKey key) {
+    uint32_t i = home(key);
+    for (;; i = (i + 1) & (BUCKETS - 1)) {
+      if (_buckets[i].slot == EMPTY) return false;
+      if (_buckets[i].key == key) break;
+    }
+    // Backward shift: pull later members of the probe run into the hole when
+    // the hole lies between their home bucket and where they sit now
+    uint32_t hole = i;
+    for (uint32_t j = (i + 1) & (BUCKETS - 1); _buckets[j].slot != EMPTY; j = (j + 1) & (BUCKETS - 1)) {
+      uint32_t h = home(_buckets[j].key);
+      if (((j - h) & (BUCKETS - 1)) >= ((j - hole) & (BUCKETS - 1))) {
+        _buckets[hole] = _buckets[j];
+        hole = j;
+      }
+    }
+    _buckets[hole].slot = EMPTY;
+    _size--;
+    return true;
+  }
+
+  uint16_t size() const { return _size; }
+  // Average buckets inspected per find() since clear()
+  float meanProbes() const { return _lookups ? (float)_probes / _lookups : 0.0f; }
+
+ private:
+  // Fibonacci hashing of the 48-bit key
+  static uint32_t home(MacKey key) {
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ull) >> 40) & (BUCKETS - 1);
+  }
+
+  struct Bucket {
+    MacKey key;
+    uint16_t slot;
+  };
+
+  Bucket _buckets[BUCKETS];
+  uint16_t _size;
+  mutable uint32_t _probes;
+  mutable uint32_t _lookups;
+};
@@ -0,0 +1,545 @@
+#pragma once
+
+// Mesh firmware update: once the hub has a verified image from the phone (BLE OTA,
+// ota_stream.h), it pushes it to the slaves running older firmware over ESP-NOW
+// before restarting into it, so one phone session updates the whole combination.
+// Every slave gets the same broadcasts; losses are repaired per window with
+// selective repeat.
+//
+// Slaves take these frames only from the hub their route leads to. What they
+// write is trusted no further than any app image. Built with signed updates (the
+// esp32s3_n16r8_signed env), a slave boots only images signed with our key, which
+// esp_ota_set_boot_partition() checks before it switches to them.
+//
+//   FRAME_OTA_OFFER   session, image size, SHA-256 and version, chunk and window
+//                     size, and the slaves asked (TLV_OTA_TARGETS), in status slot order. Sent
+//                     again every offerIntervalUs until they all answer RECEIVING;
+//                     each slave erases what the image needs of its update
+//                     partition meanwhile (PREPARING).
+//   FRAME_OTA_DATA    chunk n of the image, n * chunkSize on
+//   FRAME_OTA_POLL    after each round: the window polled. Every slave asked
+//                     answers with FRAME_OTA_STATUS in its slot, (slot + 1) * slotUs
+//                     after the poll, with a bitmap of the window's chunks it still
+//                     lacks. The hub sends again the union of those, polls again,
+//                     and moves to the next window once nobody lacks a chunk.
+//                     Polling window == windows() asks for the image to be verified:
+//                     a slave answers VERIFYING until its update partition's SHA-256
+//                     matches the offer and is set to boot (DONE), then restarts.
+//
+// A slave moves on to window w + 1 when a chunk or a poll for it comes in with all
+// of window w written, so a status that goes missing costs a poll, not a window.
+// A slave that doesn't answer maxSilent polls in a row, or isn't ready or verified
+// in time, is given up on (OTA_ERR_NO_ANSWER); the rest carry on.
+//
+//   progress notification (hub -> phone, OTA characteristic), MESH_OTA_NOTIFY_SIZE
+//     u8  magic      MESH_OTA_NOTIFY_MAGIC
+//     u8  index      Slave, in offer order
+//     u8  slaves     Slaves in the push
+//     u8  state      MeshOtaState
+//     u8  mac[6]
+//     u8  error      OTA_ERR_* when FAILED
+//     u8  reserved
+//     u32 received   Image bytes the slave has
+//     u32 total
+//
+// Times in microseconds. Not thread-safe. Host-buildable.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "espnow_frame.h"
+#include "mac_index.h"
+#include "ota_stream.h"
+
+#define MESH_OTA_NOTIFY_MAGIC   0xF5
+#define MESH_OTA_NOTIFY_SIZE    20
+#define MESH_OTA_WINDOW_MAX     (OTA_STATUS_BITMAP_SIZE * 8)
+
+enum MeshOtaState : uint8_t {
+  MESH_OTA_IDLE = 0,
+  MESH_OTA_PREPARING = 1,     // Erasing the update partition
+  MESH_OTA_RECEIVING = 2,
+  MESH_OTA_VERIFYING = 3,
+  MESH_OTA_DONE = 4,          // Verified and set to boot
+  MESH_OTA_FAILED = 5         // See error
+};
+
+enum MeshOtaSend : uint8_t {
+  MESH_OTA_SEND_NONE,
+  MESH_OTA_SEND_OFFER,
+  MESH_OTA_SEND_DATA,         // arg: the chunk
+  MESH_OTA_SEND_POLL          // arg: the window
+};
+
+struct MeshOtaConfig {
+  uint32_t offerIntervalUs;
+  uint32_t prepareUs;         // Offer -> every slave RECEIVING
+  uint32_t chunkGapUs;        // Between data frames
+  uint32_t slotUs;            // Status slot
+  uint32_t graceUs;           // After the last slot before a slave counts as silent
+  uint8_t maxSilent;          // Polls in a row
+  uint32_t verifyUs;          // Last window complete -> every slave DONE
+};
+
+struct MeshOtaTarget {
+  MacKey mac;
+  uint8_t state;              // MeshOtaState, as last reported
+  uint8_t error;
+  uint8_t silent;             // Polls in a row unanswered
+  bool answered;              // The current poll
+  uint16_t window;
+  uint8_t missing[OTA_STATUS_BITMAP_SIZE];
+};
+
+static inline bool meshOtaBit(const uint8_t* bitmap, uint16_t i) { return bitmap[i >> 3] & (1u << (i & 7)); }
+static inline void meshOtaSetBit(uint8_t* bitmap, uint16_t i) { bitmap[i >> 3] |= (uint8_t)(1u << (i & 7)); }
+
+// Firmware versions (major, minor, patch): < 0 when a is older than b
+static inline int meshOtaCompareVersion(const uint8_t* a, const uint8_t* b) {
+  for (int i = 0; i < 3; i++) {
+    if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+  }
+  return 0;
+}
+
+static inline uint16_t meshOtaBits(const uint8_t* bitmap) {
+  uint16_t n = 0;
+  for (int i = 0; i < OTA_STATUS_BITMAP_SIZE; i++) {
+    for (uint8_t b = bitmap[i]; b; b &= (uint8_t)(b - 1)) n++;
+  }
+  return n;
+}
+
+// Chunk and window arithmetic shared by both ends
+struct MeshOtaLayout {
+  uint32_t imageSize;
+  uint8_t chunkSize;
+  uint8_t windowChunks;
+
+  uint16_t chunks() const { return (uint16_t)((imageSize + chunkSize - 1) / chunkSize); }
+  uint16_t windows() const { return (uint16_t)((chunks() + windowChunks - 1) / windowChunks); }
+  uint16_t chunksIn(uint16_t window) const {
+    uint32_t first = (uint32_t)window * windowChunks;
+    if (first >= chunks()) return 0;
+    return (uint16_t)(chunks() - first < windowChunks ? chunks() - first : windowChunks);
+  }
+  uint32_t offset(uint16_t chunk) const { return (uint32_t)chunk * chunkSize; }
+  uint8_t length(uint16_t chunk) const {
+    uint32_t left = imageSize - offset(chunk);
+    return (uint8_t)(left < chunkSize ? left : chunkSize);
+  }
+  bool valid() const {
+    return imageSize > 0 && chunkSize > 0 && chunkSize <= OTA_CHUNK_MAX && windowChunks > 0 &&
+           windowChunks <= MESH_OTA_WINDOW_MAX && (imageSize + chunkSize - 1) / chunkSize <= 0xFFFF;
+  }
+
+  // Image bytes held at 'window' with 'missing' of it still to come
+  uint32_t received(uint16_t window, const uint8_t* missing) const {
+    if (window >= windows()) return imageSize;
+    uint32_t have = offset((uint16_t)(window * windowChunks));
+    uint16_t in = chunksIn(window);
+    for (uint16_t i = 0; i < in; i++) {
+      if (!meshOtaBit(missing, i)) have += length((uint16_t)(window * windowChunks + i));
+    }
+    return have;
+  }
+};
+
+static inline size_t encodeMeshOtaNotify(uint8_t* out, uint8_t index, uint8_t slaves, const MeshOtaTarget& t,
+                                         uint32_t received, uint32_t total) {
+  out[0] = MESH_OTA_NOTIFY_MAGIC;
+  out[1] = index;
+  out[2] = slaves;
+  out[3] = t.state;
+  macKeyToBytes(t.mac, out + 4);
+  out[10] = t.error;
+  out[11] = 0;
+  otaPutU32(out + 12, received);
+  otaPutU32(out + 16, total);
+  return MESH_OTA_NOTIFY_SIZE;
+}
+
+// Hub side of a push to at most N slaves
+template <uint8_t N>
+class MeshOtaSender {
+ public:
+  explicit MeshOtaSender(const MeshOtaConfig& c)
+      : _c(c), _count(0), _phase(FINISHED), _session(0), _window(0), _cursor(0), _dueUs(0), _deadlineUs(0),
+        _verifyDeadlineUs(0), _rounds(0), _chunksSent(0) {
+    memset(&_layout, 0, sizeof(_layout));
+    memset(_need, 0, sizeof(_need));
+  }
+
+  void begin(uint16_t session, uint32_t imageSize, uint8_t chunkSize, uint8_t windowChunks, int64_t now) {
+    _session = session;
+    _layout.imageSize = imageSize;
+    _layout.chunkSize = chunkSize;
+    _layout.windowChunks = windowChunks;
+    _count = 0;
+    _phase = OFFERING;
+    _window = 0;
+    _cursor = 0;
+    _dueUs = now;
+    _deadlineUs = now + _c.prepareUs;
+    _rounds = 0;
+    _chunksSent = 0;
+  }
+
+  // A slave to update; false when the push is full
+  bool add(MacKey mac) {
+    if (_count >= N) return false;
+    MeshOtaTarget& t = _targets[_count++];
+    memset(&t, 0, sizeof(t));
+    t.mac = mac;
+    return true;
+  }
+
+  // What to send at 'now', if anything: the caller sends it right away
+  MeshOtaSend next(int64_t now, uint16_t& arg) {
+    switch (_phase) {
+      case OFFERING:
+        if (allAtLeast(MESH_OTA_RECEIVING) || now >= _deadlineUs) {
+          failBelow(MESH_OTA_RECEIVING);
+          if (!startWindow(0, now)) return MESH_OTA_SEND_NONE;
+          return next(now, arg);
+        }
+        if (now < _dueUs) return MESH_OTA_SEND_NONE;
+        _dueUs = now + _c.offerIntervalUs;
+        return MESH_OTA_SEND_OFFER;
+
+      case SENDING:
+        if (now < _dueUs) return MESH_OTA_SEND_NONE;
+        while (_cursor < _layout.windowChunks && !meshOtaBit(_need, _cursor)) _cursor++;
+        if (_cursor < _layout.windowChunks) {
+          arg = (uint16_t)(_window * _layout.windowChunks + _cursor++);
+          // Paced from the last due time, so a late wake-up catches up in a short burst
+          _dueUs = _dueUs + _c.chunkGapUs < now - 4 * (int64_t)_c.chunkGapUs ? now : _dueUs + _c.chunkGapUs;
+          _chunksSent++;
+          return MESH_OTA_SEND_DATA;
+        }
+        arg = poll(now);
+        return MESH_OTA_SEND_POLL;
+
+      case POLLING:
+      case VERIFYING:
+        if (!allAnswered() && now < _deadlineUs) return MESH_OTA_SEND_NONE;
+        return closeRound(now, arg) ? MESH_OTA_SEND_POLL : next(now, arg);
+
+      default:
+        return MESH_OTA_SEND_NONE;
+    }
+  }
+
+  // A slave's status; false if it isn't part of this push
+  bool status(MacKey mac, const OtaStatus& s) {
+    if (_phase == FINISHED || s.session != _session) return false;
+    MeshOtaTarget* t = find(mac);
+    if (!t || t->state >= MESH_OTA_DONE) return false;
+    t->answered = true;
+    t->silent = 0;
+    t->error = s.error;
+    t->state = s.state;
+    if (s.state == MESH_OTA_FAILED && t->error == OTA_OK) t->error = OTA_ERR_STATE;
+    if (_phase == POLLING && t->state == MESH_OTA_RECEIVING) {
+      if (s.window == _window) {
+        memcpy(t->missing, s.missing, sizeof(t->missing));
+      } else {                          // Lost its place (or another push's leftovers): no way back
+        t->state = MESH_OTA_FAILED;
+        t->error = OTA_ERR_STATE;
+      }
+    } else if (t->state >= MESH_OTA_VERIFYING) {
+      t->window = _layout.windows();
+      memset(t->missing, 0, sizeof(t->missing));
+    }
+    return true;
+  }
+
+  // When next() may have something to send
+  int64_t dueUs() const {
+    switch (_phase) {
+      case OFFERING:  return _dueUs < _deadlineUs ? _dueUs : _deadlineUs;
+      case SENDING:   return _dueUs;
+      case POLLING:
+      case VERIFYING: return allAnswered() ? 0 : _deadlineUs;
+      default:        return INT64_MAX;
+    }
+  }
+
+  bool running() const { return _phase != FINISHED; }
+  bool offering() const { return _phase == OFFERING; }
+  uint16_t session() const { return _session; }
+  const MeshOtaLayout& layout() const { return _layout; }
+  uint16_t window() const { return _window; }
+  uint8_t count() const { return _count; }
+  const MeshOtaTarget& target(uint8_t i) const { return _targets[i]; }
+  uint32_t rounds() const { return _rounds; }
+  uint32_t chunksSent() const { return _chunksSent; }
+
+  uint32_t received(uint8_t i) const {
+    const MeshOtaTarget& t = _targets[i];
+    if (t.state < MESH_OTA_RECEIVING) return 0;
+    return _layout.received(t.window, t.missing);
+  }
+
+  uint8_t countIn(uint8_t state) const {
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < _count; i++) n += _targets[i].state == state;
+    return n;
+  }
+
+  // MACs of the slaves asked, slot order; returns how many
+  uint8_t targetList(uint8_t* out, size_t cap) const {
+    uint8_t n = 0;
+    for (; n < _count && 6u * (n + 1) <= cap; n++) macKeyToBytes(_targets[n].mac, out + 6 * n);
+    return n;
+  }
+
+ private:
+  enum Phase : uint8_t { OFFERING, SENDING, POLLING, VERIFYING, FINISHED };
+
+  static bool live(const MeshOtaTarget& t) { return t.state < MESH_OTA_DONE; }
+
+  MeshOtaTarget* find(MacKey mac) {
+    for (uint8_t i = 0; i < _count; i++) {
+      if (_targets[i].mac == mac) return &_targets[i];
+    }
+    return nullptr;
+  }
+
+  bool allAtLeast(uint8_t state) const {
+    for (uint8_t i = 0; i < _count; i++) {
+      if (_targets[i].state < state) return false;
+    }
+    return true;
+  }
+
+  bool allAnswered() const {
+    for (uint8_t i = 0; i < _count; i++) {
+      if (live(_targets[i]) && !_targets[i].answered) return false;
+    }
+    return true;
+  }
+
+  void failBelow(uint8_t state) {
+    for (uint8_t i = 0; i < _count; i++) {
+      MeshOtaTarget& t = _targets[i];
+      if (t.state >= state) continue;
+      t.state = MESH_OTA_FAILED;
+      t.error = OTA_ERR_NO_ANSWER;
+    }
+  }
+
+  // Send the whole of 'window'; false (finished) when nobody is left to send it to
+  bool startWindow(uint16_t window, int64_t now) {
+    if (allAtLeast(MESH_OTA_DONE)) {
+      _phase = FINISHED;
+      return false;
+    }
+    _window = window;
+    memset(_need, 0, sizeof(_need));
+    for (uint16_t i = 0; i < _layout.chunksIn(window); i++) meshOtaSetBit(_need, i);
+    for (uint8_t i = 0; i < _count; i++) {
+      if (live(_targets[i])) {
+        _targets[i].window = window;
+        memcpy(_targets[i].missing, _need, sizeof(_need));
+      }
+    }
+    _phase = SENDING;
+    _cursor = 0;
+    _dueUs = now;
+    return true;
+  }
+
+  uint16_t poll(int64_t now) {
+    for (uint8_t i = 0; i < _count; i++) _targets[i].answered = false;
+    _phase = _window >= _layout.windows() ? VERIFYING : POLLING;
+    _deadlineUs = now + (int64_t)(_count + 1) * _c.slotUs + _c.graceUs;
+    _rounds++;
+    return _window;
+  }
+
+  // The poll's answers are in or its time is up. True: poll again now (arg set).
+  bool closeRound(int64_t now, uint16_t& arg) {
+    bool silent = false;
+    for (uint8_t i = 0; i < _count; i++) {
+      MeshOtaTarget& t = _targets[i];
+      if (!live(t) || t.answered) continue;
+      // Verifying takes its own time; only the overall deadline gives up on it
+      if (_phase == VERIFYING ? now >= _verifyDeadlineUs : ++t.silent >= _c.maxSilent) {
+        t.state = MESH_OTA_FAILED;
+        t.error = OTA_ERR_NO_ANSWER;
+      } else {
+        silent = true;
+      }
+    }
+
+    if (_phase == VERIFYING) {
+      if (allAtLeast(MESH_OTA_DONE)) {
+        _phase = FINISHED;
+        return false;
+      }
+      if (allAnswered() && !silent) {
+        _deadlineUs = now + _c.offerIntervalUs;  // Still hashing: ask again in a while
+        for (uint8_t i = 0; i < _count; i++) _targets[i].answered = false;
+        return false;
+      }
+      arg = poll(now);
+      return true;
+    }
+
+    memset(_need, 0, sizeof(_need));
+    for (uint8_t i = 0; i < _count; i++) {
+      const MeshOtaTarget& t = _targets[i];
+      if (!live(t) || !t.answered || t.state != MESH_OTA_RECEIVING) continue;
+      for (int b = 0; b < OTA_STATUS_BITMAP_SIZE; b++) _need[b] |= t.missing[b];
+    }
+    if (allAtLeast(MESH_OTA_DONE)) {
+      _phase = FINISHED;
+      return false;
+    }
+    if (meshOtaBits(_need) > 0) {
+      _phase = SENDING;
+      _cursor = 0;
+      _dueUs = now;
+      return false;
+    }
+    if (silent) {
+      arg = poll(now);
+      return true;
+    }
+    if (_window + 1 < _layout.windows()) {
+      startWindow((uint16_t)(_window + 1), now);
+      return false;
+    }
+    _window = _layout.windows();
+    _verifyDeadlineUs = now + _c.verifyUs;
+    arg = poll(now);
+    return true;
+  }
+
+  MeshOtaConfig _c;
+  MeshOtaTarget _targets[N];
+  uint8_t _count;
+  uint8_t _phase;
+  uint16_t _session;
+  MeshOtaLayout _layout;
+  uint16_t _window;           // windows() once verifying
+  uint16_t _cursor;           // Next chunk of the window to look at
+  uint8_t _need[OTA_STATUS_BITMAP_SIZE];  // Chunks of the window still to send this round
+  int64_t _dueUs;
+  int64_t _deadlineUs;        // Of the phase: ready, answers, or the next verify poll
+  int64_t _verifyDeadlineUs;
+  uint32_t _rounds;           // Polls sent
+  uint32_t _chunksSent;
+};
+
+// Slave side: which chunks of the current window are written, and what to report
+class MeshOtaReceiver {
+ public:
+  MeshOtaReceiver() { reset(); }
+
+  void reset() {
+    memset(&_offer, 0, sizeof(_offer));
+    memset(&_layout, 0, sizeof(_layout));
+    memset(_have, 0, sizeof(_have));
+    _hub = 0;
+    _slot = 0;
+    _window = 0;
+    _state = MESH_OTA_IDLE;
+    _error = OTA_OK;
+  }
+
+  // An offer listing us in 'slot'; false if it can't be taken (left FAILED)
+  bool begin(MacKey hub, const OtaOffer& offer, uint8_t slot) {
+    reset();
+    _hub = hub;
+    _offer = offer;
+    _slot = slot;
+    _layout.imageSize = offer.imageSize;
+    _layout.chunkSize = offer.chunkSize;
+    _layout.windowChunks = offer.windowChunks;
+    _state = MESH_OTA_PREPARING;
+    if (!_layout.valid()) setState(MESH_OTA_FAILED, OTA_ERR_STATE);
+    return _state == MESH_OTA_PREPARING;
+  }
+
+  bool active() const { return _state != MESH_OTA_IDLE; }
+  bool is(MacKey hub, uint16_t session) const { return active() && _hub == hub && _offer.session == session; }
+
+  // Chunk 'chunk' of len bytes came in: true if it is new and should be written
+  // (it is counted as written; setState(FAILED) if writing it fails)
+  bool take(uint16_t chunk, uint8_t len) {
+    if (_state != MESH_OTA_RECEIVING || chunk >= _layout.chunks() || len != _layout.length(chunk)) return false;
+    uint16_t window = chunk / _layout.windowChunks;
+    if (window == _window + 1 && windowComplete()) advance();
+    if (window != _window) return false;
+    uint16_t bit = chunk % _layout.windowChunks;
+    if (meshOtaBit(_have, bit)) return false;
+    meshOtaSetBit(_have, bit);
+    return true;
+  }
+
+  // A poll for 'window'. True when that completes the image (verify now).
+  bool poll(uint16_t window) {
+    if (_state != MESH_OTA_RECEIVING) return false;
+    if (window == _window + 1 && windowComplete()) advance();
+    return complete();
+  }
+
+  void status(OtaStatus& out) const {
+    out.session = _offer.session;
+    out.window = _window;
+    out.state = _state;
+    out.error = _error;
+    memset(out.missing, 0, sizeof(out.missing));
+    if (_state != MESH_OTA_RECEIVING || complete()) return;
+    for (uint16_t i = 0; i < _layout.chunksIn(_window); i++) {
+      if (!meshOtaBit(_have, i)) meshOtaSetBit(out.missing, i);
+    }
+  }
+
+  void setState(uint8_t state, uint8_t error = OTA_OK) {
+    _state = state;
+    _error = error;
+  }
+
+  bool complete() const { return _window >= _layout.windows(); }
+  uint8_t state() const { return _state; }
+  uint8_t error() const { return _error; }
+  uint8_t slot() const { return _slot; }
+  MacKey hub() const { return _hub; }
+  uint16_t window() const { return _window; }
+  const OtaOffer& offer() const { return _offer; }
+  const MeshOtaLayout& layout() const { return _layout; }
+
+  uint32_t received() const {
+    if (complete()) return _layout.imageSize;
+    uint32_t have = _layout.offset((uint16_t)(_window * _layout.windowChunks));
+    for (uint16_t i = 0; i < _layout.chunksIn(_window); i++) {
+      if (meshOtaBit(_have, i)) have += _layout.length((uint16_t)(_window * _layout.windowChunks + i));
+    }
+    return have;
+  }
+
+ private:
+  bool windowComplete() const {
+    for (uint16_t i = 0; i < _layout.chunksIn(_window); i++) {
+      if (!meshOtaBit(_have, i)) return false;
+    }
+    return true;
+  }
+
+  void advance() {
+    _window++;
+    memset(_have, 0, sizeof(_have));
+  }
+
+  OtaOffer _offer;
+  MeshOtaLayout _layout;
+  uint8_t _have[OTA_STATUS_BITMAP_SIZE];  // Chunks of the current window written
+  MacKey _hub;
+  uint8_t _slot;
+  uint16_t _window;
+  uint8_t _state;
+  uint8_t _error;
+};
@@ -0,0 +1,266 @@
+#pragma once
+
+// Multi-hop relay toward the hub. Nodes that can't reach the hub directly hand
+// their frames to a neighbor closer to it, wrapped in FRAME_RELAY (see
+// espnow_frame.h), hop by hop until the hub unwraps them. The hub answers the
+// same way back along the path the frame came.
+//
+// Upstream: every sensor broadcast advertises the sender's route to the hub
+// (TLV_HUB_ROUTE: hops and path cost). Each node keeps a neighbor table built from
+// the broadcasts it hears directly; link quality is the delivery ratio seen in the
+// neighbor's sequence numbers, its cost the expected transmissions (ETX, 1 / ratio).
+// The parent is the neighbor with the lowest advertised cost plus link cost.
+//
+// Downstream: relays remember which neighbor each origin's frames came from
+// (RouteTable), so the hub's coefficient deliveries follow the reverse path.
+//
+// Relayed frames carry the origin's own relay sequence; every node drops an
+// (origin, sequence) it has already seen (RelayDedup) and anything past its TTL.
+// Forwarding is unicast to one next hop, never a flood, and RelayBudget caps the
+// bytes a node forwards per second, which bounds the airtime relaying can take.
+//
+// Not thread-safe. Times in ms (millis()). Host-buildable.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "mac_index.h"
+
+#define RELAY_INITIAL_QUALITY 0.5f    // A neighbor heard once isn't trusted yet
+#define RELAY_QUALITY_ALPHA   0.25f   // EWMA weight of each frame heard or missed
+#define RELAY_MIN_QUALITY     0.05f   // Link cost saturates at 20 transmissions
+#define RELAY_SWITCH_MARGIN   0.5f    // A new parent must be this much cheaper (ETX)
+#define RELAY_MAX_COST        25.5f   // Cost field on the wire is u8 tenths
+
+struct Neighbor {
+  MacKey mac;                 // 0 = free
+  uint32_t lastHeardMs;
+  uint16_t lastSeq;
+  float quality;              // Delivery ratio of its broadcasts, 0..1
+  MacKey hub;                 // Hub it advertises a route to, 0 = none
+  uint8_t hops;               // Its hops to that hub, 0 = it is the hub
+  float cost;                 // Its path cost (ETX) to the hub
+};
+
+// This node's way to the hub
+struct MeshRoute {
+  MacKey hub;                 // 0 = no route
+  MacKey parent;              // Next hop; the hub itself when it is in range
+  uint8_t hops;               // Hops from here to the hub
+  float cost;                 // Path cost, ETX
+};
+
+template <uint8_t N>
+class NeighborTable {
+ public:
+  NeighborTable(uint32_t timeoutMs, uint8_t maxHops) : _timeoutMs(timeoutMs), _maxHops(maxHops), _parent(0) {
+    memset(_n, 0, sizeof(_n));
+  }
+
+  // A sensor frame heard directly from 'mac'. The longest-silent entry makes room.
+  void heard(MacKey mac, uint16_t seq, uint32_t nowMs) {
+    Neighbor* n = find(mac);
+    if (!n) {
+      n = &_n[0];
+      for (uint8_t i = 0; i < N; i++) {
+        if (_n[i].mac == 0) { n = &_n[i]; break; }
+        if (nowMs - _n[i].lastHeardMs > nowMs - n->lastHeardMs) n = &_n[i];
+      }
+      memset(n, 0, sizeof(*n));
+      n->mac = mac;
+      n->quality = RELAY_INITIAL_QUALITY;
+    } else {
+      uint16_t gap = (uint16_t)(seq - n->lastSeq - 1);
+      if (stale(*n, nowMs) || gap > 64) {
+        n->quality = RELAY_INITIAL_QUALITY;  // Rebooted or long gone
+      } else {
+        for (uint16_t i = 0; i < gap; i++) n->quality *= 1.0f - RELAY_QUALITY_ALPHA;
+        n->quality += RELAY_QUALITY_ALPHA * (1.0f - n->quality);
+      }
+    }
+    n->lastSeq = seq;
+    n->lastHeardMs = nowMs;
+  }
+
+  // The route advertisement that came with the frame just passed to heard()
+  void advertised(MacKey mac, MacKey hub, uint8_t hops, float cost) {
+    Neighbor* n = find(mac);
+    if (!n) return;
+    n->hub = hub;
+    n->hops = hops;
+    n->cost = cost;
+  }
+
+  // Best route to a hub through the live neighbors; the hub itself doesn't ask.
+  // Routes at the hop limit or the cost cap count as none, which ends the
+  // count-to-infinity once a hub has gone and neighbors only have each other.
+  MeshRoute route(MacKey self, uint32_t nowMs) {
+    MeshRoute best = {0, 0, 0, 0.0f};
+    float current = -1.0f;
+    for (uint8_t i = 0; i < N; i++) {
+      const Neighbor& n = _n[i];
+      if (n.mac == 0 || n.hub == 0 || n.hub == self || stale(n, nowMs)) continue;
+      if (n.hops + 1 > _maxHops) continue;
+      float cost = pathCost(n);
+      if (cost >= RELAY_MAX_COST) continue;
+      if (n.mac == _parent) current = cost;
+      if (best.hub == 0 || cost < best.cost) {
+        best.hub = n.hub;
+        best.parent = n.mac;
+        best.hops = (uint8_t)(n.hops + 1);
+        best.cost = cost;
+      }
+    }
+    // Hysteresis: stay with a live parent unless the new one is clearly cheaper
+    if (current >= 0.0f && best.parent != _parent && best.cost > current - RELAY_SWITCH_MARGIN) {
+      const Neighbor* p = find(_parent);
+      best.hub = p->hub;
+      best.parent = p->mac;
+      best.hops = (uint8_t)(p->hops + 1);
+      best.cost = current;
+    }
+    _parent = best.parent;
+    return best;
+  }
+
+  uint8_t live(uint32_t nowMs) const {
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < N; i++) {
+      if (_n[i].mac != 0 && !stale(_n[i], nowMs)) count++;
+    }
+    return count;
+  }
+
+  // Copy of entry i (for status output); false if free
+  bool entry(uint8_t i, Neighbor& out) const {
+    if (i >= N || _n[i].mac == 0) return false;
+    out = _n[i];
+    return true;
+  }
+
+  static float linkCost(float quality) {
+    return 1.0f / (quality > RELAY_MIN_QUALITY ? quality : RELAY_MIN_QUALITY);
+  }
+
+ private:
+  bool stale(const Neighbor& n, uint32_t nowMs) const { return nowMs - n.lastHeardMs > _timeoutMs; }
+
+  float pathCost(const Neighbor& n) const {
+    return n.cost + linkCost(n.quality);
+  }
+
+  Neighbor* find(MacKey mac) {
+    if (mac == 0) return nullptr;
+    for (uint8_t i = 0; i < N; i++) {
+      if (_n[i].mac == mac) return &_n[i];
+    }
+    return nullptr;
+  }
+  const Neighbor* find(MacKey mac) const { return const_cast<NeighborTable*>(this)->find(mac); }
+
+  Neighbor _n[N];
+  uint32_t _timeoutMs;
+  uint8_t _maxHops;
+  MacKey _parent;
+};
+
+// Reverse routes: origin -> the neighbor its relayed frames arrived from
+struct RouteEntry {
+  MacKey dest;
+  MacKey via;
+  uint8_t hops;
+  uint32_t updatedMs;
+};
+
+template <uint8_t N>
+class RouteTable {
+ public:
+  explicit RouteTable(uint32_t timeoutMs) : _timeoutMs(timeoutMs) { memset(_r, 0, sizeof(_r)); }
+
+  void learn(MacKey dest, MacKey via, uint8_t hops, uint32_t nowMs) {
+    RouteEntry* r = nullptr;
+    RouteEntry* oldest = &_r[0];
+    for (uint8_t i = 0; i < N; i++) {
+      if (_r[i].dest == dest) { r = &_r[i]; break; }
+      if (_r[i].dest == 0) {
+        if (oldest->dest != 0) oldest = &_r[i];
+      } else if (oldest->dest != 0 && nowMs - _r[i].updatedMs > nowMs - oldest->updatedMs) {
+        oldest = &_r[i];
+      }
+    }
+    if (!r) r = oldest;
+    r->dest = dest;
+    r->via = via;
+    r->hops = hops;
+    r->updatedMs = nowMs;
+  }
+
+  // Next hop toward dest, 0 if no live route (send directly)
+  MacKey nextHop(MacKey dest, uint32_t nowMs) const {
+    for (uint8_t i = 0; i < N; i++) {
+      if (_r[i].dest == dest) return nowMs - _r[i].updatedMs > _timeoutMs ? 0 : _r[i].via;
+    }
+    return 0;
+  }
+
+  uint8_t live(uint32_t nowMs) const {
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < N; i++) {
+      if (_r[i].dest != 0 && nowMs - _r[i].updatedMs <= _timeoutMs) count++;
+    }
+    return count;
+  }
+
+ private:
+  RouteEntry _r[N];
+  uint32_t _timeoutMs;
+};
+
+// Recently relayed (origin, sequence) pairs
+template <uint8_t N>
+class RelayDedup {
+ public:
+  RelayDedup() : _head(0) { memset(_seen, 0, sizeof(_seen)); }
+
+  // True if already seen; otherwise remembers it
+  bool seen(MacKey origin, uint16_t seq) {
+    for (uint8_t i = 0; i < N; i++) {
+      if (_seen[i].origin == origin && _seen[i].seq == seq) return true;
+    }
+    _seen[_head].origin = origin;
+    _seen[_head].seq = seq;
+    _head = (uint8_t)((_head + 1) % N);
+    return false;
+  }
+
+ private:
+  struct Entry {
+    MacKey origin;
+    uint16_t seq;
+  };
+  Entry _seen[N];
+  uint8_t _head;
+};
+
+// Token bucket on forwarded bytes, kept in thousandths of a byte so slow rates
+// don't round away
+class RelayBudget {
+ public:
+  RelayBudget(uint32_t bytesPerSec, uint32_t burstBytes)
+      : _rate(bytesPerSec), _burst((uint64_t)burstBytes * 1000), _tokens(_burst), _lastMs(0) {}
+
+  bool take(uint32_t bytes, uint32_t nowMs) {
+    uint64_t tokens = _tokens + (uint64_t)(nowMs - _lastMs) * _rate;
+    _lastMs = nowMs;
+    _tokens = tokens > _burst ? _burst : tokens;
+    if ((uint64_t)bytes * 1000 > _tokens) return false;
+    _tokens -= (uint64_t)bytes * 1000;
+    return true;
+  }
+
+ private:
+  uint32_t _rate;
+  uint64_t _burst;
+  uint64_t _tokens;
+  uint32_t _lastMs;
+};
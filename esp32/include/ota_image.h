@@ -0,0 +1,185 @@
+#pragma once
+
+// Compressed firmware container for BLE OTA. The phone sends this instead of the raw
+// app image (through the same OTA protocol, see ota_stream.h); the device expands it
+// as it programs flash and checks the result against the SHA-256 in the header.
+//
+//   header, OTA_IMAGE_HEADER_SIZE bytes (little endian)
+//     u32 magic        OTA_IMAGE_MAGIC ("ASZ1"; a raw app image starts with 0xE9)
+//     u8  version      1
+//     u8  codec        OTA_CODEC_*
+//     u8  windowBits   LZSS window, OTA_LZSS_WINDOW_BITS
+//     u8  reserved
+//     u32 payloadSize  Bytes after the header
+//     u32 imageSize    Expanded
+//     u8  sha256[32]   Of the expanded image
+//   payload
+//
+// OTA_CODEC_LZSS is byte-aligned LZSS over a 4 KB window: the decoder needs the
+// window and a few bytes of state, and can stop and go on at any input byte. The
+// payload is groups of eight items, each led by a flag byte (LSB first): bit set, a
+// literal byte; clear, a match of two bytes
+//     bits 0-11  distance - 1 (1..4096 back)
+//     bits 12-15 length - 3 (3..17); 15: a third byte follows, length 18 + that
+// copied from the window, overlapping its own output when distance < length.
+// The ratio has only been measured on x86 binaries (45-59% smaller), not yet on
+// ESP32 app images; the web app sends the raw image when it doesn't pay.
+//
+// OTA_CODEC_DELTA is the same LZSS around a patch against the running image
+// (delta_patch.h) instead of the image itself.
+//
+// Not thread-safe. Host-buildable.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define OTA_IMAGE_MAGIC          0x315A5341u  // "ASZ1"
+#define OTA_IMAGE_VERSION        1
+#define OTA_IMAGE_HEADER_SIZE    48
+#define OTA_LZSS_WINDOW_BITS     12
+#define OTA_LZSS_WINDOW          (1u << OTA_LZSS_WINDOW_BITS)
+#define OTA_LZSS_MIN_MATCH       3
+#define OTA_LZSS_LONG_MATCH      18           // Length code 15: a byte of extra length follows
+#define OTA_LZSS_MAX_MATCH       (OTA_LZSS_LONG_MATCH + 255)
+
+enum OtaCodec : uint8_t {
+  OTA_CODEC_STORED = 0,       // Payload is the image
+  OTA_CODEC_LZSS = 1,
+  OTA_CODEC_DELTA = 2         // LZSS of a delta_patch.h patch
+};
+
+struct OtaImageHeader {
+  uint8_t codec;
+  uint8_t windowBits;
+  uint32_t payloadSize;
+  uint32_t imageSize;
+  uint8_t sha256[32];
+};
+
+static inline uint32_t otaImageLe32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline bool isOtaImage(const uint8_t* data, size_t len) {
+  return len >= 4 && otaImageLe32(data) == OTA_IMAGE_MAGIC;
+}
+
+// False if it isn't a container this decoder can expand
+static inline bool parseOtaImageHeader(const uint8_t* data, size_t len, OtaImageHeader& out) {
+  if (len < OTA_IMAGE_HEADER_SIZE || !isOtaImage(data, len) || data[4] != OTA_IMAGE_VERSION) return false;
+  out.codec = data[5];
+  out.windowBits = data[6];
+  out.payloadSize = otaImageLe32(data + 8);
+  out.imageSize = otaImageLe32(data + 12);
+  memcpy(out.sha256, data + 16, 32);
+  if (out.codec == OTA_CODEC_LZSS || out.codec == OTA_CODEC_DELTA) return out.windowBits == OTA_LZSS_WINDOW_BITS;
+  return out.codec == OTA_CODEC_STORED;
+}
+
+// Streaming LZSS decoder. Input may be split anywhere; output stops when the buffer
+// given is full and goes on with the next call. Between blocks of input the state
+// is the window plus what save() packs into 32 bits, so a transfer can resume from
+// a checkpoint with the window reloaded from the image already written.
+class LzssDecoder {
+ public:
+  LzssDecoder() : _window(nullptr) { begin(nullptr); }
+
+  // window: OTA_LZSS_WINDOW bytes
+  void begin(uint8_t* window) {
+    _window = window;
+    _out = 0;
+    _flags = 0;
+    _flagBits = 0;
+    _pending = 0;
+    _pend[0] = _pend[1] = 0;
+    _matchLeft = 0;
+    _matchDist = 0;
+    _failed = false;
+  }
+
+  // Decode from in[0..inLen) into out[0..outLen). Returns the input bytes used;
+  // 'produced' is the output written. Call again with more room while a match is
+  // still being copied (busy()).
+  size_t decode(const uint8_t* in, size_t inLen, uint8_t* out, size_t outLen, size_t& produced) {
+    size_t used = 0;
+    produced = 0;
+    for (;;) {
+      while (_matchLeft > 0 && produced < outLen) {
+        uint8_t b = _window[(_out - _matchDist) & (OTA_LZSS_WINDOW - 1)];
+        emit(b, out, produced);
+        _matchLeft--;
+      }
+      if (_failed || produced == outLen) return used;
+
+      if (_pending == 2) {  // Both match bytes in, maybe a length byte to come
+        uint16_t v = (uint16_t)(_pend[0] | (_pend[1] << 8));
+        uint16_t length = (v >> 12) + OTA_LZSS_MIN_MATCH;
+        if (length == OTA_LZSS_LONG_MATCH) {
+          if (used == inLen) return used;
+          length = OTA_LZSS_LONG_MATCH + in[used++];
+        }
+        _pending = 0;
+        _flags >>= 1;
+        _flagBits--;
+        _matchDist = (uint16_t)((v & 0x0FFF) + 1);
+        _matchLeft = length;
+        if (_matchDist > _out) _failed = true;  // Reaches back before the start: corrupt
+        continue;
+      }
+      if (used == inLen) return used;
+
+      if (_flagBits == 0) {
+        _flags = in[used++];
+        _flagBits = 8;
+      } else if (_flags & 1) {
+        emit(in[used++], out, produced);
+        _flags >>= 1;
+        _flagBits--;
+      } else {
+        _pend[_pending++] = in[used++];
+      }
+    }
+  }
+
+  uint32_t expanded() const { return _out; }
+  bool busy() const { return _matchLeft > 0; }
+  bool failed() const { return _failed; }
+  // Between items: nothing half-read
+  bool atBoundary() const { return _matchLeft == 0 && _pending == 0; }
+
+  // Checkpoint, taken with no match in progress
+  uint32_t save() const {
+    return (uint32_t)_flags | ((uint32_t)_flagBits << 8) | ((uint32_t)_pending << 12) |
+           ((uint32_t)_pend[0] << 16) | ((uint32_t)_pend[1] << 24);
+  }
+
+  // Back to a checkpoint at 'produced' output bytes; the caller refills the window
+  // with the last OTA_LZSS_WINDOW of them (at offset produced & (OTA_LZSS_WINDOW - 1))
+  void restore(uint8_t* window, uint32_t produced, uint32_t saved) {
+    begin(window);
+    _out = produced;
+    _flags = (uint8_t)saved;
+    _flagBits = (uint8_t)((saved >> 8) & 0x0F);
+    _pending = (uint8_t)((saved >> 12) & 0x0F);
+    _pend[0] = (uint8_t)(saved >> 16);
+    _pend[1] = (uint8_t)(saved >> 24);
+  }
+
+ private:
+  void emit(uint8_t b, uint8_t* out, size_t& produced) {
+    _window[_out & (OTA_LZSS_WINDOW - 1)] = b;
+    _out++;
+    out[produced++] = b;
+  }
+
+  uint8_t* _window;
+  uint32_t _out;              // Bytes produced since begin()
+  uint8_t _flags;
+  uint8_t _flagBits;          // Items left under _flags
+  uint8_t _pending;           // Match bytes gathered
+  uint8_t _pend[2];
+  uint16_t _matchLeft;
+  uint16_t _matchDist;
+  bool _failed;
+};
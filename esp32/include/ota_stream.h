@@ -0,0 +1,277 @@
+#pragma once
+
+// BLE firmware update, streamed. The phone writes the image to the OTA
+// characteristic; the device stages it in two PSRAM blocks while a writer task
+// programs the other into the update partition, so flash erase and program never
+// hold up the BLE stack. The device answers on the same characteristic with
+// cumulative acks and a send limit (credit): the phone keeps sending up to the
+// limit and waits for the next ack past it, which takes the place of fixed pacing.
+//
+//   commands (phone -> device)
+//     0x01 START    u32 size [u32 crc32 of the image [u8 flags, OTA_START_*, u8 version[3]]]
+//     0x02 DATA     bytes, appended at the device's receive position (original protocol)
+//     0x03 END
+//     0x04 ABORT
+//     0x05 DATA_AT  u32 offset, bytes
+//     0x06 INFO     Answered with the running image, for a delta update (delta_patch.h):
+//                     u8 OTA_INFO_MAGIC, u8 features, u16 reserved, u32 running partition size,
+//                     u8 sha256[32] (esp_partition_get_sha256), OTA_INFO_SIZE bytes
+//
+//   notifications (device -> phone), OTA_NOTIFY_SIZE bytes
+//     u8  magic      OTA_NOTIFY_MAGIC
+//     u8  event      OTA_EVT_*
+//     u8  status     OTA_ERR_* for OTA_EVT_ERROR
+//     u8  features   OTA_FEATURE_* the device supports
+//     u32 received   Contiguous bytes staged: the cumulative ack
+//     u32 limit      Send no byte at or past this offset before the next ack
+//     u32 committed  Bytes programmed to flash and recorded for resuming
+//     u32 total
+//
+// A START carrying the image CRC can resume: if the device holds the same image
+// (size and CRC) partly programmed, from this or an earlier connection or boot, it
+// answers READY with 'received' at the committed offset, and the phone continues
+// from there. Without a CRC (the original START) the transfer starts over.
+// DATA_AT with an offset other than 'received' is dropped and answered with
+// OTA_EVT_REWIND, as is an END before every byte arrived; data already staged is
+// ignored. Blocks are staged from offsets that are multiples of the block size, so
+// flash is erased a block at a time.
+//
+// START with OTA_START_RELAY and the image's version (major, minor, patch; devices
+// advertising OTA_FEATURE_RELAY): once the image is verified the device answers
+// OTA_EVT_RELAY and pushes it to the slaves reporting an older version over ESP-NOW
+// before restarting (mesh_ota.h), with a MESH_OTA_NOTIFY_MAGIC notification per
+// slave as it goes; OTA_EVT_DONE follows when every slave is done or given up on.
+// Without any older slave it answers OTA_EVT_DONE straight away.
+//
+// OtaStaging is the double buffer: one filler (the BLE callback), one drainer
+// (the writer task), each block owned by one side at a time. received() and
+// limit() belong to the filler; a drainer reporting them has to hold whatever lock
+// the filler takes around accept(). Host-buildable.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+
+#define OTA_CMD_START      0x01
+#define OTA_CMD_DATA       0x02
+#define OTA_CMD_END        0x03
+#define OTA_CMD_ABORT      0x04
+#define OTA_CMD_DATA_AT    0x05
+#define OTA_CMD_INFO       0x06
+
+#define OTA_NOTIFY_MAGIC   0xF3
+#define OTA_NOTIFY_SIZE    20
+#define OTA_INFO_MAGIC     0xF4
+#define OTA_INFO_SIZE      40
+
+#define OTA_FEATURE_IMAGE  0x01   // Takes compressed containers (ota_image.h) as well as raw images
+#define OTA_FEATURE_DELTA  0x02   //   and delta containers against the running image
+#define OTA_FEATURE_RELAY  0x04   // Passes the image on to its slaves (OTA_START_RELAY)
+
+#define OTA_START_RELAY    0x01   // Update the slaves running another image too
+
+enum OtaEvent : uint8_t {
+  OTA_EVT_READY = 1,          // START accepted; send from 'received'
+  OTA_EVT_ACK = 2,
+  OTA_EVT_REWIND = 3,         // Data out of order was dropped; send again from 'received'
+  OTA_EVT_DONE = 4,           // Image verified and set to boot; the device restarts
+  OTA_EVT_ERROR = 5,          // Transfer over, see status
+  OTA_EVT_RELAY = 6,          // Image verified and set to boot; passing it on to the slaves first
+};
+
+enum OtaError : uint8_t {
+  OTA_OK = 0,
+  OTA_ERR_SIZE = 1,           // Doesn't fit the update partition
+  OTA_ERR_NO_MEMORY = 2,      // Staging buffers couldn't be allocated
+  OTA_ERR_FLASH = 3,          // Erase or program failed
+  OTA_ERR_CRC = 4,            // Programmed image doesn't match the CRC from START
+  OTA_ERR_IMAGE = 5,          // Not a valid app image, or not signed with our key on a signed build
+  OTA_ERR_STATE = 6,          // Command out of place (no transfer running)
+  OTA_ERR_CONTAINER = 7,      // Container header not understood, or its payload is corrupt
+  OTA_ERR_DIGEST = 8,         // Expanded image doesn't match the container's SHA-256
+  OTA_ERR_BASE = 9,           // Delta made against another image than the one running: send it whole
+  OTA_ERR_NO_ANSWER = 10,     // Mesh update: the slave stopped answering
+  OTA_ERR_OLDER = 11,         // Mesh update: older than the firmware the slave runs
+};
+
+struct OtaNotify {
+  uint8_t event;
+  uint8_t status;
+  uint8_t features;
+  uint32_t received;
+  uint32_t limit;
+  uint32_t committed;
+  uint32_t total;
+};
+
+static inline void otaPutU32(uint8_t* p, uint32_t v) {
+  p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+static inline uint32_t otaGetU32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline size_t encodeOtaNotify(uint8_t* out, const OtaNotify& n) {
+  out[0] = OTA_NOTIFY_MAGIC;
+  out[1] = n.event;
+  out[2] = n.status;
+  out[3] = n.features;
+  otaPutU32(out + 4, n.received);
+  otaPutU32(out + 8, n.limit);
+  otaPutU32(out + 12, n.committed);
+  otaPutU32(out + 16, n.total);
+  return OTA_NOTIFY_SIZE;
+}
+
+static inline size_t encodeOtaInfo(uint8_t* out, uint8_t features, uint32_t partitionSize, const uint8_t* sha256) {
+  out[0] = OTA_INFO_MAGIC;
+  out[1] = features;
+  out[2] = 0;
+  out[3] = 0;
+  otaPutU32(out + 4, partitionSize);
+  memcpy(out + 8, sha256, 32);
+  return OTA_INFO_SIZE;
+}
+
+// CRC-32 (IEEE 802.3, zlib's), continued across calls: crc = otaCrc32(crc, ...)
+// starting from 0
+static inline uint32_t otaCrc32(uint32_t crc, const uint8_t* data, size_t len) {
+  static uint32_t table[256];
+  static bool ready = false;
+  if (!ready) {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      table[i] = c;
+    }
+    ready = true;
+  }
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+}
+
+enum OtaAccept : uint8_t {
+  OTA_ACCEPTED,
+  OTA_DUPLICATE,              // Already staged, ignored
+  OTA_OUT_OF_ORDER,           // Starts past 'received'
+  OTA_NO_ROOM,                // Both blocks full; part of it may have been taken
+};
+
+class OtaStaging {
+ public:
+  struct Block {
+    const uint8_t* data;
+    uint32_t offset;          // Within the image
+    uint32_t length;
+  };
+
+  OtaStaging() : _blockSize(0), _total(0), _received(0), _fillOffset(0), _fillLen(0), _fill(0), _drain(0) {
+    _buf[0] = _buf[1] = nullptr;
+    _full[0].store(false);
+    _full[1].store(false);
+    _len[0] = _len[1] = 0;
+    _offset[0] = _offset[1] = 0;
+  }
+
+  void init(uint8_t* block0, uint8_t* block1, uint32_t blockSize) {
+    _buf[0] = block0;
+    _buf[1] = block1;
+    _blockSize = blockSize;
+  }
+
+  // Both sides idle. 'from' is a multiple of the block size.
+  void begin(uint32_t total, uint32_t from) {
+    _total = total;
+    _received = from;
+    _fillOffset = from;
+    _fillLen = 0;
+    _fill = 0;
+    _drain = 0;
+    _full[0].store(false);
+    _full[1].store(false);
+  }
+
+  // Filler: stage data for image offset 'offset'. 'taken' is how much of it was
+  // staged (less than len only with OTA_NO_ROOM).
+  OtaAccept accept(uint32_t offset, const uint8_t* data, uint32_t len, uint32_t& taken) {
+    taken = 0;
+    if (offset + len <= _received) return OTA_DUPLICATE;
+    if (offset > _received) return OTA_OUT_OF_ORDER;
+    uint32_t skip = _received - offset;  // Overlaps what is staged: take the new part
+    data += skip;
+    len -= skip;
+    if (_received + len > _total) len = _total - _received;
+    while (len > 0) {
+      if (_full[_fill].load(std::memory_order_acquire)) return OTA_NO_ROOM;
+      uint32_t n = _blockSize - _fillLen;
+      if (n > len) n = len;
+      memcpy(_buf[_fill] + _fillLen, data, n);
+      _fillLen += n;
+      _received += n;
+      taken += n;
+      data += n;
+      len -= n;
+      if (_fillLen == _blockSize || _received == _total) publish();
+    }
+    return OTA_ACCEPTED;
+  }
+
+  uint32_t received() const { return _received; }
+  uint32_t total() const { return _total; }
+  uint32_t blockSize() const { return _blockSize; }
+
+  // Filler: how far the phone may send. Room left in the block being filled, plus
+  // the other block if the writer is done with it.
+  uint32_t limit() const {
+    if (_received >= _total) return _total;
+    if (_full[_fill].load(std::memory_order_acquire)) return _received;
+    uint32_t room = _blockSize - _fillLen;
+    if (!_full[_fill ^ 1].load(std::memory_order_acquire)) room += _blockSize;
+    return _received + room > _total ? _total : _received + room;
+  }
+
+  // Drainer: the next block to program, false if none is ready
+  bool next(Block& out) const {
+    if (!_full[_drain].load(std::memory_order_acquire)) return false;
+    out.data = _buf[_drain];
+    out.offset = _offset[_drain];
+    out.length = _len[_drain];
+    return true;
+  }
+
+  // Drainer: the block from next() is programmed; hand it back to the filler
+  void release() {
+    uint8_t b = _drain;
+    _drain ^= 1;
+    _full[b].store(false, std::memory_order_release);
+  }
+
+  // Drainer: both blocks handed back
+  bool drained() const { return !_full[0].load(std::memory_order_acquire) && !_full[1].load(std::memory_order_acquire); }
+
+ private:
+  // Hand the block being filled to the drainer and move on to the other one. Its
+  // offset and length are set before the release store, so the drainer sees them.
+  void publish() {
+    _offset[_fill] = _fillOffset;
+    _len[_fill] = _fillLen;
+    _full[_fill].store(true, std::memory_order_release);
+    _fill ^= 1;
+    _fillOffset = _received;
+    _fillLen = 0;
+  }
+
+  uint8_t* _buf[2];
+  uint32_t _blockSize;
+  uint32_t _total;
+  uint32_t _received;         // Filler only, as are the four below
+  uint32_t _fillOffset;       // Image offset of the block being filled
+  uint32_t _fillLen;
+  uint8_t _fill;
+  uint8_t _drain;             // Drainer only
+  std::atomic<bool> _full[2]; // true: the drainer owns the block
+  uint32_t _len[2];           // Of a published block
+  uint32_t _offset[2];
+};
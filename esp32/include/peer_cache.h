@@ -0,0 +1,98 @@
+#pragma once
+
+// LRU set of unicast ESP-NOW peers. The peer table in the WiFi driver is small
+// (20 entries including broadcast), so the radio task keeps at most N unicast
+// peers registered and removes the least recently used one to make room. Peers
+// with a delivery in flight are pinned and never chosen for eviction. Only tracks
+// keys; the caller adds/deletes the driver entries. Not thread-safe. Host-buildable.
+
+#include <stdint.h>
+#include "mac_index.h"
+
+enum PeerCacheResult : uint8_t {
+  PEER_HIT,      // Already registered
+  PEER_ADDED,    // Caller must register it (and first delete 'evicted' if set)
+  PEER_FULL,     // Every entry is pinned
+};
+
+template <uint8_t N>
+class PeerCache {
+ public:
+  PeerCache() : _clock(0), _hits(0), _misses(0), _evictions(0) {
+    for (uint8_t i = 0; i < N; i++) {
+      _entries[i].key = 0;
+      _entries[i].pins = 0;
+    }
+  }
+
+  // Make key resident and most recently used
+  PeerCacheResult acquire(MacKey key, MacKey& evicted) {
+    evicted = 0;
+    int victim = -1;
+    for (uint8_t i = 0; i < N; i++) {
+      Entry& e = _entries[i];
+      if (e.key == key) {
+        e.lastUsed = ++_clock;
+        _hits++;
+        return PEER_HIT;
+      }
+      if (e.key == 0) {
+        if (victim < 0 || _entries[victim].key != 0) victim = i;
+      } else if (e.pins == 0 && (victim < 0 || (_entries[victim].key != 0 && e.lastUsed < _entries[victim].lastUsed))) {
+        victim = i;
+      }
+    }
+    if (victim < 0) return PEER_FULL;
+
+    Entry& e = _entries[victim];
+    if (e.key != 0) {
+      evicted = e.key;
+      _evictions++;
+    }
+    e.key = key;
+    e.pins = 0;
+    e.lastUsed = ++_clock;
+    _misses++;
+    return PEER_ADDED;
+  }
+
+  void pin(MacKey key) {
+    Entry* e = find(key);
+    if (e) e->pins++;
+  }
+
+  void unpin(MacKey key) {
+    Entry* e = find(key);
+    if (e && e->pins > 0) e->pins--;
+  }
+
+  uint8_t size() const {
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < N; i++) n += _entries[i].key != 0;
+    return n;
+  }
+
+  uint32_t hits() const { return _hits; }
+  uint32_t misses() const { return _misses; }
+  uint32_t evictions() const { return _evictions; }
+
+ private:
+  struct Entry {
+    MacKey key;         // 0 = unused
+    uint32_t lastUsed;
+    uint8_t pins;
+  };
+
+  Entry* find(MacKey key) {
+    for (uint8_t i = 0; i < N; i++) {
+      if (_entries[i].key == key) return &_entries[i];
+    }
+    return nullptr;
+  }
+
+  Entry _entries[N];
+  uint32_t _clock;
+  uint32_t _hits;
+  uint32_t _misses;
+  uint32_t _evictions;
+};
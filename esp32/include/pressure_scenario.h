@@ -0,0 +1,314 @@
+#pragma once
+
+// Pressure scenario engine: synthesizes parameterized pressure profiles (load ramps,
+// leaks, sensor dropouts, vibration) or replays a recorded CSV trace, on a scenario
+// clock that can run faster than real time. Deterministic for a given seed and call
+// order, and free of Arduino/IDF dependencies so the same scenarios drive host runs.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define SCENARIO_MAX_SEGMENTS 16
+
+enum ScenarioShape : uint8_t {
+  SHAPE_HOLD,     // Stay at startPsi
+  SHAPE_LINEAR,   // Straight line startPsi -> endPsi
+  SHAPE_COSINE    // Eased (half-cosine) startPsi -> endPsi
+};
+
+struct ScenarioSegment {
+  float duration;  // s
+  float startPsi;
+  float endPsi;
+  ScenarioShape shape;
+};
+
+struct ScenarioProfile {
+  ScenarioSegment segments[SCENARIO_MAX_SEGMENTS];
+  uint8_t segmentCount = 0;
+  float ch2Offset = 0.0f;          // s, CH2 runs this far ahead of CH1
+  float noisePsi = 0.0f;           // Uniform noise amplitude (+/-)
+  float vibrationPsi = 0.0f;       // Sinusoidal vibration amplitude
+  float vibrationHz = 0.0f;
+  float leakPsiPerMin = 0.0f;      // Pressure lost per minute (cumulative)
+  uint8_t leakChannels = 0;        // Bit 0 = CH1, bit 1 = CH2
+  float dropoutPeriod = 0.0f;      // s between sensor dropouts (0 = never)
+  float dropoutDuration = 0.0f;    // s each dropout lasts (sensor reads 0 PSI)
+  uint8_t dropoutChannels = 0;     // Bit 0 = CH1, bit 1 = CH2
+  float minPsi = 0.0f;
+  float maxPsi = 150.0f;
+  float ambientPsi = 14.7f;
+  float temperatureF = 72.0f;
+  uint32_t seed = 1;
+
+  void addSegment(float duration, float startPsi, float endPsi, ScenarioShape shape) {
+    if (segmentCount >= SCENARIO_MAX_SEGMENTS) return;
+    ScenarioSegment& s = segments[segmentCount++];
+    s.duration = duration;
+    s.startPsi = startPsi;
+    s.endPsi = endPsi;
+    s.shape = shape;
+  }
+
+  float duration() const {
+    float total = 0.0f;
+    for (uint8_t i = 0; i < segmentCount; i++) total += segments[i].duration;
+    return total;
+  }
+};
+
+// Recorded trace: rows of "t_s,ch1_psi,ch2_psi[,ambient_psi,temp_f]" over caller storage
+struct ScenarioTrace {
+  float* t = nullptr;
+  float* ch1 = nullptr;
+  float* ch2 = nullptr;
+  float* ambient = nullptr;
+  float* temp = nullptr;
+  uint32_t count = 0;
+  uint32_t capacity = 0;
+  bool hasEnvironment = false;
+
+  // storage must hold 5 * capacity floats
+  void attach(float* storage, uint32_t cap) {
+    t = storage;
+    ch1 = storage + cap;
+    ch2 = storage + 2 * cap;
+    ambient = storage + 3 * cap;
+    temp = storage + 4 * cap;
+    capacity = cap;
+    count = 0;
+    hasEnvironment = false;
+  }
+
+  // Append one CSV line; header/comment lines and rows going back in time are skipped
+  bool parseLine(const char* line) {
+    if (count >= capacity) return false;
+    float v[5];
+    int n = 0;
+    const char* p = line;
+    while (n < 5) {
+      char* end;
+      float x = strtof(p, &end);
+      if (end == p) break;
+      v[n++] = x;
+      p = end;
+      while (*p == ' ' || *p == '\t') p++;
+      if (*p != ',') break;
+      p++;
+    }
+    if (n < 3) return false;
+    if (count > 0 && v[0] <= t[count - 1]) return false;
+
+    t[count] = v[0];
+    ch1[count] = v[1];
+    ch2[count] = v[2];
+    ambient[count] = n >= 4 ? v[3] : 14.7f;
+    temp[count] = n >= 5 ? v[4] : 72.0f;
+    if (n >= 5) hasEnvironment = true;
+    count++;
+    return true;
+  }
+
+  // Parse a whole CSV buffer (not necessarily NUL-terminated). Returns rows loaded.
+  uint32_t parseCsv(const char* text, size_t len) {
+    char line[96];
+    size_t pos = 0;
+    while (pos < len) {
+      size_t n = 0;
+      while (pos < len && text[pos] != '\n') {
+        if (n < sizeof(line) - 1) line[n++] = text[pos];
+        pos++;
+      }
+      pos++;
+      line[n] = '\0';
+      parseLine(line);
+    }
+    return count;
+  }
+
+  float duration() const { return count > 1 ? t[count - 1] - t[0] : 0.0f; }
+};
+
+class PressureScenario {
+ public:
+  void setProfile(const ScenarioProfile& profile) {
+    _profile = profile;
+    _trace = nullptr;
+    _rng = profile.seed ? profile.seed : 1;
+  }
+
+  // Replay a trace instead of the synthetic profile (noise/vibration/leak/dropout
+  // from the profile are still layered on top)
+  void setTrace(const ScenarioTrace* trace) {
+    _trace = (trace && trace->count > 1) ? trace : nullptr;
+    _cursor = 0;
+  }
+
+  bool replaying() const { return _trace != nullptr; }
+  const ScenarioProfile& profile() const { return _profile; }
+
+  float duration() const { return _trace ? _trace->duration() : _profile.duration(); }
+
+  // Pressure for channel 1 or 2 at scenario time t (s). Loops over the scenario duration.
+  float pressure(int channel, float t) {
+    const ScenarioProfile& p = _profile;
+    uint8_t bit = channel == 2 ? 0x02 : 0x01;
+
+    if (p.dropoutPeriod > 0 && (p.dropoutChannels & bit) &&
+        fmodf(t, p.dropoutPeriod) >= p.dropoutPeriod - p.dropoutDuration) {
+      return 0.0f;
+    }
+
+    float base;
+    if (_trace) {
+      base = traceValue(channel == 2 ? _trace->ch2 : _trace->ch1, loopTime(t));
+    } else {
+      float tc = t + (channel == 2 ? p.ch2Offset : 0.0f);
+      base = profileValue(loopTime(tc));
+    }
+
+    if (p.leakPsiPerMin > 0 && (p.leakChannels & bit)) base -= p.leakPsiPerMin * t / 60.0f;
+    if (p.vibrationPsi > 0) base += p.vibrationPsi * sinf(2.0f * (float)M_PI * p.vibrationHz * t);
+    if (p.noisePsi > 0) base += p.noisePsi * (2.0f * uniform() - 1.0f);
+
+    if (base < p.minPsi) base = p.minPsi;
+    if (base > p.maxPsi) base = p.maxPsi;
+    return base;
+  }
+
+  // Ambient pressure / temperature at scenario time t (trace columns when present)
+  void environment(float t, float* ambientPsi, float* temperatureF) {
+    if (_trace && _trace->hasEnvironment) {
+      float lt = loopTime(t);
+      *ambientPsi = traceValue(_trace->ambient, lt);
+      *temperatureF = traceValue(_trace->temp, lt);
+    } else {
+      *ambientPsi = _profile.ambientPsi;
+      *temperatureF = _profile.temperatureF;
+    }
+  }
+
+ private:
+  float loopTime(float t) const {
+    float d = duration();
+    if (d <= 0) return 0.0f;
+    float lt = fmodf(t, d);
+    return lt < 0 ? lt + d : lt;
+  }
+
+  float profileValue(float t) const {
+    const ScenarioProfile& p = _profile;
+    for (uint8_t i = 0; i < p.segmentCount; i++) {
+      const ScenarioSegment& s = p.segments[i];
+      if (t < s.duration || i == p.segmentCount - 1) {
+        float progress = s.duration > 0 ? t / s.duration : 1.0f;
+        if (progress > 1.0f) progress = 1.0f;
+        switch (s.shape) {
+          case SHAPE_HOLD:   return s.startPsi;
+          case SHAPE_LINEAR: return s.startPsi + (s.endPsi - s.startPsi) * progress;
+          case SHAPE_COSINE: return s.startPsi + (s.endPsi - s.startPsi) * (1.0f - cosf(progress * (float)M_PI)) / 2.0f;
+        }
+      }
+      t -= s.duration;
+    }
+    return 0.0f;
+  }
+
+  // Linear interpolation over trace time (offset so the trace starts at t = 0)
+  float traceValue(const float* column, float t) {
+    const ScenarioTrace& tr = *_trace;
+    float tt = tr.t[0] + t;
+    if (_cursor >= tr.count - 1 || tr.t[_cursor] > tt) _cursor = 0;  // Looped or rewound
+    while (_cursor < tr.count - 2 && tr.t[_cursor + 1] <= tt) _cursor++;
+
+    float t0 = tr.t[_cursor], t1 = tr.t[_cursor + 1];
+    float f = (tt - t0) / (t1 - t0);
+    if (f < 0) f = 0;
+    if (f > 1) f = 1;
+    return column[_cursor] + (column[_cursor + 1] - column[_cursor]) * f;
+  }
+
+  // xorshift32 - deterministic and cheap enough to call per ADC sample
+  float uniform() {
+    _rng ^= _rng << 13;
+    _rng ^= _rng >> 17;
+    _rng ^= _rng << 5;
+    return (_rng >> 8) * (1.0f / 16777216.0f);
+  }
+
+  ScenarioProfile _profile;
+  const ScenarioTrace* _trace = nullptr;
+  uint32_t _cursor = 0;
+  uint32_t _rng = 1;
+};
+
+// ------------------------------------------------------------
+// Built-in profiles
+// ------------------------------------------------------------
+
+// The original 12-minute loading/unloading cycle, CH2 90 s ahead, +/-0.5 PSI noise
+inline ScenarioProfile scenarioCycleProfile() {
+  ScenarioProfile p;
+  p.addSegment(300, 110, 40, SHAPE_COSINE);  // Loading trailer
+  p.addSegment(120, 40, 40, SHAPE_HOLD);     // Loaded, stationary
+  p.addSegment(60, 40, 80, SHAPE_COSINE);    // Partial unload
+  p.addSegment(20, 80, 80, SHAPE_HOLD);
+  p.addSegment(120, 80, 20, SHAPE_COSINE);   // Heavy load
+  p.addSegment(100, 20, 75, SHAPE_COSINE);   // Partial unload, end of cycle
+  p.ch2Offset = 90;
+  p.noisePsi = 0.5f;
+  p.minPsi = 15;
+  p.maxPsi = 110;
+  return p;
+}
+
+// Fill a profile by name: cycle, ramp, leak, dropout, vibration. Returns false if unknown.
+inline bool scenarioProfileByName(const char* name, ScenarioProfile* out) {
+  if (strcmp(name, "cycle") == 0) {
+    *out = scenarioCycleProfile();
+    return true;
+  }
+
+  ScenarioProfile p;
+  p.minPsi = 0;
+  p.maxPsi = 150;
+  p.noisePsi = 0.3f;
+
+  if (strcmp(name, "ramp") == 0) {
+    // Empty -> loaded -> empty with long holds, for settle-time measurements
+    p.addSegment(60, 20, 20, SHAPE_HOLD);
+    p.addSegment(120, 20, 90, SHAPE_LINEAR);
+    p.addSegment(120, 90, 90, SHAPE_HOLD);
+    p.addSegment(60, 90, 20, SHAPE_LINEAR);
+    p.ch2Offset = 30;
+  } else if (strcmp(name, "leak") == 0) {
+    // Loaded and parked with a slow leak on CH1
+    p.addSegment(3600, 85, 85, SHAPE_HOLD);
+    p.leakPsiPerMin = 0.5f;
+    p.leakChannels = 0x01;
+  } else if (strcmp(name, "dropout") == 0) {
+    // Steady load with CH2 dropping out for 2 s every 30 s
+    p.addSegment(600, 70, 70, SHAPE_HOLD);
+    p.dropoutPeriod = 30;
+    p.dropoutDuration = 2;
+    p.dropoutChannels = 0x02;
+  } else if (strcmp(name, "vibration") == 0) {
+    // Loaded and driving: road vibration plus leveling-valve steps
+    p.addSegment(40, 80, 80, SHAPE_HOLD);
+    p.addSegment(2, 80, 84, SHAPE_LINEAR);
+    p.addSegment(40, 84, 84, SHAPE_HOLD);
+    p.addSegment(2, 84, 80, SHAPE_LINEAR);
+    p.vibrationPsi = 3.0f;
+    p.vibrationHz = 2.5f;
+    p.noisePsi = 1.5f;
+    p.ch2Offset = 11;
+  } else {
+    return false;
+  }
+
+  *out = p;
+  return true;
+}
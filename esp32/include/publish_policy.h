@@ -0,0 +1,104 @@
+#pragma once
+
+// Change-driven publishing for the hub's BLE fleet notifications. The app writes a
+// PublishConfig to the subscription characteristic; the hub then notifies as soon
+// as any channel of any device moved by more than its deadband since it was last
+// notified (but not more often than minIntervalMs), and otherwise only sends a
+// full heartbeat every maxIntervalMs.
+//
+//   config payload (10 bytes, little endian, also returned on read)
+//     u16 minIntervalMs   Floor between notifications (>= PUBLISH_MIN_INTERVAL_FLOOR_MS)
+//     u16 maxIntervalMs   Heartbeat when nothing changes (>= minIntervalMs)
+//     u16 ch1Deadband     0.1 lb; 0 = notify on any change
+//     u16 ch2Deadband
+//     u16 coherenceMs     Fleet total only sums samples this close in mesh time; 0 = all
+//                         fresh samples. Optional: 8-byte writes keep the default.
+//
+// ChangeTracker remembers what was last notified per registry slot, keyed by MAC so
+// a reused slot reads as changed. Not thread-safe: the BLE task owns it.
+// Host-buildable.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include "mac_index.h"
+
+#define PUBLISH_CONFIG_SIZE            10
+#define PUBLISH_CONFIG_MIN_SIZE        8
+#define PUBLISH_MIN_INTERVAL_FLOOR_MS  50
+#define PUBLISH_DEFAULT_COHERENCE_MS   500
+
+struct PublishConfig {
+  uint16_t minIntervalMs;
+  uint16_t maxIntervalMs;
+  float deadband[2];       // lbs, per channel
+  uint16_t coherenceMs;
+};
+
+// False if the payload is short or inconsistent (out is left unchanged)
+static inline bool publishConfigDecode(const uint8_t* in, size_t len, PublishConfig& out) {
+  if (len < PUBLISH_CONFIG_MIN_SIZE) return false;
+  uint16_t minMs = (uint16_t)(in[0] | (in[1] << 8));
+  uint16_t maxMs = (uint16_t)(in[2] | (in[3] << 8));
+  if (minMs < PUBLISH_MIN_INTERVAL_FLOOR_MS || maxMs < minMs) return false;
+  out.minIntervalMs = minMs;
+  out.maxIntervalMs = maxMs;
+  out.deadband[0] = (uint16_t)(in[4] | (in[5] << 8)) / 10.0f;
+  out.deadband[1] = (uint16_t)(in[6] | (in[7] << 8)) / 10.0f;
+  out.coherenceMs = len >= PUBLISH_CONFIG_SIZE ? (uint16_t)(in[8] | (in[9] << 8)) : PUBLISH_DEFAULT_COHERENCE_MS;
+  return true;
+}
+
+static inline void publishConfigEncode(const PublishConfig& c, uint8_t* out) {
+  uint16_t d1 = (uint16_t)lroundf(c.deadband[0] * 10.0f);
+  uint16_t d2 = (uint16_t)lroundf(c.deadband[1] * 10.0f);
+  out[0] = (uint8_t)c.minIntervalMs;
+  out[1] = (uint8_t)(c.minIntervalMs >> 8);
+  out[2] = (uint8_t)c.maxIntervalMs;
+  out[3] = (uint8_t)(c.maxIntervalMs >> 8);
+  out[4] = (uint8_t)d1;
+  out[5] = (uint8_t)(d1 >> 8);
+  out[6] = (uint8_t)d2;
+  out[7] = (uint8_t)(d2 >> 8);
+  out[8] = (uint8_t)c.coherenceMs;
+  out[9] = (uint8_t)(c.coherenceMs >> 8);
+}
+
+template <uint16_t SLOTS>
+class ChangeTracker {
+ public:
+  ChangeTracker() { reset(); }
+
+  // Everything reads as changed (new subscriber, new config)
+  void reset() {
+    for (uint16_t i = 0; i < SLOTS; i++) _notified[i].key = 0;
+  }
+
+  // Moved past a deadband since mark(), or never notified
+  bool changed(uint16_t slot, MacKey key, float ch1, float ch2, const PublishConfig& c) const {
+    if (slot >= SLOTS) return false;
+    const Entry& e = _notified[slot];
+    if (e.key != key || key == 0) return true;
+    return exceeds(ch1 - e.ch1, c.deadband[0]) || exceeds(ch2 - e.ch2, c.deadband[1]);
+  }
+
+  void mark(uint16_t slot, MacKey key, float ch1, float ch2) {
+    if (slot >= SLOTS) return;
+    _notified[slot].key = key;
+    _notified[slot].ch1 = ch1;
+    _notified[slot].ch2 = ch2;
+  }
+
+ private:
+  static bool exceeds(float delta, float deadband) {
+    return deadband > 0.0f ? fabsf(delta) >= deadband : delta != 0.0f;
+  }
+
+  struct Entry {
+    MacKey key;
+    float ch1;
+    float ch2;
+  };
+
+  Entry _notified[SLOTS];
+};
@@ -0,0 +1,201 @@
+#pragma once
+
+// Sample history: a fixed-capacity ring of quantized samples (the firmware puts the
+// storage in PSRAM) plus the delta/zigzag/varint block codec used for the flash log
+// and for BLE bulk download. No Arduino/IDF dependencies.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// One quantized sample (20 bytes in RAM)
+struct HistorySample {
+  uint32_t timestamp;        // ms since boot
+  int32_t ch1Weight;         // lbs
+  int32_t ch2Weight;         // lbs
+  uint16_t ch1Pressure;      // PSI * 100
+  uint16_t ch2Pressure;      // PSI * 100
+  uint16_t ambientPressure;  // PSI * 100
+  int16_t temperature;       // °F * 10
+};
+
+// Ring over caller-provided storage. Samples are addressed by a monotonically
+// increasing index so readers can tell when data they want has been overwritten.
+class HistoryRing {
+ public:
+  void attach(HistorySample* storage, uint32_t capacity) {
+    _buf = storage;
+    _capacity = capacity;
+    _next = 0;
+  }
+
+  bool ready() const { return _buf != nullptr && _capacity > 0; }
+  uint32_t capacity() const { return _capacity; }
+
+  // Index one past the newest sample (total samples ever pushed)
+  uint32_t endIndex() const { return _next; }
+
+  // Index of the oldest sample still held
+  uint32_t beginIndex() const { return _next > _capacity ? _next - _capacity : 0; }
+
+  void push(const HistorySample& s) {
+    _buf[_next % _capacity] = s;
+    _next++;
+  }
+
+  // Copy up to maxOut samples starting at index 'from'. Returns the count copied;
+  // 'from' is clamped forward if it has already been overwritten.
+  uint32_t read(uint32_t& from, HistorySample* out, uint32_t maxOut) const {
+    if (from < beginIndex()) from = beginIndex();
+    uint32_t n = 0;
+    while (from + n < _next && n < maxOut) {
+      out[n] = _buf[(from + n) % _capacity];
+      n++;
+    }
+    return n;
+  }
+
+  // First index whose timestamp is >= ts (binary search over the held window)
+  uint32_t lowerBound(uint32_t ts) const {
+    uint32_t lo = beginIndex(), hi = _next;
+    while (lo < hi) {
+      uint32_t mid = lo + (hi - lo) / 2;
+      if (_buf[mid % _capacity].timestamp < ts) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+  }
+
+ private:
+  HistorySample* _buf = nullptr;
+  uint32_t _capacity = 0;
+  uint32_t _next = 0;
+};
+
+// ------------------------------------------------------------
+// Block codec
+// ------------------------------------------------------------
+// Block = header + payload. The payload is, per sample, the zigzag varint of the
+// difference from the previous sample for each field (the first sample is coded
+// against zero). Slowly changing weights/pressures mostly encode in 1 byte/field.
+
+#define HISTORY_BLOCK_MAGIC 0x4853  // "SH"
+
+#pragma pack(push, 1)
+struct HistoryBlockHeader {
+  uint16_t magic;
+  uint16_t bootId;       // Boot counter, so timestamps from different boots don't mix
+  uint16_t count;        // Samples in the block
+  uint16_t payloadLen;   // Bytes following the header
+  uint32_t firstTimestamp;
+  uint32_t lastTimestamp;
+};
+#pragma pack(pop)
+
+namespace history_codec {
+
+inline uint32_t zigzag(int32_t v) { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+inline int32_t unzigzag(uint32_t v) { return (int32_t)(v >> 1) ^ -(int32_t)(v & 1); }
+
+inline size_t putVarint(uint8_t* out, size_t cap, size_t pos, uint32_t v) {
+  while (v >= 0x80) {
+    if (pos >= cap) return 0;
+    out[pos++] = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  if (pos >= cap) return 0;
+  out[pos++] = (uint8_t)v;
+  return pos;
+}
+
+inline size_t getVarint(const uint8_t* in, size_t len, size_t pos, uint32_t* v) {
+  uint32_t result = 0;
+  for (uint8_t shift = 0; shift < 35; shift += 7) {
+    if (pos >= len) return 0;
+    uint8_t b = in[pos++];
+    result |= (uint32_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) {
+      *v = result;
+      return pos;
+    }
+  }
+  return 0;
+}
+
+}  // namespace history_codec
+
+// Worst case is 5 bytes per field
+#define HISTORY_MAX_ENCODED_SAMPLE 35
+
+// Encode n samples into 'out'. Returns total block bytes (header included), 0 if it didn't fit.
+inline size_t encodeHistoryBlock(const HistorySample* samples, uint16_t n, uint16_t bootId,
+                                 uint8_t* out, size_t cap) {
+  using namespace history_codec;
+  if (n == 0 || cap < sizeof(HistoryBlockHeader)) return 0;
+
+  size_t pos = sizeof(HistoryBlockHeader);
+  HistorySample prev;
+  memset(&prev, 0, sizeof(prev));
+
+  for (uint16_t i = 0; i < n; i++) {
+    const HistorySample& s = samples[i];
+    const int32_t deltas[7] = {
+      (int32_t)(s.timestamp - prev.timestamp),
+      s.ch1Weight - prev.ch1Weight,
+      s.ch2Weight - prev.ch2Weight,
+      (int32_t)s.ch1Pressure - (int32_t)prev.ch1Pressure,
+      (int32_t)s.ch2Pressure - (int32_t)prev.ch2Pressure,
+      (int32_t)s.ambientPressure - (int32_t)prev.ambientPressure,
+      (int32_t)s.temperature - (int32_t)prev.temperature,
+    };
+    for (uint8_t f = 0; f < 7; f++) {
+      pos = putVarint(out, cap, pos, zigzag(deltas[f]));
+      if (pos == 0) return 0;
+    }
+    prev = s;
+  }
+
+  HistoryBlockHeader hdr;
+  hdr.magic = HISTORY_BLOCK_MAGIC;
+  hdr.bootId = bootId;
+  hdr.count = n;
+  hdr.payloadLen = (uint16_t)(pos - sizeof(HistoryBlockHeader));
+  hdr.firstTimestamp = samples[0].timestamp;
+  hdr.lastTimestamp = samples[n - 1].timestamp;
+  memcpy(out, &hdr, sizeof(hdr));
+  return pos;
+}
+
+// Decode one block. Returns the number of samples written to 'out' (0 on a corrupt block).
+inline uint16_t decodeHistoryBlock(const uint8_t* in, size_t len, HistorySample* out, uint16_t maxOut) {
+  using namespace history_codec;
+  HistoryBlockHeader hdr;
+  if (len < sizeof(hdr)) return 0;
+  memcpy(&hdr, in, sizeof(hdr));
+  if (hdr.magic != HISTORY_BLOCK_MAGIC || sizeof(hdr) + hdr.payloadLen > len || hdr.count > maxOut) return 0;
+
+  size_t end = sizeof(hdr) + hdr.payloadLen;
+  size_t pos = sizeof(hdr);
+  HistorySample prev;
+  memset(&prev, 0, sizeof(prev));
+
+  for (uint16_t i = 0; i < hdr.count; i++) {
+    int32_t d[7];
+    for (uint8_t f = 0; f < 7; f++) {
+      uint32_t v;
+      pos = getVarint(in, end, pos, &v);
+      if (pos == 0) return 0;
+      d[f] = unzigzag(v);
+    }
+    HistorySample s;
+    s.timestamp = prev.timestamp + (uint32_t)d[0];
+    s.ch1Weight = prev.ch1Weight + d[1];
+    s.ch2Weight = prev.ch2Weight + d[2];
+    s.ch1Pressure = (uint16_t)(prev.ch1Pressure + d[3]);
+    s.ch2Pressure = (uint16_t)(prev.ch2Pressure + d[4]);
+    s.ambientPressure = (uint16_t)(prev.ambientPressure + d[5]);
+    s.temperature = (int16_t)(prev.temperature + d[6]);
+    out[i] = s;
+    prev = s;
+  }
+  return hdr.count;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+// Sequence lock for one small trivially copyable record. Readers take a copy and
+// retry if a write overlapped it; they never block the writer and never see a torn
+// record. The payload is stored as relaxed atomic words, so a copy racing a write is
+// well defined (and discarded by the sequence check). Host-buildable.
+//
+// Writer side: callers must serialize writers themselves (one writer task, or a
+// critical section around edit()/publish()). The writer keeps a private copy of the
+// record that it can inspect and modify without going through the sequence.
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <type_traits>
+
+template <typename T>
+class Seqlock {
+ public:
+  static_assert(std::is_trivially_copyable<T>::value, "seqlock records are copied word by word");
+
+  Seqlock() : _seq(0) {
+    memset(&_shadow, 0, sizeof(_shadow));
+    for (uint32_t i = 0; i < WORDS; i++) _words[i].store(0, std::memory_order_relaxed);
+  }
+
+  // ---- Writer side ----
+
+  // Writer's private copy; modify it, then publish()
+  T& edit() { return _shadow; }
+  const T& current() const { return _shadow; }
+
+  void publish() {
+    uint32_t src[WORDS];
+    src[WORDS - 1] = 0;
+    memcpy(src, &_shadow, sizeof(T));
+
+    uint32_t seq = _seq.load(std::memory_order_relaxed);
+    _seq.store(seq + 1, std::memory_order_relaxed);  // Odd: write in progress
+    std::atomic_thread_fence(std::memory_order_release);
+    for (uint32_t i = 0; i < WORDS; i++) _words[i].store(src[i], std::memory_order_relaxed);
+    _seq.store(seq + 2, std::memory_order_release);
+  }
+
+  void write(const T& value) {
+    _shadow = value;
+    publish();
+  }
+
+  // ---- Reader side (any task, any core) ----
+
+  // One attempt; false if a write overlapped the copy
+  bool tryRead(T& out) const {
+    uint32_t before = _seq.load(std::memory_order_acquire);
+    if (before & 1) return false;
+    uint32_t dst[WORDS];
+    for (uint32_t i = 0; i < WORDS; i++) dst[i] = _words[i].load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (_seq.load(std::memory_order_relaxed) != before) return false;
+    memcpy(&out, dst, sizeof(T));
+    return true;
+  }
+
+  // Retries until a consistent copy is taken. Returns the number of retries.
+  uint32_t read(T& out) const {
+    uint32_t retries = 0;
+    while (!tryRead(out)) retries++;
+    return retries;
+  }
+
+  // Bumps by 2 on every publish(); lets readers skip unchanged records
+  uint32_t version() const { return _seq.load(std::memory_order_acquire) & ~1u; }
+
+ private:
+  static const uint32_t WORDS = (sizeof(T) + 3) / 4;
+
+  T _shadow;
+  std::atomic<uint32_t> _seq;
+  std::atomic<uint32_t> _words[WORDS];
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+// Bounded lock-free ring queues for passing small POD messages between tasks.
+// SpscQueue: one producer task, one consumer task (wait-free on both sides).
+// MpscQueue: any number of producers (tasks, BLE/WiFi callbacks), one consumer.
+// Both are fixed-size, never allocate, and never block: push() returns false when
+// the queue is full and the caller decides what to drop. Host-buildable.
+
+#include <stdint.h>
+#include <atomic>
+
+template <typename T, uint32_t N>
+class SpscQueue {
+ public:
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "queue size must be a power of two");
+
+  bool push(const T& value) {
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    if (head - _tail.load(std::memory_order_acquire) >= N) return false;
+    _buf[head & (N - 1)] = value;
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T& out) {
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail == _head.load(std::memory_order_acquire)) return false;
+    out = _buf[tail & (N - 1)];
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  uint32_t size() const {
+    return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+  }
+  bool empty() const { return size() == 0; }
+  static constexpr uint32_t capacity() { return N; }
+
+ private:
+  T _buf[N];
+  std::atomic<uint32_t> _head{0};  // Written by the producer only
+  std::atomic<uint32_t> _tail{0};  // Written by the consumer only
+};
+
+// Bounded MPSC queue (Vyukov's sequence-numbered ring). Each cell carries a sequence
+// number that tells producers whether it is free for their ticket and tells the
+// consumer whether the value in it has been published.
+template <typename T, uint32_t N>
+class MpscQueue {
+ public:
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "queue size must be a power of two");
+
+  MpscQueue() {
+    for (uint32_t i = 0; i < N; i++) _cells[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+  bool push(const T& value) {
+    uint32_t pos = _enqueue.load(std::memory_order_relaxed);
+    Cell* cell;
+    for (;;) {
+      cell = &_cells[pos & (N - 1)];
+      uint32_t seq = cell->seq.load(std::memory_order_acquire);
+      int32_t diff = (int32_t)(seq - pos);
+      if (diff == 0) {
+        if (_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+      } else if (diff < 0) {
+        return false;  // Full: the consumer hasn't freed this cell yet
+      } else {
+        pos = _enqueue.load(std::memory_order_relaxed);
+      }
+    }
+    cell->value = value;
+    cell->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only
+  bool pop(T& out) {
+    Cell& cell = _cells[_dequeue & (N - 1)];
+    uint32_t seq = cell.seq.load(std::memory_order_acquire);
+    if ((int32_t)(seq - (_dequeue + 1)) < 0) return false;  // Not published yet
+    out = cell.value;
+    cell.seq.store(_dequeue + N, std::memory_order_release);
+    _dequeue++;
+    return true;
+  }
+
+  static constexpr uint32_t capacity() { return N; }
+
+ private:
+  struct Cell {
+    std::atomic<uint32_t> seq;
+    T value;
+  };
+
+  Cell _cells[N];
+  std::atomic<uint32_t> _enqueue{0};
+  uint32_t _dequeue = 0;
+};
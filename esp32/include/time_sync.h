@@ -0,0 +1,155 @@
+#pragma once
+
+// Mesh timebase. The hub is the time master: its esp_timer clock is mesh time, and
+// it broadcasts a FRAME_TIME_SYNC beacon stamped with that clock just before the
+// send. A slave pairs each beacon with its own clock at receive and fits offset and
+// drift by least squares over the last WINDOW beacons, so mesh time is a straight
+// line through the recent beacons rather than a clock that steps at each one, and
+// keeps running on the fitted drift if beacons stop for a while.
+//
+// The beacon's stamp-to-receive latency isn't measured. It is close to constant and
+// the same for every slave, so it shifts the whole mesh clock slightly but doesn't
+// skew slaves against each other - which is what coherent snapshots need.
+//
+// Beacons far off the fit are dropped as late deliveries; a few in a row, or one
+// very far off (the master rebooted), restart the fit. So does a different master.
+//
+// Times in microseconds. Not thread-safe. Host-buildable.
+
+#include <stdint.h>
+#include <math.h>
+#include "mac_index.h"
+
+#define TIME_SYNC_MAX_DRIFT 500e-6   // Way past any crystal: a bad fit, not a clock
+
+enum TimeSyncUpdate : uint8_t {
+  TIME_SYNC_ACCEPTED,
+  TIME_SYNC_OUTLIER,     // Dropped, fit unchanged
+  TIME_SYNC_RESTARTED,   // New master or a step in its clock: fit starts over from this beacon
+};
+
+template <uint8_t WINDOW>
+class TimeSync {
+ public:
+  TimeSync(uint32_t outlierUs, uint32_t stepUs, uint32_t holdoverUs)
+      : _outlierUs(outlierUs), _stepUs(stepUs), _holdoverUs(holdoverUs),
+        _beacons(0), _outliers(0), _restarts(0) {
+    clear(0);
+  }
+
+  TimeSyncUpdate update(MacKey master, int64_t localUs, int64_t masterUs) {
+    _beacons++;
+    int64_t offset = masterUs - localUs;
+    TimeSyncUpdate result = TIME_SYNC_ACCEPTED;
+
+    if (master != _master) {
+      if (_master != 0) _restarts++;
+      clear(master);
+      result = TIME_SYNC_RESTARTED;
+    } else if (_count > 0) {
+      int64_t residual = offset - offsetAt(localUs);
+      int64_t magnitude = residual < 0 ? -residual : residual;
+      if (magnitude > (int64_t)_stepUs || (magnitude > (int64_t)_outlierUs && _outlierRun >= 2)) {
+        _restarts++;
+        clear(master);
+        result = TIME_SYNC_RESTARTED;
+      } else if (magnitude > (int64_t)_outlierUs) {
+        _outliers++;
+        _outlierRun++;
+        return TIME_SYNC_OUTLIER;
+      }
+    }
+    _outlierRun = 0;
+
+    _local[_head] = localUs;
+    _offset[_head] = offset;
+    _head = (uint8_t)((_head + 1) % WINDOW);
+    if (_count < WINDOW) _count++;
+    _lastBeaconUs = localUs;
+    fit();
+    return result;
+  }
+
+  // Two beacons make a drift estimate; holdover bounds how long it is trusted alone
+  bool synced(int64_t localUs) const {
+    return _count >= 2 && localUs - _lastBeaconUs < (int64_t)_holdoverUs;
+  }
+
+  int64_t toMaster(int64_t localUs) const { return localUs + offsetAt(localUs); }
+
+  int64_t offsetAt(int64_t localUs) const {
+    return _fitOffset + (int64_t)(_fitSlope * (double)(localUs - _fitRef));
+  }
+
+  MacKey master() const { return _master; }
+  float driftPpm() const { return (float)(_fitSlope * 1e6); }
+  uint32_t jitterUs() const { return _jitterUs; }   // RMS residual of the fit
+  int64_t lastBeaconUs() const { return _lastBeaconUs; }
+  uint32_t beacons() const { return _beacons; }
+  uint32_t outliers() const { return _outliers; }
+  uint32_t restarts() const { return _restarts; }
+
+ private:
+  void clear(MacKey master) {
+    _master = master;
+    _count = 0;
+    _head = 0;
+    _outlierRun = 0;
+    _fitRef = 0;
+    _fitOffset = 0;
+    _fitSlope = 0.0;
+    _jitterUs = 0;
+    _lastBeaconUs = 0;
+  }
+
+  // Offset = a + b * (local - ref), ref = newest beacon. Offsets are taken relative
+  // to the newest one too, so doubles keep full microsecond precision.
+  void fit() {
+    uint8_t newest = (uint8_t)((_head + WINDOW - 1) % WINDOW);
+    _fitRef = _local[newest];
+    int64_t base = _offset[newest];
+
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (uint8_t i = 0; i < _count; i++) {
+      double x = (double)(_local[i] - _fitRef);
+      double y = (double)(_offset[i] - base);
+      sx += x;
+      sy += y;
+      sxx += x * x;
+      sxy += x * y;
+    }
+    double n = _count;
+    double denom = n * sxx - sx * sx;
+    double slope = (_count >= 2 && denom > 0) ? (n * sxy - sx * sy) / denom : 0.0;
+    if (slope > TIME_SYNC_MAX_DRIFT) slope = TIME_SYNC_MAX_DRIFT;
+    if (slope < -TIME_SYNC_MAX_DRIFT) slope = -TIME_SYNC_MAX_DRIFT;
+    double intercept = (sy - slope * sx) / n;
+    _fitSlope = slope;
+    _fitOffset = base + (int64_t)intercept;
+
+    double sse = 0;
+    for (uint8_t i = 0; i < _count; i++) {
+      double r = (double)(_offset[i] - base) - (intercept + slope * (double)(_local[i] - _fitRef));
+      sse += r * r;
+    }
+    _jitterUs = (uint32_t)sqrt(sse / n);
+  }
+
+  int64_t _local[WINDOW];
+  int64_t _offset[WINDOW];   // master - local
+  uint8_t _count;
+  uint8_t _head;
+  uint8_t _outlierRun;
+  MacKey _master;
+  int64_t _fitRef;
+  int64_t _fitOffset;
+  double _fitSlope;
+  uint32_t _jitterUs;
+  int64_t _lastBeaconUs;
+  uint32_t _outlierUs;
+  uint32_t _stepUs;
+  uint32_t _holdoverUs;
+  uint32_t _beacons;
+  uint32_t _outliers;
+  uint32_t _restarts;
+};
@@ -0,0 +1,215 @@
+#pragma once
+
+// Weigh now: a synchronized fleet snapshot on demand. The phone writes a request to
+// the hub; the hub broadcasts FRAME_WEIGH_TRIGGER naming a mesh time instant a little
+// ahead and a reply slot per slave; every node takes its weights at that instant and
+// each slave answers in its own slot, so the replies don't all contend for the air at
+// once. The hub collects the answers here and notifies one result - slaves that
+// didn't answer are listed as missing rather than left out.
+//
+//   request write
+//     u8  op           WEIGH_OP_REQUEST
+//     u8  requestId    Chosen by the app, echoed in the result
+//
+//   result notification(s), split to the MTU like the fleet frame
+//     u8  magic        BLE_WEIGH_MAGIC
+//     u8  requestId
+//     u8  index        Frame number within the result
+//     u8  flags        WEIGH_RESULT_*
+//     u8  count        Records in this frame
+//     u8  recordSize
+//     u8  expected     Slaves asked
+//     u8  answered     Of those, slaves that answered
+//     f32 total        Hub + every answer (lbs)
+//     u16 elapsedMs    Request -> result
+//     u16 reserved
+//   records, recordSize bytes each (first record of frame 0 is the hub):
+//     u8  flags        WEIGH_REC_*
+//     u8  mac[6]
+//     i32 ch1/ch2 weight 0.1 lb, u16 ch1/ch2 std dev 0.1 lb (zero when missing)
+//
+// Slots: the trigger lists the last two MAC bytes of every slave asked, in slot
+// order; slaves the hub didn't know about share a few spare slots after those.
+// Two slaves with the same two bytes would share a slot - ESP-NOW's carrier sense
+// and retries still get both through, just not collision-free.
+//
+// Not thread-safe. Host-buildable.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "espnow_frame.h"
+#include "mac_index.h"
+
+#define WEIGH_OP_REQUEST        0x01
+#define BLE_WEIGH_MAGIC         0xF2
+#define BLE_WEIGH_HEADER_SIZE   16
+#define BLE_WEIGH_RECORD_SIZE   19
+
+#define WEIGH_RESULT_LAST       0x01
+#define WEIGH_RESULT_COMPLETE   0x02   // Every slave asked answered
+
+#define WEIGH_REC_HUB           0x01
+#define WEIGH_REC_ANSWERED      0x02
+#define WEIGH_REC_CH1_SETTLED   0x04
+#define WEIGH_REC_CH2_SETTLED   0x08
+#define WEIGH_REC_SYNCED        0x10   // Sampled on the mesh clock
+#define WEIGH_REC_STALE         0x20   // No sample close to the instant
+#define WEIGH_REC_UNLISTED      0x40   // Answered without being asked (hub didn't know it yet)
+
+struct WeighEntry {
+  MacKey mac;
+  uint8_t flags;
+  float ch1Weight;
+  float ch2Weight;
+  float ch1WeightStdDev;
+  float ch2WeightStdDev;
+};
+
+// Reply slot of the slave with MAC 'mac' in a trigger listing 'listed' slaves
+static inline uint8_t weighSlot(const uint8_t* tails, uint8_t listed, uint8_t slots, const uint8_t* mac) {
+  return frameTailSlot(tails, listed, slots, (uint16_t)(mac[4] << 8 | mac[5]));
+}
+
+// Hub side of one round. Entry 0 is the hub, then the slaves asked in slot order,
+// then any unlisted slaves that answered.
+template <uint16_t N>
+class WeighNowCollector {
+ public:
+  WeighNowCollector() : _count(0), _expected(0), _answered(0), _id(0), _requestId(0),
+                        _startUs(0), _active(false), _finished(false) {}
+
+  void begin(uint8_t requestId, uint8_t id, MacKey hub, int64_t startUs) {
+    _requestId = requestId;
+    _id = id;
+    _startUs = startUs;
+    _expected = 0;
+    _answered = 0;
+    _active = true;
+    _finished = false;
+    memset(&_entries[0], 0, sizeof(WeighEntry));
+    _entries[0].mac = hub;
+    _entries[0].flags = WEIGH_REC_HUB;
+    _count = 1;
+  }
+
+  // Add a slave to ask; false when the round is full
+  bool expect(MacKey mac) {
+    if (_count >= N || _expected >= 255) return false;
+    WeighEntry& e = _entries[_count++];
+    memset(&e, 0, sizeof(e));
+    e.mac = mac;
+    _expected++;
+    return true;
+  }
+
+  // Last two MAC bytes of the slaves asked, slot order; returns how many
+  uint8_t slotTails(uint8_t* out, size_t cap) const {
+    uint8_t n = 0;
+    for (uint16_t i = 1; i <= _expected && 2u * (n + 1) <= cap; i++, n++) {
+      framePutU16(out + 2 * n, (uint16_t)(_entries[i].mac & 0xFFFF));
+    }
+    return n;
+  }
+
+  void setHub(const WeighReply& r) { fill(_entries[0], r); }
+
+  // A slave's answer; false for another round, a repeat or no room
+  bool record(MacKey mac, const WeighReply& r) {
+    if (!_active || _finished || r.id != _id) return false;
+    for (uint16_t i = 1; i < _count; i++) {
+      WeighEntry& e = _entries[i];
+      if (e.mac != mac) continue;
+      if (e.flags & WEIGH_REC_ANSWERED) return false;
+      fill(e, r);
+      if (i <= _expected) _answered++;
+      return true;
+    }
+    if (_count >= N) return false;
+    WeighEntry& e = _entries[_count++];
+    e.mac = mac;
+    fill(e, r);
+    e.flags |= WEIGH_REC_UNLISTED;
+    return true;
+  }
+
+  bool complete() const { return (_entries[0].flags & WEIGH_REC_ANSWERED) && _answered == _expected; }
+
+  // True only for the first call of a round: that caller publishes the result
+  bool finish() {
+    if (!_active || _finished) return false;
+    _finished = true;
+    return true;
+  }
+
+  bool running() const { return _active && !_finished; }
+  bool finished() const { return _active && _finished; }
+  uint8_t id() const { return _id; }
+  uint8_t requestId() const { return _requestId; }
+  uint8_t expected() const { return _expected; }
+  uint8_t answered() const { return _answered; }
+  int64_t startUs() const { return _startUs; }
+
+  float total() const {
+    float sum = 0;
+    for (uint16_t i = 0; i < _count; i++) {
+      if (_entries[i].flags & WEIGH_REC_ANSWERED) sum += _entries[i].ch1Weight + _entries[i].ch2Weight;
+    }
+    return sum;
+  }
+
+  // Result frame 'index', records from 'next' on; advances next. Frames are
+  // encoded until next reaches the end, the frame that gets there is flagged LAST.
+  size_t encodeResult(uint8_t* out, size_t cap, uint8_t index, uint16_t elapsedMs, uint16_t& next) const {
+    if (cap < BLE_WEIGH_HEADER_SIZE + BLE_WEIGH_RECORD_SIZE) return 0;
+    out[0] = BLE_WEIGH_MAGIC;
+    out[1] = _requestId;
+    out[2] = index;
+    out[3] = complete() ? WEIGH_RESULT_COMPLETE : 0;
+    out[4] = 0;
+    out[5] = BLE_WEIGH_RECORD_SIZE;
+    out[6] = _expected;
+    out[7] = _answered;
+    framePutF32(out + 8, total());
+    framePutU16(out + 12, elapsedMs);
+    framePutU16(out + 14, 0);  // Reserved
+    size_t len = BLE_WEIGH_HEADER_SIZE;
+    while (next < _count && len + BLE_WEIGH_RECORD_SIZE <= cap) {
+      const WeighEntry& e = _entries[next++];
+      uint8_t* p = out + len;
+      p[0] = e.flags;
+      macKeyToBytes(e.mac, p + 1);
+      framePutU32(p + 7, (uint32_t)frameQuantize(e.ch1Weight, 10.0f, -2000000000, 2000000000));
+      framePutU32(p + 11, (uint32_t)frameQuantize(e.ch2Weight, 10.0f, -2000000000, 2000000000));
+      framePutU16(p + 15, (uint16_t)frameQuantize(e.ch1WeightStdDev, 10.0f, 0, 65535));
+      framePutU16(p + 17, (uint16_t)frameQuantize(e.ch2WeightStdDev, 10.0f, 0, 65535));
+      out[4]++;
+      len += BLE_WEIGH_RECORD_SIZE;
+    }
+    if (next >= _count) out[3] |= WEIGH_RESULT_LAST;
+    return len;
+  }
+
+ private:
+  static void fill(WeighEntry& e, const WeighReply& r) {
+    e.ch1Weight = r.ch1Weight;
+    e.ch2Weight = r.ch2Weight;
+    e.ch1WeightStdDev = r.ch1WeightStdDev;
+    e.ch2WeightStdDev = r.ch2WeightStdDev;
+    e.flags = (uint8_t)((e.flags & (WEIGH_REC_HUB | WEIGH_REC_UNLISTED)) | WEIGH_REC_ANSWERED |
+                        ((r.flags & 0x01) ? WEIGH_REC_CH1_SETTLED : 0) |
+                        ((r.flags & 0x02) ? WEIGH_REC_CH2_SETTLED : 0) |
+                        ((r.flags & WEIGH_REPLY_SYNCED) ? WEIGH_REC_SYNCED : 0) |
+                        ((r.flags & WEIGH_REPLY_STALE) ? WEIGH_REC_STALE : 0));
+  }
+
+  WeighEntry _entries[N];
+  uint16_t _count;
+  uint8_t _expected;
+  uint8_t _answered;
+  uint8_t _id;
+  uint8_t _requestId;
+  int64_t _startUs;
+  bool _active;
+  bool _finished;
+};
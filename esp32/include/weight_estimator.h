@@ -0,0 +1,127 @@
+#pragma once
+
+// Per-channel weight estimator for dynamic weighing.
+// A two-state (weight, rate) constant-velocity Kalman filter with adaptive noise:
+// innovations that keep the same sign (load changes, leveling valves) inflate the
+// process noise so the estimate follows quickly, while zero-mean innovations that
+// are just larger than expected (road vibration) inflate the measurement noise so
+// the estimate stays smooth. Plain C++ so recorded traces can be replayed on a host.
+
+#include <stdint.h>
+#include <math.h>
+
+struct WeightEstimatorConfig {
+  float measurementStdDev = 150.0f;  // lbs, noise of one decimated weight sample
+  float processStdDev = 10.0f;       // lbs/s^2, baseline rate random walk
+  float adaptAlpha = 0.05f;          // EWMA weight for the innovation statistics
+  float biasThreshold = 0.5f;        // |mean normalized innovation| above this = real change
+  float maxProcessScale = 400.0f;    // Upper bound on the process noise multiplier
+  float noiseAdaptRate = 0.01f;      // How fast the measurement noise follows the innovations
+  float maxNoiseScale = 100.0f;      // Upper bound on the measurement noise multiplier
+  float settleRate = 50.0f;          // lbs/s, |rate| below this counts as steady
+  float settleStdDev = 60.0f;        // lbs, estimate std dev below this counts as steady
+  float settleTime = 2.0f;           // s, must stay steady this long to report settled
+};
+
+class WeightEstimator {
+ public:
+  WeightEstimator() {
+    configure(WeightEstimatorConfig());
+    reset(0.0f);
+  }
+
+  void configure(const WeightEstimatorConfig& cfg) {
+    _cfg = cfg;
+    _r = cfg.measurementStdDev * cfg.measurementStdDev;
+    _q = cfg.processStdDev * cfg.processStdDev;
+  }
+
+  void reset(float weight) {
+    _w = weight;
+    _rate = 0.0f;
+    _p00 = 1e8f;  // Unknown start: the first measurement takes over
+    _p01 = 0.0f;
+    _p11 = 1e4f;
+    _bias = 0.0f;
+    _nis = 1.0f;
+    _rScale = 1.0f;
+    _steadyFor = 0.0f;
+    _settled = false;
+    _initialized = false;
+  }
+
+  // Fold in one weight measurement taken dt seconds after the previous one
+  void update(float z, float dt) {
+    if (!_initialized) {
+      reset(z);
+      _p00 = _r;
+      _initialized = true;
+      return;
+    }
+    if (dt <= 0.0f) return;
+
+    // Predict (F = [1 dt; 0 1], Q = q * [dt^3/3 dt^2/2; dt^2/2 dt])
+    float q = _q * processScale();
+    float dt2 = dt * dt;
+
+    _w += _rate * dt;
+    _p00 += dt * (2.0f * _p01 + dt * _p11) + q * dt2 * dt / 3.0f;
+    _p01 += dt * _p11 + q * dt2 * 0.5f;
+    _p11 += q * dt;
+
+    // Update (H = [1 0])
+    float y = z - _w;
+    float s = _p00 + _r * _rScale;
+    float k0 = _p00 / s;
+    float k1 = _p01 / s;
+
+    _w += k0 * y;
+    _rate += k1 * y;
+    _p11 -= k1 * _p01;
+    _p00 -= k0 * _p00;
+    _p01 -= k0 * _p01;
+
+    // Adapt on the normalized innovation: its running mean flags a real change in
+    // load, its running square (when unbiased) tracks the actual measurement noise
+    float nu = y / sqrtf(s);
+    _bias += _cfg.adaptAlpha * (nu - _bias);
+    _nis += _cfg.adaptAlpha * (nu * nu - _nis);
+    if (fabsf(_bias) <= _cfg.biasThreshold) {
+      _rScale *= 1.0f + _cfg.noiseAdaptRate * (_nis - 1.0f);
+      if (_rScale < 0.25f) _rScale = 0.25f;
+      if (_rScale > _cfg.maxNoiseScale) _rScale = _cfg.maxNoiseScale;
+    }
+
+    // Settled once rate and uncertainty have both been low for settleTime
+    bool steady = fabsf(_rate) < _cfg.settleRate && sqrtf(_p00) < _cfg.settleStdDev;
+    _steadyFor = steady ? _steadyFor + dt : 0.0f;
+    _settled = _steadyFor >= _cfg.settleTime;
+  }
+
+  float weight() const { return _w; }
+  float rate() const { return _rate; }
+  float variance() const { return _p00; }
+  float stdDev() const { return sqrtf(_p00); }
+  float noiseScale() const { return _rScale; }
+  float processScale() const {
+    float ratio = fabsf(_bias) / _cfg.biasThreshold;
+    if (ratio <= 1.0f) return 1.0f;
+    float scale = ratio * ratio * ratio * ratio;
+    return scale < _cfg.maxProcessScale ? scale : _cfg.maxProcessScale;
+  }
+  bool settled() const { return _settled; }
+  bool initialized() const { return _initialized; }
+
+ private:
+  WeightEstimatorConfig _cfg;
+  float _r = 0.0f;
+  float _q = 0.0f;
+  float _w, _rate;
+  float _p00, _p01, _p11;
+  float _bias;
+  float _nis;
+  float _rScale;
+  float _steadyFor;
+  bool _settled;
+  bool _initialized;
+};
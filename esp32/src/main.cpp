@@ -1,5 +1,5 @@
 #include <WiFi.h>
-#include <WebServer.h>
+#include <ESPAsyncWebServer.h>  // Serves from the AsyncTCP task; nothing to poll
 #include <HTTPClient.h>
 #include <ArduinoJson.h>
 #include <SPIFFS.h>
@@ -16,8 +16,43 @@
 #include <Adafruit_Sensor.h>
 #include <Adafruit_BME280.h>
 #include <Adafruit_NeoPixel.h>
-#include <Update.h>      // ESP32 OTA library
+#include <esp_partition.h>  // OTA blocks programmed straight into the update partition
 #include <esp_ota_ops.h>  // OTA partition operations
+#include <mbedtls/sha256.h>  // Compressed OTA images, hashed on the SHA accelerator
+#include <atomic>
+#include <new>            // Placement new for PSRAM-resident tables
+#include <driver/adc.h>   // Continuous (DMA) ADC driver
+#include <esp_adc_cal.h>  // ADC calibration (raw code -> mV)
+#include <esp_timer.h>    // Microsecond timestamps for latency stats
+#include <esp_pm.h>       // Dynamic frequency scaling / automatic light sleep
+#include <esp_coexist.h>  // Wi-Fi / Bluetooth arbitration per airtime phase
+#include <esp_idf_version.h>
+#include "adc_decimator.h"
+#include "weight_estimator.h"
+#include "sample_history.h"
+#include "pressure_scenario.h"
+#include "spsc_queue.h"
+#include "latency_stats.h"
+#include "buffer_pool.h"
+#include "seqlock.h"
+#include "event_scheduler.h"
+#include "mac_index.h"
+#include "espnow_frame.h"
+#include "peer_cache.h"
+#include "coeff_delivery.h"
+#include "ble_fleet_frame.h"
+#include "publish_policy.h"
+#include "coeff_batch.h"
+#include "time_sync.h"
+#include "weigh_now.h"
+#include "mesh_relay.h"
+#include "broadcast_policy.h"
+#include "link_stats.h"
+#include "airtime_plan.h"
+#include "ota_stream.h"
+#include "ota_image.h"
+#include "delta_patch.h"
+#include "mesh_ota.h"
 
 // ============================================================
 // CONFIGURATION
@@ -36,15 +71,88 @@
 #define PRESSURE_SENSOR_CH1_PIN 34  // Channel 1 - Axle Group 1
 #define PRESSURE_SENSOR_CH2_PIN 35  // Channel 2 - Axle Group 2
 
+// Pressure transducer scaling at the ADC pin (after the divider)
+#define PRESSURE_SENSOR_ZERO_MV   330     // Output at 0 PSI
+#define PRESSURE_SENSOR_FULL_MV   2970    // Output at full scale
+#define PRESSURE_SENSOR_FULL_PSI  150.0   // Full-scale pressure
+
+// Continuous ADC acquisition (DMA) + CIC decimation
+#define ADC_SAMPLE_RATE_HZ   4000  // Conversions per second, per channel
+#define ADC_DECIMATION       64    // 4 kHz / 64 = 62.5 Hz decimated pressure
+#define ADC_CIC_STAGES       3     // 12 + 3*log2(64) = 30 bits, fits the uint32 CIC
+#define ADC_DMA_FRAME_BYTES  256   // Bytes per DMA conversion frame
+#define ADC_FULL_SCALE_MV    3100  // ADC_ATTEN_DB_11 usable range on the S3
+
 // BLE configuration
 #define SERVICE_UUID        "12345678-1234-1234-1234-123456789abc"
 #define SENSOR_CHAR_UUID    "87654321-4321-4321-4321-cba987654321"
 #define COEFFS_CHAR_UUID    "11111111-2222-3333-4444-555555555555"
 #define OTA_CHAR_UUID       "22222222-3333-4444-5555-666666666666"  // OTA firmware updates
+#define HISTORY_CHAR_UUID   "33333333-4444-5555-6666-777777777777"  // Sample history bulk download
+#define PUBLISH_CHAR_UUID   "44444444-5555-6666-7777-888888888888"  // Notify rate limits and weight deadbands
+#define COEFF_BATCH_CHAR_UUID "55555555-6666-7777-8888-999999999999"  // Binary calibration batches + per-record status
+#define WEIGH_NOW_CHAR_UUID "66666666-7777-8888-9999-aaaaaaaaaaaa"  // On-demand synchronized fleet snapshot
+#define BLE_SERVICE_HANDLES 30     // Attribute handles for the service (the library default of 15 is used up)
 #define DEVICE_NAME_PREFIX  "AirScale-"
 
+// BLE firmware update (see ota_stream.h)
+#define OTA_BLOCK_BYTES         (64UL * 1024UL)  // PSRAM staging block (two of them), one flash block erase
+#define OTA_BLOCK_BYTES_NO_PSRAM 4096            // Fallback in internal RAM: a sector at a time
+#define OTA_COMMIT_BYTES        (64UL * 1024UL)  // Progress recorded in NVS this often, for resuming
+#define OTA_ACK_BYTES           (16UL * 1024UL)  // Cumulative ack at least this often
+#define OTA_SPILL_BYTES         (32UL * 1024UL)  // Original protocol: writes held while both blocks are staged (PSRAM)
+#define OTA_SPILL_STEP          512              // Writer moves spilled data on this much per hold of the lock
+#define OTA_START_WAIT_MS       1000             // Original START: longest the Bluedroid task waits for the writer to take it
+
 // ESP-NOW Configuration - FIXED CHANNEL (no WiFi required)
 #define ESPNOW_CHANNEL 1
+#define ESPNOW_NAME_EVERY       6        // Device name TLV rides along on every Nth broadcast
+#define LEGACY_PEER_TIMEOUT_MS  600000   // Also send legacy ESPNowData while an old node was heard this recently
+#define ESPNOW_PEER_CACHE       8        // Unicast peers kept registered (driver limit is 20 incl. broadcast)
+#define COEFF_RETRY_BASE_MS     40       // First retransmit of an unacknowledged coefficient set
+#define COEFF_RETRY_MAX_MS      640      // Backoff cap
+#define COEFF_MAX_ATTEMPTS      6        // Sends before a delivery is given up (~1.9 s)
+#define COEFF_ACK_HOLD          4        // Slave: acks waiting for our airtime slot, beyond that sent at once
+#define TIME_SYNC_INTERVAL_MS   1000     // Hub's mesh time beacon
+#define TIME_SYNC_WINDOW        8        // Beacons in the offset/drift fit
+#define TIME_SYNC_OUTLIER_US    2000     // Beacon this far off the fit arrived late: dropped
+#define TIME_SYNC_STEP_US       50000    // This far off: the hub's clock jumped, start over
+#define TIME_SYNC_HOLDOVER_MS   30000    // Trust the fit this long without a beacon
+#define WEIGH_LEAD_MS           50       // Weigh now: trigger -> sample instant, for every slave to hear it
+#define WEIGH_CAPTURE_MS        40       // Instant -> weights read, once the next decimated sample is in
+#define WEIGH_SLOT_US           4000     // Reply slot: one unicast with its MAC retries
+#define WEIGH_SPARE_SLOTS       4        // Shared by slaves the hub doesn't know yet
+#define WEIGH_GRACE_MS          30       // After the last slot before missing replies are given up
+#define WEIGH_TRIGGER_COPIES    2        // Broadcasts get no MAC retries
+#define WEIGH_SAMPLE_HISTORY    8        // Radio task's recent samples (128 ms at 62.5 Hz)
+#define WEIGH_MAX_GAP_MS        50       // Samples this far apart around the instant: reading flagged stale
+#define RELAY_MAX_HOPS          4        // Relay: TTL of a relayed frame, and the longest route taken
+#define RELAY_NEIGHBORS         16       // Neighbors tracked for choosing a parent
+#define RELAY_DEDUP             32       // (origin, sequence) pairs remembered
+#define RELAY_NEIGHBOR_TIMEOUT_MS 85000  // Two missed longest heartbeats and a neighbor is gone
+#define RELAY_ROUTE_TIMEOUT_MS  85000    // Reverse route not refreshed by a relayed frame this long
+#define RELAY_BUDGET_BYTES_S    1024     // Forwarded bytes per second (~1% of the air at 1 Mbps)
+#define RELAY_BUDGET_BURST      2048     // A fleet's worth of relayed broadcasts at once
+#define RELAY_POOL_BUFFERS      8        // Forwarded frames waiting for the radio task
+#define AIRTIME_FRAME_MS        250      // Airtime superframe on the mesh clock; beacons open every 4th
+#define AIRTIME_HUB_SLOT_US     8000     // Beacon and the hub's own report
+#define AIRTIME_SLOT_US         6000     // Per slave: a full-size frame plus a tick of wake-up slack
+#define AIRTIME_GUARD_US        500      // Mesh clock error allowed for at the start of each slot
+#define AIRTIME_MAX_SLOTS       16       // ESP-NOW part at most 104 ms; the rest of the superframe is BLE's
+#define AIRTIME_SPARE_SLOTS     4        // Shared by slaves the hub doesn't list yet
+#define MESH_OTA_CHUNK_BYTES    232      // Mesh firmware update (mesh_ota.h): image bytes per data frame
+#define MESH_OTA_WINDOW_CHUNKS  128      // Selective-repeat window, one status bitmap (~29 KB)
+#define MESH_OTA_MAX_TARGETS    16       // Slaves one push updates (an offer lists them all)
+#define MESH_OTA_OFFER_MS       500      // Offer repeated until every slave has erased and is ready
+#define MESH_OTA_PREPARE_MS     15000    // A slave not ready by then is left out
+#define MESH_OTA_CHUNK_GAP_US   2600     // Data frame pace: a full frame's airtime at 1 Mbps
+#define MESH_OTA_SLOT_US        3000     // Status slot: one short unicast with its MAC retries
+#define MESH_OTA_GRACE_MS       20       // After the last status slot before a slave counts as silent
+#define MESH_OTA_MAX_SILENT     16       // Polls in a row a slave may miss (30% frame loss still gets through)
+#define MESH_OTA_VERIFY_MS      20000    // Last window in -> every slave hashed its image
+#define MESH_OTA_REPORT_MS      250      // Hub: per-slave progress to the phone at most this often
+#define MESH_OTA_IDLE_MS        20000    // Slave: a push not heard from this long is dropped
+#define MESH_OTA_RESTART_MS     3000     // Slave: verified, answers polls this long before restarting
 
 // Server Configuration (only used when WiFi available)
 const char* SERVER_URL = "https://beaker.ca";
@@ -54,9 +162,125 @@ const char* FALLBACK_SSID = "";     // Leave empty for truck deployment
 const char* FALLBACK_PASSWORD = ""; // Leave empty for truck deployment
 
 // Timing Configuration
-#define BROADCAST_INTERVAL_MS   10000  // Slaves broadcast every 10 seconds
-#define HUB_SEND_INTERVAL_MS    5000   // Hub sends to phone every 5 seconds
+#define BROADCAST_INTERVAL_MS   10000  // Former fixed pace with a hub listening; broadcast savings are counted against it
+#define BROADCAST_DEADBAND_LBS  10.0f  // Channel move reported at once while a hub listens
+#define BROADCAST_RATE_LBS_S    25.0f  // Either channel moving faster: loading, report every BROADCAST_FAST_MS
+#define BROADCAST_RATE_WINDOW_MS 500   // Rate measured across this window
+#define BROADCAST_FAST_MS       500    // Loading pace, and floor between change reports
+#define BROADCAST_HEARTBEAT_MIN_MS 2500   // First heartbeat after a change, doubling while steady...
+#define BROADCAST_HEARTBEAT_MAX_MS 40000  // ...up to this (< the hub's 60 s fleet freshness)
+#define BROADCAST_JITTER_MS     40     // Random delay on every broadcast so nodes don't collide
+#define HUB_SEND_INTERVAL_MS    5000   // Default heartbeat to the phone when nothing changes
+#define HUB_MIN_NOTIFY_MS       250    // Default floor between change-driven notifications
+#define HUB_WEIGHT_DEADBAND_LBS 20.0f  // Default per-channel change that triggers a notification
 #define DEVICE_TIMEOUT_MS       120000 // Mark device inactive after 2 minutes
+#define DEVICE_EVICT_MS         600000 // Free an inactive device's registry slot after 10 minutes
+
+// Task layout: acquisition owns core 1; radio work shares core 0 with the WiFi/BT
+// stacks (and the AsyncTCP task serving HTTP). Higher number = higher priority.
+#define ACQ_TASK_CORE           1
+#define ACQ_TASK_PRIORITY       5
+#define ACQ_TASK_STACK          4096
+#define RADIO_TASK_CORE         0
+#define RADIO_TASK_PRIORITY     4      // ESP-NOW TX
+#define RADIO_TASK_STACK        4096
+#define BLE_TASK_CORE           0
+#define BLE_TASK_PRIORITY       3      // BLE notifications + history streaming
+#define BLE_TASK_STACK          6144
+#define HOUSEKEEPING_TASK_CORE  1
+#define HOUSEKEEPING_TASK_PRIORITY 2   // LED, watchdogs, BME280, history log, status
+#define HOUSEKEEPING_TASK_STACK 6144
+#define HOUSEKEEPING_MAX_JOBS   12
+#define WORKER_TASK_CORE        1
+#define WORKER_TASK_PRIORITY    3      // Deferred callback work: parsing, NVS writes, logging
+#define WORKER_TASK_STACK       6144
+#define OTA_WRITER_TASK_CORE    1
+#define OTA_WRITER_TASK_PRIORITY 4     // Flash erase/program of a staged firmware update; idle otherwise
+#define OTA_WRITER_TASK_STACK   4096
+#define SNAPSHOT_QUEUE_DEPTH    16     // Decimated samples buffered per consumer (~250 ms)
+#define RADIO_QUEUE_DEPTH       16     // Pending radio commands (coefficient pushes and acks)
+#define DEFERRED_POOL_BUFFERS   16     // Callback payload buffers (a burst of trailers at once)
+#define DEFERRED_BUFFER_SIZE    512    // ATT's longest attribute value, so any BLE write fits (ESP-NOW: 250)
+#define DEFERRED_QUEUE_DEPTH    32
+#define BROADCAST_STANDALONE_MS 30000  // Fixed heartbeat when no hub is listening
+#define BLE_NOTIFY_TIMEOUT_MS   100    // Give up on a fleet refresh if the stack doesn't confirm a notification
+#define LED_FLASH_MS            50     // White TX flash
+#define LED_PULSE_MS            30     // Pulse animation step (hub / standalone)
+#define STATUS_INTERVAL_MS      30000  // Serial status dump
+#define ADV_WATCHDOG_MS         20000  // Re-kick BLE advertising while unconnected
+#define DEVICE_CLEANUP_MS       60000  // Device timeout sweep
+#define POWER_SAVE_LIGHT_SLEEP  1      // Auto light sleep when idle (CONFIG_PM_ENABLE + tickless idle: esp32s3_n16r8_lowpower env)
+
+// BME280 normal-mode cadence (must match setSampling() in initBME280)
+#define BME_STANDBY_MS          500    // t_standby between conversions
+#define BME_MEASURE_MS          47     // t_measure for T x2, P x16, H x1
+
+// Sample history (PSRAM ring + compressed append-only flash log)
+#define HISTORY_SAMPLE_INTERVAL_MS  100                  // 10 Hz into the ring
+#define HISTORY_RING_SAMPLES        (200UL * 1024UL)     // ~4 MB of PSRAM, ~5.7 h at 10 Hz
+#define HISTORY_RING_SAMPLES_NO_PSRAM 2048               // Fallback when PSRAM is missing
+#define HISTORY_FLUSH_INTERVAL_MS   60000                // Append compressed blocks every minute
+#define HISTORY_BLOCK_SAMPLES       256                  // Samples per compressed block
+#define HISTORY_LOG_MAX_BYTES       (1024UL * 1024UL)    // Rotate log -> old at 1 MB
+#define HISTORY_LOG_PATH            "/history.log"
+#define HISTORY_OLD_PATH            "/history.old"
+
+// Simulated pressure scenarios (used when there are no ADC pins / transducers)
+#define SCENARIO_DEFAULT            "cycle"              // Built-in profile when no trace is present
+#define SCENARIO_TRACE_PATH         "/scenario.csv"      // t_s,ch1_psi,ch2_psi[,ambient_psi,temp_f]
+#define SCENARIO_TRACE_MAX_ROWS     20000                // 400 KB of PSRAM
+#define SCENARIO_TRACE_MAX_ROWS_NO_PSRAM 1024
+#define SCENARIO_MAX_SPEED          100.0f               // Scenario seconds per real second
+
+// ============================================================
+// BME280 BURST READER
+// ============================================================
+
+// Adafruit_BME280 with a single-transaction burst read of temperature + pressure.
+// readTemperature()/readPressure()/readAltitude() are separate bus transactions and
+// the pressure/altitude reads re-read temperature; this reads 0xF7..0xFC once and
+// runs the datasheet compensation on the cached calibration.
+class BurstBME280 : public Adafruit_BME280 {
+ public:
+  bool readBurst(float* tempC, float* pressurePa) {
+    if (!i2c_dev) return false;
+
+    uint8_t reg = BME280_REGISTER_PRESSUREDATA;
+    uint8_t buf[6];
+    if (!i2c_dev->write_then_read(&reg, 1, buf, sizeof(buf))) return false;
+
+    int32_t adcP = ((uint32_t)buf[0] << 12) | ((uint32_t)buf[1] << 4) | (buf[2] >> 4);
+    int32_t adcT = ((uint32_t)buf[3] << 12) | ((uint32_t)buf[4] << 4) | (buf[5] >> 4);
+    if (adcT == 0x80000 || adcP == 0x80000) return false;  // Measurement skipped
+
+    const bme280_calib_data& c = _bme280_calib;
+
+    // Temperature (also produces t_fine for the pressure compensation)
+    int32_t var1 = ((adcT / 8) - ((int32_t)c.dig_T1 * 2));
+    var1 = (var1 * ((int32_t)c.dig_T2)) / 2048;
+    int32_t var2 = (adcT / 16) - ((int32_t)c.dig_T1);
+    var2 = (((var2 * var2) / 4096) * ((int32_t)c.dig_T3)) / 16384;
+    t_fine = var1 + var2 + t_fine_adjust;
+    *tempC = ((t_fine * 5 + 128) / 256) / 100.0f;
+
+    // Pressure (64-bit integer compensation, result in Pa)
+    int64_t p1 = ((int64_t)t_fine) - 128000;
+    int64_t p2 = p1 * p1 * (int64_t)c.dig_P6;
+    p2 = p2 + ((p1 * (int64_t)c.dig_P5) * 131072);
+    p2 = p2 + (((int64_t)c.dig_P4) * 34359738368);
+    p1 = ((p1 * p1 * (int64_t)c.dig_P3) / 256) + ((p1 * ((int64_t)c.dig_P2) * 4096));
+    p1 = (((int64_t)1) * 140737488355328 + p1) * ((int64_t)c.dig_P1) / 8589934592;
+    if (p1 == 0) return false;
+
+    int64_t p = 1048576 - adcP;
+    p = (((p * 2147483648) - p2) * 3125) / p1;
+    int64_t p9 = (((int64_t)c.dig_P9) * (p / 8192) * (p / 8192)) / 33554432;
+    int64_t p8 = (((int64_t)c.dig_P8) * p) / 524288;
+    p = ((p + p9 + p8) / 256) + (((int64_t)c.dig_P7) * 16);
+    *pressurePa = (float)p / 256.0f;
+    return true;
+  }
+};
 
 // ============================================================
 // GLOBAL OBJECTS
@@ -64,27 +288,137 @@ const char* FALLBACK_PASSWORD = ""; // Leave empty for truck deployment
 
 // Late-init objects (pointers) to avoid pre-setup() crashes
 // HTTPClient removed as global - use local instances when needed
-WebServer* server = nullptr;
+AsyncWebServer* server = nullptr;
 Preferences preferences;
-Adafruit_BME280 bme;
+BurstBME280 bme;
 Adafruit_NeoPixel* pixel = nullptr;
 
 // BLE Global Objects
 BLEServer* pServer = nullptr;
 BLEAdvertising* g_adv = nullptr;  // Single advertising instance - use this everywhere
 BLECharacteristic* pSensorCharacteristic = nullptr;
+
+// Fleet notification flow control: the GATTS handler gives g_bleTxDone when the stack
+// confirms a sensor (or weigh-now) notification or the link stops being congested
+static SemaphoreHandle_t g_bleTxDone = nullptr;
+static volatile bool g_bleCongested = false;
+static uint8_t g_fleetRefreshSeq = 0;
+static uint32_t g_fleetFramesSent = 0;
+static uint32_t g_bleNotifyStalls = 0;
 BLECharacteristic* pCoeffsCharacteristic = nullptr;
 BLECharacteristic* pOtaCharacteristic = nullptr;
+BLECharacteristic* pHistoryCharacteristic = nullptr;
+BLECharacteristic* pPublishCharacteristic = nullptr;
+BLECharacteristic* pCoeffBatchCharacteristic = nullptr;
+BLECharacteristic* pWeighNowCharacteristic = nullptr;
 bool deviceConnected = false;
 bool bleEnabled = false;
 String bleDeviceName;
 
-// OTA Update State
+// BLE firmware update (ota_stream.h). The OTA callback stages the image and returns;
+// the writer task programs staged blocks into the update partition, records progress
+// in NVS and sends every OTA notification. otaInProgress keeps the radio, BLE
+// publishing and housekeeping quiet meanwhile.
+enum OtaState : uint8_t {
+  OTA_IDLE,
+  OTA_RECEIVING,
+  OTA_FINISHING,              // END received: the writer verifies, sets the boot partition, restarts
+  OTA_STOPPING                // Aborted, failed or disconnected: the writer winds down
+};
+
+// Writer task notification bits
+#define OTA_WAKE_BLOCK   0x01   // A block was staged
+#define OTA_WAKE_START   0x02   // START received: the writer sets the transfer up
+#define OTA_WAKE_ACK     0x04
+#define OTA_WAKE_REWIND  0x08
+#define OTA_WAKE_END     0x10
+#define OTA_WAKE_STOP    0x20   // Bring the radio back (g_otaDiscard: and forget the transfer)
+#define OTA_WAKE_ERROR   0x40   // Report g_otaError
+#define OTA_WAKE_INFO    0x80   // Report the running image
+#define OTA_WAKE_MESH_ERASE  0x100  // Slave: a mesh update was offered, erase for it
+#define OTA_WAKE_MESH_VERIFY 0x200  // Slave: every chunk is in
+#define OTA_WAKE_MESH_STATUS 0x400  // Hub: a slave reported, tell the phone
+
 bool otaInProgress = false;
-size_t otaTotalSize = 0;
-size_t otaReceived = 0;
-uint32_t otaStartTime = 0;
-int otaChunkCount = 0;  // For debug logging of first few chunks
+static volatile OtaState g_otaState = OTA_IDLE;
+static OtaStaging g_otaStaging;
+static portMUX_TYPE g_otaMux = portMUX_INITIALIZER_UNLOCKED;  // Staging's filler side, for the writer's reports
+static TaskHandle_t g_otaWriterTaskHandle = nullptr;
+static const esp_partition_t* g_otaPartition = nullptr;
+static uint32_t g_otaCrc = 0;                 // Image CRC from START, 0 = none (not resumable)
+static bool g_otaRelay = false;               // START asked for the slaves to be updated too
+static uint8_t g_otaRelayVersion[3];          //   and gave the image's version
+static volatile uint32_t g_otaCommitted = 0;  // Writer: programmed into flash
+static volatile bool g_otaDiscard = false;    // Writer drops staged blocks and the NVS session
+static volatile uint8_t g_otaError = OTA_OK;
+static uint32_t g_otaAcked = 0;               // Callback: 'received' when it last asked for an ack
+static uint32_t g_otaRewoundAt = UINT32_MAX;  //   and when it last asked for a rewind
+static uint32_t g_otaStartMs = 0;
+static uint32_t g_otaResumedFrom = 0;
+static uint32_t g_otaRewinds = 0;
+static uint32_t g_otaFullStalls = 0;          // Data arrived with both blocks still staged
+static uint8_t g_otaStartCmd[13];             // START as received, for the writer (g_otaMux)
+static uint8_t g_otaStartLen = 0;
+static std::atomic<bool> g_otaStartPending(false);  // START handed to the writer, transfer not set up yet
+static uint8_t* g_otaSpill = nullptr;         // Original protocol: data behind a full staging, in order (g_otaMux)
+static uint32_t g_otaSpillSize = 0;
+static uint32_t g_otaSpillHead = 0;
+static uint32_t g_otaSpillLen = 0;
+static uint32_t g_otaFlashMs = 0;             // Writer: time spent erasing and programming
+static uint8_t g_otaBounce[SPI_FLASH_SEC_SIZE];  // Writer: internal RAM between PSRAM and flash
+
+// Resume point, NVS "ota_ckpt". For a container (ota_image.h) the expanded image
+// and the decoder state go with the transfer offset; for a raw image 'image' is
+// the same as 'received'.
+struct OtaCheckpoint {
+  uint32_t received;
+  uint32_t image;
+  uint32_t decoder;           // LzssDecoder::save()
+};
+static OtaCheckpoint g_otaResume = {0, 0, 0};  // Callback: what START resumed from, for the writer
+
+// Writer: a container is expanded into the update partition through g_otaBounce
+static bool g_otaContainer = false;
+static OtaImageHeader g_otaHeader;
+static LzssDecoder g_otaDecoder;
+static uint8_t g_otaWindow[OTA_LZSS_WINDOW];
+static mbedtls_sha256_context g_otaSha;
+static uint32_t g_otaImageOut = 0;            // Image bytes expanded, the last g_otaOutLen still in g_otaBounce
+static uint32_t g_otaOutLen = 0;
+static uint32_t g_otaErasedTo = 0;
+
+// Writer: a delta container's LZSS output is a patch against the running image,
+// applied from g_otaPatch into g_otaBounce
+static DeltaPatcher g_otaPatcher;
+static uint8_t g_otaPatch[1024];
+static uint32_t g_otaPatchAt = 0;
+static uint32_t g_otaPatchLen = 0;
+static const esp_partition_t* g_otaBase = nullptr;  // Running partition
+static uint8_t g_otaBaseSha[32];
+static bool g_otaBaseShaValid = false;
+
+// Mesh firmware update (mesh_ota.h). Hub: the writer task starts a push once a
+// BLE update is verified and reports it to the phone, the radio task sends it, the
+// worker records the slaves' statuses. Slave: the worker takes offers, chunks and
+// polls, the writer erases and verifies, the radio task answers in our slot.
+static_assert(MESH_OTA_CHUNK_BYTES <= OTA_CHUNK_MAX && MESH_OTA_WINDOW_CHUNKS <= MESH_OTA_WINDOW_MAX,
+              "a chunk fits a frame and a window one status");
+static const MeshOtaConfig g_meshOtaConfig = {MESH_OTA_OFFER_MS * 1000, MESH_OTA_PREPARE_MS * 1000UL,
+                                              MESH_OTA_CHUNK_GAP_US, MESH_OTA_SLOT_US, MESH_OTA_GRACE_MS * 1000,
+                                              MESH_OTA_MAX_SILENT, MESH_OTA_VERIFY_MS * 1000UL};
+static MeshOtaSender<MESH_OTA_MAX_TARGETS> g_meshOtaTx(g_meshOtaConfig);
+static MeshOtaReceiver g_meshOtaRx;
+static portMUX_TYPE g_meshOtaMux = portMUX_INITIALIZER_UNLOCKED;
+static const esp_partition_t* g_meshOtaPartition = nullptr;  // Image pushed (hub) or received (slave)
+static uint8_t g_meshOtaSha[32];              // Hub: of the image pushed
+static uint8_t g_meshOtaVersion[3];           //   and its version
+static uint32_t g_meshOtaStartMs = 0;
+static volatile uint32_t g_meshOtaHeardMs = 0;  // Slave: last frame of the push
+static uint32_t g_meshOtaChunks = 0;          // Slave (worker): chunks written
+static uint32_t g_meshOtaDuplicates = 0;      //   and heard again
+static uint32_t g_meshOtaStatusSent = 0;      // Slave (radio task)
+static uint32_t g_meshOtaSendErrors = 0;      // Hub (radio task): frames the driver didn't take
+static uint32_t g_meshOtaForeign = 0;         // Slave (worker): frames from other than our route's hub
 
 // Device State
 String deviceMAC;
@@ -93,23 +427,58 @@ bool isConnectedToWiFi = false;
 bool isHub = false;
 bool bmeInitialized = false;
 
-// BLE discovery quiet window (helps BLE scans win airtime vs ESP-NOW)
-static unsigned long g_lastDiscoveryWindowStart = 0;
-static bool g_discoveryQuiet = false;
-
-// Promiscuous mode state
-static bool g_promiscuousModeEnabled = false;
-
-// RSSI sentinel when promiscuous is off / unavailable
-static constexpr int8_t RSSI_UNKNOWN = -127;
-
-// Store last received RSSI (captured via promiscuous mode callback)
-static int8_t lastReceivedRssi = RSSI_UNKNOWN;
+// Cached environment sample - refreshed on the BME280's own cadence, read by everyone
+struct EnvSample {
+  float temperature;          // °F
+  float atmosphericPressure;  // PSI
+  float elevation;            // ft
+  uint32_t timestamp;         // millis() of the burst read
+  bool valid;
+};
+static EnvSample g_env = {};
+static portMUX_TYPE g_envMux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t g_envI2cTransactions = 0;  // Bus transactions issued by the sampler
+static uint32_t g_envReadErrors = 0;
+
+// Airtime plan (airtime_plan.h): the worker applies the slot list of each beacon,
+// the radio and BLE tasks place their traffic by it
+static_assert(TIME_SYNC_INTERVAL_MS % AIRTIME_FRAME_MS == 0, "beacons open a superframe");
+static const AirtimeConfig g_airtimeConfig = {AIRTIME_FRAME_MS * 1000, AIRTIME_HUB_SLOT_US, AIRTIME_SLOT_US,
+                                              AIRTIME_GUARD_US, AIRTIME_MAX_SLOTS, AIRTIME_SPARE_SLOTS};
+static AirtimePlan g_airtime(g_airtimeConfig);
+static portMUX_TYPE g_airtimeMux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t g_airtimeHeld = 0;        // Radio task: relay forwards that waited for our slot
+static uint32_t g_airtimeOffSlot = 0;     // Radio task: relay forwards sent at once, the backlog being full
+static uint32_t g_coexSwitches = 0;       // Radio task
+static uint32_t g_coexErrors = 0;
+static uint32_t g_bleWindowHolds = 0;     // BLE task: fleet notifications held for the BLE window
+static std::atomic<uint32_t> g_espnowUnicastSent(0);    // Send callback: acknowledged by the peer
+static std::atomic<uint32_t> g_espnowUnicastFailed(0);  // Send callback: no ack after the MAC retries
+static volatile uint32_t g_advStartedMs = 0;  // Advertising (re)started and no phone yet, 0 = connected
+static LatencyStats g_discoveryTime;          // Advertising started -> phone connected
+
+// RSSI sentinel when the radio didn't report one: relayed or unrecognized packets,
+// and every packet before IDF 5 (esp_now_recv_info_t), whose receive callback gets
+// only the sender's MAC
+static constexpr int8_t RSSI_UNKNOWN = LINK_RSSI_NONE;
 
 // Mesh activity tracking - if we haven't received ESP-NOW data in X seconds, assume mesh is dead
 static unsigned long g_lastMeshActivity = 0;
 static constexpr uint32_t MESH_TIMEOUT_MS = 60000; // 60 seconds
 
+// Pressure acquisition - written only by the acquisition task, read lock-free everywhere else
+static TaskHandle_t g_adcTaskHandle = nullptr;
+static bool g_adcHardware = false;          // true = DMA ADC, false = simulated sample stream
+static std::atomic<float> g_pressurePsi[2]; // Latest decimated pressure per channel
+static AdcChannelStats g_adcStats[2];
+static uint32_t g_adcOverruns = 0;          // DMA pool overflowed before the task drained it
+
+// Simulated pressure scenario - the engine itself is owned by the acquisition task
+static char g_scenarioName[16] = SCENARIO_DEFAULT;
+static float g_scenarioSpeed = 1.0f;
+static uint32_t g_scenarioSeed = 1;
+static std::atomic<float> g_scenarioSeconds(0.0f);  // Scenario clock, for status only
+
 // ============================================================
 // DATA STRUCTURES
 // ============================================================
@@ -130,23 +499,100 @@ typedef struct {
   uint8_t batteryLevel;
   bool isCharging;
   uint8_t messageType;        // 0 = sensor data, 1 = ch1 coefficients, 2 = ch2 coefficients
+  float ch1WeightStdDev;      // Estimator 1-sigma for CH1 (lbs), 0 = unknown
+  float ch2WeightStdDev;      // Estimator 1-sigma for CH2 (lbs), 0 = unknown
+  uint8_t settledFlags;       // SETTLED_CH1 | SETTLED_CH2 | REPORT_HOLDS
 } ESPNowData;
 
+// ESPNowData is the in-memory record of a node's latest report and the legacy wire
+// format (pre compact frames, see espnow_frame.h), still accepted on RX and sent to
+// old nodes. Size of ESPNowData before the estimator fields were appended:
+#define ESPNOW_DATA_V0_SIZE offsetof(ESPNowData, ch1WeightStdDev)
+
+#define SETTLED_CH1 0x01
+#define SETTLED_CH2 0x02
+#define REPORT_HOLDS 0x04     // Compact frames: sender reports deadband moves at once, so this holds until its next report
+
 #define MSG_TYPE_SENSOR_DATA 0
 #define MSG_TYPE_COEFFICIENTS_CH1 1
 #define MSG_TYPE_COEFFICIENTS_CH2 2
 
 // Device tracking
-#define MAX_DEVICES 10
+#define MAX_DEVICES 96                 // Registry capacity (PSRAM); passing trucks get evicted
+static_assert(MAX_DEVICES >= 64 && MAX_DEVICES <= 128, "registry is sized for 64-128 devices");
+#define COEFF_DELIVERY_SLOTS (2 * MAX_DEVICES)  // Both channels of a full fleet in one push
+
 struct DeviceData {
+  MacKey macKey;              // Packed MAC, 0 = free slot
   char macAddress[18];
   char deviceName[32];
   ESPNowData lastData;
   unsigned long lastSeen;
   bool isActive;
-  int8_t espNowRssi;          // ESP-NOW signal strength (dBm)
-} knownDevices[MAX_DEVICES];
-int deviceCount = 0;
+  int8_t espNowRssi;          // RSSI of its last packet heard directly (dBm), RSSI_UNKNOWN if not reported
+  LinkStats link;             // Direct link: RSSI/loss EWMAs, jitter, last heard
+  uint8_t frameVersion;       // Compact frame version it sends, 0 = legacy ESPNowData
+  uint16_t lastSeq;           // Last compact frame sequence number
+  uint32_t framesLost;        // Sequence gaps seen from this device
+  uint32_t coeffVersion[2];   // Coefficient versions it has applied (ack or broadcast), 0 = unknown
+  int64_t sampleTimeUs;       // Mesh time of lastData's sample (sent, else stamped on receive), 0 = unknown
+  bool sampleTimeStamped;     // sampleTimeUs is our receive time: the sender isn't synced or predates mesh time
+  uint8_t hops;               // Relay hops its last report took, 0 = heard directly
+  uint8_t firmware[3];        // Version it runs (major, minor, patch), 0.0.0 = not reported
+  uint8_t imageId[FIRMWARE_IMAGE_ID_SIZE];  // Leading bytes of its running image's SHA-256
+};
+
+// Device registry. Written by the worker task (ESP-NOW RX) and housekeeping
+// (timeouts, eviction), read by the BLE publisher, status dump and web server.
+// Each slot is a seqlock: readers copy with readDevice() and never block the
+// writers; writers serialize on g_deviceWriteMux. Lookups go through a hash index
+// on the packed MAC. Slots of long-inactive devices are freed and reused; readers
+// scan slots below g_deviceSlotHigh and skip free ones.
+static Seqlock<DeviceData>* knownDevices = nullptr;   // MAX_DEVICES slots, PSRAM when available
+static MacIndex<MAX_DEVICES> g_deviceIndex;           // Writer side only
+static uint16_t g_freeDeviceSlots[MAX_DEVICES];       // Writer side only
+static uint16_t g_freeDeviceSlotCount = 0;
+static std::atomic<int> deviceCount(0);               // Live devices
+static std::atomic<int> g_deviceSlotHigh(0);          // Slots ever used (reader scan bound)
+static portMUX_TYPE g_deviceWriteMux = portMUX_INITIALIZER_UNLOCKED;
+static std::atomic<uint32_t> g_deviceReadRetries(0);
+static uint32_t g_devicesEvicted = 0;
+static uint32_t g_devicesRejected = 0;                // Every slot held by an active device
+
+// ESP-NOW wire statistics (worker task writes, status output reads)
+static uint16_t g_espnowTxSeq = 0;                    // Radio task only; sensor frames, which receivers count loss on
+static uint16_t g_coeffTxSeq = 0;                     // Radio task only; coefficient sets and acks
+static volatile unsigned long g_lastLegacyPeerHeard = 0;
+static uint32_t g_framesCompactRx = 0;
+static uint32_t g_framesLegacyRx = 0;
+static uint32_t g_framesRejected = 0;                 // Bad size/header or unknown type
+static uint32_t g_framesLost = 0;
+static uint32_t g_espnowTxBytes = 0;
+
+// Mesh timebase (time_sync.h): the worker feeds the hub's beacons in, any task reads
+// through meshTime(). The hub also keeps the sample of its last broadcast here, the
+// one on the same grid as its slaves' broadcasts.
+struct TimedWeight {
+  int64_t sampleUs;           // Mesh time, 0 = none yet
+  float weight;
+};
+static TimeSync<TIME_SYNC_WINDOW> g_timeSync(TIME_SYNC_OUTLIER_US, TIME_SYNC_STEP_US, TIME_SYNC_HOLDOVER_MS * 1000);
+static TimedWeight g_hubBroadcastWeight = {0, 0.0f};
+static portMUX_TYPE g_timeSyncMux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t g_timeSyncBeaconsSent = 0;            // Radio task (hub)
+static LatencyStats g_fleetSkew;                      // Spread of sample times in a fleet total
+static uint32_t g_fleetInTotal = 0;                   // Last fleet total: samples summed
+static uint32_t g_fleetOutOfWindow = 0;               //   and left out (outside the window or time unknown)
+static uint32_t g_fleetUnaligned = 0;                 //   summed without a sample time of their own
+
+// Coefficient delivery. The radio task owns the queue and the peer cache; at most
+// ESPNOW_PEER_CACHE - 1 deliveries are in flight so one peer is always free for acks
+// and legacy nodes. Slaves remember the version applied per channel (NVS).
+static CoeffDeliveryQueue<COEFF_DELIVERY_SLOTS> g_coeffDeliveries(
+    COEFF_RETRY_BASE_MS * 1000, COEFF_RETRY_MAX_MS * 1000, COEFF_MAX_ATTEMPTS, ESPNOW_PEER_CACHE - 1);
+static PeerCache<ESPNOW_PEER_CACHE> g_peerCache;
+static CoeffBatchResult g_lastCoeffPush = {0, 0, 0};
+static uint32_t g_appliedCoeffVersion[2] = {0, 0};
 
 // Sensor Data Structure
 struct SensorData {
@@ -158,6 +604,9 @@ struct SensorData {
   float ch1Weight;            // Weight from Channel 1
   float ch2Weight;            // Weight from Channel 2
   float totalWeight;          // Combined weight
+  float ch1WeightStdDev;      // Estimator 1-sigma (lbs)
+  float ch2WeightStdDev;
+  uint8_t settledFlags;       // SETTLED_CH1 | SETTLED_CH2
   String timestamp;
 };
 
@@ -171,6 +620,26 @@ struct RegressionCoeffs {
 
 RegressionCoeffs ch1Coeffs;  // Channel 1 - Axle Group 1
 RegressionCoeffs ch2Coeffs;  // Channel 2 - Axle Group 2
+// The acquisition task reads the live coefficients, the worker replaces them
+static portMUX_TYPE g_coeffsMux = portMUX_INITIALIZER_UNLOCKED;
+// Channels (bit0 = CH1, bit1 = CH2) whose estimator restarts on its next sample:
+// weights from the old coefficients are a different scale, not a load change
+static std::atomic<uint8_t> g_estimatorReset(0);
+
+// One channel's live coefficients, all four from the same update
+static RegressionCoeffs liveCoeffs(int channel) {
+  portENTER_CRITICAL(&g_coeffsMux);
+  RegressionCoeffs coeffs = (channel == 1) ? ch1Coeffs : ch2Coeffs;
+  portEXIT_CRITICAL(&g_coeffsMux);
+  return coeffs;
+}
+
+// Filtered weight per channel, published by the acquisition task
+struct ChannelEstimate {
+  float weight;     // lbs
+  float stdDev;     // lbs (1-sigma)
+  bool settled;
+};
 
 // LED Status Colors
 enum LEDStatus {
@@ -182,27 +651,283 @@ enum LEDStatus {
   LED_CONNECTED     // Green solid (slave connected to hub)
 };
 
-LEDStatus currentLEDStatus = LED_OFF;
+volatile LEDStatus currentLEDStatus = LED_OFF;
+
+// One decimated sample as published by the acquisition task (POD, queue-friendly)
+struct SensorSnapshot {
+  uint32_t seq;
+  int64_t sampledUs;          // esp_timer time the sample left the decimator
+  float ch1AirPressure;
+  float ch2AirPressure;
+  float ch1Weight;
+  float ch2Weight;
+  float ch1WeightStdDev;
+  float ch2WeightStdDev;
+  uint8_t settledFlags;
+};
+
+// Work for the radio task (ESP-NOW is only ever driven from that task)
+enum RadioCommandType : uint8_t {
+  RADIO_CMD_SEND_COEFFS,      // Hub: deliver coefficients to a slave
+  RADIO_CMD_COEFFS_ACKED,     // Hub: the slave acknowledged (channel, version)
+  RADIO_CMD_SEND_COEFFS_ACK,  // Slave: answer the hub
+  RADIO_CMD_SEND_COEFF_BATCH, // Hub: deliver the slave records of g_coeffBatch
+  RADIO_CMD_WEIGH_TRIGGER,    // Hub: start weigh-now round weighId (roster in g_weighNow)
+  RADIO_CMD_WEIGH_REPLY,      // Slave: sample at sampleAtUs, answer the hub at replyAtUs
+  RADIO_CMD_RELAY,            // Pass g_relayPool buffer relaySlot on to targetMac
+  RADIO_CMD_MESH_OTA_STATUS   // Slave: report our mesh update to the hub at replyAtUs
+};
+
+struct RadioCommand {
+  RadioCommandType type;
+  uint8_t channel;
+  uint8_t status;             // CoeffsAckStatus, or WEIGH_REPLY_SYNCED
+  char targetMac[18];
+  RegressionCoeffs coeffs;
+  uint32_t version;           // Coefficient version
+  uint8_t weighId;            // Weigh-now round
+  int64_t sampleAtUs;         // Weigh now: the instant on the local clock
+  int64_t replyAtUs;          //   and the start of this node's reply slot (also the mesh update's)
+  int8_t relaySlot;           // Relay: frame to forward
+  uint8_t relayLen;
+};
+
+// Radio task: the last few decimated samples, so a weigh-now can read the weights
+// at an exact instant once the samples either side of it are in
+struct SampleHistory {
+  SensorSnapshot samples[WEIGH_SAMPLE_HISTORY];
+  uint8_t head;
+  uint8_t count;
+};
+
+// Radio task: this node's part of a weigh-now round
+enum WeighState : uint8_t {
+  WEIGH_IDLE,
+  WEIGH_SAMPLING,             // Waiting for the samples around the instant
+  WEIGH_REPLYING,             // Slave: waiting for its slot
+  WEIGH_COLLECTING            // Hub: waiting for the slots to pass
+};
+
+struct WeighJob {
+  WeighState state;
+  bool hub;
+  uint8_t id;
+  uint8_t flags;              // WEIGH_REPLY_SYNCED
+  uint8_t hubMac[6];          // Slave: where the reply goes
+  int64_t sampleAtUs;         // Local clock
+  int64_t replyAtUs;          // Slave: start of its slot
+  int64_t deadlineUs;         // Hub: last slot over, missing replies given up
+  WeighReply reply;
+};
+
+// Inter-task messaging: the acquisition task hands every snapshot to each consumer
+// through its own SPSC ring; any task or callback can queue radio work (MPSC)
+static SpscQueue<SensorSnapshot, SNAPSHOT_QUEUE_DEPTH> g_bleSnapshots;
+static SpscQueue<SensorSnapshot, SNAPSHOT_QUEUE_DEPTH> g_radioSnapshots;
+static MpscQueue<RadioCommand, RADIO_QUEUE_DEPTH> g_radioCommands;
+static TaskHandle_t g_radioTaskHandle = nullptr;
+static TaskHandle_t g_bleTaskHandle = nullptr;
+static TaskHandle_t g_housekeepingTaskHandle = nullptr;
+static uint32_t g_snapshotDrops = 0;      // Consumer fell behind, newest sample dropped
+static uint32_t g_radioCommandDrops = 0;
+
+// Sample-to-output latency and publish-deadline lateness (jitter), in microseconds
+static LatencyStats g_notifyLatency;      // Sample -> last fleet frame confirmed by the stack
+static LatencyStats g_fleetRefreshTime;   // First fleet frame -> last one confirmed
+
+// Change-driven publishing: the app writes the policy (BLE callback), the BLE task
+// applies it. The worker flags new device reports; the tracker (BLE task only)
+// remembers what was last notified per registry slot, the hub itself in the last one.
+static PublishConfig g_publishConfig = {HUB_MIN_NOTIFY_MS, HUB_SEND_INTERVAL_MS,
+                                        {HUB_WEIGHT_DEADBAND_LBS, HUB_WEIGHT_DEADBAND_LBS},
+                                        PUBLISH_DEFAULT_COHERENCE_MS};
+static portMUX_TYPE g_publishConfigMux = portMUX_INITIALIZER_UNLOCKED;
+static std::atomic<bool> g_publishResync(false);      // New subscriber or policy: full refresh
+static std::atomic<bool> g_publishPolicyWritten(false);  // The resync is for a new policy: log it
+static std::atomic<uint32_t> g_publishRejected(0);    // Malformed policy writes, for the BLE task to log
+static std::atomic<bool> g_fleetDirty(false);
+static ChangeTracker<MAX_DEVICES + 1> g_notifyTracker;
+static uint32_t g_publishOnChange = 0;
+static uint32_t g_publishHeartbeats = 0;
+
+// Calibration batches: the BLE callback hands a complete batch over in
+// g_coeffBatchIn; the worker applies/validates it into g_coeffBatch, which the
+// radio task settles as slaves answer and the BLE task reports from
+static CoeffBatch g_coeffBatchIn;
+static bool g_coeffBatchInReady = false;
+static CoeffBatch g_coeffBatch;
+static portMUX_TYPE g_coeffBatchMux = portMUX_INITIALIZER_UNLOCKED;
+static std::atomic<bool> g_coeffBatchStatusDirty(false);
+static uint32_t g_coeffBatches = 0;
+static uint32_t g_coeffBatchRecords = 0;
+
+// Weigh now (weigh_now.h): the worker starts a round from the phone's request, the
+// radio task adds the hub's own reading and ends it at the deadline, the worker
+// records the slaves' answers; whoever completes it hands it to the BLE task
+static WeighNowCollector<MAX_DEVICES + 1> g_weighNow;
+static portMUX_TYPE g_weighMux = portMUX_INITIALIZER_UNLOCKED;
+static std::atomic<bool> g_weighResultDirty(false);
+static uint32_t g_weighRounds = 0;                    // Hub: rounds started
+static uint32_t g_weighComplete = 0;                  //   that every slave answered
+static uint32_t g_weighBusy = 0;                      //   requests refused, a round was running
+static uint32_t g_weighLateReplies = 0;               //   answers after the round ended (or repeats)
+static uint32_t g_weighReplies = 0;                   // Slave: answers sent
+static uint8_t g_weighLastAnswered = 0;
+static uint8_t g_weighLastExpected = 0;
+static LatencyStats g_weighLatency;                   // Request -> result notified
+
+// Multi-hop relay (mesh_relay.h): the worker hears neighbors and forwards relayed
+// frames, the radio task picks our parent and routes what it sends. The tables
+// both use are under g_relayMux; forwarded frames wait for the radio task in
+// g_relayPool.
+static NeighborTable<RELAY_NEIGHBORS> g_neighbors(RELAY_NEIGHBOR_TIMEOUT_MS, RELAY_MAX_HOPS);
+static RouteTable<MAX_DEVICES> g_routes(RELAY_ROUTE_TIMEOUT_MS);
+static MeshRoute g_meshRoute = {0, 0, 0, 0.0f};      // Last one the radio task chose
+static portMUX_TYPE g_relayMux = portMUX_INITIALIZER_UNLOCKED;
+static RelayDedup<RELAY_DEDUP> g_relayDedup;           // Worker only
+static RelayBudget g_relayBudget(RELAY_BUDGET_BYTES_S, RELAY_BUDGET_BURST);  // Worker only
+static BufferPool<RELAY_POOL_BUFFERS, ESPNOW_FRAME_MAX> g_relayPool;
+static uint32_t g_relayOriginated = 0;                // Radio task: our frames sent through a neighbor
+static uint32_t g_relayForwarded = 0;                 // Worker: other nodes' frames passed on
+static uint32_t g_relayDelivered = 0;                 //   relayed frames addressed to us
+static uint32_t g_relayDuplicates = 0;                //   copies already seen
+static uint32_t g_relayExpired = 0;                   //   out of hops
+static uint32_t g_relayBudgetDrops = 0;               //   over the airtime budget
+static std::atomic<uint32_t> g_relayDrops(0);         // No buffer, queue or peer, or would loop back
+static LatencyStats g_notifyLateness;     // Scheduled publish time -> actual
+static LatencyStats g_broadcastLatency;   // Sample -> esp_now_send() accepted
+
+// Change-driven broadcasts (broadcast_policy.h), radio task writes
+static uint32_t g_broadcastsBy[4] = {0, 0, 0, 0};    // Per BroadcastReason
+static uint64_t g_broadcastFixedMicro = 0;            // Broadcasts the fixed interval would have sent, x1e6
+static uint32_t g_broadcastHeartbeatMs = BROADCAST_HEARTBEAT_MIN_MS;
+static float g_broadcastRate = 0.0f;                  // lbs/s, fastest channel
+static LatencyStats g_coeffDeliveryLatency;  // Coefficients queued -> acknowledged
+static portMUX_TYPE g_latencyMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Housekeeping runs deadline-scheduled jobs; other tasks wake it with these
+// notification bits when something needs attention before the next deadline
+#define HK_EVENT_LED   0x01   // LED status changed or TX flash requested
+#define HK_EVENT_MESH  0x04   // First ESP-NOW frame after the mesh was idle
+
+static EventScheduler<HOUSEKEEPING_MAX_JOBS> g_scheduler;  // Housekeeping task only
+static LatencyStats g_wakeLatency;        // Job deadline -> dispatch
+static uint32_t g_housekeepingWakeups = 0;
+static bool g_lightSleepEnabled = false;
+
+// Work handed off by radio callbacks. The callback copies its payload into a pool
+// buffer, queues one of these and returns; the worker task does the rest.
+enum DeferredWorkType : uint8_t {
+  DEFERRED_ESPNOW_RX,         // ESP-NOW frame (payload in pool buffer)
+  DEFERRED_ESPNOW_TX_FAILED,  // Send callback reported failure for 'mac'
+  DEFERRED_BLE_COEFFS,        // Coefficients JSON written by the phone (payload in pool buffer)
+  DEFERRED_BLE_COEFF_BATCH,   // Calibration batch complete in g_coeffBatchIn
+  DEFERRED_BLE_WEIGH_NOW,     // Weigh-now request written by the phone (payload in pool buffer)
+  DEFERRED_BLE_DISCONNECT     // Phone disconnected: pause a firmware update, restart advertising
+};
+
+struct DeferredWork {
+  DeferredWorkType type;
+  int8_t slot;                // Pool buffer, -1 = none
+  int8_t rssi;
+  uint16_t len;
+  uint8_t mac[6];
+  int64_t rxUs;               // esp_timer time the callback ran
+};
+
+static BufferPool<DEFERRED_POOL_BUFFERS, DEFERRED_BUFFER_SIZE> g_deferredPool;
+static MpscQueue<DeferredWork, DEFERRED_QUEUE_DEPTH> g_deferredQueue;
+static TaskHandle_t g_workerTaskHandle = nullptr;
+static std::atomic<uint32_t> g_deferredDrops(0);  // Pool or queue exhausted, work lost
+static uint32_t g_deferredProcessed = 0;
+
+// LED is rendered only by the housekeeping task once it is running
+static volatile bool g_ledDirty = false;
+static volatile uint32_t g_ledFlashUntil = 0;
 
 // ============================================================
 // FUNCTION DECLARATIONS
 // ============================================================
 
 void initESPNow();
-void promiscuousRxCallback(void *buf, wifi_promiscuous_pkt_type_t type);
+#if ESP_IDF_VERSION_MAJOR >= 5
+void onESPNowDataReceived(const esp_now_recv_info_t* info, const uint8_t *incomingData, int len);
+#else
 void onESPNowDataReceived(const uint8_t *mac_addr, const uint8_t *incomingData, int len);
+#endif
 void onESPNowDataSent(const uint8_t *mac_addr, esp_now_send_status_t status);
-void broadcastMyData();
-void sendAllDataViaBLE();
-void sendCoeffsToDevice(const char* targetMAC, RegressionCoeffs* targetCoeffs, int channel);
-SensorData readSensors();
+static void recordLatency(LatencyStats& stats, int64_t us);
+void broadcastMyData(const SensorSnapshot& snap, BroadcastReason reason, bool holds);
+void sendAllDataViaBLE(const SensorSnapshot& snap, bool full);
+static PublishConfig readPublishConfig();
+uint8_t queueCoeffsDelivery(const RadioCommand& cmd);
+void serviceCoeffDeliveries(const AirtimePlan& plan, int64_t nowUs, int64_t planNowUs);
+void sendCoeffsAck(const RadioCommand& cmd);
+static void completeCoeffsDelivery(const RadioCommand& cmd);
+static void queueCoeffBatch();
+static void settleCoeffBatchRecord(MacKey target, uint8_t channel, uint32_t version, uint8_t status);
+static void notifyCoeffBatchStatus();
+uint32_t nextCoeffVersion();
+bool queueRadioCommand(const RadioCommand& cmd);
+bool deferWork(DeferredWorkType type, const void* payload, size_t len, const uint8_t* mac = nullptr, int8_t rssi = 0);
+void handleESPNowFrame(const uint8_t* mac, const uint8_t* frameData, int len, int8_t rssi, int64_t rxUs,
+                       uint8_t hops = 0);
+static void handleRelayFrame(const uint8_t* mac, int64_t rxUs, const uint8_t* frame, int len, const FrameHeader& header);
+static MeshRoute meshRoute();
+static MeshRoute lastMeshRoute();
+static bool meshSend(const uint8_t* dest, const uint8_t* frame, size_t len);
+static void forwardRelayFrame(const RadioCommand& cmd);
+void sendTimeSyncBeacon();
+static uint8_t airtimeRoster(uint8_t* tails);
+static void startWeighRound(WeighJob& job, uint8_t id);
+static void serviceWeighJob(WeighJob& job, const SampleHistory& history);
+static void serviceMeshOta(int64_t& replyAtUs);
+static void finishWeighNow();
+static void sendWeighResult();
+static bool notifyAndWait(BLECharacteristic* characteristic, const uint8_t* frame, size_t len);
+void handleCoeffsWrite(const char* json, size_t len);
+void handleCoeffBatch();
+static void handleWeighRequest(const uint8_t* payload, size_t len, int64_t rxUs);
+static void workerTask(void* arg);
+void saveChannelCoeffs(int channel, const RegressionCoeffs& coeffs);
+void startTasks();
+void signalHousekeeping(uint32_t events);
+void initPowerManagement();
+SensorData readSensors(const SensorSnapshot& snap);
 float simulatePressure(int channel);
+void initScenario();
+bool setScenario(const char* name, float speed, uint32_t seed);
+void initAdcAcquisition();
+float getChannelPressure(int channel);
+ChannelEstimate getChannelEstimate(int channel);
+float computeChannelWeight(const RegressionCoeffs& coeffs, float airPressure, float ambientPressure, float temperature);
+void initHistory();
+void recordHistorySample();
+void serviceHistoryLog();
+void requestHistoryDownload(uint16_t bootId, uint32_t fromTs, uint32_t toTs, uint16_t resumeBoot, uint32_t resumeTs);
+void cancelHistoryDownload();
+void serviceHistoryDownload();
 String getCurrentTimestamp();
 void initBLE();
-void updateDeviceData(ESPNowData* data, int8_t rssi);
-DeviceData* findDevice(const char* mac);
+void initDeviceRegistry();
+void updateDeviceData(ESPNowData* data, int8_t rssi, uint8_t frameVersion = 0, uint16_t seq = 0,
+                      int64_t sampleTimeUs = 0, const uint32_t* coeffVersions = nullptr, uint8_t hops = 0,
+                      int64_t rxUs = 0, const uint8_t* firmware = nullptr, bool sampleStamped = false);
+void parseFirmwareVersion(const char* version, uint8_t* major, uint8_t* minor, uint8_t* patch);
+void setDeviceCoeffVersion(MacKey key, int channel, uint32_t version);
+bool findDeviceSnapshot(MacKey key, DeviceData& out);
+static void formatMacKey(MacKey key, char* out);
+static bool legacyPeersPresent();
+bool readDevice(int index, DeviceData& out);
+int deviceSlotsInUse();
+int expireDevices();
 void initBME280();
+void serviceEnvironmentSampler();
+EnvSample getEnvironment();
+uint8_t readBatteryLevel();
 void setLEDStatus(LEDStatus status);
+static void showLEDStatus(LEDStatus status);
+void flashLED();
 void updateLED();
 void tryConnectWiFi();
 void setupWebServer();
@@ -217,6 +942,12 @@ class MyServerCallbacks: public BLEServerCallbacks {
     isHub = true;  // BLE connection makes me the hub!
     Serial.println("🔵 BLE Client Connected - I AM NOW THE HUB!");
     setLEDStatus(LED_HUB_MODE);
+    g_publishResync = true;  // New subscriber starts from a full refresh
+    uint32_t advertised = g_advStartedMs;
+    if (advertised != 0) {
+      recordLatency(g_discoveryTime, (int64_t)(millis() - advertised) * 1000);
+      g_advStartedMs = 0;
+    }
   }
 
   void onDisconnect(BLEServer* pServer) {
@@ -224,72 +955,98 @@ class MyServerCallbacks: public BLEServerCallbacks {
     isHub = false;  // No longer a hub when disconnected
     Serial.println("🔵 BLE Client Disconnected - No longer hub");
 
-    // Restart advertising using global instance
-    if (bleEnabled && g_adv) {
-      delay(200);
-      g_adv->start();
-      Serial.println("📡 BLE advertising restarted");
-    }
+    // Advertising restart (and its settle delay) happens in the worker task
+    deferWork(DEFERRED_BLE_DISCONNECT, nullptr, 0);
 
     setLEDStatus(LED_STANDALONE);
   }
 };
 
-class CoeffsCallbacks: public BLECharacteristicCallbacks {
+// Runs in the Bluedroid task, alongside the library's own handler
+static void bleGattsEventHandler(esp_gatts_cb_event_t event, esp_gatt_if_t gattsIf, esp_ble_gatts_cb_param_t* param) {
+  switch (event) {
+    case ESP_GATTS_CONF_EVT:
+      if ((pSensorCharacteristic && param->conf.handle == pSensorCharacteristic->getHandle()) ||
+          (pWeighNowCharacteristic && param->conf.handle == pWeighNowCharacteristic->getHandle())) {
+        xSemaphoreGive(g_bleTxDone);
+      }
+      break;
+    case ESP_GATTS_CONGEST_EVT:
+      g_bleCongested = param->congest.congested;
+      if (!g_bleCongested) xSemaphoreGive(g_bleTxDone);
+      break;
+    default:
+      break;
+  }
+}
+
+// App sets the notify rate limits and deadbands (see publish_policy.h)
+class PublishCallbacks: public BLECharacteristicCallbacks {
   void onWrite(BLECharacteristic* pCharacteristic) {
     std::string rxValue = pCharacteristic->getValue();
+    PublishConfig config;
+    if (!publishConfigDecode((const uint8_t*)rxValue.data(), rxValue.length(), config)) {
+      g_publishRejected++;
+      if (g_bleTaskHandle) xTaskNotifyGive(g_bleTaskHandle);
+      uint8_t current[PUBLISH_CONFIG_SIZE];
+      publishConfigEncode(readPublishConfig(), current);
+      pCharacteristic->setValue(current, sizeof(current));  // Reads keep showing what applies
+      return;
+    }
+    portENTER_CRITICAL(&g_publishConfigMux);
+    g_publishConfig = config;
+    portEXIT_CRITICAL(&g_publishConfigMux);
+    g_publishPolicyWritten = true;
+    g_publishResync = true;
+    if (g_bleTaskHandle) xTaskNotifyGive(g_bleTaskHandle);  // Logged there, not in the Bluedroid task
+  }
+};
 
-    if (rxValue.length() > 0) {
-      Serial.println("📥 Received coefficients via BLE");
-      Serial.println(rxValue.c_str());
+class CoeffsCallbacks: public BLECharacteristicCallbacks {
+  void onWrite(BLECharacteristic* pCharacteristic) {
+    // Copy out and return - parsing and NVS writes happen in the worker task
+    std::string rxValue = pCharacteristic->getValue();
+    if (rxValue.length() > DEFERRED_BUFFER_SIZE) {
+      Serial.printf("❌ Coefficients JSON too long (%u > %u bytes) - not applied\n",
+                    (unsigned)rxValue.length(), (unsigned)DEFERRED_BUFFER_SIZE);
+      return;
+    }
+    if (rxValue.length() > 0 && !deferWork(DEFERRED_BLE_COEFFS, rxValue.data(), rxValue.length())) {
+      Serial.println("❌ Worker queue full - coefficients not applied");
+    }
+  }
+};
 
-      DynamicJsonDocument doc(512);
-      DeserializationError error = deserializeJson(doc, rxValue.c_str());
+// Binary calibration batch (see coeff_batch.h). Chunks are assembled here; the
+// worker takes the batch once the last one is in.
+class CoeffBatchCallbacks: public BLECharacteristicCallbacks {
+  void onWrite(BLECharacteristic* pCharacteristic) {
+    std::string rxValue = pCharacteristic->getValue();
+    CoeffBatchFeed result = _staging.feed((const uint8_t*)rxValue.data(), rxValue.length());
+    if (result == COEFF_BATCH_MALFORMED) {
+      Serial.printf("❌ Coefficient batch chunk rejected (%u bytes)\n", (unsigned)rxValue.length());
+      _staging.clear();
+      return;
+    }
+    if (result == COEFF_BATCH_PARTIAL) return;
+
+    portENTER_CRITICAL(&g_coeffBatchMux);
+    g_coeffBatchIn = _staging;
+    g_coeffBatchInReady = true;
+    portEXIT_CRITICAL(&g_coeffBatchMux);
+    _staging.clear();
+    deferWork(DEFERRED_BLE_COEFF_BATCH, nullptr, 0);
+  }
 
-      if (error) {
-        Serial.printf("❌ JSON parse error: %s\n", error.c_str());
-        return;
-      }
+  CoeffBatch _staging;  // Bluedroid task only
+};
 
-      // Check if this is for a specific device and channel
-      const char* targetMac = doc["target_mac"] | "";
-      int channel = doc["channel"] | 1;  // Default to channel 1
-
-      // Extract coefficients from JSON
-      RegressionCoeffs newCoeffs;
-      newCoeffs.intercept = doc["intercept"] | 0.0;
-      newCoeffs.airPressureCoeff = doc["air_pressure_coeff"] | 0.0;
-      newCoeffs.ambientPressureCoeff = doc["ambient_pressure_coeff"] | 0.0;
-      newCoeffs.airTempCoeff = doc["air_temp_coeff"] | 0.0;
-
-      Serial.printf("📊 CH%d Coefficients: intercept=%.4f, air=%.4f, ambient=%.4f, temp=%.4f\n",
-                   channel, newCoeffs.intercept, newCoeffs.airPressureCoeff,
-                   newCoeffs.ambientPressureCoeff, newCoeffs.airTempCoeff);
-      Serial.printf("🎯 Target MAC: '%s'\n", targetMac);
-
-      // Is this for me (the hub) or no target specified?
-      if (strlen(targetMac) == 0 || strcasecmp(targetMac, deviceMAC.c_str()) == 0) {
-        // Save locally to appropriate channel
-        if (channel == 1) {
-          ch1Coeffs = newCoeffs;
-          preferences.putFloat("ch1_intercept", ch1Coeffs.intercept);
-          preferences.putFloat("ch1_air_coeff", ch1Coeffs.airPressureCoeff);
-          preferences.putFloat("ch1_amb_coeff", ch1Coeffs.ambientPressureCoeff);
-          preferences.putFloat("ch1_temp_coeff", ch1Coeffs.airTempCoeff);
-          Serial.println("✅ Saved CH1 coefficients locally");
-        } else {
-          ch2Coeffs = newCoeffs;
-          preferences.putFloat("ch2_intercept", ch2Coeffs.intercept);
-          preferences.putFloat("ch2_air_coeff", ch2Coeffs.airPressureCoeff);
-          preferences.putFloat("ch2_amb_coeff", ch2Coeffs.ambientPressureCoeff);
-          preferences.putFloat("ch2_temp_coeff", ch2Coeffs.airTempCoeff);
-          Serial.println("✅ Saved CH2 coefficients locally");
-        }
-      } else {
-        // Forward to slave device via ESP-NOW
-        Serial.printf("📡 Forwarding CH%d coefficients to slave: %s\n", channel, targetMac);
-        sendCoeffsToDevice(targetMac, &newCoeffs, channel);
-      }
+// Weigh-now request (see weigh_now.h); the worker starts the round
+class WeighNowCallbacks: public BLECharacteristicCallbacks {
+  void onWrite(BLECharacteristic* pCharacteristic) {
+    std::string rxValue = pCharacteristic->getValue();
+    if (rxValue.length() > 0) {
+      deferWork(DEFERRED_BLE_WEIGH_NOW, rxValue.data(), rxValue.length());
     }
   }
 };
@@ -298,169 +1055,331 @@ class CoeffsCallbacks: public BLECharacteristicCallbacks {
 // OTA UPDATE CALLBACKS
 // ============================================================
 
-class OtaCallbacks: public BLECharacteristicCallbacks {
-  void onWrite(BLECharacteristic* pCharacteristic) {
-    std::string rxValue = pCharacteristic->getValue();
+static void otaWake(uint32_t bits) {
+  if (g_otaWriterTaskHandle) xTaskNotify(g_otaWriterTaskHandle, bits, eSetBits);
+}
 
-    if (rxValue.length() == 0) return;
+// Report an error; a transfer in progress ends, its NVS session kept unless discard
+static void otaFail(uint8_t error, bool discard) {
+  g_otaError = error;
+  uint32_t bits = OTA_WAKE_ERROR;
+  if (g_otaState == OTA_RECEIVING) {
+    g_otaDiscard = discard;
+    g_otaState = OTA_STOPPING;
+    bits |= OTA_WAKE_STOP;
+  }
+  otaWake(bits);
+}
 
-    uint8_t* data = (uint8_t*)rxValue.data();
-    size_t len = rxValue.length();
+// Two staging blocks in PSRAM, allocated on the first update
+static bool otaAllocStaging() {
+  static uint8_t* blocks[2] = {nullptr, nullptr};
+  if (blocks[0]) return true;
 
-    // Command packet: first byte indicates command type
-    // 0x01 = Start OTA (followed by 4-byte size)
-    // 0x02 = Data chunk
-    // 0x03 = End OTA / Verify
-    // 0x04 = Abort OTA
+  uint32_t blockBytes = OTA_BLOCK_BYTES_NO_PSRAM;
+  uint32_t spillBytes = OTA_BLOCK_BYTES_NO_PSRAM;
+  uint32_t caps = MALLOC_CAP_INTERNAL;
+  if (psramFound()) {
+    blockBytes = OTA_BLOCK_BYTES;
+    spillBytes = OTA_SPILL_BYTES;
+    caps = MALLOC_CAP_SPIRAM;
+  }
+  uint8_t* b0 = (uint8_t*)heap_caps_malloc(blockBytes, caps);
+  uint8_t* b1 = (uint8_t*)heap_caps_malloc(blockBytes, caps);
+  uint8_t* spill = (uint8_t*)heap_caps_malloc(spillBytes, caps);
+  if (!b0 || !b1 || !spill) {
+    heap_caps_free(b0);
+    heap_caps_free(b1);
+    heap_caps_free(spill);
+    return false;
+  }
+  blocks[0] = b0;
+  blocks[1] = b1;
+  g_otaStaging.init(b0, b1, blockBytes);
+  g_otaSpill = spill;
+  g_otaSpillSize = spillBytes;
+  Serial.printf("📦 OTA staging: 2 x %u KB in %s\n", (unsigned)(blockBytes / 1024), psramFound() ? "PSRAM" : "internal RAM");
+  return true;
+}
 
-    uint8_t cmd = data[0];
+static OtaAccept otaAccept(uint32_t offset, const uint8_t* data, uint32_t len, uint32_t& taken) {
+  portENTER_CRITICAL(&g_otaMux);
+  OtaAccept result = g_otaStaging.accept(offset, data, len, taken);
+  portEXIT_CRITICAL(&g_otaMux);
+  return result;
+}
 
-    switch (cmd) {
-      case 0x01: {  // Start OTA
-        if (len < 5) {
-          Serial.println("❌ OTA start packet too short");
-          return;
-        }
+// Any task: a mesh update is being received here (or was, and we restart soon)
+static bool meshOtaReceiving() {
+  portENTER_CRITICAL(&g_meshOtaMux);
+  uint8_t state = g_meshOtaRx.state();
+  portEXIT_CRITICAL(&g_meshOtaMux);
+  return state != MESH_OTA_IDLE && state != MESH_OTA_FAILED;
+}
 
-        // Extract firmware size (4 bytes, little-endian) with explicit casts
-        otaTotalSize =
-          (uint32_t)data[1] |
-          ((uint32_t)data[2] << 8) |
-          ((uint32_t)data[3] << 16) |
-          ((uint32_t)data[4] << 24);
-
-        // Sanity check: reject obviously invalid sizes
-        if (otaTotalSize < 4096 || otaTotalSize > (14UL * 1024UL * 1024UL)) {
-          Serial.printf("❌ OTA invalid size: %u bytes (must be 4KB-14MB)\n", (unsigned)otaTotalSize);
-          otaInProgress = false;
-          return;
-        }
+// START, in the Bluedroid task: what can be answered at once is; the rest waits
+// for the writer, which owns flash, NVS and the staging blocks
+static void otaStart(const uint8_t* data, size_t len) {
+  if (len < 5) {
+    Serial.println("❌ OTA start packet too short");
+    return;
+  }
+  if (g_otaState == OTA_FINISHING) {
+    Serial.println("❌ OTA start while the last transfer is being installed");
+    otaFail(OTA_ERR_STATE, false);
+    return;
+  }
+  if (meshOtaReceiving()) {
+    Serial.println("❌ OTA start while a mesh update is being received");
+    otaFail(OTA_ERR_STATE, false);
+    return;
+  }
+  portENTER_CRITICAL(&g_otaMux);
+  g_otaStartLen = len < sizeof(g_otaStartCmd) ? (uint8_t)len : sizeof(g_otaStartCmd);
+  memcpy(g_otaStartCmd, data, g_otaStartLen);
+  portEXIT_CRITICAL(&g_otaMux);
+  g_otaStartPending = true;
+  otaWake(OTA_WAKE_START);
+  if (len >= 9) return;
+
+  // The original client (no CRC) streams DATA after a fixed pause and can't rewind,
+  // so DATA dropped before the writer is receiving corrupts its image. Its START is
+  // done here, before the next write is handled: wait for the writer to take it
+  // (otaBegin doesn't notify before then, so it never waits on this task).
+  for (uint32_t waited = 0; g_otaStartPending && waited < OTA_START_WAIT_MS; waited += 2) {
+    vTaskDelay(pdMS_TO_TICKS(2));
+  }
+  if (g_otaStartPending) Serial.println("⚠️ OTA start not taken yet, DATA may be refused");
+}
 
-        otaReceived = 0;
-        otaStartTime = millis();
+static void otaReady();
 
-        Serial.printf("📦 OTA Start: expecting %u bytes\n", (unsigned)otaTotalSize);
+// Writer task: START's size, optionally the image CRC, flags and version. Resumes
+// the NVS session for the same image. A START again mid-transfer (the phone giving
+// up on a stall) waits for the staged blocks, so the committed offset is current
+// and the blocks are free; one after a stop, for the stop to be done.
+static void otaBegin() {
+  if (g_otaState == OTA_STOPPING || (g_otaState == OTA_RECEIVING && !g_otaStaging.drained())) {
+    otaWake(OTA_WAKE_START);  // Again on the next pass, which drains or stops first
+    return;
+  }
+  uint8_t data[sizeof(g_otaStartCmd)];
+  portENTER_CRITICAL(&g_otaMux);
+  size_t len = g_otaStartLen;
+  memcpy(data, g_otaStartCmd, len);
+  portEXIT_CRITICAL(&g_otaMux);
+  uint32_t size = otaGetU32(data + 1);
+  uint32_t crc = len >= 9 ? otaGetU32(data + 5) : 0;
+  // Relaying needs the version too: slaves only ever get newer firmware
+  bool relay = len >= 13 && (data[9] & OTA_START_RELAY);
+
+  const esp_partition_t* part = esp_ota_get_next_update_partition(NULL);
+  if (!part || size < 4096 || size > part->size) {
+    Serial.printf("❌ OTA invalid size: %u bytes (update partition holds %u)\n",
+                  (unsigned)size, part ? (unsigned)part->size : 0);
+    g_otaStartPending = false;
+    otaFail(OTA_ERR_SIZE, true);
+    return;
+  }
+  if (!otaAllocStaging()) {
+    Serial.println("❌ OTA staging buffers couldn't be allocated");
+    g_otaStartPending = false;
+    otaFail(OTA_ERR_NO_MEMORY, false);
+    return;
+  }
 
-        // Begin OTA update
-        if (!Update.begin(otaTotalSize)) {
-          Serial.printf("❌ OTA begin failed: %s\n", Update.errorString());
-          otaInProgress = false;
-          return;
-        }
+  bool restart = g_otaState == OTA_RECEIVING;
+  uint32_t from = 0;
+  OtaCheckpoint ckpt = {0, 0, 0};
+  if (crc != 0 && preferences.getUInt("ota_size", 0) == size && preferences.getUInt("ota_crc", 0) == crc &&
+      preferences.getUInt("ota_addr", 0) == part->address &&
+      preferences.getBytes("ota_ckpt", &ckpt, sizeof(ckpt)) == sizeof(ckpt)) {
+    from = ckpt.received;
+    if (from > size || (from % g_otaStaging.blockSize() != 0 && from != size)) from = 0;
+  } else {
+    preferences.remove("ota_ckpt");  // First, so the old progress never pairs with the new image
+    preferences.remove("ota_hdr");
+    preferences.putUInt("ota_size", size);
+    preferences.putUInt("ota_crc", crc);
+    preferences.putUInt("ota_addr", part->address);
+  }
 
-        otaInProgress = true;
-        otaChunkCount = 0;  // Reset chunk counter for debug logging
-        setLEDStatus(LED_BOOTING);  // Show update in progress
+  portENTER_CRITICAL(&g_otaMux);
+  g_otaStaging.begin(size, from);
+  g_otaSpillHead = 0;
+  g_otaSpillLen = 0;
+  portEXIT_CRITICAL(&g_otaMux);
+  g_otaPartition = part;
+  g_otaCrc = crc;
+  g_otaRelay = relay;
+  if (relay) memcpy(g_otaRelayVersion, data + 10, sizeof(g_otaRelayVersion));
+  g_otaCommitted = from;
+  g_otaDiscard = false;
+  g_otaAcked = from;
+  g_otaRewoundAt = UINT32_MAX;
+  g_otaResumedFrom = from;
+  g_otaResume = ckpt;
+  g_otaRewinds = 0;
+  g_otaFullStalls = 0;
+  g_otaFlashMs = 0;
+  g_otaStartMs = millis();
+  g_otaState = OTA_RECEIVING;
+  g_otaStartPending = false;
+
+  if (from > 0) {
+    Serial.printf("📦 OTA Start: %u bytes, resuming at %u\n", (unsigned)size, (unsigned)from);
+  } else {
+    Serial.printf("📦 OTA Start: expecting %u bytes%s\n", (unsigned)size, crc ? "" : " (no CRC, not resumable)");
+  }
+  Serial.printf("📦 OTA target partition: %s size=%uKB\n", part->label, (unsigned)(part->size / 1024));
 
-        // Log partition and heap info for debugging
-        const esp_partition_t* otaPart = esp_ota_get_next_update_partition(NULL);
-        if (otaPart) {
-          Serial.printf("📦 OTA target partition: %s size=%uKB\n",
-                        otaPart->label, (unsigned)(otaPart->size / 1024));
-        }
-        Serial.printf("📦 Free heap at OTA start: %u bytes\n", (unsigned)ESP.getFreeHeap());
+  if (!restart) {
+    otaInProgress = true;
+    setLEDStatus(LED_BOOTING);  // Show update in progress
 
-        // Disable WiFi/ESP-NOW during OTA to reduce BLE/WiFi coexistence throttling
-        // This gives BLE maximum bandwidth for faster transfers
-        esp_now_deinit();
-        WiFi.mode(WIFI_MODE_NULL);
-        Serial.println("📡 WiFi/ESP-NOW disabled for OTA speed");
+    // Disable WiFi/ESP-NOW during OTA to reduce BLE/WiFi coexistence throttling
+    // This gives BLE maximum bandwidth for faster transfers
+    esp_now_deinit();
+    WiFi.mode(WIFI_MODE_NULL);
+    Serial.println("📡 WiFi/ESP-NOW disabled for OTA speed");
+  }
+  otaReady();
+}
 
-        Serial.println("✅ OTA update started");
-        break;
-      }
+// Original protocol (DATA): no offsets and no rewind, so what doesn't fit the
+// staging goes to the spill buffer, and everything after it too until the writer
+// has moved it on (otaDrainSpill)
+static bool otaSpillData(const uint8_t* data, uint32_t len) {
+  portENTER_CRITICAL(&g_otaMux);
+  uint32_t taken = 0;
+  if (g_otaSpillLen == 0 && g_otaStaging.accept(g_otaStaging.received(), data, len, taken) != OTA_NO_ROOM) {
+    portEXIT_CRITICAL(&g_otaMux);
+    return true;
+  }
+  bool fits = g_otaSpillHead + g_otaSpillLen + (len - taken) <= g_otaSpillSize;
+  if (fits) {
+    if (g_otaSpillLen == 0) g_otaFullStalls++;
+    memcpy(g_otaSpill + g_otaSpillHead + g_otaSpillLen, data + taken, len - taken);
+    g_otaSpillLen += len - taken;
+  }
+  portEXIT_CRITICAL(&g_otaMux);
+  return fits;
+}
 
-      case 0x02: {  // Data chunk
-        if (!otaInProgress) {
-          Serial.println("❌ OTA data received but not in progress");
-          return;
-        }
+// DATA / DATA_AT
+static void otaData(uint32_t offset, const uint8_t* data, uint32_t len, bool legacy) {
+  uint32_t before = g_otaStaging.received();
+  uint32_t taken = 0;
+  OtaAccept result = OTA_ACCEPTED;
+  if (legacy) {
+    if (!otaSpillData(data, len)) {
+      Serial.println("❌ OTA flash writer fell behind");
+      otaFail(OTA_ERR_FLASH, false);
+      return;
+    }
+  } else {
+    result = otaAccept(offset, data, len, taken);
+    if (result == OTA_NO_ROOM) g_otaFullStalls++;
+  }
+
+  uint32_t received = g_otaStaging.received();
+  if (result == OTA_OUT_OF_ORDER || result == OTA_NO_ROOM) {
+    if (received != g_otaRewoundAt) {  // One rewind per position; the rest of that burst is dropped quietly
+      g_otaRewoundAt = received;
+      g_otaRewinds++;
+      otaWake(OTA_WAKE_REWIND);
+    }
+    return;
+  }
 
-        // Write data (skip command byte) with error checking
-        size_t toWrite = len - 1;
+  uint32_t bits = 0;
+  if (received / g_otaStaging.blockSize() != before / g_otaStaging.blockSize() || received == g_otaStaging.total()) {
+    bits |= OTA_WAKE_BLOCK;
+  }
+  if (received - g_otaAcked >= OTA_ACK_BYTES || (received == g_otaStaging.total() && received != before)) {
+    g_otaAcked = received;
+    bits |= OTA_WAKE_ACK;
+  }
+  if (bits) otaWake(bits);
+}
 
-        // Debug: log first few chunk sizes to detect MTU issues
-        if (otaChunkCount < 5) {
-          Serial.printf("📦 OTA chunk #%d: %u bytes\n", otaChunkCount, (unsigned)toWrite);
-        }
-        otaChunkCount++;
+static void otaEnd() {
+  portENTER_CRITICAL(&g_otaMux);
+  uint32_t received = g_otaStaging.received() + g_otaSpillLen;  // The writer stages what is spilled before finishing
+  portEXIT_CRITICAL(&g_otaMux);
+  if (received != g_otaStaging.total()) {
+    Serial.printf("⚠️ OTA end at %u of %u bytes, asking for the rest\n",
+                  (unsigned)received, (unsigned)g_otaStaging.total());
+    g_otaRewoundAt = received;
+    g_otaRewinds++;
+    otaWake(OTA_WAKE_REWIND);
+    return;
+  }
+  g_otaState = OTA_FINISHING;
+  otaWake(OTA_WAKE_END);
+}
 
-        size_t written = Update.write(data + 1, toWrite);
+// Phone gone mid-transfer: keep what is committed for it to resume
+static void otaSuspend() {
+  if (g_otaState != OTA_RECEIVING) return;
+  g_otaDiscard = false;
+  g_otaState = OTA_STOPPING;
+  otaWake(OTA_WAKE_STOP);
+  Serial.printf("⏸️ OTA paused at %u of %u bytes%s\n", (unsigned)g_otaStaging.received(),
+                (unsigned)g_otaStaging.total(), g_otaCrc ? ", resumable" : "");
+}
 
-        if (written != toWrite) {
-          Serial.printf("❌ OTA short write: wrote %u of %u (%s)\n",
-                        (unsigned)written, (unsigned)toWrite, Update.errorString());
-          otaInProgress = false;
-          Update.abort();
-          setLEDStatus(LED_STANDALONE);
-          return;
-        }
+// Commands arrive in the Bluedroid task, which only copies data into staging; the
+// writer task does the flash work and answers (see ota_stream.h)
+class OtaCallbacks: public BLECharacteristicCallbacks {
+  void onWrite(BLECharacteristic* pCharacteristic) {
+    std::string rxValue = pCharacteristic->getValue();
 
-        otaReceived += written;
+    if (rxValue.length() == 0) return;
 
-        // Progress update every 10KB
-        if (otaReceived % 10240 < toWrite) {
-          int progress = (otaReceived * 100) / otaTotalSize;
-          Serial.printf("📥 OTA Progress: %d%% (%u/%u bytes)\n", progress, otaReceived, otaTotalSize);
-        }
+    const uint8_t* data = (const uint8_t*)rxValue.data();
+    size_t len = rxValue.length();
+    uint8_t cmd = data[0];
+
+    switch (cmd) {
+      case OTA_CMD_START:
+        otaStart(data, len);
         break;
-      }
 
-      case 0x03: {  // End OTA
-        if (!otaInProgress) {
-          Serial.println("❌ OTA end received but not in progress");
+      case OTA_CMD_DATA:
+      case OTA_CMD_DATA_AT:
+        if (g_otaState != OTA_RECEIVING) {
+          Serial.println("❌ OTA data received but not in progress");
           return;
         }
+        if (cmd == OTA_CMD_DATA) {
+          otaData(g_otaStaging.received(), data + 1, len - 1, true);
+        } else if (len > 5) {
+          otaData(otaGetU32(data + 1), data + 5, len - 5, false);
+        }
+        break;
 
-        // Verify we received exactly what was expected
-        if (otaReceived != otaTotalSize) {
-          Serial.printf("❌ OTA size mismatch: got %u expected %u\n",
-                        (unsigned)otaReceived, (unsigned)otaTotalSize);
-          otaInProgress = false;
-          Update.abort();
-          setLEDStatus(LED_STANDALONE);
+      case OTA_CMD_END:
+        if (g_otaState != OTA_RECEIVING) {
+          Serial.println("❌ OTA end received but not in progress");
+          otaFail(OTA_ERR_STATE, false);
           return;
         }
+        otaEnd();
+        break;
 
-        if (Update.end(true)) {  // true = set as boot partition
-          uint32_t duration = millis() - otaStartTime;
-          Serial.printf("✅ OTA Complete! %u bytes in %u ms\n", otaReceived, duration);
-          Serial.println("🔄 Rebooting in 2 seconds...");
-
-          otaInProgress = false;
-
-          // Send success response via BLE before reboot
-          delay(500);
-
-          // Reboot to new firmware
-          delay(1500);
-          ESP.restart();
-        } else {
-          Serial.printf("❌ OTA end failed: %s\n", Update.errorString());
-          otaInProgress = false;
-          setLEDStatus(LED_STANDALONE);
-        }
+      case OTA_CMD_INFO:
+        otaWake(OTA_WAKE_INFO);
         break;
-      }
 
-      case 0x04: {  // Abort OTA
-        if (otaInProgress) {
-          Update.abort();
-          otaInProgress = false;
-          otaReceived = 0;
-          otaTotalSize = 0;
+      case OTA_CMD_ABORT:
+        if (g_otaState == OTA_RECEIVING) {
           Serial.println("⚠️ OTA aborted by user");
-          setLEDStatus(LED_STANDALONE);
-
-          // Restore WiFi/ESP-NOW after abort
-          WiFi.mode(WIFI_STA);
-          WiFi.setSleep(true);
-          esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
-          initESPNow();
-          Serial.println("📡 WiFi/ESP-NOW restored after OTA abort");
+          g_otaDiscard = true;
+          g_otaState = OTA_STOPPING;
+          otaWake(OTA_WAKE_STOP);
         }
         break;
-      }
 
       default:
         Serial.printf("❌ Unknown OTA command: 0x%02X\n", cmd);
@@ -470,86 +1389,699 @@ class OtaCallbacks: public BLECharacteristicCallbacks {
 };
 
 // ============================================================
-// SETUP
+// OTA FLASH WRITER
 // ============================================================
 
-void setup() {
-  Serial.begin(115200);
-  delay(1000);
-  
-  Serial.println("\n\n🚀 ========================================");
-  Serial.println("🚀 AirScale Firmware v4.0 (No WiFi Required)");
-  Serial.println("🚀 ========================================\n");
+// Writer task only: the one place OTA notifications are sent from
+static void otaNotify(uint8_t event, uint8_t status) {
+  OtaNotify n;
+  n.event = event;
+  n.status = status;
+  n.features = OTA_FEATURE_IMAGE | OTA_FEATURE_DELTA | OTA_FEATURE_RELAY;
+  portENTER_CRITICAL(&g_otaMux);
+  n.received = g_otaStaging.received();
+  n.limit = g_otaStaging.limit();
+  n.total = g_otaStaging.total();
+  portEXIT_CRITICAL(&g_otaMux);
+  n.committed = g_otaCommitted;
+
+  if (!deviceConnected || !pOtaCharacteristic) return;
+  uint8_t buf[OTA_NOTIFY_SIZE];
+  encodeOtaNotify(buf, n);
+  pOtaCharacteristic->setValue(buf, sizeof(buf));
+  pOtaCharacteristic->notify();
+}
 
-  // PSRAM sanity check
-  if (psramFound()) {
-    Serial.printf("✅ PSRAM OK: %u bytes\n", ESP.getPsramSize());
-  } else {
-    Serial.println("❌ PSRAM NOT FOUND");
+static void otaClearSession() {
+  preferences.remove("ota_ckpt");
+  preferences.remove("ota_hdr");
+  preferences.remove("ota_size");
+  preferences.remove("ota_crc");
+  preferences.remove("ota_addr");
+}
+
+// Erase and program one staged block. The cache (and PSRAM with it) is off while
+// the flash is busy, so data goes through an internal-RAM bounce buffer.
+static bool otaProgram(const OtaStaging::Block& block) {
+  uint32_t t0 = millis();
+  uint32_t eraseLen = (block.length + SPI_FLASH_SEC_SIZE - 1) & ~(uint32_t)(SPI_FLASH_SEC_SIZE - 1);
+  esp_err_t err = esp_partition_erase_range(g_otaPartition, block.offset, eraseLen);
+  for (uint32_t done = 0; err == ESP_OK && done < block.length; done += sizeof(g_otaBounce)) {
+    uint32_t n = block.length - done < sizeof(g_otaBounce) ? block.length - done : sizeof(g_otaBounce);
+    memcpy(g_otaBounce, block.data + done, n);
+    err = esp_partition_write(g_otaPartition, block.offset + done, g_otaBounce, n);
   }
+  g_otaFlashMs += millis() - t0;
 
-  // OTA partition check - verify we have proper OTA layout
-  const esp_partition_t* running = esp_ota_get_running_partition();
-  const esp_partition_t* nextOta = esp_ota_get_next_update_partition(NULL);
-  if (running) {
-    Serial.printf("📦 Running partition: %s @0x%08X size=%uKB\n",
-                  running->label, (unsigned)running->address, (unsigned)(running->size / 1024));
+  if (err != ESP_OK) {
+    Serial.printf("❌ OTA flash write at %u failed: %s\n", (unsigned)block.offset, esp_err_to_name(err));
+    return false;
   }
-  if (nextOta) {
-    Serial.printf("📦 Next OTA partition: %s @0x%08X size=%uKB\n",
-                  nextOta->label, (unsigned)nextOta->address, (unsigned)(nextOta->size / 1024));
-  } else {
-    Serial.println("⚠️ No OTA partition available - OTA updates will fail!");
+  return true;
+}
+
+// The running image's SHA-256, the name a delta update is made against. Reading
+// it verifies the whole image, so it is worked out once.
+static bool otaBaseSha() {
+  if (!g_otaBaseShaValid) {
+    g_otaBase = esp_ota_get_running_partition();
+    g_otaBaseShaValid = g_otaBase && esp_partition_get_sha256(g_otaBase, g_otaBaseSha) == ESP_OK;
   }
+  return g_otaBaseShaValid;
+}
 
-  // *** CRITICAL: Initialize WiFi BEFORE getting MAC address ***
-  WiFi.mode(WIFI_STA);
+static void otaSendInfo() {
+  if (!otaBaseSha() || !deviceConnected || !pOtaCharacteristic) return;
+  uint8_t buf[OTA_INFO_SIZE];
+  encodeOtaInfo(buf, OTA_FEATURE_IMAGE | OTA_FEATURE_DELTA | OTA_FEATURE_RELAY, g_otaBase->size, g_otaBaseSha);
+  pOtaCharacteristic->setValue(buf, sizeof(buf));
+  pOtaCharacteristic->notify();
+}
 
-  // Now safe to initialize objects that may depend on system being ready
-  server = new WebServer(80);
-  pixel = new Adafruit_NeoPixel(1, WS2812B_PIN, NEO_GRB + NEO_KHZ800);
+static bool otaReadBase(void* ctx, uint32_t offset, uint8_t* out, size_t len) {
+  return esp_partition_read(g_otaBase, offset, out, len) == ESP_OK;
+}
 
-  // Initialize LED
-  pixel->begin();
-  pixel->setBrightness(255); // was set to 50 on 3.3V but way too dim
-  setLEDStatus(LED_BOOTING);
+// Program the expanded bytes waiting in g_otaBounce, erasing ahead of them (a
+// flash block at a time where the image goes on that far), and hash them
+static bool otaFlushImage() {
+  if (g_otaOutLen == 0) return true;
+  uint32_t at = g_otaImageOut - g_otaOutLen;
+  uint32_t end = (g_otaHeader.imageSize + SPI_FLASH_SEC_SIZE - 1) & ~(uint32_t)(SPI_FLASH_SEC_SIZE - 1);
+  uint32_t t0 = millis();
+  esp_err_t err = ESP_OK;
+  while (err == ESP_OK && g_otaErasedTo < at + g_otaOutLen) {
+    uint32_t span = g_otaErasedTo % OTA_BLOCK_BYTES == 0 && g_otaErasedTo + OTA_BLOCK_BYTES <= end
+                    ? OTA_BLOCK_BYTES : SPI_FLASH_SEC_SIZE;
+    err = esp_partition_erase_range(g_otaPartition, g_otaErasedTo, span);
+    if (err == ESP_OK) g_otaErasedTo += span;
+  }
+  if (err == ESP_OK) err = esp_partition_write(g_otaPartition, at, g_otaBounce, g_otaOutLen);
+  g_otaFlashMs += millis() - t0;
 
-  delay(100);
+  if (err != ESP_OK) {
+    Serial.printf("❌ OTA flash write at %u failed: %s\n", (unsigned)at, esp_err_to_name(err));
+    return false;
+  }
+  mbedtls_sha256_update_ret(&g_otaSha, g_otaBounce, g_otaOutLen);
+  g_otaOutLen = 0;
+  return true;
+}
 
-  // Get MAC address (WiFi must be in STA mode briefly for this)
-  deviceMAC = WiFi.macAddress();
-  apSSID = "AirScale-" + deviceMAC;
-  bleDeviceName = DEVICE_NAME_PREFIX + deviceMAC;
-  
-  Serial.println("📱 Device MAC: " + deviceMAC);
-  Serial.println("📱 BLE Name: " + bleDeviceName);
-  
-  // Initialize SPIFFS
-  if (!SPIFFS.begin(true)) {
-    Serial.println("⚠️ SPIFFS Mount Failed");
+// A delta's header names the image it was made against
+static bool otaBaseMatches() {
+  if (!otaBaseSha() || g_otaPatcher.baseSize() > g_otaBase->size ||
+      memcmp(g_otaPatcher.baseSha256(), g_otaBaseSha, sizeof(g_otaBaseSha)) != 0) {
+    Serial.println("❌ OTA delta was made against another image than the one running");
+    return false;
   }
-  
-  // Initialize preferences and load saved coefficients for both channels
-  preferences.begin("airscale", false);
+  return true;
+}
 
-  // Channel 1 coefficients
-  ch1Coeffs.intercept = preferences.getFloat("ch1_intercept", 0.0);
-  ch1Coeffs.airPressureCoeff = preferences.getFloat("ch1_air_coeff", 0.0);
-  ch1Coeffs.ambientPressureCoeff = preferences.getFloat("ch1_amb_coeff", 0.0);
-  ch1Coeffs.airTempCoeff = preferences.getFloat("ch1_temp_coeff", 0.0);
+// Expand one staged block of a container. Everything it yields is in flash on
+// return, so the end of every block is a point the transfer can resume from.
+static uint8_t otaExpand(const OtaStaging::Block& block) {
+  const uint8_t* in = block.data;
+  uint32_t len = block.length;
+  if (block.offset == 0) {
+    if (!parseOtaImageHeader(in, len, g_otaHeader)) return OTA_ERR_CONTAINER;
+    if (g_otaHeader.payloadSize != g_otaStaging.total() - OTA_IMAGE_HEADER_SIZE ||
+        (g_otaHeader.codec == OTA_CODEC_STORED && g_otaHeader.payloadSize != g_otaHeader.imageSize)) {
+      return OTA_ERR_CONTAINER;
+    }
+    if (g_otaHeader.imageSize > g_otaPartition->size) return OTA_ERR_SIZE;
+    if (g_otaCrc != 0 && preferences.putBytes("ota_hdr", in, OTA_IMAGE_HEADER_SIZE) != OTA_IMAGE_HEADER_SIZE) {
+      return OTA_ERR_FLASH;
+    }
+    Serial.printf("📦 OTA container: %u bytes expand to %u (%s)\n", (unsigned)g_otaHeader.payloadSize,
+                  (unsigned)g_otaHeader.imageSize,
+                  g_otaHeader.codec == OTA_CODEC_DELTA ? "delta" : g_otaHeader.codec == OTA_CODEC_LZSS ? "LZSS" : "stored");
+    mbedtls_sha256_init(&g_otaSha);
+    mbedtls_sha256_starts_ret(&g_otaSha, 0);
+    g_otaDecoder.begin(g_otaWindow);
+    g_otaPatcher.begin(otaReadBase, nullptr);
+    g_otaPatchAt = g_otaPatchLen = 0;
+    g_otaImageOut = 0;
+    g_otaOutLen = 0;
+    g_otaErasedTo = 0;
+    in += OTA_IMAGE_HEADER_SIZE;
+    len -= OTA_IMAGE_HEADER_SIZE;
+  }
 
-  // Channel 2 coefficients
-  ch2Coeffs.intercept = preferences.getFloat("ch2_intercept", 0.0);
-  ch2Coeffs.airPressureCoeff = preferences.getFloat("ch2_air_coeff", 0.0);
-  ch2Coeffs.ambientPressureCoeff = preferences.getFloat("ch2_amb_coeff", 0.0);
-  ch2Coeffs.airTempCoeff = preferences.getFloat("ch2_temp_coeff", 0.0);
+  bool lzss = g_otaHeader.codec != OTA_CODEC_STORED;
+  while (len > 0 || (lzss && g_otaDecoder.busy()) || g_otaPatchAt < g_otaPatchLen) {
+    uint8_t* out = g_otaBounce + g_otaOutLen;
+    size_t room = sizeof(g_otaBounce) - g_otaOutLen;
+    size_t used = 0, produced = 0;
+    if (g_otaHeader.codec == OTA_CODEC_DELTA) {
+      if (g_otaPatchAt == g_otaPatchLen) {  // Expand the next stretch of patch
+        size_t patched;
+        used = g_otaDecoder.decode(in, len, g_otaPatch, sizeof(g_otaPatch), patched);
+        g_otaPatchAt = 0;
+        g_otaPatchLen = patched;
+      } else {
+        bool ready = g_otaPatcher.ready();
+        g_otaPatchAt += g_otaPatcher.apply(g_otaPatch + g_otaPatchAt, g_otaPatchLen - g_otaPatchAt, out, room, produced);
+        if (!ready && g_otaPatcher.ready() && !otaBaseMatches()) return OTA_ERR_BASE;
+      }
+      if (g_otaDecoder.failed() || g_otaPatcher.failed()) return OTA_ERR_CONTAINER;
+    } else if (lzss) {
+      used = g_otaDecoder.decode(in, len, out, room, produced);
+      if (g_otaDecoder.failed()) return OTA_ERR_CONTAINER;
+    } else {
+      used = produced = len < room ? len : room;
+      memcpy(out, in, used);
+    }
+    in += used;
+    len -= used;
+    g_otaOutLen += produced;
+    g_otaImageOut += produced;
+    if (g_otaImageOut > g_otaHeader.imageSize) return OTA_ERR_CONTAINER;
+    if (g_otaOutLen == sizeof(g_otaBounce) && !otaFlushImage()) return OTA_ERR_FLASH;
+  }
+  return otaFlushImage() ? OTA_OK : OTA_ERR_FLASH;
+}
 
-  Serial.printf("📊 CH1 coefficients: intercept=%.4f, air=%.4f, ambient=%.4f, temp=%.4f\n",
-               ch1Coeffs.intercept, ch1Coeffs.airPressureCoeff,
-               ch1Coeffs.ambientPressureCoeff, ch1Coeffs.airTempCoeff);
-  Serial.printf("📊 CH2 coefficients: intercept=%.4f, air=%.4f, ambient=%.4f, temp=%.4f\n",
-               ch2Coeffs.intercept, ch2Coeffs.airPressureCoeff,
-               ch2Coeffs.ambientPressureCoeff, ch2Coeffs.airTempCoeff);
+// A raw image is programmed as staged; one starting with the container magic is
+// expanded
+static uint8_t otaWriteBlock(const OtaStaging::Block& block) {
+  if (block.offset == 0) g_otaContainer = isOtaImage(block.data, block.length);
+  if (g_otaContainer) return otaExpand(block);
+  return otaProgram(block) ? OTA_OK : OTA_ERR_FLASH;
+}
+
+// A delta doesn't resume: its LZSS window holds patch bytes, which aren't kept
+// anywhere to reload it from. It is small enough to send again.
+static void otaCheckpoint(uint32_t committed) {
+  OtaCheckpoint ckpt = {committed, committed, 0};
+  if (g_otaContainer && g_otaHeader.codec == OTA_CODEC_DELTA) return;
+  if (g_otaContainer) {
+    ckpt.image = g_otaImageOut;
+    ckpt.decoder = g_otaDecoder.save();
+  }
+  preferences.putBytes("ota_ckpt", &ckpt, sizeof(ckpt));
+}
+
+// START resumed a container: hash the image already in flash again and reload the
+// decoder's window from its tail. The sector the checkpoint falls in may hold
+// bytes written after it, so its head goes back into g_otaBounce to be erased and
+// programmed again with the next output.
+static bool otaResumeImage() {
+  uint8_t raw[OTA_IMAGE_HEADER_SIZE];
+  g_otaContainer = preferences.getBytes("ota_hdr", raw, sizeof(raw)) == sizeof(raw);
+  if (!g_otaContainer) return true;
+  if (!parseOtaImageHeader(raw, sizeof(raw), g_otaHeader)) return false;
+
+  uint32_t image = g_otaResume.image;
+  uint32_t keep = image & ~(uint32_t)(SPI_FLASH_SEC_SIZE - 1);
+  mbedtls_sha256_init(&g_otaSha);
+  mbedtls_sha256_starts_ret(&g_otaSha, 0);
+  for (uint32_t off = 0; off < keep; off += sizeof(g_otaBounce)) {
+    if (esp_partition_read(g_otaPartition, off, g_otaBounce, sizeof(g_otaBounce)) != ESP_OK) return false;
+    mbedtls_sha256_update_ret(&g_otaSha, g_otaBounce, sizeof(g_otaBounce));
+  }
+  if (image > keep && esp_partition_read(g_otaPartition, keep, g_otaBounce, image - keep) != ESP_OK) return false;
+
+  uint32_t tail = image < OTA_LZSS_WINDOW ? image : OTA_LZSS_WINDOW;
+  uint32_t pos = (image - tail) & (OTA_LZSS_WINDOW - 1);
+  uint32_t first = OTA_LZSS_WINDOW - pos < tail ? OTA_LZSS_WINDOW - pos : tail;
+  if (first > 0 && esp_partition_read(g_otaPartition, image - tail, g_otaWindow + pos, first) != ESP_OK) return false;
+  if (tail > first && esp_partition_read(g_otaPartition, image - tail + first, g_otaWindow, tail - first) != ESP_OK) {
+    return false;
+  }
+
+  g_otaDecoder.restore(g_otaWindow, image, g_otaResume.decoder);
+  g_otaImageOut = image;
+  g_otaOutLen = image - keep;
+  g_otaErasedTo = keep;
+  Serial.printf("📦 OTA container resumed at %u image bytes\n", (unsigned)image);
+  return true;
+}
+
+// Container finished: all of it expanded to exactly the image, which hashes to
+// the SHA-256 in its header
+static uint8_t otaVerifyImage() {
+  if (!otaFlushImage()) return OTA_ERR_FLASH;  // Left over from a resume with nothing more to expand
+  uint8_t digest[32];
+  mbedtls_sha256_finish_ret(&g_otaSha, digest);
+  mbedtls_sha256_free(&g_otaSha);
+  if (g_otaImageOut != g_otaHeader.imageSize || !g_otaDecoder.atBoundary()) return OTA_ERR_CONTAINER;
+  if (g_otaHeader.codec == OTA_CODEC_DELTA && !g_otaPatcher.atBoundary()) return OTA_ERR_CONTAINER;
+  return memcmp(digest, g_otaHeader.sha256, sizeof(digest)) == 0 ? OTA_OK : OTA_ERR_DIGEST;
+}
+
+static void restoreRadioAfterOta() {
+  WiFi.mode(WIFI_STA);
+  WiFi.setSleep(true);
+  esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+  initESPNow();
+  Serial.println("📡 WiFi/ESP-NOW restored after OTA");
+}
+
+// Transfer over without a restart. An aborted or failed one forgets its NVS
+// session; a suspended one keeps it for the phone to resume.
+static void otaStopped() {
+  if (g_otaDiscard) otaClearSession();
+  g_otaState = OTA_IDLE;
+  otaInProgress = false;
+  restoreRadioAfterOta();
+  setLEDStatus(deviceConnected ? LED_HUB_MODE : LED_STANDALONE);
+}
+
+// Writer task (hub): a mesh update's progress, one slave per notification
+static void meshOtaNotify(uint8_t index, uint8_t slaves, const MeshOtaTarget& t, uint32_t received, uint32_t total) {
+  if (!deviceConnected || !pOtaCharacteristic) return;
+  uint8_t buf[MESH_OTA_NOTIFY_SIZE];
+  encodeMeshOtaNotify(buf, index, slaves, t, received, total);
+  pOtaCharacteristic->setValue(buf, sizeof(buf));
+  pOtaCharacteristic->notify();
+}
+
+// Writer task (hub): pass a verified image on to the slaves heard directly that
+// run older firmware, before restarting into it. The radio is back for this; the
+// radio task sends, the worker records the slaves' statuses, and this reports
+// them to the phone until every slave is done or given up on.
+static void otaRelayToSlaves(uint32_t imageSize) {
+  uint8_t digest[32];
+  if (esp_partition_get_sha256(g_otaPartition, digest) != ESP_OK) {
+    Serial.println("❌ Mesh OTA: new image couldn't be hashed, slaves not updated");
+    return;
+  }
+
+  // Slaves that report their image (older firmware doesn't take mesh updates) and
+  // a version older than this one; never a downgrade or a sideways push
+  MacKey targets[MESH_OTA_MAX_TARGETS];
+  uint8_t count = 0;
+  uint8_t upToDate = 0;
+  int slots = deviceSlotsInUse();
+  for (int i = 0; i < slots && count < MESH_OTA_MAX_TARGETS; i++) {
+    DeviceData device;
+    if (!readDevice(i, device) || !device.isActive || device.hops != 0) continue;
+    bool reported = false;
+    for (int b = 0; b < FIRMWARE_IMAGE_ID_SIZE; b++) reported |= device.imageId[b] != 0;
+    if (!reported) continue;
+    if (memcmp(device.imageId, digest, FIRMWARE_IMAGE_ID_SIZE) == 0 ||
+        meshOtaCompareVersion(device.firmware, g_otaRelayVersion) >= 0) {
+      upToDate++;
+      continue;
+    }
+    targets[count++] = device.macKey;
+  }
+  if (count == 0) {
+    Serial.printf("📦 Mesh OTA: no slave runs older than %u.%u.%u (%u up to date)\n",
+                  g_otaRelayVersion[0], g_otaRelayVersion[1], g_otaRelayVersion[2], upToDate);
+    return;
+  }
+
+  otaNotify(OTA_EVT_RELAY, OTA_OK);
+  restoreRadioAfterOta();
+  otaInProgress = false;
+  g_meshOtaPartition = g_otaPartition;
+  memcpy(g_meshOtaSha, digest, sizeof(digest));
+  memcpy(g_meshOtaVersion, g_otaRelayVersion, sizeof(g_meshOtaVersion));
+  g_meshOtaStartMs = millis();
+  portENTER_CRITICAL(&g_meshOtaMux);
+  g_meshOtaTx.begin((uint16_t)esp_random(), imageSize, MESH_OTA_CHUNK_BYTES, MESH_OTA_WINDOW_CHUNKS,
+                    esp_timer_get_time());
+  for (uint8_t i = 0; i < count; i++) g_meshOtaTx.add(targets[i]);
+  portEXIT_CRITICAL(&g_meshOtaMux);
+  Serial.printf("📡 Mesh OTA: pushing %u bytes to %u slave(s), %u already up to date\n",
+                (unsigned)imageSize, count, upToDate);
+  if (g_radioTaskHandle) xTaskNotifyGive(g_radioTaskHandle);
+
+  uint8_t lastState[MESH_OTA_MAX_TARGETS];
+  uint8_t lastPercent[MESH_OTA_MAX_TARGETS];
+  memset(lastState, 0xFF, sizeof(lastState));
+  memset(lastPercent, 0xFF, sizeof(lastPercent));
+  bool running = true;
+  while (running) {
+    uint32_t events = 0;
+    xTaskNotifyWait(0, UINT32_MAX, &events, pdMS_TO_TICKS(MESH_OTA_REPORT_MS));
+    if (events & OTA_WAKE_ERROR) otaNotify(OTA_EVT_ERROR, g_otaError);  // A START meanwhile
+    if (events & OTA_WAKE_INFO) otaSendInfo();
+
+    MeshOtaTarget t[MESH_OTA_MAX_TARGETS];
+    uint32_t received[MESH_OTA_MAX_TARGETS];
+    portENTER_CRITICAL(&g_meshOtaMux);
+    running = g_meshOtaTx.running();
+    for (uint8_t i = 0; i < count; i++) {
+      t[i] = g_meshOtaTx.target(i);
+      received[i] = g_meshOtaTx.received(i);
+    }
+    portEXIT_CRITICAL(&g_meshOtaMux);
+
+    for (uint8_t i = 0; i < count; i++) {
+      uint8_t percent = (uint8_t)((uint64_t)received[i] * 100 / imageSize);
+      if (t[i].state == lastState[i] && percent == lastPercent[i]) continue;
+      if (t[i].state != lastState[i] && t[i].state >= MESH_OTA_DONE) {
+        char mac[18];
+        formatMacKey(t[i].mac, mac);
+        Serial.printf("%s Mesh OTA %s: %s\n", t[i].state == MESH_OTA_DONE ? "✅" : "❌", mac,
+                      t[i].state == MESH_OTA_DONE ? "verified, restarting" : "failed");
+      }
+      lastState[i] = t[i].state;
+      lastPercent[i] = percent;
+      meshOtaNotify(i, count, t[i], received[i], imageSize);
+    }
+  }
+
+  portENTER_CRITICAL(&g_meshOtaMux);
+  uint8_t done = g_meshOtaTx.countIn(MESH_OTA_DONE);
+  uint32_t chunks = g_meshOtaTx.chunksSent();
+  uint32_t rounds = g_meshOtaTx.rounds();
+  uint16_t needed = g_meshOtaTx.layout().chunks();
+  portEXIT_CRITICAL(&g_meshOtaMux);
+  Serial.printf("📡 Mesh OTA: %u of %u slave(s) updated in %u ms | %u chunk frames for %u chunks, %u polls\n",
+                done, count, millis() - g_meshOtaStartMs, chunks, needed, rounds);
+}
+
+// Every byte is programmed: check the container's SHA-256, or the CRC from START
+// against flash, then let esp_ota_set_boot_partition() validate the image and
+// switch to it
+static void otaFinish() {
+  uint32_t total = g_otaStaging.total();
+  uint8_t error = OTA_OK;
+  if (g_otaContainer) {
+    error = otaVerifyImage();
+  } else if (g_otaCrc != 0) {
+    uint32_t crc = 0;
+    for (uint32_t off = 0; off < total; off += sizeof(g_otaBounce)) {
+      uint32_t n = total - off < sizeof(g_otaBounce) ? total - off : sizeof(g_otaBounce);
+      if (esp_partition_read(g_otaPartition, off, g_otaBounce, n) != ESP_OK) {
+        error = OTA_ERR_FLASH;
+        break;
+      }
+      crc = otaCrc32(crc, g_otaBounce, n);
+    }
+    if (error == OTA_OK && crc != g_otaCrc) error = OTA_ERR_CRC;
+  }
+  if (error == OTA_OK && esp_ota_set_boot_partition(g_otaPartition) != ESP_OK) error = OTA_ERR_IMAGE;
+  otaClearSession();
+
+  if (error != OTA_OK) {
+    Serial.printf("❌ OTA verify failed (error %u)\n", error);
+    otaNotify(OTA_EVT_ERROR, error);
+    otaStopped();
+    return;
+  }
+
+  uint32_t duration = millis() - g_otaStartMs;
+  uint32_t sent = total - g_otaResumedFrom;
+  Serial.printf("✅ OTA Complete! %u bytes in %u ms (%.1f KB/s) | flash busy %u ms | full stalls %u, rewinds %u\n",
+                (unsigned)sent, duration, duration ? sent / 1024.0 * 1000.0 / duration : 0.0,
+                g_otaFlashMs, g_otaFullStalls, g_otaRewinds);
+  if (g_otaContainer) {
+    Serial.printf("📦 OTA image %u bytes from %u sent, SHA-256 verified\n",
+                  (unsigned)g_otaHeader.imageSize, (unsigned)total);
+  }
+  if (g_otaRelay) otaRelayToSlaves(g_otaContainer ? g_otaHeader.imageSize : total);
+  otaNotify(OTA_EVT_DONE, OTA_OK);
+  Serial.println("🔄 Rebooting in 2 seconds...");
+  delay(2000);
+  ESP.restart();
+}
+
+// Writer task (slave): make room for an offered mesh update. The next status tells
+// the hub we are ready.
+static void meshOtaErase() {
+  portENTER_CRITICAL(&g_meshOtaMux);
+  bool preparing = g_meshOtaRx.state() == MESH_OTA_PREPARING;
+  uint16_t session = g_meshOtaRx.offer().session;
+  uint32_t size = g_meshOtaRx.offer().imageSize;
+  portEXIT_CRITICAL(&g_meshOtaMux);
+  if (!preparing) return;
+
+  uint32_t t0 = millis();
+  uint32_t eraseLen = (size + SPI_FLASH_SEC_SIZE - 1) & ~(uint32_t)(SPI_FLASH_SEC_SIZE - 1);
+  esp_err_t err = esp_partition_erase_range(g_meshOtaPartition, 0, eraseLen);
+  portENTER_CRITICAL(&g_meshOtaMux);
+  if (g_meshOtaRx.state() == MESH_OTA_PREPARING && g_meshOtaRx.offer().session == session) {
+    if (err == ESP_OK) g_meshOtaRx.setState(MESH_OTA_RECEIVING);
+    else g_meshOtaRx.setState(MESH_OTA_FAILED, OTA_ERR_FLASH);
+  }
+  portEXIT_CRITICAL(&g_meshOtaMux);
+  if (err != ESP_OK) {
+    Serial.printf("❌ Mesh OTA erase failed: %s\n", esp_err_to_name(err));
+  } else {
+    Serial.printf("📦 Mesh OTA: %u KB of %s erased in %u ms, receiving\n", (unsigned)(eraseLen / 1024),
+                  g_meshOtaPartition->label, millis() - t0);
+  }
+}
+
+// Writer task (slave): every chunk is written. The image counts when its SHA-256
+// is the offer's and esp_ota_set_boot_partition() takes it; the hub's polls are
+// answered a while longer, then we restart into it.
+static void meshOtaVerify() {
+  uint8_t expected[32];
+  portENTER_CRITICAL(&g_meshOtaMux);
+  bool verifying = g_meshOtaRx.state() == MESH_OTA_VERIFYING;
+  memcpy(expected, g_meshOtaRx.offer().sha256, sizeof(expected));
+  uint32_t size = g_meshOtaRx.offer().imageSize;
+  portEXIT_CRITICAL(&g_meshOtaMux);
+  if (!verifying) return;
+
+  uint8_t digest[32];
+  uint8_t error = OTA_OK;
+  if (esp_partition_get_sha256(g_meshOtaPartition, digest) != ESP_OK || memcmp(digest, expected, sizeof(digest)) != 0) {
+    error = OTA_ERR_DIGEST;
+  } else if (esp_ota_set_boot_partition(g_meshOtaPartition) != ESP_OK) {
+    error = OTA_ERR_IMAGE;
+  }
+  portENTER_CRITICAL(&g_meshOtaMux);
+  if (g_meshOtaRx.state() == MESH_OTA_VERIFYING) {
+    g_meshOtaRx.setState(error == OTA_OK ? MESH_OTA_DONE : MESH_OTA_FAILED, error);
+  }
+  portEXIT_CRITICAL(&g_meshOtaMux);
+
+  if (error != OTA_OK) {
+    Serial.printf("❌ Mesh OTA verify failed (error %u)\n", error);
+    return;
+  }
+  Serial.printf("✅ Mesh OTA complete! %u bytes in %u ms | %u chunks written, %u heard again\n",
+                (unsigned)size, millis() - g_meshOtaStartMs, g_meshOtaChunks, g_meshOtaDuplicates);
+  Serial.printf("🔄 Rebooting in %u seconds...\n", MESH_OTA_RESTART_MS / 1000);
+  vTaskDelay(pdMS_TO_TICKS(MESH_OTA_RESTART_MS));
+  ESP.restart();
+}
+
+// Writer task: the transfer START set up, resuming a container where it stopped
+static void otaReady() {
+  g_otaContainer = false;
+  if (g_otaResumedFrom > 0 && !otaResumeImage()) {
+    Serial.println("❌ OTA resume: image in flash couldn't be read back");
+    g_otaDiscard = true;
+    g_otaState = OTA_STOPPING;
+    otaNotify(OTA_EVT_ERROR, OTA_ERR_FLASH);
+    otaWake(OTA_WAKE_STOP);
+    return;
+  }
+  otaNotify(OTA_EVT_READY, OTA_OK);
+}
+
+// Writer task: a block was freed, so the original protocol's spilled writes move on
+// into staging, as far as they fit
+static void otaDrainSpill() {
+  for (;;) {
+    portENTER_CRITICAL(&g_otaMux);
+    uint32_t n = g_otaSpillLen < OTA_SPILL_STEP ? g_otaSpillLen : OTA_SPILL_STEP;
+    uint32_t taken = 0;
+    if (n > 0) g_otaStaging.accept(g_otaStaging.received(), g_otaSpill + g_otaSpillHead, n, taken);
+    g_otaSpillHead += taken;
+    g_otaSpillLen -= taken;
+    if (g_otaSpillLen == 0) g_otaSpillHead = 0;
+    portEXIT_CRITICAL(&g_otaMux);
+    if (taken < n || n == 0) return;
+  }
+}
+
+// Programs blocks as the OTA callback stages them, so erase and program time
+// overlaps the next block's transfer instead of holding up the BLE stack
+static void otaWriterTask(void* arg) {
+  for (;;) {
+    uint32_t events = 0;
+    xTaskNotifyWait(0, UINT32_MAX, &events, portMAX_DELAY);
+
+    if (events & OTA_WAKE_ERROR) otaNotify(OTA_EVT_ERROR, g_otaError);
+    if (events & OTA_WAKE_INFO) otaSendInfo();
+    if (events & OTA_WAKE_MESH_ERASE) meshOtaErase();
+    if (events & OTA_WAKE_MESH_VERIFY) meshOtaVerify();
+
+    OtaStaging::Block block;
+    while (g_otaStaging.next(block)) {
+      if (!g_otaDiscard) {
+        uint8_t error = otaWriteBlock(block);
+        if (error == OTA_OK) {
+          uint32_t committed = block.offset + block.length;
+          if (g_otaCrc != 0 && (committed % OTA_COMMIT_BYTES == 0 || committed == g_otaStaging.total())) {
+            otaCheckpoint(committed);
+          }
+          g_otaCommitted = committed;
+          if (committed % OTA_COMMIT_BYTES == 0) {
+            uint32_t elapsed = millis() - g_otaStartMs;
+            Serial.printf("📥 OTA Progress: %u%% (%u/%u bytes, %.1f KB/s)\n",
+                          (unsigned)((uint64_t)committed * 100 / g_otaStaging.total()),
+                          (unsigned)committed, (unsigned)g_otaStaging.total(),
+                          elapsed ? (committed - g_otaResumedFrom) / 1024.0 * 1000.0 / elapsed : 0.0);
+          }
+        } else if (g_otaState == OTA_RECEIVING || g_otaState == OTA_FINISHING) {
+          g_otaDiscard = true;
+          g_otaState = OTA_STOPPING;
+          otaNotify(OTA_EVT_ERROR, error);
+          events |= OTA_WAKE_STOP;
+          events &= ~OTA_WAKE_END;
+        }
+      }
+      g_otaStaging.release();
+      otaDrainSpill();
+      events |= OTA_WAKE_ACK;  // Room for the phone
+    }
+
+    if (g_otaState == OTA_RECEIVING) {
+      if (events & OTA_WAKE_REWIND) otaNotify(OTA_EVT_REWIND, OTA_OK);
+      else if (events & OTA_WAKE_ACK) otaNotify(OTA_EVT_ACK, OTA_OK);
+    }
+    if (events & OTA_WAKE_END) otaFinish();
+    if (events & OTA_WAKE_STOP) otaStopped();
+    if (events & OTA_WAKE_START) otaBegin();
+  }
+}
+
+// ============================================================
+// HISTORY DOWNLOAD CALLBACKS
+// ============================================================
+
+class HistoryCallbacks: public BLECharacteristicCallbacks {
+  void onWrite(BLECharacteristic* pCharacteristic) {
+    std::string rxValue = pCharacteristic->getValue();
+    if (rxValue.length() == 0) return;
+
+    const uint8_t* data = (const uint8_t*)rxValue.data();
+    size_t len = rxValue.length();
+
+    // Command packet:
+    // 0x01 = Download range: bootId (u16, 0 = any boot), fromTs (u32), toTs (u32), little-endian,
+    //        optionally resumeBoot (u16), resumeTs (u32): the last block the phone got whole
+    //        before a gap; the stream starts again with the block after it
+    // 0x02 = Cancel download
+    switch (data[0]) {
+      case 0x01: {
+        if (len < 11) {
+          Serial.println("❌ History request too short");
+          return;
+        }
+        uint16_t bootId = data[1] | (data[2] << 8);
+        uint32_t fromTs = (uint32_t)data[3] | ((uint32_t)data[4] << 8) |
+                          ((uint32_t)data[5] << 16) | ((uint32_t)data[6] << 24);
+        uint32_t toTs = (uint32_t)data[7] | ((uint32_t)data[8] << 8) |
+                        ((uint32_t)data[9] << 16) | ((uint32_t)data[10] << 24);
+        uint16_t resumeBoot = 0;
+        uint32_t resumeTs = 0;
+        if (len >= 17) {
+          resumeBoot = data[11] | (data[12] << 8);
+          resumeTs = (uint32_t)data[13] | ((uint32_t)data[14] << 8) |
+                     ((uint32_t)data[15] << 16) | ((uint32_t)data[16] << 24);
+        }
+        // Streaming happens from the loop, never inside the BLE callback
+        requestHistoryDownload(bootId, fromTs, toTs, resumeBoot, resumeTs);
+        break;
+      }
+
+      case 0x02:
+        cancelHistoryDownload();
+        break;
+
+      default:
+        Serial.printf("❌ Unknown history command: 0x%02X\n", data[0]);
+        break;
+    }
+  }
+};
+
+// ============================================================
+// SETUP
+// ============================================================
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+  
+  Serial.println("\n\n🚀 ========================================");
+  Serial.println("🚀 AirScale Firmware v4.0 (No WiFi Required)");
+  Serial.println("🚀 ========================================\n");
+
+  // PSRAM sanity check
+  if (psramFound()) {
+    Serial.printf("✅ PSRAM OK: %u bytes\n", ESP.getPsramSize());
+  } else {
+    Serial.println("❌ PSRAM NOT FOUND");
+  }
+
+  // OTA partition check - verify we have proper OTA layout
+  const esp_partition_t* running = esp_ota_get_running_partition();
+  const esp_partition_t* nextOta = esp_ota_get_next_update_partition(NULL);
+  if (running) {
+    Serial.printf("📦 Running partition: %s @0x%08X size=%uKB\n",
+                  running->label, (unsigned)running->address, (unsigned)(running->size / 1024));
+  }
+  if (nextOta) {
+    Serial.printf("📦 Next OTA partition: %s @0x%08X size=%uKB\n",
+                  nextOta->label, (unsigned)nextOta->address, (unsigned)(nextOta->size / 1024));
+  } else {
+    Serial.println("⚠️ No OTA partition available - OTA updates will fail!");
+  }
+
+  // *** CRITICAL: Initialize WiFi BEFORE getting MAC address ***
+  WiFi.mode(WIFI_STA);
+
+  // Now safe to initialize objects that may depend on system being ready
+  server = new AsyncWebServer(80);
+  pixel = new Adafruit_NeoPixel(1, WS2812B_PIN, NEO_GRB + NEO_KHZ800);
+
+  // Initialize LED
+  pixel->begin();
+  pixel->setBrightness(255); // was set to 50 on 3.3V but way too dim
+  setLEDStatus(LED_BOOTING);
+
+  delay(100);
+
+  // Get MAC address (WiFi must be in STA mode briefly for this)
+  deviceMAC = WiFi.macAddress();
+  apSSID = "AirScale-" + deviceMAC;
+  bleDeviceName = DEVICE_NAME_PREFIX + deviceMAC;
+  
+  Serial.println("📱 Device MAC: " + deviceMAC);
+  Serial.println("📱 BLE Name: " + bleDeviceName);
+  
+  // Initialize SPIFFS
+  if (!SPIFFS.begin(true)) {
+    Serial.println("⚠️ SPIFFS Mount Failed");
+  }
+  
+  // Initialize preferences and load saved coefficients for both channels
+  preferences.begin("airscale", false);
+
+  // Channel 1 coefficients
+  ch1Coeffs.intercept = preferences.getFloat("ch1_intercept", 0.0);
+  ch1Coeffs.airPressureCoeff = preferences.getFloat("ch1_air_coeff", 0.0);
+  ch1Coeffs.ambientPressureCoeff = preferences.getFloat("ch1_amb_coeff", 0.0);
+  ch1Coeffs.airTempCoeff = preferences.getFloat("ch1_temp_coeff", 0.0);
+
+  // Channel 2 coefficients
+  ch2Coeffs.intercept = preferences.getFloat("ch2_intercept", 0.0);
+  ch2Coeffs.airPressureCoeff = preferences.getFloat("ch2_air_coeff", 0.0);
+  ch2Coeffs.ambientPressureCoeff = preferences.getFloat("ch2_amb_coeff", 0.0);
+  ch2Coeffs.airTempCoeff = preferences.getFloat("ch2_temp_coeff", 0.0);
+
+  // Versions of the coefficients in effect, reported to the hub
+  g_appliedCoeffVersion[0] = preferences.getUInt("ch1_coeff_ver", 0);
+  g_appliedCoeffVersion[1] = preferences.getUInt("ch2_coeff_ver", 0);
+
+  Serial.printf("📊 CH1 coefficients: intercept=%.4f, air=%.4f, ambient=%.4f, temp=%.4f\n",
+               ch1Coeffs.intercept, ch1Coeffs.airPressureCoeff,
+               ch1Coeffs.ambientPressureCoeff, ch1Coeffs.airTempCoeff);
+  Serial.printf("📊 CH2 coefficients: intercept=%.4f, air=%.4f, ambient=%.4f, temp=%.4f\n",
+               ch2Coeffs.intercept, ch2Coeffs.airPressureCoeff,
+               ch2Coeffs.ambientPressureCoeff, ch2Coeffs.airTempCoeff);
   
   // Start as non-hub (will become hub when BLE connects)
   isHub = false;
@@ -576,6 +2108,9 @@ void setup() {
   // Setup web server
   setupWebServer();
 
+  // Device registry must exist before the first ESP-NOW frame arrives
+  initDeviceRegistry();
+
   // Initialize ESP-NOW with fixed channel
   initESPNow();
 
@@ -584,8 +2119,26 @@ void setup() {
   Wire.setPins(I2C_SDA, I2C_SCL);
   initBME280();
 
-  // Set initial LED status
+  // Sample history ring must exist before the acquisition task starts feeding it
+  initHistory();
+
+  // Scenario for the simulated sample stream (only used without ADC pins)
+  initScenario();
+
+  // Set initial LED status (rendered by the housekeeping task from here on)
   setLEDStatus(LED_STANDALONE);
+
+  // Running image's digest before the radio task announces it (a full read of the image)
+  otaBaseSha();
+
+  // Radio, BLE and housekeeping tasks first, so they are waiting on the first samples
+  startTasks();
+
+  // Frequency scaling + automatic light sleep while every task is blocked
+  initPowerManagement();
+
+  // Start continuous pressure acquisition (falls back to simulated samples without ADC pins)
+  initAdcAcquisition();
   
   Serial.println("\n✅ ========================================");
   Serial.println("✅ AirScale Ready!");
@@ -598,301 +2151,1890 @@ void setup() {
 // MAIN LOOP
 // ============================================================
 
+// Everything runs in its own task (see TASKS below) and HTTP is served from the
+// AsyncTCP task, so the Arduino loop task has nothing to do: it blocks for good
+// instead of waking every few ms to poll, which also leaves the CPU idle for DFS
+// and light sleep.
 void loop() {
-  if (server) server->handleClient();
-  updateLED();
+  ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+}
 
-  // During OTA, freeze all radio gymnastics (ESP-NOW, advertising toggles, etc.)
-  // This prevents interference with the firmware stream
-  if (otaInProgress) {
-    delay(2);
-    yield();  // Let BLE stack process incoming OTA packets
-    return;
+// ============================================================
+// TASKS
+// ============================================================
+
+static void recordLatency(LatencyStats& stats, int64_t us) {
+  portENTER_CRITICAL(&g_latencyMux);
+  stats.record(us);
+  portEXIT_CRITICAL(&g_latencyMux);
+}
+
+static LatencyStats readLatency(const LatencyStats& stats) {
+  portENTER_CRITICAL(&g_latencyMux);
+  LatencyStats copy = stats;
+  portEXIT_CRITICAL(&g_latencyMux);
+  return copy;
+}
+
+// Ticks left until 'last + interval', 0 if already due
+static TickType_t ticksUntil(TickType_t last, uint32_t intervalMs) {
+  TickType_t elapsed = xTaskGetTickCount() - last;
+  TickType_t interval = pdMS_TO_TICKS(intervalMs);
+  return elapsed >= interval ? 0 : interval - elapsed;
+}
+
+// Mesh time for a local esp_timer reading: the hub's own clock, a slave's fitted
+// estimate of the hub's, or false while a slave isn't synced
+static bool meshTime(int64_t localUs, int64_t& meshUs) {
+  if (isHub) {
+    meshUs = localUs;
+    return true;
   }
+  int64_t now = esp_timer_get_time();
+  portENTER_CRITICAL(&g_timeSyncMux);
+  bool synced = g_timeSync.synced(now);
+  if (synced) meshUs = g_timeSync.toMaster(localUs);
+  portEXIT_CRITICAL(&g_timeSyncMux);
+  return synced;
+}
 
-  // Status debug output every 30 seconds
-  static unsigned long lastDebugPrint = 0;
-  if (millis() - lastDebugPrint > 30000) {
-    uint8_t currentChannel;
-    wifi_second_chan_t dummy;
-    esp_wifi_get_channel(&currentChannel, &dummy);
-    
-    Serial.printf("\n📊 STATUS: %s | Ch:%d | RAM:%d | Devices:%d | BLE:%s | BME280:%s\n", 
-                 isHub ? "HUB" : "DEVICE", 
-                 currentChannel, 
-                 ESP.getFreeHeap(), 
-                 deviceCount,
-                 deviceConnected ? "Connected" : "Waiting",
-                 bmeInitialized ? "OK" : "FAIL");
-    
-    if (deviceCount > 0) {
-      Serial.println("📡 Known devices:");
-      for (int i = 0; i < deviceCount; i++) {
-        if (knownDevices[i].isActive) {
-          unsigned long age = millis() - knownDevices[i].lastSeen;
-          Serial.printf("   %d: %s | CH1=%.1f | CH2=%.1f | Total=%.1f lbs | RSSI=%d dBm | %lu ms ago\n",
-                       i, knownDevices[i].macAddress,
-                       knownDevices[i].lastData.ch1Weight,
-                       knownDevices[i].lastData.ch2Weight,
-                       knownDevices[i].lastData.totalWeight,
-                       knownDevices[i].espNowRssi,
-                       age);
-        }
+// Next broadcast after one at lastUs (local). On mesh time every node broadcasts on
+// the same grid of multiples of the interval, so the newest samples of the whole
+// fleet are taken within a few ms of each other; unsynced nodes just keep the interval.
+static int64_t broadcastDueUs(int64_t lastUs, uint32_t intervalMs) {
+  int64_t intervalUs = (int64_t)intervalMs * 1000;
+  int64_t mesh;
+  if (!meshTime(lastUs, mesh) || mesh < 0) return lastUs + intervalUs;
+  int64_t toGrid = intervalUs - mesh % intervalUs;
+  if (toGrid < intervalUs / 2) toGrid += intervalUs;  // Realigning never doubles up a broadcast
+  return lastUs + toGrid;
+}
+
+// A slave currently following a hub's beacons
+static bool meshSynced() {
+  int64_t mesh;
+  return !isHub && meshTime(esp_timer_get_time(), mesh);
+}
+
+// Any task: the airtime plan in force and localUs on its clock. Off the mesh clock
+// a node runs the plan alone on its own clock, in the hub slot; false then.
+static bool airtimePlan(int64_t localUs, AirtimePlan& plan, int64_t& planUs) {
+  if (!meshTime(localUs, planUs)) {
+    planUs = localUs;
+    plan.assignHub(0);
+    return false;
+  }
+  portENTER_CRITICAL(&g_airtimeMux);
+  plan = g_airtime;
+  portEXIT_CRITICAL(&g_airtimeMux);
+  if (isHub && plan.slot() != AIRTIME_HUB_SLOT) plan.assignHub(0);  // Hub before its first beacon
+  return true;
+}
+
+// Local time a frame of airUs due at dueUs can go out: in our slot, no sooner than
+// either due or now
+static int64_t slotTxAt(const AirtimePlan& plan, int64_t nowUs, int64_t planNowUs, int64_t dueUs, uint32_t airUs) {
+  int64_t at = dueUs > nowUs ? dueUs : nowUs;
+  int64_t planAt = planNowUs + (at - nowUs);
+  return at + (plan.txAt(planAt, airUs) - planAt);
+}
+
+// Radio task: favor Wi-Fi through the ESP-NOW part of the superframe, so slot
+// traffic is heard, and Bluetooth through the BLE window
+static void applyCoexPhase(AirtimePhase phase) {
+  static int current = -1;
+  if (!bleEnabled || phase == current) return;
+  current = phase;
+  if (esp_coex_preference_set(phase == AIRTIME_ESPNOW ? ESP_COEX_PREFER_WIFI : ESP_COEX_PREFER_BT) == ESP_OK) {
+    g_coexSwitches++;
+  } else {
+    g_coexErrors++;
+  }
+}
+
+// Radio task: choose our way to the hub from what the neighbors advertise. The hub
+// routes to itself, with nothing to pay.
+static MeshRoute meshRoute() {
+  MacKey self = macKeyFromString(deviceMAC.c_str());
+  uint32_t now = millis();
+  portENTER_CRITICAL(&g_relayMux);
+  MeshRoute route = {self, self, 0, 0.0f};
+  if (!isHub) route = g_neighbors.route(self, now);
+  g_meshRoute = route;
+  portEXIT_CRITICAL(&g_relayMux);
+  return route;
+}
+
+// The route the radio task chose last, safe from any task
+static MeshRoute lastMeshRoute() {
+  portENTER_CRITICAL(&g_relayMux);
+  MeshRoute route = g_meshRoute;
+  portEXIT_CRITICAL(&g_relayMux);
+  return route;
+}
+
+// Next hop toward dest: our parent for the hub, else the neighbor dest's relayed
+// frames came in through, else dest itself
+static MacKey meshNextHop(MacKey dest) {
+  uint32_t now = millis();
+  portENTER_CRITICAL(&g_relayMux);
+  MacKey next = dest == g_meshRoute.hub && g_meshRoute.parent ? g_meshRoute.parent : g_routes.nextHop(dest, now);
+  portEXIT_CRITICAL(&g_relayMux);
+  return next ? next : dest;
+}
+
+bool queueRadioCommand(const RadioCommand& cmd) {
+  if (!g_radioCommands.push(cmd)) {
+    g_radioCommandDrops++;
+    return false;
+  }
+  if (g_radioTaskHandle) xTaskNotifyGive(g_radioTaskHandle);
+  return true;
+}
+
+static void pushSampleHistory(SampleHistory& history, const SensorSnapshot& snap) {
+  history.samples[history.head] = snap;
+  history.head = (uint8_t)((history.head + 1) % WEIGH_SAMPLE_HISTORY);
+  if (history.count < WEIGH_SAMPLE_HISTORY) history.count++;
+}
+
+// Weights at local time atUs, interpolated between the samples either side of it.
+// False while no sample at or after it is in yet.
+static bool sampleHistoryAt(const SampleHistory& history, int64_t atUs, WeighReply& out) {
+  const SensorSnapshot* before = nullptr;
+  const SensorSnapshot* after = nullptr;
+  for (uint8_t i = 0; i < history.count; i++) {  // Oldest first
+    const SensorSnapshot& s =
+        history.samples[(history.head + WEIGH_SAMPLE_HISTORY - history.count + i) % WEIGH_SAMPLE_HISTORY];
+    if (s.sampledUs <= atUs) before = &s;
+    else if (!after) after = &s;
+  }
+  if (!after) return false;
+
+  out.flags = 0;
+  if (!before) {
+    before = after;  // Instant older than the history
+    out.flags |= WEIGH_REPLY_STALE;
+  }
+  int64_t span = after->sampledUs - before->sampledUs;
+  if (span > WEIGH_MAX_GAP_MS * 1000LL) out.flags |= WEIGH_REPLY_STALE;
+  float f = span > 0 ? (float)(atUs - before->sampledUs) / (float)span : 0.0f;
+  out.ch1Weight = before->ch1Weight + f * (after->ch1Weight - before->ch1Weight);
+  out.ch2Weight = before->ch2Weight + f * (after->ch2Weight - before->ch2Weight);
+  out.ch1WeightStdDev = before->ch1WeightStdDev + f * (after->ch1WeightStdDev - before->ch1WeightStdDev);
+  out.ch2WeightStdDev = before->ch2WeightStdDev + f * (after->ch2WeightStdDev - before->ch2WeightStdDev);
+  out.flags |= (f < 0.5f ? before : after)->settledFlags & (SETTLED_CH1 | SETTLED_CH2);
+  return true;
+}
+
+// Next time the weigh-now job needs the radio task
+static int64_t weighDueUs(const WeighJob& job) {
+  switch (job.state) {
+    case WEIGH_SAMPLING:   return job.sampleAtUs + WEIGH_CAPTURE_MS * 1000LL;
+    case WEIGH_REPLYING:   return job.replyAtUs;
+    case WEIGH_COLLECTING: return job.deadlineUs;
+    default:               return INT64_MAX;
+  }
+}
+
+// Radio task: when the next broadcast is due. While a hub listens, a pending change
+// goes out once the fast floor since the last broadcast has passed, else the next
+// heartbeat comes on the mesh grid; with no hub around, only the slow heartbeat.
+static int64_t broadcastDueAt(const BroadcastScheduler& policy, BroadcastReason reason, bool listening,
+                              int64_t lastUs) {
+  if (!listening) return broadcastDueUs(lastUs, BROADCAST_STANDALONE_MS);
+  int64_t heartbeatAt = broadcastDueUs(lastUs, policy.heartbeatUs() / 1000);
+  if (reason == BROADCAST_NONE) return heartbeatAt;
+  int64_t fastAt = lastUs + policy.fastUs();
+  return fastAt < heartbeatAt ? fastAt : heartbeatAt;
+}
+
+// Radio task: the only caller of esp_now_send(). Wakes on every snapshot, on
+// queued commands and at airtime phase changes. Beacons, reports, relay forwards,
+// coefficient frames and the weigh-now trigger go out in our airtime slot; weigh
+// replies have slots of their own in the round.
+static void radioTask(void* arg) {
+  SensorSnapshot latest;
+  bool haveSample = false;
+  int64_t lastBroadcastUs = esp_timer_get_time();
+  int64_t lastBeaconUs = 0;
+  int64_t lastLoopUs = lastBroadcastUs;
+  int64_t jitterUs = 0;
+  static SampleHistory history;
+  static RadioCommand held[RELAY_POOL_BUFFERS];  // Relay forwards waiting for our slot
+  uint8_t heldCount = 0;
+  static RadioCommand heldAcks[COEFF_ACK_HOLD];  // Slave: coefficient acks waiting for our slot
+  uint8_t heldAckCount = 0;
+  WeighJob weigh = {};
+  bool weighPending = false;                    // Hub: weigh-now trigger waiting for our slot
+  uint8_t weighPendingId = 0;
+  int64_t meshOtaReplyAt = INT64_MAX;           // Slave: our status slot in the hub's mesh update
+  BroadcastPolicyConfig policyConfig = {{BROADCAST_DEADBAND_LBS, BROADCAST_DEADBAND_LBS}, BROADCAST_RATE_LBS_S,
+                                        BROADCAST_RATE_WINDOW_MS * 1000, BROADCAST_FAST_MS * 1000,
+                                        BROADCAST_HEARTBEAT_MIN_MS * 1000, BROADCAST_HEARTBEAT_MAX_MS * 1000};
+  BroadcastScheduler policy(policyConfig);
+  AirtimePlan plan(g_airtimeConfig);
+  const uint32_t reportAirUs = espnowAirUs(ESPNOW_FRAME_MAX);
+  const uint32_t beaconAirUs = espnowAirUs(ESPNOW_FRAME_HEADER_SIZE + TIME_SYNC_FIXED_SIZE + 2 + 2 * AIRTIME_MAX_SLOTS);
+  const uint32_t triggerAirUs = WEIGH_TRIGGER_COPIES * reportAirUs;
+  const uint32_t coeffsAirUs = espnowAirUs(ESPNOW_FRAME_HEADER_SIZE + COEFFS_FIXED_SIZE);
+  const uint32_t ackAirUs = espnowAirUs(ESPNOW_FRAME_HEADER_SIZE + COEFFS_ACK_FIXED_SIZE);
+
+  for (;;) {
+    // Someone listens when we are the hub, or follow a hub's beacons or relay route
+    bool beaconing = isHub && deviceConnected;
+    bool routed = !isHub && lastMeshRoute().hub != 0;
+    bool listening = beaconing || meshSynced() || routed;
+    int64_t now = esp_timer_get_time();
+    int64_t planNow;
+    airtimePlan(now, plan, planNow);
+    uint32_t fixedMs = listening ? BROADCAST_INTERVAL_MS : BROADCAST_STANDALONE_MS;
+    g_broadcastFixedMicro += (uint64_t)(now - lastLoopUs) * 1000 / fixedMs;
+    lastLoopUs = now;
+    int64_t broadcastAt = broadcastDueAt(policy, listening ? policy.pending() : BROADCAST_NONE, listening,
+                                         lastBroadcastUs) + jitterUs;
+    int64_t wakeAt = slotTxAt(plan, now, planNow, broadcastAt, reportAirUs);
+    int64_t beaconAt = slotTxAt(plan, now, planNow, lastBeaconUs + TIME_SYNC_INTERVAL_MS * 1000LL, beaconAirUs);
+    if (beaconing && beaconAt < wakeAt) wakeAt = beaconAt;
+    if (heldCount > 0) {
+      int64_t relayAt = slotTxAt(plan, now, planNow, now, espnowAirUs(held[0].relayLen));
+      if (relayAt < wakeAt) wakeAt = relayAt;
+    }
+    int64_t phaseAt = now + (plan.nextPhaseChange(planNow) - planNow);
+    if (bleEnabled && phaseAt < wakeAt) wakeAt = phaseAt;
+    int64_t retryAt = g_coeffDeliveries.nextDeadline(now);
+    if (retryAt != INT64_MAX) retryAt = slotTxAt(plan, now, planNow, retryAt, coeffsAirUs);
+    if (retryAt < wakeAt) wakeAt = retryAt;
+    if (heldAckCount > 0) {
+      int64_t ackAt = slotTxAt(plan, now, planNow, now, ackAirUs);
+      if (ackAt < wakeAt) wakeAt = ackAt;
+    }
+    if (weighPending) {
+      int64_t triggerAt = slotTxAt(plan, now, planNow, now, triggerAirUs);
+      if (triggerAt < wakeAt) wakeAt = triggerAt;
+    }
+    int64_t weighAt = weighDueUs(weigh);
+    if (weighAt < wakeAt) wakeAt = weighAt;
+    portENTER_CRITICAL(&g_meshOtaMux);
+    int64_t pushAt = g_meshOtaTx.dueUs();
+    portEXIT_CRITICAL(&g_meshOtaMux);
+    if (pushAt < wakeAt) wakeAt = pushAt;
+    if (meshOtaReplyAt < wakeAt) wakeAt = meshOtaReplyAt;
+    ulTaskNotifyTake(pdTRUE, wakeAt <= now ? 0 : pdMS_TO_TICKS((wakeAt - now) / 1000) + 1);
+
+    SensorSnapshot snap;
+    while (g_radioSnapshots.pop(snap)) {
+      latest = snap;
+      haveSample = true;
+      pushSampleHistory(history, snap);
+      policy.sample(snap.ch1Weight, snap.ch2Weight, snap.sampledUs);
+    }
+
+    // ESP-NOW is torn down for the duration of an OTA
+    if (otaInProgress) continue;
+
+    now = esp_timer_get_time();
+    bool slotted = airtimePlan(now, plan, planNow);
+    applyCoexPhase(plan.phase(planNow));
+
+    RadioCommand cmd;
+    while (g_radioCommands.pop(cmd)) {
+      switch (cmd.type) {
+        case RADIO_CMD_SEND_COEFFS:
+          queueCoeffsDelivery(cmd);
+          break;
+        case RADIO_CMD_COEFFS_ACKED:
+          completeCoeffsDelivery(cmd);
+          break;
+        case RADIO_CMD_SEND_COEFFS_ACK:
+          if (heldAckCount < COEFF_ACK_HOLD) {
+            heldAcks[heldAckCount++] = cmd;
+          } else {
+            sendCoeffsAck(cmd);
+          }
+          break;
+        case RADIO_CMD_SEND_COEFF_BATCH:
+          queueCoeffBatch();
+          break;
+        case RADIO_CMD_WEIGH_TRIGGER:
+          // Goes out in our slot; the sample instant is set at the send, so the
+          // lead is kept. A newer request replaces one still waiting.
+          weighPending = true;
+          weighPendingId = cmd.weighId;
+          break;
+        case RADIO_CMD_WEIGH_REPLY:
+          // A newer trigger replaces a round still pending
+          weigh = {};
+          weigh.state = WEIGH_SAMPLING;
+          weigh.id = cmd.weighId;
+          weigh.flags = cmd.status;
+          macKeyToBytes(macKeyFromString(cmd.targetMac), weigh.hubMac);
+          weigh.sampleAtUs = cmd.sampleAtUs;
+          weigh.replyAtUs = cmd.replyAtUs;
+          break;
+        case RADIO_CMD_RELAY:
+          if (heldCount < RELAY_POOL_BUFFERS) {
+            held[heldCount++] = cmd;
+            g_airtimeHeld++;
+          } else {
+            forwardRelayFrame(cmd);
+            g_airtimeOffSlot++;
+          }
+          break;
+        case RADIO_CMD_MESH_OTA_STATUS:
+          meshOtaReplyAt = cmd.replyAtUs;  // A later offer or poll moves our answer to its slot
+          break;
       }
     }
-    
-    lastDebugPrint = millis();
+    serviceCoeffDeliveries(plan, now, planNow);
+    serviceWeighJob(weigh, history);
+    serviceMeshOta(meshOtaReplyAt);
+
+    // Scheduled traffic, each frame only where it still fits our slot
+    if (weighPending) {
+      int64_t t = esp_timer_get_time();
+      if (slotTxAt(plan, now, planNow, t, triggerAirUs) <= t) {
+        weighPending = false;
+        startWeighRound(weigh, weighPendingId);
+      }
+    }
+
+    while (heldAckCount > 0) {
+      int64_t t = esp_timer_get_time();
+      if (slotTxAt(plan, now, planNow, t, ackAirUs) > t) break;
+      sendCoeffsAck(heldAcks[0]);
+      memmove(&heldAcks[0], &heldAcks[1], --heldAckCount * sizeof(heldAcks[0]));
+    }
+
+    while (heldCount > 0) {
+      int64_t t = esp_timer_get_time();
+      if (slotTxAt(plan, now, planNow, t, espnowAirUs(held[0].relayLen)) > t) break;
+      forwardRelayFrame(held[0]);
+      memmove(&held[0], &held[1], --heldCount * sizeof(held[0]));
+    }
+
+    int64_t t = esp_timer_get_time();
+    if (beaconing && t - lastBeaconUs >= TIME_SYNC_INTERVAL_MS * 1000LL &&
+        slotTxAt(plan, now, planNow, t, beaconAirUs) <= t) {
+      sendTimeSyncBeacon();
+      lastBeaconUs = esp_timer_get_time();
+    }
+
+    // ALL devices broadcast their sensor data via ESP-NOW, except while a mesh
+    // update comes in: the air is the hub's then
+    if (haveSample && meshOtaReceiving()) {
+      lastBroadcastUs = esp_timer_get_time();
+    } else if (haveSample) {
+      BroadcastReason reason = listening ? policy.pending() : BROADCAST_NONE;
+      int64_t dueAt = broadcastDueAt(policy, reason, listening, lastBroadcastUs) + jitterUs;
+      t = esp_timer_get_time();
+      if (t >= dueAt && slotTxAt(plan, now, planNow, t, reportAirUs) <= t) {
+        if (reason == BROADCAST_NONE) reason = BROADCAST_HEARTBEAT;
+        flashLED();
+        broadcastMyData(latest, reason, listening);
+        policy.sent(reason);
+        g_broadcastsBy[reason]++;
+        g_broadcastHeartbeatMs = policy.heartbeatUs() / 1000;
+        lastBroadcastUs = esp_timer_get_time();
+        // On the mesh clock the slot keeps us apart; on our own, only jitter does
+        jitterUs = slotted ? 0 : esp_random() % (BROADCAST_JITTER_MS * 1000);
+      }
+      g_broadcastRate = policy.rate();
+    }
   }
-  
-  // BLE advertising watchdog - keep device discoverable when not connected
-  // This compensates for WiFi/ESP-NOW coexistence suppressing BLE advertising
-  // Relaxed to 20s since discovery window already restarts advertising every 6s
-  static unsigned long lastAdvCheck = 0;
-  if (bleEnabled && !deviceConnected && millis() - lastAdvCheck > 20000) {
+}
+
+static PublishConfig readPublishConfig() {
+  portENTER_CRITICAL(&g_publishConfigMux);
+  PublishConfig config = g_publishConfig;
+  portEXIT_CRITICAL(&g_publishConfigMux);
+  return config;
+}
+
+// BLE task: did the hub or any device move past its deadband since it was last
+// notified? Devices are only scanned after the worker stored a new report.
+static bool fleetChanged(const SensorSnapshot& snap, const PublishConfig& config) {
+  if (g_notifyTracker.changed(MAX_DEVICES, macKeyFromString(deviceMAC.c_str()),
+                              snap.ch1Weight, snap.ch2Weight, config)) {
+    return true;
+  }
+  if (!g_fleetDirty.exchange(false)) return false;
+
+  int slots = deviceSlotsInUse();
+  for (int i = 0; i < slots; i++) {
+    DeviceData device;
+    if (readDevice(i, device) && device.isActive &&
+        g_notifyTracker.changed(i, device.macKey, device.lastData.ch1Weight, device.lastData.ch2Weight, config)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// BLE task: per-record status of the current calibration batch, split over as
+// many notifications as the MTU needs (all 32 records in one at 247, 3 per one at 23)
+static void sendCoeffBatchStatus() {
+  static CoeffBatch batch;
+  portENTER_CRITICAL(&g_coeffBatchMux);
+  batch = g_coeffBatch;
+  portEXIT_CRITICAL(&g_coeffBatchMux);
+  if (!pCoeffBatchCharacteristic) return;
+
+  uint8_t status[COEFF_BATCH_STATUS_HEADER_SIZE + COEFF_BATCH_MAX * COEFF_BATCH_STATUS_SIZE];
+  uint16_t mtu = pServer->getPeerMTU(pServer->getConnId());
+  size_t cap = (mtu > 23 ? mtu : 23) - 3;
+  if (cap > sizeof(status)) cap = sizeof(status);
+  uint8_t next = 0;
+  do {
+    size_t len = batch.encodeStatus(status, cap, next);
+    if (len == 0 || !notifyAndWait(pCoeffBatchCharacteristic, status, len)) {
+      Serial.printf("❌ Coefficient batch #%u status not delivered (MTU %u)\n", batch.id, mtu);
+      return;
+    }
+  } while (next < batch.count);
+}
+
+// BLE task (hub): wait out the ESP-NOW part of the superframe, so a fleet frame goes
+// out in the BLE window carrying every report from the slots just before it
+static void holdForBleWindow() {
+  AirtimePlan plan(g_airtimeConfig);
+  int64_t planNow;
+  airtimePlan(esp_timer_get_time(), plan, planNow);
+  if (plan.phase(planNow) != AIRTIME_ESPNOW) return;
+  int64_t waitUs = plan.nextPhaseChange(planNow) - planNow;
+  vTaskDelay(pdMS_TO_TICKS(waitUs / 1000) + 1);
+  g_bleWindowHolds++;
+}
+
+// BLE task: hub notifications to the phone and history streaming. Wakes on every
+// sample, device report and policy write; notifies when something crossed its
+// deadband (no sooner than the policy's minimum interval), otherwise heartbeats.
+static void bleTask(void* arg) {
+  SensorSnapshot latest;
+  bool haveSample = false;
+  TickType_t lastSend = xTaskGetTickCount();
+
+  for (;;) {
+    PublishConfig config = readPublishConfig();
+    ulTaskNotifyTake(pdTRUE, ticksUntil(lastSend, config.maxIntervalMs));
+
+    SensorSnapshot snap;
+    while (g_bleSnapshots.pop(snap)) {
+      latest = snap;
+      haveSample = true;
+    }
+
+    serviceHistoryDownload();
+
+    uint32_t rejected = g_publishRejected.exchange(0);
+    if (rejected) Serial.printf("❌ Publish config rejected (%u writes)\n", rejected);
+    if (otaInProgress) continue;
+
+    if (!(isHub && deviceConnected)) {
+      lastSend = xTaskGetTickCount();  // Start a fresh schedule on the next connection
+      continue;
+    }
+    if (g_coeffBatchStatusDirty.exchange(false)) sendCoeffBatchStatus();
+    if (g_weighResultDirty.exchange(false)) sendWeighResult();
+    if (!haveSample) continue;
+
+    config = readPublishConfig();
+    bool resync = g_publishResync.exchange(false);
+    if (resync) g_notifyTracker.reset();
+    if (resync && g_publishPolicyWritten.exchange(false)) {
+      Serial.printf("🎚️ Publish policy: %u..%u ms, deadband CH1 %.1f / CH2 %.1f lbs, coherence %u ms\n",
+                   config.minIntervalMs, config.maxIntervalMs, config.deadband[0], config.deadband[1],
+                   config.coherenceMs);
+    }
+    bool heartbeat = resync || ticksUntil(lastSend, config.maxIntervalMs) == 0;
+    bool changed = !heartbeat && ticksUntil(lastSend, config.minIntervalMs) == 0 && fleetChanged(latest, config);
+
+    if (heartbeat || changed) {
+      if (heartbeat && !resync) {
+        // How late this heartbeat is against its schedule
+        TickType_t late = xTaskGetTickCount() - lastSend - pdMS_TO_TICKS(config.maxIntervalMs);
+        recordLatency(g_notifyLateness, (int64_t)late * portTICK_PERIOD_MS * 1000);
+      }
+      if (heartbeat) g_publishHeartbeats++;
+      else g_publishOnChange++;
+      holdForBleWindow();
+      flashLED();
+      sendAllDataViaBLE(latest, heartbeat);
+      lastSend = xTaskGetTickCount();
+    }
+  }
+}
+
+// ------------------------------------------------------------
+// Housekeeping: deadline-scheduled jobs
+// ------------------------------------------------------------
+// LED animation, BME280 sampling, history log, status output, mesh timeout and
+// device cleanup. Each is a job in g_scheduler with its own deadline;
+// the task sleeps until the earliest one (or an HK_EVENT_* from another task) and
+// runs whatever is due, so the core is idle rather than polling between events.
+// Nothing here is latency-critical.
+
+static int g_ledJob = -1;
+static int g_meshJob = -1;
+
+void signalHousekeeping(uint32_t events) {
+  if (g_housekeepingTaskHandle) xTaskNotify(g_housekeepingTaskHandle, events, eSetBits);
+}
+
+// Whole ticks covering 'us', so a timed wait never ends before the deadline
+static TickType_t ticksForUs(int64_t us) {
+  const int64_t tickUs = (int64_t)portTICK_PERIOD_MS * 1000;
+  int64_t ticks = (us + tickUs - 1) / tickUs;
+  return ticks >= (int64_t)portMAX_DELAY ? portMAX_DELAY - 1 : (TickType_t)ticks;
+}
+
+// Mean frame loss over the devices heard directly: what collisions and fading
+// cost the slots, from the receive side
+static float directFrameLoss() {
+  float sum = 0.0f;
+  int links = 0;
+  int slots = deviceSlotsInUse();
+  for (int i = 0; i < slots; i++) {
+    DeviceData device;
+    if (readDevice(i, device) && device.isActive && device.hops == 0 && device.link.haveSeq) {
+      sum += device.link.loss;
+      links++;
+    }
+  }
+  return links > 0 ? sum / links : 0.0f;
+}
+
+static void printStatus() {
+  uint8_t currentChannel;
+  wifi_second_chan_t dummy;
+  esp_wifi_get_channel(&currentChannel, &dummy);
+
+  Serial.printf("\n📊 STATUS: %s | Ch:%d | RAM:%d | Devices:%d | BLE:%s | BME280:%s\n", 
+               isHub ? "HUB" : "DEVICE", 
+               currentChannel, 
+               ESP.getFreeHeap(), 
+               deviceCount.load(),
+               deviceConnected ? "Connected" : "Waiting",
+               bmeInitialized ? "OK" : "FAIL");
+  Serial.printf("🎚️ ADC: %s | CH1=%.2f psi | CH2=%.2f psi | raw=%u/%u | out=%u/%u | overruns=%u\n",
+               g_adcHardware ? "DMA" : "SIM",
+               getChannelPressure(1), getChannelPressure(2),
+               g_adcStats[0].rawSamples, g_adcStats[1].rawSamples,
+               g_adcStats[0].decimatedSamples, g_adcStats[1].decimatedSamples,
+               g_adcOverruns);
+  if (!g_adcHardware) {
+    Serial.printf("🎬 SCENARIO: %s @ %.1fx | t=%.1f s\n",
+                 g_scenarioName, g_scenarioSpeed, g_scenarioSeconds.load(std::memory_order_relaxed));
+  }
+  ChannelEstimate est1 = getChannelEstimate(1);
+  ChannelEstimate est2 = getChannelEstimate(2);
+  Serial.printf("⚖️ EST: CH1=%.1f±%.1f lbs%s | CH2=%.1f±%.1f lbs%s\n",
+               est1.weight, est1.stdDev, est1.settled ? " (settled)" : "",
+               est2.weight, est2.stdDev, est2.settled ? " (settled)" : "");
+  EnvSample env = getEnvironment();
+  Serial.printf("🌡️ ENV: %.1f°F | %.2f PSI | age=%lu ms | I2C transactions=%u | errors=%u\n",
+               env.temperature, env.atmosphericPressure,
+               millis() - env.timestamp, g_envI2cTransactions, g_envReadErrors);
+  LatencyStats notify = readLatency(g_notifyLatency);
+  LatencyStats late = readLatency(g_notifyLateness);
+  LatencyStats bcast = readLatency(g_broadcastLatency);
+  Serial.printf("🧵 LATENCY: sample->notify %.1f±%.1f ms (p99<%.0f, max %.1f, n=%u) | notify late %.1f±%.1f ms | sample->broadcast %.1f±%.1f ms | drops=%u/%u\n",
+               notify.mean / 1000.0, notify.stdDev() / 1000.0, notify.percentile(0.99) / 1000.0,
+               notify.maxUs / 1000.0, notify.count,
+               late.mean / 1000.0, late.stdDev() / 1000.0,
+               bcast.mean / 1000.0, bcast.stdDev() / 1000.0,
+               g_snapshotDrops, g_radioCommandDrops);
+  LatencyStats refresh = readLatency(g_fleetRefreshTime);
+  Serial.printf("📲 BLE FLEET: on change=%u heartbeats=%u | frames=%u | stalls=%u | refresh %.1f±%.1f ms (max %.1f, n=%u)\n",
+               g_publishOnChange, g_publishHeartbeats, g_fleetFramesSent, g_bleNotifyStalls,
+               refresh.mean / 1000.0, refresh.stdDev() / 1000.0, refresh.maxUs / 1000.0, refresh.count);
+  if (isHub) {
+    LatencyStats skew = readLatency(g_fleetSkew);
+    Serial.printf("⏲️ MESH TIME: master | beacons sent=%u | fleet total %u in window (%u unaligned), %u out | sample skew %.1f ms (max %.1f)\n",
+                 g_timeSyncBeaconsSent, g_fleetInTotal, g_fleetUnaligned, g_fleetOutOfWindow, skew.mean / 1000.0,
+                 skew.maxUs / 1000.0);
+  } else {
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&g_timeSyncMux);
+    bool synced = g_timeSync.synced(now);
+    MacKey master = g_timeSync.master();
+    int64_t offset = g_timeSync.offsetAt(now);
+    float drift = g_timeSync.driftPpm();
+    uint32_t jitter = g_timeSync.jitterUs();
+    int64_t lastBeacon = g_timeSync.lastBeaconUs();
+    uint32_t beacons = g_timeSync.beacons();
+    uint32_t outliers = g_timeSync.outliers();
+    uint32_t restarts = g_timeSync.restarts();
+    portEXIT_CRITICAL(&g_timeSyncMux);
+    char masterMac[18] = "none";
+    if (master) formatMacKey(master, masterMac);
+    Serial.printf("⏲️ MESH TIME: %s hub %s | offset %lld us, drift %.2f ppm, fit jitter %u us | last beacon %lld ms ago | beacons=%u outliers=%u restarts=%u\n",
+                 synced ? "synced to" : "NOT synced,", masterMac, (long long)offset, drift, jitter,
+                 (long long)(lastBeacon ? (now - lastBeacon) / 1000 : -1), beacons, outliers, restarts);
+  }
+  Serial.printf("📨 DEFERRED: processed=%u | drops=%u | pool peak %u/%u\n",
+               g_deferredProcessed, g_deferredDrops.load(), g_deferredPool.peakInUse(), g_deferredPool.count());
+  Serial.printf("📶 ESP-NOW: rx compact=%u legacy=%u rejected=%u lost=%u | tx %u bytes%s\n",
+               g_framesCompactRx, g_framesLegacyRx, g_framesRejected, g_framesLost,
+               g_espnowTxBytes, legacyPeersPresent() ? " | legacy peers present" : "");
+  {
+    uint32_t sent = g_broadcastsBy[BROADCAST_CHANGE] + g_broadcastsBy[BROADCAST_LOADING] + g_broadcastsBy[BROADCAST_HEARTBEAT];
+    double fixed = g_broadcastFixedMicro / 1e6;
+    Serial.printf("📡 BROADCASTS: change=%u loading=%u heartbeat=%u | fixed interval: %.0f, saved %.0f (%.0f%%) | heartbeat %u ms, rate %.1f lbs/s\n",
+                 g_broadcastsBy[BROADCAST_CHANGE], g_broadcastsBy[BROADCAST_LOADING], g_broadcastsBy[BROADCAST_HEARTBEAT],
+                 fixed, fixed - sent, fixed > 0 ? 100.0 * (fixed - sent) / fixed : 0.0,
+                 g_broadcastHeartbeatMs, g_broadcastRate);
+  }
+  {
+    AirtimePlan plan(g_airtimeConfig);
+    int64_t planNow;
+    bool slotted = airtimePlan(esp_timer_get_time(), plan, planNow);
+    char slot[12] = "hub";
+    if (plan.slot() != AIRTIME_HUB_SLOT) snprintf(slot, sizeof(slot), "%u%s", plan.slot(), plan.listed() ? "" : " spare");
+    uint32_t ok = g_espnowUnicastSent.load();
+    uint32_t failed = g_espnowUnicastFailed.load();
+    LatencyStats discovery = readLatency(g_discoveryTime);
+    Serial.printf("🗓️ AIRTIME: %s | ESP-NOW %.0f of %u ms, %u slave slots, ours %s | relay held=%u off-slot=%u | coex switches=%u errors=%u | BLE window holds=%u\n",
+                 slotted ? "mesh clock" : "own clock", plan.espnowUs() / 1000.0, AIRTIME_FRAME_MS, plan.slots(), slot,
+                 g_airtimeHeld, g_airtimeOffSlot, g_coexSwitches, g_coexErrors, g_bleWindowHolds);
+    Serial.printf("🗓️ AIRTIME results: unicast failures %.1f%% (%u/%u) | direct frame loss %.1f%% | discovery %.0f ms mean (max %.0f, n=%u) | notify p99<%lld ms\n",
+                 ok + failed > 0 ? 100.0 * failed / (ok + failed) : 0.0, failed, ok + failed,
+                 directFrameLoss() * 100.0, discovery.mean / 1000.0, discovery.maxUs / 1000.0, discovery.count,
+                 (long long)(readLatency(g_notifyLatency).percentile(0.99) / 1000));
+  }
+  if (g_otaStartMs != 0) {
+    Serial.printf("📦 OTA: last transfer %u of %u bytes committed (resumed at %u)%s | flash busy %u ms | full stalls %u, rewinds %u\n",
+                 (unsigned)g_otaCommitted, (unsigned)g_otaStaging.total(), (unsigned)g_otaResumedFrom,
+                 g_otaCrc ? ", resumable" : "", g_otaFlashMs, g_otaFullStalls, g_otaRewinds);
+    if (g_otaContainer) {
+      Serial.printf("📦 OTA container: %u of %u image bytes expanded\n",
+                   (unsigned)g_otaImageOut, (unsigned)g_otaHeader.imageSize);
+    }
+  }
+  if (g_meshOtaStartMs != 0) {
+    portENTER_CRITICAL(&g_meshOtaMux);
+    bool pushing = g_meshOtaTx.running();
+    uint8_t targets = g_meshOtaTx.count();
+    uint8_t done = g_meshOtaTx.countIn(MESH_OTA_DONE);
+    uint8_t failed = g_meshOtaTx.countIn(MESH_OTA_FAILED);
+    uint32_t rounds = g_meshOtaTx.rounds();
+    uint32_t sent = g_meshOtaTx.chunksSent();
+    uint8_t state = g_meshOtaRx.state();
+    uint16_t window = g_meshOtaRx.window();
+    portEXIT_CRITICAL(&g_meshOtaMux);
+    if (targets > 0) {
+      Serial.printf("📡 MESH OTA push: %s | %u slaves, %u done, %u failed | %u rounds, %u chunks sent, %u send errors | %lu s\n",
+                   pushing ? "running" : "finished", targets, done, failed, rounds, sent, g_meshOtaSendErrors,
+                   (unsigned long)((millis() - g_meshOtaStartMs) / 1000));
+    } else {
+      Serial.printf("📡 MESH OTA receive: state %u, window %u | %u chunks, %u duplicates, %u statuses sent, %u foreign\n",
+                   state, window, g_meshOtaChunks, g_meshOtaDuplicates, g_meshOtaStatusSent, g_meshOtaForeign);
+    }
+  }
+  LatencyStats ack = readLatency(g_coeffDeliveryLatency);
+  Serial.printf("🎯 COEFFS: pending %u (in flight %u) | delivered %u failed %u retx %u | ack %.0f±%.0f ms (max %.0f) | last push %u/%u in %lld ms | peers %u/%d evicted %u\n",
+               g_coeffDeliveries.pending(), g_coeffDeliveries.inFlight(),
+               g_coeffDeliveries.delivered(), g_coeffDeliveries.failed(), g_coeffDeliveries.retransmits(),
+               ack.mean / 1000.0, ack.stdDev() / 1000.0, ack.maxUs / 1000.0,
+               g_lastCoeffPush.delivered, g_lastCoeffPush.delivered + g_lastCoeffPush.failed,
+               (long long)(g_lastCoeffPush.durationUs / 1000),
+               g_peerCache.size(), ESPNOW_PEER_CACHE, g_peerCache.evictions());
+  Serial.printf("🧮 COEFF BATCHES: %u (%u records)\n", g_coeffBatches, g_coeffBatchRecords);
+  LatencyStats weigh = readLatency(g_weighLatency);
+  Serial.printf("⚖️ WEIGH NOW: rounds=%u complete=%u busy=%u late replies=%u | last %u/%u answered | request->result %.0f±%.0f ms (max %.0f) | replies sent=%u\n",
+               g_weighRounds, g_weighComplete, g_weighBusy, g_weighLateReplies,
+               g_weighLastAnswered, g_weighLastExpected,
+               weigh.mean / 1000.0, weigh.stdDev() / 1000.0, weigh.maxUs / 1000.0, g_weighReplies);
+  {
+    MeshRoute route = lastMeshRoute();
+    uint32_t nowMs = millis();
+    portENTER_CRITICAL(&g_relayMux);
+    uint8_t neighbors = g_neighbors.live(nowMs);
+    uint8_t routes = g_routes.live(nowMs);
+    portEXIT_CRITICAL(&g_relayMux);
+    char parent[18] = "none";
+    if (route.parent) formatMacKey(route.parent, parent);
+    Serial.printf("🔁 RELAY: %s | parent %s, %u hops, cost %.1f | neighbors %u, reverse routes %u | originated=%u forwarded=%u delivered=%u | dropped dup=%u ttl=%u budget=%u other=%u | pool peak %u/%u\n",
+                 isHub ? "hub" : (route.hub ? "routed" : "no route"), parent, route.hops, route.cost,
+                 neighbors, routes, g_relayOriginated, g_relayForwarded, g_relayDelivered,
+                 g_relayDuplicates, g_relayExpired, g_relayBudgetDrops, g_relayDrops.load(),
+                 g_relayPool.peakInUse(), g_relayPool.count());
+  }
+  LatencyStats wake = readLatency(g_wakeLatency);
+  Serial.printf("⏱️ SCHEDULER: wakeups=%u | jobs run=%u | deadline->dispatch %.0f±%.0f us (p99<%lld, max %lld) | light sleep %s\n",
+               g_housekeepingWakeups, g_scheduler.dispatched(),
+               wake.mean, wake.stdDev(), (long long)wake.percentile(0.99), (long long)wake.maxUs,
+               g_lightSleepEnabled ? "on" : "off");
+
+  int slots = deviceSlotsInUse();
+  if (deviceCount.load() > 0) {
+    Serial.printf("📡 Known devices (%d/%d | evicted %u | rejected %u | probes %.2f | snapshot retries %u):\n",
+                 deviceCount.load(), MAX_DEVICES, g_devicesEvicted, g_devicesRejected,
+                 g_deviceIndex.meanProbes(), g_deviceReadRetries.load());
+    for (int i = 0; i < slots; i++) {
+      DeviceData device;
+      if (readDevice(i, device) && device.isActive) {
+        unsigned long age = millis() - device.lastSeen;
+        Serial.printf("   %d: %s | CH1=%.1f | CH2=%.1f | Total=%.1f lbs | RSSI=%.0f dBm loss %.1f%% jitter %.1f ms | hops %u | coeffs v%u/v%u | %lu ms ago\n",
+                     i, device.macAddress,
+                     device.lastData.ch1Weight,
+                     device.lastData.ch2Weight,
+                     device.lastData.totalWeight,
+                     device.link.rssi, device.link.loss * 100.0f, device.link.jitterUs / 1000.0f, device.hops,
+                     device.coeffVersion[0], device.coeffVersion[1],
+                     age);
+      }
+    }
+  }
+}
+
+static void statusJob(void* arg) {
+  if (otaInProgress) return;
+  printStatus();
+}
+
+// Re-armed while a flash is showing or the status pulses; idle otherwise until
+// setLEDStatus()/flashLED() signal HK_EVENT_LED
+static void ledJob(void* arg) {
+  updateLED();
+
+  int64_t now = esp_timer_get_time();
+  int32_t flashLeft = (int32_t)(g_ledFlashUntil - millis());
+  if (flashLeft > 0) {
+    g_scheduler.schedule(g_ledJob, now + (int64_t)flashLeft * 1000);
+  } else if (currentLEDStatus == LED_HUB_MODE || currentLEDStatus == LED_STANDALONE) {
+    g_scheduler.schedule(g_ledJob, now + LED_PULSE_MS * 1000LL);
+  }
+}
+
+static void environmentJob(void* arg) {
+  serviceEnvironmentSampler();
+}
+
+static void historyLogJob(void* arg) {
+  serviceHistoryLog();
+}
+
+// BLE advertising watchdog - keep device discoverable when not connected
+// This compensates for WiFi/ESP-NOW coexistence suppressing BLE advertising; the
+// airtime plan should make it redundant, which the discovery time in the status shows
+static void advertisingWatchdogJob(void* arg) {
+  if (otaInProgress) return;
+  if (bleEnabled && !deviceConnected) {
     if (g_adv) g_adv->start();
     Serial.println("📡 BLE watchdog: g_adv->start()");
-    lastAdvCheck = millis();
   }
+}
 
-  // Gate promiscuous mode: only enable when hub (reduces WiFi workload, improves BLE)
-  // When standalone, we don't need RSSI values from other devices
-  if (isHub && !g_promiscuousModeEnabled) {
-    esp_wifi_set_promiscuous_rx_cb(promiscuousRxCallback); // (re)attach callback
-    esp_wifi_set_promiscuous(true);
-    g_promiscuousModeEnabled = true;
-    Serial.println("📡 Promiscuous mode enabled (hub mode)");
-  } else if (!isHub && g_promiscuousModeEnabled) {
-    esp_wifi_set_promiscuous(false);
-    esp_wifi_set_promiscuous_rx_cb(nullptr); // optional cleanup
-    g_promiscuousModeEnabled = false;
-    Serial.println("📡 Promiscuous mode disabled (standalone mode - better BLE coexistence)");
+// Check for mesh timeout - if we haven't received ESP-NOW data in 60s, assume mesh is dead
+// This allows devices to become discoverable again after the hub disconnects.
+// Armed by HK_EVENT_MESH; re-arms itself for the moment the newest frame goes stale.
+static void meshTimeoutJob(void* arg) {
+  unsigned long last = g_lastMeshActivity;
+  if (last == 0) return;  // Idle; the next frame re-arms us
+
+  unsigned long age = millis() - last;
+  if (age < MESH_TIMEOUT_MS || otaInProgress) {
+    uint32_t left = age < MESH_TIMEOUT_MS ? MESH_TIMEOUT_MS - age : 1000;
+    g_scheduler.schedule(g_meshJob, esp_timer_get_time() + (int64_t)left * 1000);
+    return;
   }
 
-  // Check for mesh timeout - if we haven't received ESP-NOW data in 60s, assume mesh is dead
-  // This allows devices to become discoverable again after the hub disconnects
-  bool meshActive = (g_lastMeshActivity > 0) && (millis() - g_lastMeshActivity < MESH_TIMEOUT_MS);
-  if (!meshActive && g_lastMeshActivity > 0) {
-    Serial.println("⏰ Mesh timeout - no ESP-NOW data in 60s, enabling BLE discovery");
+  Serial.println("⏰ Mesh timeout - no ESP-NOW data in 60s, enabling BLE discovery");
+
+  // CRITICAL: Force BLE advertising restart to ensure discoverability
+  // The BLE stack sometimes needs a full stop/start cycle after being suppressed by ESP-NOW
+  if (bleEnabled && g_adv && !deviceConnected) {
+    g_adv->stop();
+    delay(100);
+    g_adv->start();
+    Serial.println("🔵 BLE advertising force-restarted after mesh timeout");
+  }
 
-    // CRITICAL: Force BLE advertising restart to ensure discoverability
-    // The BLE stack sometimes needs a full stop/start cycle after being suppressed by ESP-NOW
-    if (bleEnabled && g_adv) {
-      g_adv->stop();
-      delay(100);
-      g_adv->start();
-      Serial.println("🔵 BLE advertising force-restarted after mesh timeout");
+  g_lastMeshActivity = 0; // Reset so we don't report this again until the mesh is back
+}
+
+// Clean up old devices
+static void cleanupJob(void* arg) {
+  if (otaInProgress) return;
+  expireDevices();
+}
+
+static void registerHousekeepingJobs() {
+  int64_t now = esp_timer_get_time();
+  g_ledJob = g_scheduler.add("led", ledJob, nullptr, now);
+  g_meshJob = g_scheduler.add("mesh_timeout", meshTimeoutJob, nullptr, SCHEDULER_NEVER);
+  g_scheduler.add("environment", environmentJob, nullptr,
+                  now + (BME_STANDBY_MS + BME_MEASURE_MS) * 1000LL, (BME_STANDBY_MS + BME_MEASURE_MS) * 1000UL);
+  g_scheduler.add("history_log", historyLogJob, nullptr,
+                  now + HISTORY_FLUSH_INTERVAL_MS * 1000LL, HISTORY_FLUSH_INTERVAL_MS * 1000UL);
+  g_scheduler.add("status", statusJob, nullptr, now + STATUS_INTERVAL_MS * 1000LL, STATUS_INTERVAL_MS * 1000UL);
+  g_scheduler.add("adv_watchdog", advertisingWatchdogJob, nullptr,
+                  now + ADV_WATCHDOG_MS * 1000LL, ADV_WATCHDOG_MS * 1000UL);
+  g_scheduler.add("cleanup", cleanupJob, nullptr, now + DEVICE_CLEANUP_MS * 1000LL, DEVICE_CLEANUP_MS * 1000UL);
+  if (g_lastMeshActivity > 0) g_scheduler.schedule(g_meshJob, now);
+}
+
+// Housekeeping task: block until the next job deadline or an HK_EVENT_*, then
+// dispatch whatever is due in deadline order
+static void housekeepingTask(void* arg) {
+  registerHousekeepingJobs();
+
+  for (;;) {
+    int64_t next = g_scheduler.nextDeadline();
+    int64_t now = esp_timer_get_time();
+    TickType_t wait = portMAX_DELAY;
+    if (next != SCHEDULER_NEVER) wait = next <= now ? 0 : ticksForUs(next - now);
+
+    uint32_t events = 0;
+    xTaskNotifyWait(0, UINT32_MAX, &events, wait);
+    now = esp_timer_get_time();
+    g_housekeepingWakeups++;
+
+    if (events & HK_EVENT_LED) g_scheduler.scheduleNoLater(g_ledJob, now);
+    if (events & HK_EVENT_MESH) g_scheduler.scheduleNoLater(g_meshJob, now + MESH_TIMEOUT_MS * 1000LL);
+    if (next <= now) recordLatency(g_wakeLatency, now - next);
+
+    g_scheduler.runDue(now);
+  }
+}
+
+void startTasks() {
+  xTaskCreatePinnedToCore(workerTask, "worker", WORKER_TASK_STACK, nullptr,
+                          WORKER_TASK_PRIORITY, &g_workerTaskHandle, WORKER_TASK_CORE);
+  xTaskCreatePinnedToCore(radioTask, "radio", RADIO_TASK_STACK, nullptr,
+                          RADIO_TASK_PRIORITY, &g_radioTaskHandle, RADIO_TASK_CORE);
+  xTaskCreatePinnedToCore(bleTask, "ble_pub", BLE_TASK_STACK, nullptr,
+                          BLE_TASK_PRIORITY, &g_bleTaskHandle, BLE_TASK_CORE);
+  xTaskCreatePinnedToCore(housekeepingTask, "housekeeping", HOUSEKEEPING_TASK_STACK, nullptr,
+                          HOUSEKEEPING_TASK_PRIORITY, &g_housekeepingTaskHandle, HOUSEKEEPING_TASK_CORE);
+  xTaskCreatePinnedToCore(otaWriterTask, "ota_writer", OTA_WRITER_TASK_STACK, nullptr,
+                          OTA_WRITER_TASK_PRIORITY, &g_otaWriterTaskHandle, OTA_WRITER_TASK_CORE);
+  Serial.println("🧵 Tasks started: radio + BLE on core 0, worker + housekeeping + OTA writer on core 1");
+}
+
+// Dynamic frequency scaling, plus automatic light sleep whenever every task is
+// blocked (housekeeping waiting on its next deadline, radio/BLE tasks waiting on
+// samples). WiFi/BLE keep their own PM locks while they need the radio, so sleep
+// only happens in the gaps between radio events.
+void initPowerManagement() {
+#if CONFIG_PM_ENABLE
+  esp_pm_config_esp32s3_t pm = {};
+  pm.max_freq_mhz = 240;
+  pm.min_freq_mhz = 80;
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+  pm.light_sleep_enable = POWER_SAVE_LIGHT_SLEEP;
+#endif
+  esp_err_t err = esp_pm_configure(&pm);
+  if (err != ESP_OK) {
+    Serial.printf("⚠️ Power management not configured: %s\n", esp_err_to_name(err));
+    return;
+  }
+  g_lightSleepEnabled = pm.light_sleep_enable;
+  Serial.printf("⚡ Power management: %d-%d MHz, light sleep %s\n",
+               pm.min_freq_mhz, pm.max_freq_mhz, g_lightSleepEnabled ? "on" : "off");
+#else
+  Serial.println("⚡ Power management not available in this build (CONFIG_PM_ENABLE off)");
+#endif
+}
+
+// ============================================================
+// DEFERRED WORK
+// ============================================================
+
+// Radio callbacks (WiFi task for ESP-NOW, BLE host task for GATT writes) must not
+// block: no flash writes, no JSON, no Serial. They copy the payload into a pool
+// buffer and queue it; the worker task below does the parsing, NVS and logging.
+
+// Safe from any callback or task. Returns false (and counts a drop) when the pool or
+// queue is exhausted or the payload doesn't fit a pool buffer.
+bool deferWork(DeferredWorkType type, const void* payload, size_t len, const uint8_t* mac, int8_t rssi) {
+  DeferredWork work;
+  work.type = type;
+  work.slot = -1;
+  work.rssi = rssi;
+  work.len = (uint16_t)len;
+  work.rxUs = esp_timer_get_time();
+  if (mac) {
+    memcpy(work.mac, mac, 6);
+  } else {
+    memset(work.mac, 0, 6);
+  }
+
+  if (payload && len > 0) {
+    if (len > DEFERRED_BUFFER_SIZE) {
+      g_deferredDrops++;
+      return false;
+    }
+    int slot = g_deferredPool.acquire();
+    if (slot < 0) {
+      g_deferredDrops++;
+      return false;
     }
+    memcpy(g_deferredPool.data(slot), payload, len);
+    work.slot = (int8_t)slot;
+  }
 
-    g_lastMeshActivity = 0; // Reset so we don't print this every loop
+  if (!g_deferredQueue.push(work)) {
+    g_deferredPool.release(work.slot);
+    g_deferredDrops++;
+    return false;
   }
+  if (g_workerTaskHandle) xTaskNotifyGive(g_workerTaskHandle);
+  return true;
+}
 
-  // BLE discovery quiet window (Android/Capacitor tuned):
-  // Every ~6s while NOT connected over BLE AND (no active mesh OR mesh timed out), pause ESP-NOW TX for ~1.2s and restart advertising once.
-  // This makes Android BLE scanning feel instant by giving frequent clean scan windows.
-  static unsigned long lastDiscoveryKick = 0;
+static void workerTask(void* arg) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    DeferredWork work;
+    while (g_deferredQueue.pop(work)) {
+      const uint8_t* payload = work.slot >= 0 ? g_deferredPool.data(work.slot) : nullptr;
+
+      switch (work.type) {
+        case DEFERRED_ESPNOW_RX:
+          handleESPNowFrame(work.mac, payload, work.len, work.rssi, work.rxUs);
+          break;
+
+        case DEFERRED_ESPNOW_TX_FAILED:
+          Serial.printf("📤 ESP-NOW TX FAILED to %02X:%02X:%02X:%02X:%02X:%02X\n",
+                       work.mac[0], work.mac[1], work.mac[2],
+                       work.mac[3], work.mac[4], work.mac[5]);
+          break;
+
+        case DEFERRED_BLE_COEFFS:
+          handleCoeffsWrite((const char*)payload, work.len);
+          break;
+
+        case DEFERRED_BLE_COEFF_BATCH:
+          handleCoeffBatch();
+          break;
+
+        case DEFERRED_BLE_WEIGH_NOW:
+          handleWeighRequest(payload, work.len, work.rxUs);
+          break;
+
+        case DEFERRED_BLE_DISCONNECT:
+          otaSuspend();
+          // Restart advertising using global instance
+          if (bleEnabled && g_adv) {
+            g_adv->start();
+            g_advStartedMs = millis();
+            Serial.println("📡 BLE advertising restarted");
+          }
+          break;
+      }
 
-  const uint32_t DISCOVERY_KICK_MS  = 6000;   // how often we create a scan-friendly gap
-  const uint32_t DISCOVERY_QUIET_MS = 1200;   // how long we pause ESP-NOW TX
+      g_deferredPool.release(work.slot);
+      g_deferredProcessed++;
+    }
+  }
+}
+
+// NVS copy of one channel's coefficients
+static void persistChannelCoeffs(int channel, const RegressionCoeffs& coeffs) {
+  if (channel == 1) {
+    preferences.putFloat("ch1_intercept", coeffs.intercept);
+    preferences.putFloat("ch1_air_coeff", coeffs.airPressureCoeff);
+    preferences.putFloat("ch1_amb_coeff", coeffs.ambientPressureCoeff);
+    preferences.putFloat("ch1_temp_coeff", coeffs.airTempCoeff);
+  } else {
+    preferences.putFloat("ch2_intercept", coeffs.intercept);
+    preferences.putFloat("ch2_air_coeff", coeffs.airPressureCoeff);
+    preferences.putFloat("ch2_amb_coeff", coeffs.ambientPressureCoeff);
+    preferences.putFloat("ch2_temp_coeff", coeffs.airTempCoeff);
+  }
+}
+
+// Persist one channel's coefficients and make them live
+void saveChannelCoeffs(int channel, const RegressionCoeffs& coeffs) {
+  portENTER_CRITICAL(&g_coeffsMux);
+  if (channel == 1) {
+    ch1Coeffs = coeffs;
+  } else {
+    ch2Coeffs = coeffs;
+  }
+  portEXIT_CRITICAL(&g_coeffsMux);
+  g_estimatorReset.fetch_or(channel == 1 ? 0x01 : 0x02);
+  persistChannelCoeffs(channel, coeffs);
+}
+
+// Coefficients JSON written by the phone: apply locally or forward to a slave
+void handleCoeffsWrite(const char* json, size_t len) {
+  Serial.println("📥 Received coefficients via BLE");
+  Serial.printf("%.*s\n", (int)len, json);
+
+  DynamicJsonDocument doc(512);
+  DeserializationError error = deserializeJson(doc, json, len);
+
+  if (error) {
+    Serial.printf("❌ JSON parse error: %s\n", error.c_str());
+    return;
+  }
+
+  // Check if this is for a specific device and channel
+  const char* targetMac = doc["target_mac"] | "";
+  int channel = doc["channel"] | 1;  // Default to channel 1
+
+  // Extract coefficients from JSON
+  RegressionCoeffs newCoeffs;
+  newCoeffs.intercept = doc["intercept"] | 0.0;
+  newCoeffs.airPressureCoeff = doc["air_pressure_coeff"] | 0.0;
+  newCoeffs.ambientPressureCoeff = doc["ambient_pressure_coeff"] | 0.0;
+  newCoeffs.airTempCoeff = doc["air_temp_coeff"] | 0.0;
+
+  Serial.printf("📊 CH%d Coefficients: intercept=%.4f, air=%.4f, ambient=%.4f, temp=%.4f\n",
+               channel, newCoeffs.intercept, newCoeffs.airPressureCoeff,
+               newCoeffs.ambientPressureCoeff, newCoeffs.airTempCoeff);
+  Serial.printf("🎯 Target MAC: '%s'\n", targetMac);
+
+  // Is this for me (the hub) or no target specified?
+  if (strlen(targetMac) == 0 || strcasecmp(targetMac, deviceMAC.c_str()) == 0) {
+    // Save locally to appropriate channel
+    saveChannelCoeffs(channel == 1 ? 1 : 2, newCoeffs);
+    Serial.printf("✅ Saved CH%d coefficients locally\n", channel == 1 ? 1 : 2);
+  } else {
+    // Forward to slave device via ESP-NOW (sent from the radio task)
+    RadioCommand cmd = {};
+    cmd.type = RADIO_CMD_SEND_COEFFS;
+    cmd.channel = channel;
+    strncpy(cmd.targetMac, targetMac, sizeof(cmd.targetMac) - 1);
+    cmd.coeffs = newCoeffs;
+    cmd.version = nextCoeffVersion();
+    Serial.printf("📡 Forwarding CH%d coefficients v%u to slave: %s\n", channel, cmd.version, targetMac);
+    if (!queueRadioCommand(cmd)) {
+      Serial.println("❌ Radio queue full - coefficients not forwarded");
+    }
+  }
+}
 
-  // Only run discovery windows if NOT connected AND (never been in mesh OR mesh timed out)
-  if (bleEnabled && !deviceConnected && !meshActive) {
-    if (!g_discoveryQuiet && (millis() - lastDiscoveryKick > DISCOVERY_KICK_MS)) {
-      g_discoveryQuiet = true;
-      g_lastDiscoveryWindowStart = millis();
-      lastDiscoveryKick = millis();
+static bool coeffRecordValid(const CoeffBatchRecord& r) {
+  return (r.channel == 1 || r.channel == 2) &&
+         isfinite(r.intercept) && isfinite(r.airPressureCoeff) &&
+         isfinite(r.ambientPressureCoeff) && isfinite(r.airTempCoeff);
+}
 
-      // Force stop/start cycle using global advertising instance
-      if (g_adv) {
-        g_adv->stop();
-        delay(30);
-        g_adv->start();
+// Worker task: act on a complete calibration batch. The hub's own records are
+// applied all or nothing, both channels in one swap so the acquisition task never
+// mixes old and new; the slave records go to the radio task as one command.
+void handleCoeffBatch() {
+  static CoeffBatch batch;  // ~1.3 KB, kept off the worker stack
+  portENTER_CRITICAL(&g_coeffBatchMux);
+  bool ready = g_coeffBatchInReady;
+  if (ready) batch = g_coeffBatchIn;
+  g_coeffBatchInReady = false;
+  portEXIT_CRITICAL(&g_coeffBatchMux);
+  if (!ready) return;
+
+  MacKey self = macKeyFromString(deviceMAC.c_str());
+  bool hubValid = true;
+  for (uint8_t i = 0; i < batch.count; i++) {
+    CoeffBatchRecord& r = batch.records[i];
+    if (r.target == self) r.target = 0;
+    if (!coeffRecordValid(r)) {
+      r.status = COEFF_REC_INVALID;
+      if (r.target == 0) hubValid = false;
+      continue;
+    }
+    if (r.version == 0) r.version = nextCoeffVersion();
+    for (uint8_t j = 0; j < i; j++) {
+      CoeffBatchRecord& earlier = batch.records[j];
+      if (earlier.status == COEFF_REC_QUEUED && earlier.target == r.target && earlier.channel == r.channel) {
+        earlier.status = COEFF_REC_SUPERSEDED;
       }
-      Serial.println("📡 BLE discovery window: quiet ESP-NOW TX ~1.2s + restart advertising");
     }
+  }
 
-    if (g_discoveryQuiet && (millis() - g_lastDiscoveryWindowStart > DISCOVERY_QUIET_MS)) {
-      g_discoveryQuiet = false;
-      Serial.println("📡 BLE discovery window: resume ESP-NOW TX");
+  RegressionCoeffs next[2] = {liveCoeffs(1), liveCoeffs(2)};
+  bool touched[2] = {false, false};
+  uint32_t versions[2];
+  uint8_t hubRecords = 0;
+  uint8_t slaveRecords = 0;
+  for (uint8_t i = 0; i < batch.count; i++) {
+    CoeffBatchRecord& r = batch.records[i];
+    if (r.status != COEFF_REC_QUEUED) continue;
+    if (r.target != 0) {
+      slaveRecords++;
+      continue;
+    }
+    hubRecords++;
+    if (!hubValid) {
+      r.status = COEFF_REC_INVALID;
+      continue;
     }
+    int idx = r.channel - 1;
+    next[idx].intercept = r.intercept;
+    next[idx].airPressureCoeff = r.airPressureCoeff;
+    next[idx].ambientPressureCoeff = r.ambientPressureCoeff;
+    next[idx].airTempCoeff = r.airTempCoeff;
+    versions[idx] = r.version;
+    touched[idx] = true;
+    r.status = COEFF_REC_APPLIED;
+  }
+
+  if (touched[0] || touched[1]) {
+    portENTER_CRITICAL(&g_coeffsMux);
+    ch1Coeffs = next[0];
+    ch2Coeffs = next[1];
+    portEXIT_CRITICAL(&g_coeffsMux);
+    g_estimatorReset.fetch_or((touched[0] ? 0x01 : 0) | (touched[1] ? 0x02 : 0));
+    for (int idx = 0; idx < 2; idx++) {
+      if (!touched[idx]) continue;
+      persistChannelCoeffs(idx + 1, next[idx]);
+      g_appliedCoeffVersion[idx] = versions[idx];
+      preferences.putUInt(idx == 0 ? "ch1_coeff_ver" : "ch2_coeff_ver", versions[idx]);
+    }
+  }
+
+  portENTER_CRITICAL(&g_coeffBatchMux);
+  g_coeffBatch = batch;
+  portEXIT_CRITICAL(&g_coeffBatchMux);
+
+  if (slaveRecords > 0) {
+    RadioCommand cmd = {};
+    cmd.type = RADIO_CMD_SEND_COEFF_BATCH;
+    if (!queueRadioCommand(cmd)) {
+      Serial.println("❌ Radio queue full - coefficient batch not forwarded");
+      portENTER_CRITICAL(&g_coeffBatchMux);
+      for (uint8_t i = 0; i < g_coeffBatch.count; i++) {
+        if (g_coeffBatch.records[i].status == COEFF_REC_QUEUED) g_coeffBatch.records[i].status = COEFF_REC_DROPPED;
+      }
+      portEXIT_CRITICAL(&g_coeffBatchMux);
+    }
+  }
+
+  g_coeffBatches++;
+  g_coeffBatchRecords += batch.count;
+  Serial.printf("📥 Coefficient batch #%u: %u records | hub %u %s | %u to slaves\n",
+               batch.id, batch.count, hubRecords, hubValid ? "applied" : "REJECTED", slaveRecords);
+  notifyCoeffBatchStatus();
+}
+
+// Status notification wanted: after a batch is taken and again once it settles
+static void notifyCoeffBatchStatus() {
+  g_coeffBatchStatusDirty = true;
+  if (g_bleTaskHandle) xTaskNotifyGive(g_bleTaskHandle);
+}
+
+// ============================================================
+// ESP-NOW FUNCTIONS
+// ============================================================
+
+void initESPNow() {
+  Serial.println("\n📡 Initializing ESP-NOW...");
+  
+  // WiFi.mode(WIFI_STA) already called in setup()
+  
+  // If not connected to WiFi, set fixed channel
+  if (!isConnectedToWiFi) {
+    WiFi.disconnect();
+    delay(100);
+    
+    // Force to fixed channel
+    esp_wifi_set_promiscuous(true);
+    esp_wifi_set_channel(ESPNOW_CHANNEL, WIFI_SECOND_CHAN_NONE);
+    esp_wifi_set_promiscuous(false);
+
+    Serial.printf("📡 ESP-NOW set to fixed channel: %d\n", ESPNOW_CHANNEL);
   } else {
-    g_discoveryQuiet = false;
+    Serial.printf("📡 ESP-NOW using WiFi channel: %d\n", WiFi.channel());
+  }
+  
+  // Verify channel
+  uint8_t actualChannel;
+  wifi_second_chan_t dummy;
+  esp_wifi_get_channel(&actualChannel, &dummy);
+  Serial.printf("📡 Actual channel: %d\n", actualChannel);
+  
+  // Initialize ESP-NOW
+  if (esp_now_init() != ESP_OK) {
+    Serial.println("❌ ESP-NOW initialization failed!");
+    return;
+  }
+
+  // No promiscuous mode: it loads the WiFi stack and starves BLE. RSSI comes with
+  // each packet on IDF 5 and is unknown before; loss and jitter don't need it.
+
+  // Register callbacks
+  esp_now_register_send_cb(onESPNowDataSent);
+  esp_now_register_recv_cb(onESPNowDataReceived);
+
+  Serial.printf("✅ ESP-NOW initialized | Channel: %d | RAM: %d bytes\n",
+                actualChannel, ESP.getFreeHeap());
+}
+
+// Runs in the WiFi task: validate, copy into a pool buffer, hand off, return
+static void receiveESPNow(const uint8_t *mac_addr, const uint8_t *incomingData, int len, int8_t rssi) {
+  // Compact frames are validated by the worker. Legacy senders send the whole struct,
+  // pre-estimator ones without the trailing estimator fields; anything else is dropped.
+  bool compact = isCompactFrame(incomingData, len);
+  if (!compact && len != sizeof(ESPNowData) && len != ESPNOW_DATA_V0_SIZE) {
+    deferWork(DEFERRED_ESPNOW_RX, nullptr, len, mac_addr);
+    return;
+  }
+
+  // Track mesh activity - we received data, so mesh is alive
+  bool meshWasIdle = g_lastMeshActivity == 0;
+  g_lastMeshActivity = millis();
+  if (meshWasIdle) signalHousekeeping(HK_EVENT_MESH);  // Arm the mesh timeout
+
+  deferWork(DEFERRED_ESPNOW_RX, incomingData, len, mac_addr, rssi);
+}
+
+#if ESP_IDF_VERSION_MAJOR >= 5
+void onESPNowDataReceived(const esp_now_recv_info_t* info, const uint8_t *incomingData, int len) {
+  int rssi = info->rx_ctrl ? info->rx_ctrl->rssi : RSSI_UNKNOWN;
+  receiveESPNow(info->src_addr, incomingData, len, rssi < 0 && rssi > RSSI_UNKNOWN ? (int8_t)rssi : RSSI_UNKNOWN);
+}
+#else
+void onESPNowDataReceived(const uint8_t *mac_addr, const uint8_t *incomingData, int len) {
+  receiveESPNow(mac_addr, incomingData, len, RSSI_UNKNOWN);
+}
+#endif
+
+// Worker task (slave): apply a set from the hub unless it is the one in effect,
+// ack every copy so a lost ack is repaired by the hub's retransmit. Versions come
+// from the phone and restart with its session, so the same version from another
+// hub or session can carry other values: a set counts as applied by its content.
+static void applyCoeffsFrame(const char* fromMac, const CoeffsReport& c, bool crcOk) {
+  RadioCommand ack = {};
+  ack.type = RADIO_CMD_SEND_COEFFS_ACK;
+  ack.channel = c.channel;
+  ack.version = c.version;
+  strncpy(ack.targetMac, fromMac, sizeof(ack.targetMac) - 1);
+
+  int channel = c.channel == 2 ? 2 : 1;
+  RegressionCoeffs newCoeffs;
+  newCoeffs.intercept = c.intercept;
+  newCoeffs.airPressureCoeff = c.airPressureCoeff;
+  newCoeffs.ambientPressureCoeff = c.ambientPressureCoeff;
+  newCoeffs.airTempCoeff = c.airTempCoeff;
+  RegressionCoeffs current = liveCoeffs(channel);
+  bool inEffect = memcmp(&current, &newCoeffs, sizeof(RegressionCoeffs)) == 0;
+
+  if (!crcOk) {
+    g_framesRejected++;
+    ack.status = COEFFS_BAD_CRC;
+    Serial.printf("⚠️ CH%d coefficients v%u from %s failed CRC\n", channel, c.version, fromMac);
+  } else if (inEffect) {
+    ack.status = COEFFS_APPLIED;
+    if (g_appliedCoeffVersion[channel - 1] != c.version) {
+      g_appliedCoeffVersion[channel - 1] = c.version;
+      preferences.putUInt(channel == 1 ? "ch1_coeff_ver" : "ch2_coeff_ver", c.version);
+    }
+    Serial.printf("🔁 CH%d coefficients v%u already in effect - acking again\n", channel, c.version);
+  } else {
+    ack.status = COEFFS_APPLIED;
+    float oldIntercept = current.intercept;
+    saveChannelCoeffs(channel, newCoeffs);
+    g_appliedCoeffVersion[channel - 1] = c.version;
+    preferences.putUInt(channel == 1 ? "ch1_coeff_ver" : "ch2_coeff_ver", c.version);
+    Serial.printf("✅ CH%d Coefficients v%u from %s: intercept %.4f → %.4f\n",
+                 channel, c.version, fromMac, oldIntercept, newCoeffs.intercept);
+  }
+  queueRadioCommand(ack);
+}
+
+// Worker task (hub): a slave answered a coefficient delivery
+static void handleCoeffsAckFrame(const char* fromMac, const CoeffsAck& ack) {
+  if (ack.status != COEFFS_APPLIED) {
+    // Not final: the retransmit carries a fresh copy
+    Serial.printf("⚠️ %s reports CH%u coefficients v%u corrupted - resending\n", fromMac, ack.channel, ack.version);
+    return;
+  }
+  setDeviceCoeffVersion(macKeyFromString(fromMac), ack.channel, ack.version);
+
+  RadioCommand cmd = {};
+  cmd.type = RADIO_CMD_COEFFS_ACKED;
+  cmd.channel = ack.channel;
+  cmd.version = ack.version;
+  strncpy(cmd.targetMac, fromMac, sizeof(cmd.targetMac) - 1);
+  queueRadioCommand(cmd);
+}
+
+// Worker task (slave): feed a hub's beacon into the mesh clock and take up the
+// airtime slot it gives us
+static void handleTimeSyncBeacon(const uint8_t* mac, int64_t rxUs, int64_t masterUs, const uint8_t* tails,
+                                 uint8_t listed) {
+  if (isHub) return;  // We are the master; a second hub's beacons are ignored
+  MacKey master = macKeyFromBytes(mac);
+  portENTER_CRITICAL(&g_timeSyncMux);
+  TimeSyncUpdate result = g_timeSync.update(master, rxUs, masterUs);
+  int64_t offset = g_timeSync.offsetAt(rxUs);
+  bool following = g_timeSync.master() == master;
+  portEXIT_CRITICAL(&g_timeSyncMux);
+
+  if (following) {
+    uint16_t tail = (uint16_t)(macKeyFromString(deviceMAC.c_str()) & 0xFFFF);
+    portENTER_CRITICAL(&g_airtimeMux);
+    g_airtime.assign(tails, listed, tail);
+    portEXIT_CRITICAL(&g_airtimeMux);
+  }
+
+  if (result == TIME_SYNC_RESTARTED) {
+    char from[18];
+    formatMacKey(master, from);
+    Serial.printf("⏲️ Mesh time: following hub %s (offset %lld us)\n", from, (long long)offset);
+  }
+}
+
+// Worker task (hub): the phone asked for a weigh-now. Every active slave heard
+// directly that sends compact frames is asked: legacy nodes can't answer a trigger,
+// and it isn't relayed, so slaves beyond our range never hear it.
+static void handleWeighRequest(const uint8_t* payload, size_t len, int64_t rxUs) {
+  if (!payload || len < 2 || payload[0] != WEIGH_OP_REQUEST) {
+    Serial.printf("❌ Weigh-now request rejected (%u bytes)\n", (unsigned)len);
+    return;
+  }
+  if (!isHub) return;
+  uint8_t requestId = payload[1];
+
+  static MacKey roster[MAX_DEVICES];
+  int asked = 0;
+  int slots = deviceSlotsInUse();
+  for (int i = 0; i < slots && asked < MAX_DEVICES; i++) {
+    DeviceData device;
+    if (readDevice(i, device) && device.isActive && device.frameVersion > 0 && device.hops == 0) {
+      roster[asked++] = device.macKey;
+    }
+  }
+
+  static uint8_t lastId = 0;
+  uint8_t id = ++lastId;
+  portENTER_CRITICAL(&g_weighMux);
+  bool busy = g_weighNow.running();
+  if (!busy) {
+    g_weighNow.begin(requestId, id, macKeyFromString(deviceMAC.c_str()), rxUs);
+    for (int i = 0; i < asked; i++) g_weighNow.expect(roster[i]);
+  }
+  portEXIT_CRITICAL(&g_weighMux);
+  if (busy) {
+    g_weighBusy++;
+    Serial.printf("⚠️ Weigh-now request %u refused: a round is still running\n", requestId);
+    return;
+  }
+
+  g_weighRounds++;
+  RadioCommand cmd = {};
+  cmd.type = RADIO_CMD_WEIGH_TRIGGER;
+  cmd.weighId = id;
+  if (!queueRadioCommand(cmd)) {
+    finishWeighNow();  // Reported with every slave missing rather than never
+    return;
   }
+  Serial.printf("⚖️ Weigh now #%u (request %u): asking %d slaves\n", id, requestId, asked);
+}
 
-  // ALL devices broadcast their sensor data via ESP-NOW
-  // Broadcast slower when not connected to save airtime for BLE advertising
-  static unsigned long lastBroadcast = 0;
-  uint32_t broadcastInterval = deviceConnected ? BROADCAST_INTERVAL_MS : 30000;  // 30s when standalone
-  if (!g_discoveryQuiet && (millis() - lastBroadcast > broadcastInterval)) {
-    setLEDStatus(LED_TRANSMITTING);
-    broadcastMyData();
-    delay(50);
-    setLEDStatus(isHub ? LED_HUB_MODE : LED_STANDALONE);
-    lastBroadcast = millis();
+// Worker task (slave): schedule our answer to a hub's weigh-now trigger. The
+// trigger goes out twice, back to back; a second copy of a round heard within the
+// lead time is ignored. Ids restart with the hub, so an older match is a new round.
+static void handleWeighTrigger(const uint8_t* mac, int64_t rxUs, const uint8_t* frame, const FrameHeader& header) {
+  if (isHub) return;
+  WeighTrigger t;
+  if (!decodeWeighTriggerFrame(frame, header, t)) {
+    g_framesRejected++;
+    return;
   }
+  static MacKey lastHub = 0;
+  static uint8_t lastId = 0;
+  static int64_t lastRxUs = 0;
+  MacKey hub = macKeyFromBytes(mac);
+  if (hub == lastHub && t.id == lastId && rxUs - lastRxUs < WEIGH_LEAD_MS * 1000LL) return;
+  lastHub = hub;
+  lastId = t.id;
+  lastRxUs = rxUs;
+
+  // The instant on our clock: through the fitted mesh clock when following this
+  // hub, else from the trigger's own stamp (late by its delivery time)
+  int64_t sampleAtUs = 0;
+  portENTER_CRITICAL(&g_timeSyncMux);
+  bool synced = g_timeSync.master() == hub && g_timeSync.synced(rxUs);
+  if (synced) sampleAtUs = t.sampleAtUs - g_timeSync.offsetAt(rxUs);
+  portEXIT_CRITICAL(&g_timeSyncMux);
+  if (!synced) sampleAtUs = rxUs + (t.sampleAtUs - t.masterUs);
+
+  const uint8_t* tails = nullptr;
+  uint8_t tailsLen = 0;
+  findFrameTlv(frame, header, TLV_WEIGH_SLOTS, &tails, &tailsLen);
+  uint8_t self[6];
+  macKeyToBytes(macKeyFromString(deviceMAC.c_str()), self);
+  uint8_t slot = weighSlot(tails, tailsLen / 2, t.slots, self);
+
+  RadioCommand cmd = {};
+  cmd.type = RADIO_CMD_WEIGH_REPLY;
+  cmd.weighId = t.id;
+  cmd.status = synced ? WEIGH_REPLY_SYNCED : 0;
+  formatMacKey(hub, cmd.targetMac);
+  cmd.sampleAtUs = sampleAtUs;
+  cmd.replyAtUs = sampleAtUs + t.replyAfterMs * 1000LL + (int64_t)slot * t.slotUs;
+  queueRadioCommand(cmd);
+  Serial.printf("⚖️ Weigh now #%u from %s: slot %u of %u, sampling in %lld ms (%s)\n",
+               t.id, cmd.targetMac, slot, t.slots, (long long)((sampleAtUs - rxUs) / 1000),
+               synced ? "mesh time" : "trigger stamp");
+}
 
-  // Hub sends all collected data via BLE
-  if (isHub && deviceConnected) {
-    static unsigned long lastBLESend = 0;
-    if (millis() - lastBLESend > HUB_SEND_INTERVAL_MS) {
-      setLEDStatus(LED_TRANSMITTING);
-      sendAllDataViaBLE();
-      delay(50);
-      setLEDStatus(LED_HUB_MODE);
-      lastBLESend = millis();
+// Worker task (slave): the hub's mesh firmware update. An offer listing us starts
+// a session (the writer erases for it) or carries on the one running; chunks go
+// straight into the update partition; offers and polls are answered in our slot.
+// Only the hub our route leads to is listened to; a signed build also needs the
+// image signed with our key to boot it.
+static void handleMeshOtaFrame(const uint8_t* mac, int64_t rxUs, const uint8_t* frame, const FrameHeader& header) {
+  MacKey hub = macKeyFromBytes(mac);
+  if (isHub || lastMeshRoute().hub != hub) {
+    g_meshOtaForeign++;
+    return;
+  }
+  uint16_t session = 0;
+  uint32_t wake = 0;
+
+  if (header.type == FRAME_OTA_DATA) {
+    uint16_t chunk;
+    const uint8_t* data;
+    uint8_t dataLen;
+    if (!decodeOtaDataFrame(frame, header, session, chunk, &data, &dataLen)) {
+      g_framesRejected++;
+      return;
+    }
+    portENTER_CRITICAL(&g_meshOtaMux);
+    bool ours = g_meshOtaRx.is(hub, session);
+    bool fresh = ours && g_meshOtaRx.take(chunk, dataLen);
+    uint32_t offset = g_meshOtaRx.layout().offset(chunk);
+    portEXIT_CRITICAL(&g_meshOtaMux);
+    if (!ours) return;
+    g_meshOtaHeardMs = millis();
+    if (!fresh) {
+      g_meshOtaDuplicates++;
+      return;
     }
+    uint8_t bounce[MESH_OTA_CHUNK_BYTES];  // Internal RAM: the receive buffer may be in PSRAM
+    memcpy(bounce, data, dataLen < sizeof(bounce) ? dataLen : sizeof(bounce));
+    if (dataLen > sizeof(bounce) || esp_partition_write(g_meshOtaPartition, offset, bounce, dataLen) != ESP_OK) {
+      Serial.printf("❌ Mesh OTA flash write at %u failed\n", (unsigned)offset);
+      portENTER_CRITICAL(&g_meshOtaMux);
+      g_meshOtaRx.setState(MESH_OTA_FAILED, OTA_ERR_FLASH);
+      portEXIT_CRITICAL(&g_meshOtaMux);
+      return;
+    }
+    g_meshOtaChunks++;
+    return;
   }
-  
-  // Clean up old devices
-  static unsigned long lastCleanup = 0;
-  if (millis() - lastCleanup > 60000) {
-    for (int i = 0; i < deviceCount; i++) {
-      if (millis() - knownDevices[i].lastSeen > DEVICE_TIMEOUT_MS) {
-        if (knownDevices[i].isActive) {
-          Serial.printf("⚠️ Device %s marked inactive (timeout)\n", knownDevices[i].macAddress);
-          knownDevices[i].isActive = false;
-        }
+
+  uint8_t slot = 0;
+  uint16_t slotUs = 0;
+  if (header.type == FRAME_OTA_OFFER) {
+    OtaOffer offer;
+    const uint8_t* list = nullptr;
+    uint8_t listLen = 0;
+    if (!decodeOtaOfferFrame(frame, header, offer) ||
+        !findFrameTlv(frame, header, TLV_OTA_TARGETS, &list, &listLen)) {
+      g_framesRejected++;
+      return;
+    }
+    uint8_t self[6];
+    macKeyToBytes(macKeyFromString(deviceMAC.c_str()), self);
+    int index = -1;
+    for (int i = 0; i + 6 <= listLen && index < 0; i += 6) {
+      if (memcmp(list + i, self, 6) == 0) index = i / 6;
+    }
+    if (index < 0) return;  // Not for us
+    slot = (uint8_t)index;
+    slotUs = offer.slotUs;
+    session = offer.session;
+
+    portENTER_CRITICAL(&g_meshOtaMux);
+    bool current = g_meshOtaRx.is(hub, offer.session);
+    portEXIT_CRITICAL(&g_meshOtaMux);
+    if (!current) {
+      const esp_partition_t* part = esp_ota_get_next_update_partition(NULL);
+      uint8_t refused = OTA_OK;
+      uint8_t running[3];
+      parseFirmwareVersion(FIRMWARE_VERSION, &running[0], &running[1], &running[2]);
+      if (g_otaState != OTA_IDLE) refused = OTA_ERR_STATE;  // A BLE update here
+      else if (!part || offer.imageSize > part->size) refused = OTA_ERR_SIZE;
+      else if (meshOtaCompareVersion(offer.firmware, running) < 0) refused = OTA_ERR_OLDER;
+      if (refused == OTA_OK) g_meshOtaPartition = part;
+      portENTER_CRITICAL(&g_meshOtaMux);
+      if (g_meshOtaRx.begin(hub, offer, slot) && refused != OTA_OK) g_meshOtaRx.setState(MESH_OTA_FAILED, refused);
+      bool taken = g_meshOtaRx.state() == MESH_OTA_PREPARING;
+      portEXIT_CRITICAL(&g_meshOtaMux);
+      g_meshOtaStartMs = millis();
+      g_meshOtaChunks = 0;
+      g_meshOtaDuplicates = 0;
+      char hubMac[18];
+      formatMacKey(hub, hubMac);
+      if (taken) {
+        wake |= OTA_WAKE_MESH_ERASE;
+        Serial.printf("📦 Mesh OTA offer from %s: %u bytes, status slot %u\n", hubMac, (unsigned)offer.imageSize, slot);
+      } else {
+        Serial.printf("❌ Mesh OTA offer from %s refused (error %u)\n", hubMac, refused);
       }
     }
-    lastCleanup = millis();
+  } else {
+    OtaPoll poll;
+    if (!decodeOtaPollFrame(frame, header, poll)) {
+      g_framesRejected++;
+      return;
+    }
+    session = poll.session;
+    portENTER_CRITICAL(&g_meshOtaMux);
+    bool ours = g_meshOtaRx.is(hub, poll.session);
+    bool complete = ours && g_meshOtaRx.poll(poll.window);
+    if (complete) g_meshOtaRx.setState(MESH_OTA_VERIFYING);
+    slot = g_meshOtaRx.slot();
+    slotUs = g_meshOtaRx.offer().slotUs;
+    portEXIT_CRITICAL(&g_meshOtaMux);
+    if (!ours) return;
+    if (complete) wake |= OTA_WAKE_MESH_VERIFY;
   }
-  
-  delay(10);
-}
-
-// ============================================================
-// ESP-NOW FUNCTIONS
-// ============================================================
 
-void initESPNow() {
-  Serial.println("\n📡 Initializing ESP-NOW...");
-  
-  // WiFi.mode(WIFI_STA) already called in setup()
-  
-  // If not connected to WiFi, set fixed channel
-  if (!isConnectedToWiFi) {
-    WiFi.disconnect();
-    delay(100);
-    
-    // Force to fixed channel
-    esp_wifi_set_promiscuous(true);
-    esp_wifi_set_channel(ESPNOW_CHANNEL, WIFI_SECOND_CHAN_NONE);
-    esp_wifi_set_promiscuous(false);
+  g_meshOtaHeardMs = millis();
+  if (wake) otaWake(wake);
+  RadioCommand cmd = {};
+  cmd.type = RADIO_CMD_MESH_OTA_STATUS;
+  cmd.replyAtUs = (rxUs ? rxUs : esp_timer_get_time()) + (int64_t)(slot + 1) * slotUs;
+  queueRadioCommand(cmd);
+}
 
-    // Ensure clean state after channel set
-    g_promiscuousModeEnabled = false;
-    lastReceivedRssi = RSSI_UNKNOWN;
+// Worker task (hub): a slave's mesh update status; the radio task may have the
+// next round to send, the writer news for the phone
+static void handleMeshOtaStatus(const uint8_t* mac, const OtaStatus& status) {
+  portENTER_CRITICAL(&g_meshOtaMux);
+  bool taken = g_meshOtaTx.status(macKeyFromBytes(mac), status);
+  portEXIT_CRITICAL(&g_meshOtaMux);
+  if (!taken) return;
+  if (g_radioTaskHandle) xTaskNotifyGive(g_radioTaskHandle);
+  otaWake(OTA_WAKE_MESH_STATUS);
+}
 
-    Serial.printf("📡 ESP-NOW set to fixed channel: %d\n", ESPNOW_CHANNEL);
-  } else {
-    Serial.printf("📡 ESP-NOW using WiFi channel: %d\n", WiFi.channel());
-  }
-  
-  // Verify channel
-  uint8_t actualChannel;
-  wifi_second_chan_t dummy;
-  esp_wifi_get_channel(&actualChannel, &dummy);
-  Serial.printf("📡 Actual channel: %d\n", actualChannel);
-  
-  // Initialize ESP-NOW
-  if (esp_now_init() != ESP_OK) {
-    Serial.println("❌ ESP-NOW initialization failed!");
+// Worker task (hub): a slave's weigh-now answer; the last one ends the round early
+static void handleWeighReply(const uint8_t* mac, const WeighReply& reply) {
+  if (!isHub) return;
+  portENTER_CRITICAL(&g_weighMux);
+  bool accepted = g_weighNow.record(macKeyFromBytes(mac), reply);
+  bool complete = accepted && g_weighNow.complete();
+  portEXIT_CRITICAL(&g_weighMux);
+  if (!accepted) {
+    g_weighLateReplies++;
     return;
   }
-
-  // Promiscuous mode is expensive and increases WiFi workload, which can starve BLE
-  // We'll enable it dynamically only when acting as a hub
-  esp_wifi_set_promiscuous_rx_cb(nullptr);
-  Serial.println("📡 Promiscuous mode will be enabled only when hub (connected via BLE)");
-
-  // Register callbacks
-  esp_now_register_send_cb(onESPNowDataSent);
-  esp_now_register_recv_cb(onESPNowDataReceived);
-
-  Serial.printf("✅ ESP-NOW initialized | Channel: %d | RAM: %d bytes\n",
-                actualChannel, ESP.getFreeHeap());
+  if (complete) finishWeighNow();
 }
 
-// Promiscuous mode callback to capture RSSI
-void promiscuousRxCallback(void *buf, wifi_promiscuous_pkt_type_t type) {
-  if (type == WIFI_PKT_MGMT || type == WIFI_PKT_DATA) {
-    wifi_promiscuous_pkt_t *pkt = (wifi_promiscuous_pkt_t *)buf;
-    lastReceivedRssi = pkt->rx_ctrl.rssi;
+// Worker task: a sensor broadcast heard directly. Its route advertisement, or the
+// lack of one, is what the radio task chooses our parent from.
+static void hearNeighbor(const uint8_t* mac, uint16_t seq, const uint8_t* frame, const FrameHeader& header) {
+  MacKey hub = 0;
+  uint8_t hops = 0;
+  float cost = 0.0f;
+  const uint8_t* route;
+  uint8_t routeLen;
+  if (findFrameTlv(frame, header, TLV_HUB_ROUTE, &route, &routeLen) && routeLen >= HUB_ROUTE_TLV_SIZE) {
+    hub = macKeyFromBytes(route);
+    hops = route[6];
+    cost = route[7] / 10.0f;
   }
+  MacKey key = macKeyFromBytes(mac);
+  uint32_t now = millis();
+  portENTER_CRITICAL(&g_relayMux);
+  g_neighbors.heard(key, seq, now);
+  g_neighbors.advertised(key, hub, hops, cost);
+  portEXIT_CRITICAL(&g_relayMux);
 }
 
-void onESPNowDataReceived(const uint8_t *mac_addr, const uint8_t *incomingData, int len) {
-  // Validate data size
-  if (len != sizeof(ESPNowData)) {
-    Serial.printf("⚠️ Invalid ESP-NOW data size: got %d, expected %d\n", len, sizeof(ESPNowData));
+// Worker task: a relayed frame from neighbor 'mac'. Ours: unwrap it and handle it
+// as if heard from its origin. Otherwise pass it one hop on, unless it was seen
+// before, is out of hops or over the budget, or the only way on is back.
+static void handleRelayFrame(const uint8_t* mac, int64_t rxUs, const uint8_t* frame, int len, const FrameHeader& header) {
+  RelayHeader r;
+  const uint8_t* inner;
+  uint8_t innerLen;
+  if (!decodeRelayFrame(frame, header, r, &inner, &innerLen)) {
+    g_framesRejected++;
+    return;
+  }
+  MacKey self = macKeyFromString(deviceMAC.c_str());
+  MacKey origin = macKeyFromBytes(r.origin);
+  MacKey from = macKeyFromBytes(mac);
+  if (origin == self || g_relayDedup.seen(origin, r.seq)) {
+    g_relayDuplicates++;
+    return;
+  }
+  uint32_t now = millis();
+  portENTER_CRITICAL(&g_relayMux);
+  g_routes.learn(origin, from, (uint8_t)(r.hops + 1), now);
+  portEXIT_CRITICAL(&g_relayMux);
+
+  MacKey target = macKeyFromBytes(r.target);
+  if (target == self) {
+    g_relayDelivered++;
+    handleESPNowFrame(r.origin, inner, innerLen, RSSI_UNKNOWN, rxUs, (uint8_t)(r.hops + 1));
+    return;
+  }
+  if (r.ttl <= 1) {
+    g_relayExpired++;
+    return;
+  }
+  MacKey next = meshNextHop(target);
+  if (next == from) {
+    g_relayDrops++;
+    return;
+  }
+  if (!g_relayBudget.take((uint32_t)len, now)) {
+    g_relayBudgetDrops++;
+    return;
+  }
+  int slot = g_relayPool.acquire();
+  if (slot < 0) {
+    g_relayDrops++;
+    return;
+  }
+  memcpy(g_relayPool.data(slot), frame, len);
+  relayFrameStep(g_relayPool.data(slot));
+
+  RadioCommand cmd = {};
+  cmd.type = RADIO_CMD_RELAY;
+  cmd.relaySlot = (int8_t)slot;
+  cmd.relayLen = (uint8_t)len;
+  formatMacKey(next, cmd.targetMac);
+  if (!queueRadioCommand(cmd)) {
+    g_relayPool.release(slot);
+    g_relayDrops++;
     return;
   }
+  g_relayForwarded++;
+}
 
-  // Track mesh activity - we received data, so mesh is alive
-  g_lastMeshActivity = millis();
+// Worker task: parse, persist and log one received ESP-NOW frame. 'hops' > 0: it
+// was relayed, and mac is its origin rather than the neighbor that passed it on.
+void handleESPNowFrame(const uint8_t* mac, const uint8_t* frameData, int len, int8_t rssi, int64_t rxUs,
+                       uint8_t hops) {
+  if (!frameData) {
+    g_framesRejected++;
+    Serial.printf("⚠️ Invalid ESP-NOW data size: got %d, expected compact frame or %d\n", len, sizeof(ESPNowData));
+    return;
+  }
 
-  ESPNowData* data = (ESPNowData*)incomingData;
+  ESPNowData frame;
+  memset(&frame, 0, sizeof(frame));
+  ESPNowData* data = &frame;
+  uint8_t frameVersion = 0;
+  uint16_t seq = 0;
+  bool isCoeffs = false;
+  int channel = 1;
+  RegressionCoeffs newCoeffs;
+  uint32_t coeffVersions[2];
+  bool haveCoeffVersions = false;
+  int64_t sampleTimeUs = 0;
+  const uint8_t* firmware = nullptr;
+
+  if (isCompactFrame(frameData, len)) {
+    FrameHeader header;
+    if (!decodeFrameHeader(frameData, len, header)) {
+      g_framesRejected++;
+      Serial.printf("⚠️ Malformed ESP-NOW frame (%d bytes)\n", len);
+      return;
+    }
+    g_framesCompactRx++;
+    frameVersion = header.version;
+    seq = header.seq;
+
+    // Identity comes from the radio, not the payload
+    formatMacKey(macKeyFromBytes(mac), data->deviceMAC);
+
+    if (header.type == FRAME_SENSOR) {
+      if (hops == 0) hearNeighbor(mac, seq, frameData, header);
+      SensorReport report;
+      decodeSensorFrame(frameData, header, report);
+      data->ch1AirPressure = report.ch1AirPressure;
+      data->ch2AirPressure = report.ch2AirPressure;
+      data->atmosphericPressure = report.atmosphericPressure;
+      data->temperature = report.temperature;
+      data->elevation = report.elevation;
+      data->ch1Weight = report.ch1Weight;
+      data->ch2Weight = report.ch2Weight;
+      data->totalWeight = report.ch1Weight + report.ch2Weight;
+      data->ch1WeightStdDev = report.ch1WeightStdDev;
+      data->ch2WeightStdDev = report.ch2WeightStdDev;
+      data->settledFlags = report.settledFlags;
+      data->timestamp = report.timestamp;
+      data->batteryLevel = report.batteryLevel;
+      data->isCharging = report.isCharging;
+      data->messageType = MSG_TYPE_SENSOR_DATA;
+
+      const uint8_t* name;
+      uint8_t nameLen;
+      if (findFrameTlv(frameData, header, TLV_DEVICE_NAME, &name, &nameLen)) {
+        size_t n = nameLen < sizeof(data->deviceName) - 1 ? nameLen : sizeof(data->deviceName) - 1;
+        memcpy(data->deviceName, name, n);
+      }
+      const uint8_t* versions;
+      uint8_t versionsLen;
+      if (findFrameTlv(frameData, header, TLV_COEFF_VERSIONS, &versions, &versionsLen) && versionsLen >= 8) {
+        coeffVersions[0] = frameGetU32(versions);
+        coeffVersions[1] = frameGetU32(versions + 4);
+        haveCoeffVersions = true;
+      }
+      const uint8_t* sampleTime;
+      uint8_t sampleTimeLen;
+      if (findFrameTlv(frameData, header, TLV_SAMPLE_TIME, &sampleTime, &sampleTimeLen) && sampleTimeLen >= 8) {
+        sampleTimeUs = (int64_t)frameGetU64(sampleTime);
+      }
+      uint8_t firmwareLen;
+      if (!findFrameTlv(frameData, header, TLV_FIRMWARE, &firmware, &firmwareLen) || firmwareLen < FIRMWARE_TLV_SIZE) {
+        firmware = nullptr;
+      }
+    } else if (header.type == FRAME_COEFFS) {
+      CoeffsReport coeffs;
+      bool crcOk;
+      if (!decodeCoeffsFrame(frameData, header, coeffs, crcOk)) {
+        g_framesRejected++;
+        Serial.printf("⚠️ Short coefficients frame from %s\n", data->deviceMAC);
+        return;
+      }
+      applyCoeffsFrame(data->deviceMAC, coeffs, crcOk);
+      return;
+    } else if (header.type == FRAME_COEFFS_ACK) {
+      CoeffsAck ack;
+      if (!decodeCoeffsAckFrame(frameData, header, ack)) {
+        g_framesRejected++;
+        return;
+      }
+      handleCoeffsAckFrame(data->deviceMAC, ack);
+      return;
+    } else if (header.type == FRAME_TIME_SYNC) {
+      int64_t masterUs;
+      if (!decodeTimeSyncFrame(frameData, header, masterUs)) {
+        g_framesRejected++;
+        return;
+      }
+      const uint8_t* tails = nullptr;
+      uint8_t tailsLen = 0;
+      findFrameTlv(frameData, header, TLV_AIRTIME_SLOTS, &tails, &tailsLen);
+      handleTimeSyncBeacon(mac, rxUs, masterUs, tails, tailsLen / 2);
+      return;
+    } else if (header.type == FRAME_WEIGH_TRIGGER) {
+      handleWeighTrigger(mac, rxUs, frameData, header);
+      return;
+    } else if (header.type == FRAME_WEIGH_REPLY) {
+      WeighReply reply;
+      if (!decodeWeighReplyFrame(frameData, header, reply)) {
+        g_framesRejected++;
+        return;
+      }
+      handleWeighReply(mac, reply);
+      return;
+    } else if (header.type == FRAME_RELAY) {
+      if (hops > 0) {
+        g_framesRejected++;  // Relays don't nest
+        return;
+      }
+      handleRelayFrame(mac, rxUs, frameData, len, header);
+      return;
+    } else if (header.type == FRAME_OTA_OFFER || header.type == FRAME_OTA_DATA || header.type == FRAME_OTA_POLL) {
+      if (hops == 0) handleMeshOtaFrame(mac, rxUs, frameData, header);  // Only slaves the hub hears take part
+      return;
+    } else if (header.type == FRAME_OTA_STATUS) {
+      OtaStatus status;
+      if (!decodeOtaStatusFrame(frameData, header, status)) {
+        g_framesRejected++;
+        return;
+      }
+      handleMeshOtaStatus(mac, status);
+      return;
+    } else {
+      // A newer node's message type we don't know yet
+      g_framesRejected++;
+      return;
+    }
+  } else {
+    // Legacy ESPNowData (either size)
+    g_framesLegacyRx++;
+    g_lastLegacyPeerHeard = millis();
+    memcpy(&frame, frameData, len);
+    frame.deviceMAC[sizeof(frame.deviceMAC) - 1] = '\0';
+    frame.deviceName[sizeof(frame.deviceName) - 1] = '\0';
+
+    // Ignore our own broadcasts
+    if (strcmp(data->deviceMAC, deviceMAC.c_str()) == 0) {
+      return;
+    }
 
-  // Use the RSSI captured from promiscuous mode (or sentinel if promiscuous is off)
-  int8_t rssi = g_promiscuousModeEnabled ? lastReceivedRssi : RSSI_UNKNOWN;
+    if (data->messageType == MSG_TYPE_COEFFICIENTS_CH1 || data->messageType == MSG_TYPE_COEFFICIENTS_CH2) {
+      // Coefficients travel in reused fields
+      isCoeffs = true;
+      channel = (data->messageType == MSG_TYPE_COEFFICIENTS_CH1) ? 1 : 2;
+      newCoeffs.intercept = data->ch1AirPressure;
+      newCoeffs.airPressureCoeff = data->ch2AirPressure;
+      newCoeffs.ambientPressureCoeff = data->atmosphericPressure;
+      newCoeffs.airTempCoeff = data->temperature;
+    }
+  }
 
-  // Ignore our own broadcasts
-  if (strcmp(data->deviceMAC, deviceMAC.c_str()) == 0) {
-    return;
+  if (hops > 0) {
+    Serial.printf("📥 ESP-NOW RX from %s (relayed, %u hops, %s %d bytes): ", data->deviceMAC, hops,
+                 frameVersion ? "compact" : "legacy", len);
+  } else {
+    Serial.printf("📥 ESP-NOW RX from %s (RSSI: %d dBm, %s %d bytes): ", data->deviceMAC, rssi,
+                 frameVersion ? "compact" : "legacy", len);
   }
 
-  Serial.printf("📥 ESP-NOW RX from %s (RSSI: %d dBm): ", data->deviceMAC, rssi);
-  
-  // Check message type
-  if (data->messageType == MSG_TYPE_COEFFICIENTS_CH1 || data->messageType == MSG_TYPE_COEFFICIENTS_CH2) {
+  if (isCoeffs) {
     // This is a coefficient update
-    int channel = (data->messageType == MSG_TYPE_COEFFICIENTS_CH1) ? 1 : 2;
     Serial.printf("CH%d COEFFICIENTS UPDATE\n", channel);
 
-    // Extract coefficients from reused fields
-    RegressionCoeffs newCoeffs;
-    newCoeffs.intercept = data->ch1AirPressure;
-    newCoeffs.airPressureCoeff = data->ch2AirPressure;
-    newCoeffs.ambientPressureCoeff = data->atmosphericPressure;
-    newCoeffs.airTempCoeff = data->temperature;
-
-    if (channel == 1) {
-      float oldIntercept = ch1Coeffs.intercept;
-      ch1Coeffs = newCoeffs;
-      preferences.putFloat("ch1_intercept", ch1Coeffs.intercept);
-      preferences.putFloat("ch1_air_coeff", ch1Coeffs.airPressureCoeff);
-      preferences.putFloat("ch1_amb_coeff", ch1Coeffs.ambientPressureCoeff);
-      preferences.putFloat("ch1_temp_coeff", ch1Coeffs.airTempCoeff);
-      Serial.printf("✅ CH1 Coefficients updated: intercept %.4f → %.4f\n",
-                   oldIntercept, ch1Coeffs.intercept);
-    } else {
-      float oldIntercept = ch2Coeffs.intercept;
-      ch2Coeffs = newCoeffs;
-      preferences.putFloat("ch2_intercept", ch2Coeffs.intercept);
-      preferences.putFloat("ch2_air_coeff", ch2Coeffs.airPressureCoeff);
-      preferences.putFloat("ch2_amb_coeff", ch2Coeffs.ambientPressureCoeff);
-      preferences.putFloat("ch2_temp_coeff", ch2Coeffs.airTempCoeff);
-      Serial.printf("✅ CH2 Coefficients updated: intercept %.4f → %.4f\n",
-                   oldIntercept, ch2Coeffs.intercept);
-    }
+    float oldIntercept = liveCoeffs(channel).intercept;
+    saveChannelCoeffs(channel, newCoeffs);
+    Serial.printf("✅ CH%d Coefficients updated: intercept %.4f → %.4f\n",
+                 channel, oldIntercept, newCoeffs.intercept);
   } else {
     // This is sensor data
-    Serial.printf("CH1=%.1f lbs | CH2=%.1f lbs | Total=%.1f lbs\n",
-                 data->ch1Weight, data->ch2Weight, data->totalWeight);
-    updateDeviceData(data, rssi);
+    Serial.printf("CH1=%.1f±%.0f lbs%s | CH2=%.1f±%.0f lbs%s | Total=%.1f lbs\n",
+                 data->ch1Weight, data->ch1WeightStdDev, (data->settledFlags & SETTLED_CH1) ? " ✓" : "",
+                 data->ch2Weight, data->ch2WeightStdDev, (data->settledFlags & SETTLED_CH2) ? " ✓" : "",
+                 data->totalWeight);
+    // Senders that aren't synced (or predate mesh time) sampled just before sending
+    bool stamped = sampleTimeUs == 0;
+    if (stamped) meshTime(rxUs, sampleTimeUs);
+    updateDeviceData(data, rssi, frameVersion, seq, sampleTimeUs, haveCoeffVersions ? coeffVersions : nullptr, hops,
+                     rxUs, firmware, stamped);
+    if (isHub && deviceConnected) {
+      g_fleetDirty = true;
+      if (g_bleTaskHandle) xTaskNotifyGive(g_bleTaskHandle);
+    }
   }
 }
 
+// Runs in the WiFi task: failures are logged by the worker. Only unicasts are
+// acknowledged, so only they count toward the failure rate.
 void onESPNowDataSent(const uint8_t *mac_addr, esp_now_send_status_t status) {
+  if (!(mac_addr[0] & 0x01)) {
+    if (status == ESP_NOW_SEND_SUCCESS) g_espnowUnicastSent++;
+    else g_espnowUnicastFailed++;
+  }
   if (status != ESP_NOW_SEND_SUCCESS) {
-    Serial.printf("📤 ESP-NOW TX FAILED to %02X:%02X:%02X:%02X:%02X:%02X\n",
-                 mac_addr[0], mac_addr[1], mac_addr[2],
-                 mac_addr[3], mac_addr[4], mac_addr[5]);
+    deferWork(DEFERRED_ESPNOW_TX_FAILED, nullptr, 0, mac_addr);
+  }
+}
+
+// Ensure a peer entry exists before esp_now_send()
+static void ensureESPNowPeer(const uint8_t* mac) {
+  if (!esp_now_is_peer_exist(mac)) {
+    esp_now_peer_info_t peerInfo = {};
+    memcpy(peerInfo.peer_addr, mac, 6);
+    peerInfo.channel = 0;  // Use current channel
+    peerInfo.encrypt = false;
+    esp_now_add_peer(&peerInfo);
   }
 }
 
-void broadcastMyData() {
-  SensorData sensorData = readSensors();
+// While any old node is still around, it only understands the full struct
+static bool legacyPeersPresent() {
+  unsigned long last = g_lastLegacyPeerHeard;
+  return last > 0 && millis() - last < LEGACY_PEER_TIMEOUT_MS;
+}
 
+static void sendLegacyBroadcast(const uint8_t* broadcastAddress, const SensorData& sensorData) {
   ESPNowData data;
   memset(&data, 0, sizeof(data));
 
@@ -907,108 +4049,809 @@ void broadcastMyData() {
   data.ch2Weight = sensorData.ch2Weight;
   data.totalWeight = sensorData.totalWeight;
   data.timestamp = millis();
-  data.batteryLevel = 85;  // TODO: Real battery reading
+  data.batteryLevel = 85;  // Old nodes have no "unknown"; they keep the placeholder they always got
   data.isCharging = false;
   data.messageType = MSG_TYPE_SENSOR_DATA;
 
-  // Broadcast to all devices
-  uint8_t broadcastAddress[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+  // Old nodes take exactly the original struct; the estimator fields stay behind
+  if (esp_now_send(broadcastAddress, (uint8_t*)&data, ESPNOW_DATA_V0_SIZE) == ESP_OK) {
+    g_espnowTxBytes += ESPNOW_DATA_V0_SIZE;
+  }
+}
 
-  // Add broadcast peer if not exists
-  if (!esp_now_is_peer_exist(broadcastAddress)) {
-    esp_now_peer_info_t peerInfo = {};
-    memcpy(peerInfo.peer_addr, broadcastAddress, 6);
-    peerInfo.channel = 0;  // Use current channel
-    peerInfo.encrypt = false;
-    esp_now_add_peer(&peerInfo);
+// holds: we're reporting on change (a hub listens), so the reading stands until the next one
+void broadcastMyData(const SensorSnapshot& snap, BroadcastReason reason, bool holds) {
+  SensorData sensorData = readSensors(snap);
+
+  SensorReport report;
+  report.ch1AirPressure = sensorData.ch1AirPressure;
+  report.ch2AirPressure = sensorData.ch2AirPressure;
+  report.atmosphericPressure = sensorData.atmosphericPressure;
+  report.temperature = sensorData.temperature;
+  report.elevation = sensorData.elevation;
+  report.ch1Weight = sensorData.ch1Weight;
+  report.ch2Weight = sensorData.ch2Weight;
+  report.ch1WeightStdDev = sensorData.ch1WeightStdDev;
+  report.ch2WeightStdDev = sensorData.ch2WeightStdDev;
+  report.timestamp = millis();
+  report.batteryLevel = readBatteryLevel();
+  report.settledFlags = sensorData.settledFlags | (holds ? REPORT_HOLDS : 0);
+  report.isCharging = false;
+
+  uint16_t seq = g_espnowTxSeq++;
+  uint8_t frame[ESPNOW_FRAME_MAX];
+  size_t len = encodeSensorFrame(frame, sizeof(frame), seq, report);
+
+  // Receivers remember the name, so it only needs to come round now and then
+  if (seq % ESPNOW_NAME_EVERY == 0) {
+    uint8_t nameLen = (uint8_t)(bleDeviceName.length() < 31 ? bleDeviceName.length() : 31);
+    size_t withName = frameAppendTlv(frame, len, sizeof(frame), TLV_DEVICE_NAME, bleDeviceName.c_str(), nameLen);
+    if (withName) len = withName;
+
+    // Lets the hub see which coefficients are live, also after it restarts
+    uint8_t versions[8];
+    framePutU32(versions, g_appliedCoeffVersion[0]);
+    framePutU32(versions + 4, g_appliedCoeffVersion[1]);
+    size_t withVersions = frameAppendTlv(frame, len, sizeof(frame), TLV_COEFF_VERSIONS, versions, sizeof(versions));
+    if (withVersions) len = withVersions;
+
+    // And which slaves a firmware update still has to reach
+    if (g_otaBaseShaValid) {
+      uint8_t firmware[FIRMWARE_TLV_SIZE];
+      parseFirmwareVersion(FIRMWARE_VERSION, &firmware[0], &firmware[1], &firmware[2]);
+      memcpy(firmware + 3, g_otaBaseSha, FIRMWARE_IMAGE_ID_SIZE);
+      size_t withFirmware = frameAppendTlv(frame, len, sizeof(frame), TLV_FIRMWARE, firmware, sizeof(firmware));
+      if (withFirmware) len = withFirmware;
+    }
+  }
+
+  // When the sample was taken, on mesh time, so the hub can line the fleet up
+  int64_t sampleTimeUs;
+  if (meshTime(snap.sampledUs, sampleTimeUs)) {
+    uint8_t sampleTime[8];
+    framePutU64(sampleTime, (uint64_t)sampleTimeUs);
+    size_t withTime = frameAppendTlv(frame, len, sizeof(frame), TLV_SAMPLE_TIME, sampleTime, sizeof(sampleTime));
+    if (withTime) len = withTime;
+    if (isHub) {
+      portENTER_CRITICAL(&g_timeSyncMux);
+      g_hubBroadcastWeight.sampleUs = sampleTimeUs;
+      g_hubBroadcastWeight.weight = sensorData.totalWeight;
+      portEXIT_CRITICAL(&g_timeSyncMux);
+    }
+  }
+
+  // Our way to the hub, for neighbors out of its range choosing theirs
+  MeshRoute route = meshRoute();
+  if (route.hub) {
+    uint8_t advert[HUB_ROUTE_TLV_SIZE];
+    macKeyToBytes(route.hub, advert);
+    advert[6] = route.hops;
+    advert[7] = (uint8_t)frameQuantize(route.cost, 10.0f, 0, 255);
+    size_t withRoute = frameAppendTlv(frame, len, sizeof(frame), TLV_HUB_ROUTE, advert, sizeof(advert));
+    if (withRoute) len = withRoute;
   }
 
-  esp_err_t result = esp_now_send(broadcastAddress, (uint8_t*)&data, sizeof(data));
+  // Broadcast to all devices
+  uint8_t broadcastAddress[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+  ensureESPNowPeer(broadcastAddress);
+
+  esp_err_t result = esp_now_send(broadcastAddress, frame, len);
+  bool legacy = legacyPeersPresent();
+  if (legacy) sendLegacyBroadcast(broadcastAddress, sensorData);
+
+  // Beyond the hub's range the broadcast doesn't reach it: a copy goes up the route
+  bool relayed = false;
+  if (!isHub && route.hops > 1) {
+    uint8_t hub[6];
+    macKeyToBytes(route.hub, hub);
+    relayed = meshSend(hub, frame, len);
+  }
 
   if (result == ESP_OK) {
-    Serial.printf("📡 Broadcast: CH1=%.1f lbs (%.2f psi) | CH2=%.1f lbs (%.2f psi) | Total=%.1f lbs | %s\n",
-                 data.ch1Weight, data.ch1AirPressure,
-                 data.ch2Weight, data.ch2AirPressure,
-                 data.totalWeight,
+    g_espnowTxBytes += len;
+    recordLatency(g_broadcastLatency, esp_timer_get_time() - snap.sampledUs);
+    static const char* const reasons[] = {"", "change", "loading", "heartbeat"};
+    Serial.printf("📡 Broadcast #%u %s (%u bytes%s%s): CH1=%.1f lbs (%.2f psi) | CH2=%.1f lbs (%.2f psi) | Total=%.1f lbs | %s\n",
+                 seq, reasons[reason], (unsigned)len, legacy ? " + legacy" : "", relayed ? " + relayed to hub" : "",
+                 sensorData.ch1Weight, sensorData.ch1AirPressure,
+                 sensorData.ch2Weight, sensorData.ch2AirPressure,
+                 sensorData.totalWeight,
                  isHub ? "HUB" : "DEVICE");
   } else {
     Serial.printf("❌ Broadcast failed: %d\n", result);
   }
 }
 
-void sendCoeffsToDevice(const char* targetMAC, RegressionCoeffs* targetCoeffs, int channel) {
-  Serial.printf("📤 Sending CH%d coefficients to %s\n", channel, targetMAC);
+// Register a unicast peer through the LRU cache, deleting the peer it displaces
+// (radio task only). False when every cached peer has a delivery in flight.
+static bool ensureUnicastPeer(const uint8_t* mac) {
+  MacKey evicted;
+  PeerCacheResult result = g_peerCache.acquire(macKeyFromBytes(mac), evicted);
+  if (result == PEER_FULL) return false;
+  if (evicted) {
+    uint8_t old[6];
+    macKeyToBytes(evicted, old);
+    esp_now_del_peer(old);
+  }
+  ensureESPNowPeer(mac);
+  return true;
+}
+
+// Radio task: unicast a frame to dest, wrapped in a relay frame when our route to
+// it goes through a neighbor. Direct sends need dest registered by the caller.
+static bool meshSend(const uint8_t* dest, const uint8_t* frame, size_t len) {
+  static uint16_t seq = 0;  // Our relay sequence, what relays suppress duplicates by
+  MacKey destKey = macKeyFromBytes(dest);
+  MacKey next = meshNextHop(destKey);
+  if (next == destKey) {
+    if (esp_now_send(dest, frame, len) != ESP_OK) return false;
+    g_espnowTxBytes += len;
+    return true;
+  }
 
-  // Parse target MAC
-  uint8_t macBytes[6];
-  if (sscanf(targetMAC, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx",
-         &macBytes[0], &macBytes[1], &macBytes[2],
-         &macBytes[3], &macBytes[4], &macBytes[5]) != 6) {
-    Serial.println("❌ Invalid target MAC format");
-    return;
+  uint8_t hop[6];
+  macKeyToBytes(next, hop);
+  if (!ensureUnicastPeer(hop)) {
+    g_relayDrops++;
+    return false;
+  }
+  RelayHeader r;
+  macKeyToBytes(macKeyFromString(deviceMAC.c_str()), r.origin);
+  memcpy(r.target, dest, 6);
+  r.seq = seq++;
+  r.ttl = RELAY_MAX_HOPS;
+  r.hops = 0;
+  uint8_t relay[ESPNOW_FRAME_MAX];
+  size_t relayLen = encodeRelayFrame(relay, sizeof(relay), r.seq, r, frame, len);
+  if (relayLen == 0) {
+    g_relayDrops++;
+    return false;
+  }
+  if (esp_now_send(hop, relay, relayLen) != ESP_OK) return false;
+  g_espnowTxBytes += relayLen;
+  g_relayOriginated++;
+  return true;
+}
+
+// Radio task: pass on a frame the worker accepted for relaying
+static void forwardRelayFrame(const RadioCommand& cmd) {
+  uint8_t hop[6];
+  macKeyToBytes(macKeyFromString(cmd.targetMac), hop);
+  if (ensureUnicastPeer(hop) && esp_now_send(hop, g_relayPool.data(cmd.relaySlot), cmd.relayLen) == ESP_OK) {
+    g_espnowTxBytes += cmd.relayLen;
+  } else {
+    g_relayDrops++;
+  }
+  g_relayPool.release(cmd.relaySlot);
+}
+
+// Old firmware only understands coefficients smuggled through the sensor fields
+// and never acks, so they go out once:
+// ch1AirPressure = intercept, ch2AirPressure = airPressureCoeff
+// atmosphericPressure = ambientPressureCoeff, temperature = airTempCoeff
+static bool sendLegacyCoeffs(const uint8_t* mac, const RadioCommand& cmd) {
+  if (!ensureUnicastPeer(mac)) {
+    Serial.printf("❌ No free ESP-NOW peer for legacy node %s\n", cmd.targetMac);
+    return false;
   }
 
-  // Create coefficient update packet
-  // We reuse some fields to send coefficients:
-  // ch1AirPressure = intercept, ch2AirPressure = airPressureCoeff
-  // atmosphericPressure = ambientPressureCoeff, temperature = airTempCoeff
   ESPNowData coeffsData;
   memset(&coeffsData, 0, sizeof(coeffsData));
 
   strncpy(coeffsData.deviceMAC, deviceMAC.c_str(), sizeof(coeffsData.deviceMAC) - 1);
   strncpy(coeffsData.deviceName, "COEFFS", sizeof(coeffsData.deviceName) - 1);
-  coeffsData.ch1AirPressure = targetCoeffs->intercept;
-  coeffsData.ch2AirPressure = targetCoeffs->airPressureCoeff;
-  coeffsData.atmosphericPressure = targetCoeffs->ambientPressureCoeff;
-  coeffsData.temperature = targetCoeffs->airTempCoeff;
+  coeffsData.ch1AirPressure = cmd.coeffs.intercept;
+  coeffsData.ch2AirPressure = cmd.coeffs.airPressureCoeff;
+  coeffsData.atmosphericPressure = cmd.coeffs.ambientPressureCoeff;
+  coeffsData.temperature = cmd.coeffs.airTempCoeff;
   coeffsData.timestamp = millis();
-  coeffsData.messageType = (channel == 1) ? MSG_TYPE_COEFFICIENTS_CH1 : MSG_TYPE_COEFFICIENTS_CH2;
+  coeffsData.messageType = (cmd.channel == 1) ? MSG_TYPE_COEFFICIENTS_CH1 : MSG_TYPE_COEFFICIENTS_CH2;
+  esp_err_t result = esp_now_send(mac, (uint8_t*)&coeffsData, ESPNOW_DATA_V0_SIZE);
+  if (result == ESP_OK) g_espnowTxBytes += ESPNOW_DATA_V0_SIZE;
 
-  // Add peer if not exists
-  if (!esp_now_is_peer_exist(macBytes)) {
-    esp_now_peer_info_t peerInfo = {};
-    memcpy(peerInfo.peer_addr, macBytes, 6);
-    peerInfo.channel = 0;
-    peerInfo.encrypt = false;
-    esp_now_add_peer(&peerInfo);
+  Serial.printf("📤 CH%d Coefficients to legacy node %s: %s (unacknowledged)\n",
+               cmd.channel, cmd.targetMac, result == ESP_OK ? "SUCCESS" : "FAILED");
+  return result == ESP_OK;
+}
+
+// Radio task: a batch record reached its final state; the last one to settle
+// triggers the final status notification
+static void settleCoeffBatchRecord(MacKey target, uint8_t channel, uint32_t version, uint8_t status) {
+  portENTER_CRITICAL(&g_coeffBatchMux);
+  bool settled = g_coeffBatch.settle(target, channel, version, status);
+  bool done = settled && !g_coeffBatch.inProgress();
+  portEXIT_CRITICAL(&g_coeffBatchMux);
+  if (done) notifyCoeffBatchStatus();
+}
+
+// Radio task (hub): hand the slave records of the current batch to the delivery queue
+static void queueCoeffBatch() {
+  static CoeffBatch batch;
+  portENTER_CRITICAL(&g_coeffBatchMux);
+  batch = g_coeffBatch;
+  portEXIT_CRITICAL(&g_coeffBatchMux);
+
+  for (uint8_t i = 0; i < batch.count; i++) {
+    const CoeffBatchRecord& r = batch.records[i];
+    if (r.target == 0 || r.status != COEFF_REC_QUEUED) continue;
+    RadioCommand cmd = {};
+    cmd.type = RADIO_CMD_SEND_COEFFS;
+    cmd.channel = r.channel;
+    formatMacKey(r.target, cmd.targetMac);
+    cmd.coeffs.intercept = r.intercept;
+    cmd.coeffs.airPressureCoeff = r.airPressureCoeff;
+    cmd.coeffs.ambientPressureCoeff = r.ambientPressureCoeff;
+    cmd.coeffs.airTempCoeff = r.airTempCoeff;
+    cmd.version = r.version;
+    uint8_t status = queueCoeffsDelivery(cmd);
+    if (status != COEFF_REC_QUEUED) settleCoeffBatchRecord(r.target, r.channel, r.version, status);
+  }
+}
+
+// Radio task: hand a coefficient set to the delivery queue. Returns the
+// CoeffRecordStatus it ends up in for now (COEFF_REC_QUEUED while in flight).
+uint8_t queueCoeffsDelivery(const RadioCommand& cmd) {
+  MacKey key = macKeyFromString(cmd.targetMac);
+  if (key == 0) {
+    Serial.println("❌ Invalid target MAC format");
+    return COEFF_REC_INVALID;
+  }
+  uint8_t mac[6];
+  macKeyToBytes(key, mac);
+
+  DeviceData target;
+  if (findDeviceSnapshot(key, target) && target.frameVersion == 0) {
+    return sendLegacyCoeffs(mac, cmd) ? COEFF_REC_SENT : COEFF_REC_DROPPED;
+  }
+
+  CoeffsReport coeffs;
+  coeffs.channel = cmd.channel;
+  coeffs.intercept = cmd.coeffs.intercept;
+  coeffs.airPressureCoeff = cmd.coeffs.airPressureCoeff;
+  coeffs.ambientPressureCoeff = cmd.coeffs.ambientPressureCoeff;
+  coeffs.airTempCoeff = cmd.coeffs.airTempCoeff;
+  coeffs.version = cmd.version;
+  uint32_t superseded;
+  if (!g_coeffDeliveries.enqueue(key, coeffs, esp_timer_get_time(), &superseded)) {
+    Serial.printf("❌ Coefficient delivery table full - CH%d to %s dropped\n", cmd.channel, cmd.targetMac);
+    return COEFF_REC_DROPPED;
+  }
+  if (superseded != 0 && superseded != cmd.version) {
+    settleCoeffBatchRecord(key, cmd.channel, superseded, COEFF_REC_SUPERSEDED);
+  }
+  Serial.printf("📤 Queued CH%d coefficients v%u for %s (%u pending)\n",
+               cmd.channel, cmd.version, cmd.targetMac, g_coeffDeliveries.pending());
+  return COEFF_REC_QUEUED;
+}
+
+// Radio task: a slave confirmed a set
+static void completeCoeffsDelivery(const RadioCommand& cmd) {
+  MacKey key = macKeyFromString(cmd.targetMac);
+  CoeffDelivery* d = g_coeffDeliveries.findInFlight(key, cmd.channel, cmd.version);
+  if (!d) return;  // Ack for a retransmitted copy, or the set was superseded
+
+  uint8_t attempts = d->attempts;
+  g_peerCache.unpin(key);
+  recordLatency(g_coeffDeliveryLatency, g_coeffDeliveries.finish(d, true, esp_timer_get_time()));
+  Serial.printf("✅ CH%d coefficients v%u acknowledged by %s (send %u)\n",
+               cmd.channel, cmd.version, cmd.targetMac, attempts);
+  settleCoeffBatchRecord(key, cmd.channel, cmd.version, COEFF_REC_DELIVERED);
+}
+
+// Radio task: give up on deliveries out of attempts, then (re)send whatever is due
+// while it still fits our airtime slot; the rest waits for the next one
+void serviceCoeffDeliveries(const AirtimePlan& plan, int64_t nowUs, int64_t planNowUs) {
+  int64_t now = esp_timer_get_time();
+  CoeffDelivery* d;
+  while ((d = g_coeffDeliveries.nextExpired(now)) != nullptr) {
+    char mac[18];
+    formatMacKey(d->target, mac);
+    Serial.printf("❌ CH%u coefficients v%u to %s not acknowledged after %u sends\n",
+                 d->coeffs.channel, d->coeffs.version, mac, d->attempts);
+    g_peerCache.unpin(d->target);
+    g_coeffDeliveries.finish(d, false, now);
+    settleCoeffBatchRecord(d->target, d->coeffs.channel, d->coeffs.version, COEFF_REC_FAILED);
+  }
+
+  const uint32_t airUs = espnowAirUs(ESPNOW_FRAME_HEADER_SIZE + COEFFS_FIXED_SIZE);
+  for (;;) {
+    int64_t t = esp_timer_get_time();
+    if (slotTxAt(plan, nowUs, planNowUs, t, airUs) > t) break;
+    if ((d = g_coeffDeliveries.nextDue(now)) == nullptr) break;
+    uint8_t mac[6];
+    macKeyToBytes(d->target, mac);
+    if (d->state == DELIVERY_QUEUED) {
+      if (!ensureUnicastPeer(mac)) break;  // Picked up again when a delivery finishes
+      g_peerCache.pin(d->target);
+    }
+    uint8_t frame[ESPNOW_FRAME_HEADER_SIZE + COEFFS_FIXED_SIZE];
+    size_t len = encodeCoeffsFrame(frame, sizeof(frame), g_coeffTxSeq++, d->coeffs);
+    meshSend(mac, frame, len);
+    // A refused send still counts as an attempt; the backoff paces the retry.
+    // Jitter keeps retransmits to several slaves from lining up.
+    g_coeffDeliveries.sent(d, now, esp_random() % (COEFF_RETRY_BASE_MS * 250));
+  }
+
+  CoeffBatchResult batch;
+  if (g_coeffDeliveries.takeBatchResult(batch)) {
+    g_lastCoeffPush = batch;
+    Serial.printf("📦 Coefficient push finished: %u delivered, %u failed in %lld ms\n",
+                 batch.delivered, batch.failed, (long long)(batch.durationUs / 1000));
+  }
+}
+
+// Radio task (slave): answer the hub
+void sendCoeffsAck(const RadioCommand& cmd) {
+  MacKey key = macKeyFromString(cmd.targetMac);
+  if (key == 0) return;
+  uint8_t mac[6];
+  macKeyToBytes(key, mac);
+  if (!ensureUnicastPeer(mac)) return;
+
+  CoeffsAck ack;
+  ack.channel = cmd.channel;
+  ack.version = cmd.version;
+  ack.status = cmd.status;
+  uint8_t frame[ESPNOW_FRAME_HEADER_SIZE + COEFFS_ACK_FIXED_SIZE];
+  size_t len = encodeCoeffsAckFrame(frame, sizeof(frame), g_coeffTxSeq++, ack);
+  meshSend(mac, frame, len);
+}
+
+// Radio task (hub): airtime slots go to the slaves heard directly (those hear the
+// beacon) that send compact frames, in registry order so they stay put. Returns how
+// many were listed.
+static uint8_t airtimeRoster(uint8_t* tails) {
+  uint8_t listed = 0;
+  int slots = deviceSlotsInUse();
+  for (int i = 0; i < slots && listed < AIRTIME_MAX_SLOTS - AIRTIME_SPARE_SLOTS; i++) {
+    DeviceData device;
+    if (readDevice(i, device) && device.isActive && device.frameVersion > 0 && device.hops == 0) {
+      framePutU16(tails + 2 * listed++, (uint16_t)(device.macKey & 0xFFFF));
+    }
+  }
+  return listed;
+}
+
+// Radio task (hub): mesh time beacon, stamped right before the send, with the
+// airtime slot list. Beacons have their own sequence so receivers' loss counts on
+// sensor frames stay gap free.
+void sendTimeSyncBeacon() {
+  static uint16_t seq = 0;
+  uint8_t broadcastAddress[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+  ensureESPNowPeer(broadcastAddress);
+
+  uint8_t tails[2 * AIRTIME_MAX_SLOTS];
+  uint8_t listed = airtimeRoster(tails);
+  portENTER_CRITICAL(&g_airtimeMux);
+  g_airtime.assignHub(listed);
+  portEXIT_CRITICAL(&g_airtimeMux);
+
+  uint8_t frame[ESPNOW_FRAME_HEADER_SIZE + TIME_SYNC_FIXED_SIZE + 2 + 2 * AIRTIME_MAX_SLOTS];
+  size_t len = encodeTimeSyncFrame(frame, sizeof(frame), seq++, esp_timer_get_time());
+  if (listed > 0) len = frameAppendTlv(frame, len, sizeof(frame), TLV_AIRTIME_SLOTS, tails, (uint8_t)(2 * listed));
+  if (esp_now_send(broadcastAddress, frame, len) == ESP_OK) {
+    g_espnowTxBytes += len;
+    g_timeSyncBeaconsSent++;
+  }
+}
+
+// Any task (hub): end the current weigh-now round; the first caller hands the
+// result to the BLE task
+static void finishWeighNow() {
+  portENTER_CRITICAL(&g_weighMux);
+  bool first = g_weighNow.finish();
+  portEXIT_CRITICAL(&g_weighMux);
+  if (!first) return;
+  g_weighResultDirty = true;
+  if (g_bleTaskHandle) xTaskNotifyGive(g_bleTaskHandle);
+}
+
+// Radio task (hub): broadcast the trigger of round 'id' and take part in it. The
+// instant is set here, right before the send, so the lead isn't eaten by queueing.
+static void startWeighRound(WeighJob& job, uint8_t id) {
+  static uint16_t seq = 0;
+  static_assert(ESPNOW_FRAME_HEADER_SIZE + WEIGH_TRIGGER_FIXED_SIZE + 2 + 2 * MAX_DEVICES <= ESPNOW_FRAME_MAX,
+                "a full roster fits one trigger");
+  uint8_t tails[2 * MAX_DEVICES];
+  portENTER_CRITICAL(&g_weighMux);
+  bool current = g_weighNow.running() && g_weighNow.id() == id;
+  uint8_t listed = g_weighNow.slotTails(tails, sizeof(tails));
+  portEXIT_CRITICAL(&g_weighMux);
+  if (!current) return;
+
+  WeighTrigger t;
+  t.id = id;
+  t.sampleAtUs = esp_timer_get_time() + WEIGH_LEAD_MS * 1000LL;
+  t.replyAfterMs = WEIGH_CAPTURE_MS;
+  t.slotUs = WEIGH_SLOT_US;
+  t.slots = (uint8_t)(listed + WEIGH_SPARE_SLOTS);
+
+  uint8_t broadcastAddress[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+  ensureESPNowPeer(broadcastAddress);
+  uint8_t frame[ESPNOW_FRAME_MAX];
+  for (int copy = 0; copy < WEIGH_TRIGGER_COPIES; copy++) {
+    t.masterUs = esp_timer_get_time();
+    size_t len = encodeWeighTriggerFrame(frame, sizeof(frame), seq++, t);
+    if (listed > 0) len = frameAppendTlv(frame, len, sizeof(frame), TLV_WEIGH_SLOTS, tails, (uint8_t)(2 * listed));
+    if (esp_now_send(broadcastAddress, frame, len) == ESP_OK) g_espnowTxBytes += len;
   }
 
-  // Send
-  esp_err_t result = esp_now_send(macBytes, (uint8_t*)&coeffsData, sizeof(coeffsData));
+  job = {};
+  job.state = WEIGH_SAMPLING;
+  job.hub = true;
+  job.id = id;
+  job.flags = WEIGH_REPLY_SYNCED;  // The hub's clock is mesh time
+  job.sampleAtUs = t.sampleAtUs;
+  job.deadlineUs = t.sampleAtUs + (WEIGH_CAPTURE_MS + WEIGH_GRACE_MS) * 1000LL + (int64_t)t.slots * WEIGH_SLOT_US;
+}
+
+// Radio task (slave): answer the hub. Own sequence: the hub's loss count follows
+// sensor frames.
+static void sendWeighReply(const WeighJob& job) {
+  static uint16_t seq = 0;
+  if (!ensureUnicastPeer(job.hubMac)) return;
+  uint8_t frame[ESPNOW_FRAME_HEADER_SIZE + WEIGH_REPLY_FIXED_SIZE];
+  size_t len = encodeWeighReplyFrame(frame, sizeof(frame), seq++, job.reply);
+  if (meshSend(job.hubMac, frame, len)) g_weighReplies++;
+}
+
+// Radio task: read the weights once the instant has passed, then (slave) answer in
+// our slot or (hub) wait for the slots to pass
+static void serviceWeighJob(WeighJob& job, const SampleHistory& history) {
+  int64_t now = esp_timer_get_time();
+  if (job.state == WEIGH_SAMPLING && now >= job.sampleAtUs + WEIGH_CAPTURE_MS * 1000LL) {
+    if (!sampleHistoryAt(history, job.sampleAtUs, job.reply)) {
+      // No sample after the instant: acquisition stalled, use the newest there is
+      memset(&job.reply, 0, sizeof(job.reply));
+      if (history.count > 0) {
+        const SensorSnapshot& s = history.samples[(history.head + WEIGH_SAMPLE_HISTORY - 1) % WEIGH_SAMPLE_HISTORY];
+        job.reply.ch1Weight = s.ch1Weight;
+        job.reply.ch2Weight = s.ch2Weight;
+        job.reply.ch1WeightStdDev = s.ch1WeightStdDev;
+        job.reply.ch2WeightStdDev = s.ch2WeightStdDev;
+        job.reply.flags = s.settledFlags & (SETTLED_CH1 | SETTLED_CH2);
+      }
+      job.reply.flags |= WEIGH_REPLY_STALE;
+    }
+    job.reply.id = job.id;
+    job.reply.flags |= job.flags;
+
+    if (job.hub) {
+      portENTER_CRITICAL(&g_weighMux);
+      bool current = g_weighNow.running() && g_weighNow.id() == job.id;
+      if (current) g_weighNow.setHub(job.reply);
+      bool complete = current && g_weighNow.complete();
+      portEXIT_CRITICAL(&g_weighMux);
+      if (complete) finishWeighNow();
+      job.state = current ? WEIGH_COLLECTING : WEIGH_IDLE;
+    } else {
+      job.state = WEIGH_REPLYING;
+    }
+  }
+  if (job.state == WEIGH_REPLYING && now >= job.replyAtUs) {
+    sendWeighReply(job);
+    job.state = WEIGH_IDLE;
+  }
+  if (job.state == WEIGH_COLLECTING && now >= job.deadlineUs) {
+    finishWeighNow();  // No-op if every slave already answered
+    job.state = WEIGH_IDLE;
+  }
+}
+
+// Radio task (hub): one frame of the mesh update. Broadcasts get no MAC retries, and
+// a data frame the driver has no room for waits a tick rather than costing a round.
+static void sendMeshOtaFrame(MeshOtaSend what, uint16_t arg) {
+  static uint16_t seq = 0;
+  uint8_t targets[6 * MESH_OTA_MAX_TARGETS];
+  portENTER_CRITICAL(&g_meshOtaMux);
+  uint16_t session = g_meshOtaTx.session();
+  MeshOtaLayout layout = g_meshOtaTx.layout();
+  uint8_t listed = g_meshOtaTx.targetList(targets, sizeof(targets));
+  portEXIT_CRITICAL(&g_meshOtaMux);
+
+  static_assert(ESPNOW_FRAME_HEADER_SIZE + OTA_OFFER_FIXED_SIZE + 2 + 6 * MESH_OTA_MAX_TARGETS <= ESPNOW_FRAME_MAX,
+                "every target fits one offer");
+  uint8_t frame[ESPNOW_FRAME_MAX];
+  size_t len = 0;
+  if (what == MESH_OTA_SEND_OFFER) {
+    OtaOffer offer;
+    offer.session = session;
+    offer.imageSize = layout.imageSize;
+    offer.chunkSize = layout.chunkSize;
+    offer.windowChunks = layout.windowChunks;
+    offer.slotUs = MESH_OTA_SLOT_US;
+    memcpy(offer.sha256, g_meshOtaSha, sizeof(offer.sha256));
+    memcpy(offer.firmware, g_meshOtaVersion, sizeof(offer.firmware));
+    len = encodeOtaOfferFrame(frame, sizeof(frame), seq++, offer);
+    len = frameAppendTlv(frame, len, sizeof(frame), TLV_OTA_TARGETS, targets, (uint8_t)(6 * listed));
+  } else if (what == MESH_OTA_SEND_DATA) {
+    uint8_t chunk[MESH_OTA_CHUNK_BYTES];
+    uint8_t n = layout.length(arg);
+    if (esp_partition_read(g_meshOtaPartition, layout.offset(arg), chunk, n) != ESP_OK) {
+      g_meshOtaSendErrors++;
+      return;
+    }
+    len = encodeOtaDataFrame(frame, sizeof(frame), seq++, session, arg, chunk, n);
+  } else {
+    OtaPoll poll = {session, arg};
+    len = encodeOtaPollFrame(frame, sizeof(frame), seq++, poll);
+  }
+
+  uint8_t broadcastAddress[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+  ensureESPNowPeer(broadcastAddress);
+  esp_err_t err = esp_now_send(broadcastAddress, frame, len);
+  for (int tries = 0; err == ESP_ERR_ESPNOW_NO_MEM && tries < 10; tries++) {
+    vTaskDelay(1);
+    err = esp_now_send(broadcastAddress, frame, len);
+  }
+  if (err == ESP_OK) g_espnowTxBytes += len;
+  else g_meshOtaSendErrors++;
+}
+
+// Radio task (slave): where our mesh update stands, to the hub
+static void sendMeshOtaStatus() {
+  static uint16_t seq = 0;
+  OtaStatus status;
+  uint8_t hub[6];
+  portENTER_CRITICAL(&g_meshOtaMux);
+  bool active = g_meshOtaRx.active();
+  g_meshOtaRx.status(status);
+  macKeyToBytes(g_meshOtaRx.hub(), hub);
+  portEXIT_CRITICAL(&g_meshOtaMux);
+  if (!active || !ensureUnicastPeer(hub)) return;
+  uint8_t frame[ESPNOW_FRAME_HEADER_SIZE + OTA_STATUS_FIXED_SIZE];
+  size_t len = encodeOtaStatusFrame(frame, sizeof(frame), seq++, status);
+  if (meshSend(hub, frame, len)) g_meshOtaStatusSent++;
+}
+
+// Radio task: the hub's push, everything due now (data frames are paced by the
+// sender); on a slave, our status once its slot comes, and a push gone quiet
+// dropped
+static void serviceMeshOta(int64_t& replyAtUs) {
+  for (;;) {
+    uint16_t arg = 0;
+    portENTER_CRITICAL(&g_meshOtaMux);
+    MeshOtaSend what = g_meshOtaTx.next(esp_timer_get_time(), arg);
+    portEXIT_CRITICAL(&g_meshOtaMux);
+    if (what == MESH_OTA_SEND_NONE) break;
+    sendMeshOtaFrame(what, arg);
+  }
+
+  if (esp_timer_get_time() >= replyAtUs) {
+    replyAtUs = INT64_MAX;
+    sendMeshOtaStatus();
+  }
+
+  portENTER_CRITICAL(&g_meshOtaMux);
+  uint8_t state = g_meshOtaRx.state();
+  bool expired = (state == MESH_OTA_PREPARING || state == MESH_OTA_RECEIVING || state == MESH_OTA_FAILED) &&
+                 millis() - g_meshOtaHeardMs > MESH_OTA_IDLE_MS;
+  if (expired) g_meshOtaRx.reset();
+  portEXIT_CRITICAL(&g_meshOtaMux);
+  if (expired) Serial.println("⚠️ Mesh OTA: hub went quiet, update dropped");
+}
+
+void initDeviceRegistry() {
+  size_t bytes = MAX_DEVICES * sizeof(Seqlock<DeviceData>);
+  void* storage = nullptr;
+  // Seqlocks only use plain 32-bit loads/stores, which are fine in external RAM
+  if (psramFound()) storage = heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM);
+  bool inPsram = storage != nullptr;
+  if (!storage) storage = malloc(bytes);
+  if (!storage) {
+    Serial.println("❌ Device registry allocation failed - fleet tracking disabled");
+    return;
+  }
+
+  knownDevices = (Seqlock<DeviceData>*)storage;
+  for (int i = 0; i < MAX_DEVICES; i++) new (&knownDevices[i]) Seqlock<DeviceData>();
 
-  Serial.printf("📤 CH%d Coefficients to %s: %s (intercept=%.4f, air=%.4f)\n",
-               channel, targetMAC,
-               result == ESP_OK ? "SUCCESS" : "FAILED",
-               targetCoeffs->intercept,
-               targetCoeffs->airPressureCoeff);
+  // Hand out low slots first so the reader scan stays short
+  for (int i = 0; i < MAX_DEVICES; i++) g_freeDeviceSlots[i] = MAX_DEVICES - 1 - i;
+  g_freeDeviceSlotCount = MAX_DEVICES;
+
+  Serial.printf("✅ Device registry: %d slots (%u KB %s)\n",
+                MAX_DEVICES, (unsigned)(bytes / 1024), inPsram ? "PSRAM" : "heap");
+}
+
+// Writer side (caller holds g_deviceWriteMux): drop a device and free its slot
+static void releaseDeviceSlot(int slot) {
+  MacKey key = knownDevices[slot].current().macKey;
+  if (key == 0) return;
+  g_deviceIndex.erase(key);
+  DeviceData& device = knownDevices[slot].edit();
+  memset(&device, 0, sizeof(device));
+  knownDevices[slot].publish();
+  g_freeDeviceSlots[g_freeDeviceSlotCount++] = slot;
+  deviceCount.fetch_sub(1, std::memory_order_relaxed);
+}
+
+// Writer side: a free slot, else the least recently seen inactive device's slot
+// (reported through 'evicted'), else -1 when every slot holds an active device
+static int allocateDeviceSlot(MacKey& evicted) {
+  evicted = 0;
+  if (g_freeDeviceSlotCount == 0) {
+    int oldest = -1;
+    int high = g_deviceSlotHigh.load(std::memory_order_relaxed);
+    for (int i = 0; i < high; i++) {
+      const DeviceData& device = knownDevices[i].current();
+      if (device.macKey != 0 && !device.isActive &&
+          (oldest < 0 || (long)(device.lastSeen - knownDevices[oldest].current().lastSeen) < 0)) {
+        oldest = i;
+      }
+    }
+    if (oldest < 0) return -1;
+    evicted = knownDevices[oldest].current().macKey;
+    releaseDeviceSlot(oldest);
+    g_devicesEvicted++;
+  }
+
+  int slot = g_freeDeviceSlots[--g_freeDeviceSlotCount];
+  if (slot >= g_deviceSlotHigh.load(std::memory_order_relaxed)) {
+    g_deviceSlotHigh.store(slot + 1, std::memory_order_release);
+  }
+  return slot;
+}
+
+static void formatMacKey(MacKey key, char* out) {
+  uint8_t mac[6];
+  macKeyToBytes(key, mac);
+  snprintf(out, 18, "%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
+void updateDeviceData(ESPNowData* data, int8_t rssi, uint8_t frameVersion, uint16_t seq, int64_t sampleTimeUs,
+                      const uint32_t* coeffVersions, uint8_t hops, int64_t rxUs, const uint8_t* firmware,
+                      bool sampleStamped) {
+  if (!knownDevices) return;
+  MacKey key = macKeyFromString(data->deviceMAC);
+  if (key == 0) {
+    Serial.printf("⚠️ Ignoring frame with malformed MAC '%.17s'\n", data->deviceMAC);
+    return;
+  }
+
+  bool added = false;
+  MacKey evicted = 0;
+
+  portENTER_CRITICAL(&g_deviceWriteMux);
+  int slot = g_deviceIndex.find(key);
+  if (slot < 0) {
+    // Add new device
+    slot = allocateDeviceSlot(evicted);
+    if (slot >= 0) {
+      DeviceData& device = knownDevices[slot].edit();
+      memset(&device, 0, sizeof(device));
+      device.macKey = key;
+      strncpy(device.macAddress, data->deviceMAC, sizeof(device.macAddress) - 1);
+      linkStatsReset(device.link);
+      g_deviceIndex.insert(key, slot);
+      deviceCount.fetch_add(1, std::memory_order_relaxed);
+      added = true;
+    } else {
+      g_devicesRejected++;
+    }
+  }
+
+  if (slot >= 0) {
+    DeviceData& device = knownDevices[slot].edit();
+    if (frameVersion > 0) {
+      // Compact frames count gaps in the sender's sequence (a reboot restarts it)
+      uint16_t gap = (uint16_t)(seq - device.lastSeq - 1);
+      if (!added && device.frameVersion > 0 && gap > 0 && gap < 1000) {
+        device.framesLost += gap;
+        g_framesLost += gap;
+      }
+      device.lastSeq = seq;
+    }
+    device.frameVersion = frameVersion;
+    if (coeffVersions) {
+      device.coeffVersion[0] = coeffVersions[0];
+      device.coeffVersion[1] = coeffVersions[1];
+    }
+    if (firmware) {
+      memcpy(device.firmware, firmware, sizeof(device.firmware));
+      memcpy(device.imageId, firmware + 3, sizeof(device.imageId));
+    }
+    // Compact frames only carry the name now and then
+    if (data->deviceName[0]) {
+      strncpy(device.deviceName, data->deviceName, sizeof(device.deviceName) - 1);
+    }
+    memcpy(&device.lastData, data, sizeof(ESPNowData));
+    memcpy(device.lastData.deviceName, device.deviceName, sizeof(device.deviceName));
+    device.lastSeen = millis();
+    device.isActive = true;
+    if (hops == 0) {
+      // A relayed copy says nothing about our link to it
+      device.espNowRssi = rssi;
+      linkStatsUpdate(device.link, rssi, frameVersion > 0, seq, data->timestamp, rxUs ? rxUs : esp_timer_get_time());
+    }
+    device.hops = hops;
+    device.sampleTimeUs = sampleTimeUs;
+    device.sampleTimeStamped = sampleStamped;
+    knownDevices[slot].publish();
+  }
+  portEXIT_CRITICAL(&g_deviceWriteMux);
+
+  if (evicted) {
+    char mac[18];
+    formatMacKey(evicted, mac);
+    Serial.printf("♻️ Registry full - evicted %s\n", mac);
+  }
+  if (added) {
+    Serial.printf("✨ New device discovered: %s (%d/%d)\n", data->deviceMAC, deviceCount.load(), MAX_DEVICES);
+  } else if (slot < 0) {
+    Serial.printf("❌ Registry full of active devices - ignoring %s\n", data->deviceMAC);
+  }
 }
 
-void updateDeviceData(ESPNowData* data, int8_t rssi) {
-  DeviceData* device = findDevice(data->deviceMAC);
+// Consistent copy of one slot, safe from any task. False for free slots.
+bool readDevice(int index, DeviceData& out) {
+  if (!knownDevices || index < 0 || index >= g_deviceSlotHigh.load(std::memory_order_acquire)) return false;
+  uint32_t retries = knownDevices[index].read(out);
+  if (retries) g_deviceReadRetries += retries;
+  return out.macKey != 0;
+}
 
-  if (device == nullptr && deviceCount < MAX_DEVICES) {
-    // Add new device
-    device = &knownDevices[deviceCount++];
-    strncpy(device->macAddress, data->deviceMAC, sizeof(device->macAddress) - 1);
-    Serial.printf("✨ New device discovered: %s\n", data->deviceMAC);
+// Writer side: record the coefficient version a device acknowledged
+void setDeviceCoeffVersion(MacKey key, int channel, uint32_t version) {
+  if (!knownDevices || key == 0 || channel < 1 || channel > 2) return;
+  portENTER_CRITICAL(&g_deviceWriteMux);
+  int slot = g_deviceIndex.find(key);
+  if (slot >= 0) {
+    knownDevices[slot].edit().coeffVersion[channel - 1] = version;
+    knownDevices[slot].publish();
   }
+  portEXIT_CRITICAL(&g_deviceWriteMux);
+}
 
-  if (device != nullptr) {
-    strncpy(device->deviceName, data->deviceName, sizeof(device->deviceName) - 1);
-    memcpy(&device->lastData, data, sizeof(ESPNowData));
-    device->lastSeen = millis();
-    device->isActive = true;
-    device->espNowRssi = rssi;
+// Reader-side lookup by MAC (scans the slots; for occasional use off the RX path)
+bool findDeviceSnapshot(MacKey key, DeviceData& out) {
+  int slots = deviceSlotsInUse();
+  for (int i = 0; i < slots; i++) {
+    if (readDevice(i, out) && out.macKey == key) return true;
   }
+  return false;
 }
 
-DeviceData* findDevice(const char* mac) {
-  for (int i = 0; i < deviceCount; i++) {
-    if (strcmp(knownDevices[i].macAddress, mac) == 0) {
-      return &knownDevices[i];
+// Upper bound for iterating slots with readDevice()
+int deviceSlotsInUse() {
+  return g_deviceSlotHigh.load(std::memory_order_acquire);
+}
+
+// Mark devices not heard from within DEVICE_TIMEOUT_MS inactive, and free the
+// slots of devices silent for DEVICE_EVICT_MS. Returns how many went inactive.
+int expireDevices() {
+  if (!knownDevices) return 0;
+  MacKey expired[MAX_DEVICES];
+  int expiredCount = 0;
+  int freed = 0;
+  unsigned long now = millis();
+
+  portENTER_CRITICAL(&g_deviceWriteMux);
+  int high = g_deviceSlotHigh.load(std::memory_order_relaxed);
+  for (int i = 0; i < high; i++) {
+    DeviceData& device = knownDevices[i].edit();
+    if (device.macKey == 0) continue;
+    unsigned long age = now - device.lastSeen;
+    if (!device.isActive && age > DEVICE_EVICT_MS) {
+      releaseDeviceSlot(i);
+      freed++;
+    } else if (device.isActive && age > DEVICE_TIMEOUT_MS) {
+      device.isActive = false;
+      knownDevices[i].publish();
+      expired[expiredCount++] = device.macKey;
     }
   }
-  return nullptr;
+  portEXIT_CRITICAL(&g_deviceWriteMux);
+
+  for (int i = 0; i < expiredCount; i++) {
+    char mac[18];
+    formatMacKey(expired[i], mac);
+    Serial.printf("⚠️ Device %s marked inactive (timeout)\n", mac);
+  }
+  if (freed > 0) {
+    Serial.printf("♻️ Freed %d stale registry slots (%d/%d in use)\n", freed, deviceCount.load(), MAX_DEVICES);
+  }
+  return expiredCount;
 }
 
 // ============================================================
@@ -1032,12 +4875,14 @@ void initBLE() {
   esp_err_t mtuRes = esp_ble_gatt_set_local_mtu(247);
   Serial.printf("📏 esp_ble_gatt_set_local_mtu(247): %s\n", esp_err_to_name(mtuRes));
 
+  if (!g_bleTxDone) g_bleTxDone = xSemaphoreCreateBinary();
+  BLEDevice::setCustomGattsHandler(bleGattsEventHandler);
   BLEDevice::init(bleDeviceName.c_str());
 
   pServer = BLEDevice::createServer();
   pServer->setCallbacks(new MyServerCallbacks());
   
-  BLEService *pService = pServer->createService(SERVICE_UUID);
+  BLEService *pService = pServer->createService(BLEUUID(SERVICE_UUID), BLE_SERVICE_HANDLES);
   
   // Sensor data characteristic (notify phone of sensor readings)
   pSensorCharacteristic = pService->createCharacteristic(
@@ -1057,10 +4902,46 @@ void initBLE() {
   // WRITE for compatibility + WRITE_NR for speed (phone can choose)
   pOtaCharacteristic = pService->createCharacteristic(
       OTA_CHAR_UUID,
-      BLECharacteristic::PROPERTY_WRITE | BLECharacteristic::PROPERTY_WRITE_NR
+      BLECharacteristic::PROPERTY_WRITE | BLECharacteristic::PROPERTY_WRITE_NR |
+      BLECharacteristic::PROPERTY_NOTIFY
   );
+  pOtaCharacteristic->addDescriptor(new BLE2902());
   pOtaCharacteristic->setCallbacks(new OtaCallbacks());
-  Serial.println("📦 OTA characteristic initialized (WRITE + WRITE_NR)");
+  Serial.println("📦 OTA characteristic initialized (WRITE + WRITE_NR + NOTIFY: acks, resume)");
+
+  // History characteristic (phone requests a range, device streams compressed blocks)
+  pHistoryCharacteristic = pService->createCharacteristic(
+      HISTORY_CHAR_UUID,
+      BLECharacteristic::PROPERTY_WRITE | BLECharacteristic::PROPERTY_NOTIFY
+  );
+  pHistoryCharacteristic->addDescriptor(new BLE2902());
+  pHistoryCharacteristic->setCallbacks(new HistoryCallbacks());
+
+  // Publish policy characteristic (app sets notify rate limits and deadbands)
+  pPublishCharacteristic = pService->createCharacteristic(
+      PUBLISH_CHAR_UUID,
+      BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_WRITE
+  );
+  pPublishCharacteristic->setCallbacks(new PublishCallbacks());
+  uint8_t policy[PUBLISH_CONFIG_SIZE];
+  publishConfigEncode(readPublishConfig(), policy);
+  pPublishCharacteristic->setValue(policy, sizeof(policy));
+
+  // Calibration batch characteristic (binary records in, per-record status notified back)
+  pCoeffBatchCharacteristic = pService->createCharacteristic(
+      COEFF_BATCH_CHAR_UUID,
+      BLECharacteristic::PROPERTY_WRITE | BLECharacteristic::PROPERTY_NOTIFY
+  );
+  pCoeffBatchCharacteristic->addDescriptor(new BLE2902());
+  pCoeffBatchCharacteristic->setCallbacks(new CoeffBatchCallbacks());
+
+  // Weigh-now characteristic (phone requests a synchronized snapshot, result notified back)
+  pWeighNowCharacteristic = pService->createCharacteristic(
+      WEIGH_NOW_CHAR_UUID,
+      BLECharacteristic::PROPERTY_WRITE | BLECharacteristic::PROPERTY_NOTIFY
+  );
+  pWeighNowCharacteristic->addDescriptor(new BLE2902());
+  pWeighNowCharacteristic->setCallbacks(new WeighNowCallbacks());
 
   pService->start();
 
@@ -1085,40 +4966,14 @@ void initBLE() {
   g_adv->setMinPreferred(0x12);
 
   g_adv->start();  // Use global instance, not BLEDevice::startAdvertising()
+  g_advStartedMs = millis();
 
   bleEnabled = true;
   Serial.println("✅ BLE advertising started: " + bleDeviceName);
 }
 
-// Binary BLE notification packet structure (45 bytes - fits any MTU)
-// This replaces the ~300+ byte JSON that was getting truncated
-#pragma pack(push, 1)
-struct BLESensorPacket {
-  uint8_t  packetType;        // 0 = hub, 1 = device   (offset 0)
-  uint8_t  mac[6];            // MAC address bytes     (offset 1-6)
-  float    ch1AirPressure;    // 4 bytes               (offset 7-10)
-  float    ch2AirPressure;    // 4 bytes               (offset 11-14)
-  float    atmosphericPressure; // 4 bytes             (offset 15-18)
-  float    temperature;       // 4 bytes               (offset 19-22)
-  float    ch1Weight;         // 4 bytes               (offset 23-26)
-  float    ch2Weight;         // 4 bytes               (offset 27-30)
-  float    totalWeight;       // 4 bytes               (offset 31-34)
-  uint8_t  batteryLevel;      // 1 byte                (offset 35)
-  uint8_t  deviceCount;       // 1 byte (hub only)     (offset 36)
-  float    fleetTotalWeight;  // 4 bytes (hub only)    (offset 37-40)
-  uint8_t  fwMajor;           // 1 byte                (offset 41)
-  uint8_t  fwMinor;           // 1 byte                (offset 42)
-  uint8_t  fwPatch;           // 1 byte                (offset 43)
-  int8_t   espnowRssi;        // 1 byte (devices only) (offset 44)
-};  // Total: 45 bytes (packed)
-#pragma pack(pop)
-
-// Helper to parse MAC string "AA:BB:CC:DD:EE:FF" into 6 bytes
-void parseMacString(const char* macStr, uint8_t* macBytes) {
-  sscanf(macStr, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx",
-         &macBytes[0], &macBytes[1], &macBytes[2],
-         &macBytes[3], &macBytes[4], &macBytes[5]);
-}
+// Hub notifications use the fleet frame (ble_fleet_frame.h): every device record
+// that fits the negotiated MTU goes into one notification.
 
 // Helper to parse firmware version string "X.Y.Z" into bytes
 void parseFirmwareVersion(const char* version, uint8_t* major, uint8_t* minor, uint8_t* patch) {
@@ -1129,156 +4984,1012 @@ void parseFirmwareVersion(const char* version, uint8_t* major, uint8_t* minor, u
   *patch = (uint8_t)pat;
 }
 
-void sendAllDataViaBLE() {
-  if (!deviceConnected || !bleEnabled) return;
+// Send one notification and wait for the stack to confirm it (and for a congested
+// link to clear) rather than sleeping a fixed gap. False if it never confirmed.
+static bool notifyAndWait(BLECharacteristic* characteristic, const uint8_t* frame, size_t len) {
+  TickType_t timeout = pdMS_TO_TICKS(BLE_NOTIFY_TIMEOUT_MS);
+  xSemaphoreTake(g_bleTxDone, 0);  // Drop a stale confirmation
+  while (g_bleCongested) {
+    if (xSemaphoreTake(g_bleTxDone, timeout) != pdTRUE) {
+      g_bleNotifyStalls++;
+      return false;
+    }
+  }
 
-  // Read my own sensor data
-  SensorData myData = readSensors();
+  characteristic->setValue((uint8_t*)frame, len);
+  characteristic->notify();
+  if (xSemaphoreTake(g_bleTxDone, timeout) != pdTRUE) {
+    g_bleNotifyStalls++;
+    return false;
+  }
+  return true;
+}
 
-  // Count active devices and sum weights
-  int activeDevices = 0;
-  float fleetTotalWeight = myData.totalWeight;
+// BLE task: the finished weigh-now round, split over as many notifications as the
+// MTU needs (12 records per frame at 247)
+static void sendWeighResult() {
+  static WeighNowCollector<MAX_DEVICES + 1> result;
+  portENTER_CRITICAL(&g_weighMux);
+  result = g_weighNow;
+  portEXIT_CRITICAL(&g_weighMux);
+  if (!result.finished() || !pWeighNowCharacteristic) return;  // A new round started meanwhile
+
+  uint8_t frame[BLE_FLEET_MAX_FRAME];
+  uint16_t mtu = pServer->getPeerMTU(pServer->getConnId());
+  size_t cap = (mtu > 23 ? mtu : 23) - 3;
+  if (cap > sizeof(frame)) cap = sizeof(frame);
+  int64_t elapsedUs = esp_timer_get_time() - result.startUs();
+  uint16_t elapsedMs = (uint16_t)(elapsedUs / 1000 < 65535 ? elapsedUs / 1000 : 65535);
+
+  uint16_t next = 0;
+  uint8_t index = 0;
+  for (;;) {
+    size_t len = result.encodeResult(frame, cap, index, elapsedMs, next);
+    if (len == 0 || !notifyAndWait(pWeighNowCharacteristic, frame, len)) {
+      Serial.printf("❌ Weigh-now result #%u not delivered (MTU %u)\n", result.id(), mtu);
+      return;
+    }
+    if (frame[3] & WEIGH_RESULT_LAST) break;
+    index++;
+  }
+
+  recordLatency(g_weighLatency, esp_timer_get_time() - result.startUs());
+  g_weighLastAnswered = result.answered();
+  g_weighLastExpected = result.expected();
+  if (result.complete()) g_weighComplete++;
+  Serial.printf("⚖️ Weigh now #%u: %u/%u slaves answered | Fleet=%.1f lbs | %u frames | %.1f ms\n",
+               result.id(), result.answered(), result.expected(), result.total(), index + 1,
+               (esp_timer_get_time() - result.startUs()) / 1000.0);
+}
+
+// Coherence window test for the fleet total; a window of 0 takes every fresh sample
+static bool inCoherenceWindow(int64_t sampleUs, int64_t referenceUs, int64_t windowUs) {
+  if (windowUs == 0) return true;
+  if (sampleUs == 0) return false;  // Time unknown
+  int64_t delta = sampleUs - referenceUs;
+  return delta <= windowUs && delta >= -windowUs;
+}
+
+// A device reporting on change still weighs what it last said: its reading counts
+// as taken at the reference time. So does one that can't say when it sampled
+// (legacy or unsynced, stamped on receive): the window can't judge a receive time,
+// so it is summed as is and its record is flagged unaligned.
+static int64_t fleetSampleUs(const DeviceData& device, int64_t referenceUs) {
+  int64_t sampleUs = device.sampleTimeUs;
+  if (device.sampleTimeStamped) return referenceUs;
+  if ((device.lastData.settledFlags & REPORT_HOLDS) && sampleUs != 0 && sampleUs < referenceUs) return referenceUs;
+  return sampleUs;
+}
+
+static int16_t fleetSkewMs(int64_t sampleUs, int64_t referenceUs) {
+  if (sampleUs == 0) return BLE_FLEET_SKEW_UNKNOWN;
+  int64_t ms = (sampleUs - referenceUs) / 1000;
+  return (int16_t)(ms > 32767 ? 32767 : (ms < -32767 ? -32767 : ms));
+}
+
+// full = heartbeat with every device; otherwise only the records that moved past
+// their deadband (the hub record always goes, it carries the fleet totals)
+void sendAllDataViaBLE(const SensorSnapshot& snap, bool full) {
+  if (!deviceConnected || !bleEnabled) return;
+  int64_t startUs = esp_timer_get_time();
+  PublishConfig config = readPublishConfig();
+
+  uint8_t frame[BLE_FLEET_MAX_FRAME];
+  uint16_t mtu = pServer->getPeerMTU(pServer->getConnId());
+  size_t cap = (mtu > 23 ? mtu : 23) - 3;  // ATT notification header
+  if (cap > sizeof(frame)) cap = sizeof(frame);
+  if (cap < BLE_FLEET_HEADER_SIZE + BLE_FLEET_RECORD_SIZE) {
+    g_bleNotifyStalls++;
+    Serial.printf("⚠️ BLE MTU %u too small for a fleet frame\n", mtu);
+    return;
+  }
 
-  for (int i = 0; i < deviceCount; i++) {
-    if (knownDevices[i].isActive && millis() - knownDevices[i].lastSeen < 60000) {
+  // Fleet total from a coherent set of samples, on mesh time (the hub's clock): the
+  // newest device sample is the reference and only samples within the coherence
+  // window of it are summed, plus the unaligned readings (see fleetSampleUs). The hub contributes whichever of its live sample and
+  // its last broadcast (taken on the same grid as the slaves') is closer.
+  int64_t windowUs = (int64_t)config.coherenceMs * 1000;
+  int64_t reference = snap.sampledUs;
+  bool haveReference = false;
+  int activeDevices = 0;
+  int slots = deviceSlotsInUse();
+  for (int i = 0; i < slots; i++) {
+    DeviceData device;
+    if (readDevice(i, device) && device.isActive && millis() - device.lastSeen < 60000) {
       activeDevices++;
-      fleetTotalWeight += knownDevices[i].lastData.totalWeight;
-    }
-  }
-
-  // Build binary packet for hub
-  BLESensorPacket hubPacket;
-  memset(&hubPacket, 0, sizeof(hubPacket));
-
-  hubPacket.packetType = 0;  // hub
-  parseMacString(deviceMAC.c_str(), hubPacket.mac);
-  hubPacket.ch1AirPressure = myData.ch1AirPressure;
-  hubPacket.ch2AirPressure = myData.ch2AirPressure;
-  hubPacket.atmosphericPressure = myData.atmosphericPressure;
-  hubPacket.temperature = myData.temperature;
-  hubPacket.ch1Weight = myData.ch1Weight;
-  hubPacket.ch2Weight = myData.ch2Weight;
-  hubPacket.totalWeight = myData.totalWeight;
-  hubPacket.batteryLevel = 85;  // TODO: Real battery reading
-  hubPacket.deviceCount = activeDevices + 1;  // Include myself
-  hubPacket.fleetTotalWeight = fleetTotalWeight;
-  parseFirmwareVersion(FIRMWARE_VERSION, &hubPacket.fwMajor, &hubPacket.fwMinor, &hubPacket.fwPatch);
-  hubPacket.espnowRssi = 0;  // Not applicable for hub
-
-  pSensorCharacteristic->setValue((uint8_t*)&hubPacket, sizeof(hubPacket));
-  pSensorCharacteristic->notify();
-
-  Serial.printf("📲 BLE TX [HUB]: CH1=%.1f | CH2=%.1f | Total=%.1f | Fleet=%.1f lbs | Devices: %d (48 bytes)\n",
-               myData.ch1Weight, myData.ch2Weight, myData.totalWeight,
-               fleetTotalWeight, activeDevices + 1);
-
-  delay(100);  // Small delay between notifications
-
-  // Send each slave's data
-  for (int i = 0; i < deviceCount; i++) {
-    if (knownDevices[i].isActive && millis() - knownDevices[i].lastSeen < 60000) {
-      BLESensorPacket slavePacket;
-      memset(&slavePacket, 0, sizeof(slavePacket));
-
-      slavePacket.packetType = 1;  // device
-      parseMacString(knownDevices[i].macAddress, slavePacket.mac);
-      slavePacket.ch1AirPressure = knownDevices[i].lastData.ch1AirPressure;
-      slavePacket.ch2AirPressure = knownDevices[i].lastData.ch2AirPressure;
-      slavePacket.atmosphericPressure = knownDevices[i].lastData.atmosphericPressure;
-      slavePacket.temperature = knownDevices[i].lastData.temperature;
-      slavePacket.ch1Weight = knownDevices[i].lastData.ch1Weight;
-      slavePacket.ch2Weight = knownDevices[i].lastData.ch2Weight;
-      slavePacket.totalWeight = knownDevices[i].lastData.totalWeight;
-      slavePacket.batteryLevel = knownDevices[i].lastData.batteryLevel;
-      slavePacket.deviceCount = 0;  // Not applicable for devices
-      slavePacket.fleetTotalWeight = 0;  // Not applicable for devices
-      parseFirmwareVersion(FIRMWARE_VERSION, &slavePacket.fwMajor, &slavePacket.fwMinor, &slavePacket.fwPatch);
-      slavePacket.espnowRssi = knownDevices[i].espNowRssi;
-
-      pSensorCharacteristic->setValue((uint8_t*)&slavePacket, sizeof(slavePacket));
-      pSensorCharacteristic->notify();
-
-      Serial.printf("📲 BLE TX [SLAVE]: %s | CH1=%.1f | CH2=%.1f | Total=%.1f lbs | RSSI=%d (48 bytes)\n",
-                   knownDevices[i].macAddress,
-                   knownDevices[i].lastData.ch1Weight,
-                   knownDevices[i].lastData.ch2Weight,
-                   knownDevices[i].lastData.totalWeight,
-                   knownDevices[i].espNowRssi);
-
-      delay(100);
+      if (device.sampleTimeUs != 0 && !device.sampleTimeStamped && (!haveReference || device.sampleTimeUs > reference)) {
+        reference = device.sampleTimeUs;
+        haveReference = true;
+      }
+    }
+  }
+  uint8_t devices = activeDevices + 1 < 255 ? activeDevices + 1 : 255;  // Include myself
+
+  portENTER_CRITICAL(&g_timeSyncMux);
+  TimedWeight hubBroadcast = g_hubBroadcastWeight;
+  portEXIT_CRITICAL(&g_timeSyncMux);
+  int64_t hubSampleUs = snap.sampledUs;
+  float hubWeight = snap.ch1Weight + snap.ch2Weight;
+  if (hubBroadcast.sampleUs != 0 && llabs(hubBroadcast.sampleUs - reference) < llabs(hubSampleUs - reference)) {
+    hubSampleUs = hubBroadcast.sampleUs;
+    hubWeight = hubBroadcast.weight;
+  }
+
+  float fleetTotalWeight = 0;
+  int inTotal = 0;
+  int unaligned = 0;
+  int64_t earliest = INT64_MAX;
+  int64_t latestSample = INT64_MIN;
+  auto addToTotal = [&](int64_t sampleUs, float weight) -> bool {
+    if (!inCoherenceWindow(sampleUs, reference, windowUs)) return false;
+    fleetTotalWeight += weight;
+    inTotal++;
+    if (sampleUs != 0 && sampleUs < earliest) earliest = sampleUs;
+    if (sampleUs != 0 && sampleUs > latestSample) latestSample = sampleUs;
+    return true;
+  };
+  bool hubInTotal = addToTotal(hubSampleUs, hubWeight);
+  for (int i = 0; i < slots; i++) {
+    DeviceData device;
+    if (readDevice(i, device) && device.isActive && millis() - device.lastSeen < 60000) {
+      if (device.sampleTimeStamped) {
+        fleetTotalWeight += device.lastData.totalWeight;  // Kept out of the skew stats
+        inTotal++;
+        unaligned++;
+      } else {
+        addToTotal(fleetSampleUs(device, reference), device.lastData.totalWeight);
+      }
+    }
+  }
+  g_fleetInTotal = inTotal;
+  g_fleetOutOfWindow = devices - inTotal;
+  g_fleetUnaligned = unaligned;
+  if (inTotal - unaligned >= 2 && latestSample > earliest) recordLatency(g_fleetSkew, latestSample - earliest);
+
+  uint8_t fw[3];
+  parseFirmwareVersion(FIRMWARE_VERSION, &fw[0], &fw[1], &fw[2]);
+  uint8_t frameFlags = full ? 0 : BLE_FLEET_DELTA;
+
+  // Hub record straight from the snapshot and the cached environment
+  MacKey hubKey = macKeyFromString(deviceMAC.c_str());
+  bool hubChanged = g_notifyTracker.changed(MAX_DEVICES, hubKey, snap.ch1Weight, snap.ch2Weight, config);
+  g_notifyTracker.mark(MAX_DEVICES, hubKey, snap.ch1Weight, snap.ch2Weight);
+  EnvSample env = getEnvironment();
+  FleetRecord rec;
+  memset(&rec, 0, sizeof(rec));
+  rec.flags = FLEET_REC_HUB | (hubChanged ? FLEET_REC_CHANGED : 0) | (hubInTotal ? FLEET_REC_IN_TOTAL : 0) |
+              ((snap.settledFlags & SETTLED_CH1) ? FLEET_REC_CH1_SETTLED : 0) |
+              ((snap.settledFlags & SETTLED_CH2) ? FLEET_REC_CH2_SETTLED : 0);
+  macKeyToBytes(hubKey, rec.mac);
+  rec.ch1AirPressure = snap.ch1AirPressure;
+  rec.ch2AirPressure = snap.ch2AirPressure;
+  rec.atmosphericPressure = env.atmosphericPressure;
+  rec.temperature = env.temperature;
+  rec.ch1Weight = snap.ch1Weight;
+  rec.ch2Weight = snap.ch2Weight;
+  rec.ch1WeightStdDev = snap.ch1WeightStdDev;
+  rec.ch2WeightStdDev = snap.ch2WeightStdDev;
+  rec.batteryLevel = readBatteryLevel();
+  memcpy(rec.fw, fw, 3);
+  rec.ageMs = (uint32_t)((startUs - snap.sampledUs) / 1000);
+  rec.skewMs = fleetSkewMs(hubSampleUs, reference);
+  rec.linkLoss = -1.0f;
+  rec.linkJitterMs = -1.0f;
+
+  uint8_t refresh = g_fleetRefreshSeq++;
+  uint8_t index = 0;
+  size_t len = fleetFrameBegin(frame, refresh, index, devices, fleetTotalWeight);
+  fleetFrameSetFlags(frame, frameFlags);
+  len = fleetFrameAppend(frame, len, cap, rec);
+  int records = 1;
+
+  // Slaves, re-read one by one; a full frame goes out before the next is started
+  for (int i = 0; i < slots; i++) {
+    DeviceData device;
+    if (!readDevice(i, device) || !device.isActive || millis() - device.lastSeen >= 60000) continue;
+
+    bool changed = g_notifyTracker.changed(i, device.macKey, device.lastData.ch1Weight, device.lastData.ch2Weight, config);
+    if (!changed && !full) continue;
+    g_notifyTracker.mark(i, device.macKey, device.lastData.ch1Weight, device.lastData.ch2Weight);
+
+    memset(&rec, 0, sizeof(rec));
+    rec.flags = (changed ? FLEET_REC_CHANGED : 0) |
+                (inCoherenceWindow(fleetSampleUs(device, reference), reference, windowUs) ? FLEET_REC_IN_TOTAL : 0) |
+                (device.sampleTimeStamped ? FLEET_REC_UNALIGNED : 0) |
+                ((device.lastData.settledFlags & SETTLED_CH1) ? FLEET_REC_CH1_SETTLED : 0) |
+                ((device.lastData.settledFlags & SETTLED_CH2) ? FLEET_REC_CH2_SETTLED : 0);
+    macKeyToBytes(device.macKey, rec.mac);
+    rec.ch1AirPressure = device.lastData.ch1AirPressure;
+    rec.ch2AirPressure = device.lastData.ch2AirPressure;
+    rec.atmosphericPressure = device.lastData.atmosphericPressure;
+    rec.temperature = device.lastData.temperature;
+    rec.ch1Weight = device.lastData.ch1Weight;
+    rec.ch2Weight = device.lastData.ch2Weight;
+    rec.ch1WeightStdDev = device.lastData.ch1WeightStdDev;
+    rec.ch2WeightStdDev = device.lastData.ch2WeightStdDev;
+    rec.batteryLevel = device.lastData.batteryLevel;
+    bool heard = device.link.received > 0;
+    rec.rssi = heard && device.link.rssi != LINK_RSSI_NONE ? (int8_t)lroundf(device.link.rssi) : device.espNowRssi;
+    rec.linkLoss = heard ? device.link.loss : -1.0f;
+    rec.linkJitterMs = heard ? device.link.jitterUs / 1000.0f : -1.0f;
+    memcpy(rec.fw, device.firmware, 3);  // 0.0.0 until it reports its own
+    rec.ageMs = millis() - device.lastSeen;
+    rec.skewMs = device.sampleTimeStamped ? BLE_FLEET_SKEW_UNKNOWN : fleetSkewMs(device.sampleTimeUs, reference);
+
+    size_t next = fleetFrameAppend(frame, len, cap, rec);
+    if (!next) {
+      if (!notifyAndWait(pSensorCharacteristic, frame, len)) {
+        g_publishResync = true;  // The tracker got ahead of the phone: resend everything
+        return;
+      }
+      g_fleetFramesSent++;
+      len = fleetFrameBegin(frame, refresh, ++index, devices, fleetTotalWeight);
+      fleetFrameSetFlags(frame, frameFlags);
+      next = fleetFrameAppend(frame, len, cap, rec);
     }
+    len = next;
+    records++;
+  }
+
+  fleetFrameSetFlags(frame, BLE_FLEET_LAST);
+  if (!notifyAndWait(pSensorCharacteristic, frame, len)) {
+    g_publishResync = true;
+    return;
   }
+  g_fleetFramesSent++;
+
+  int64_t doneUs = esp_timer_get_time();
+  recordLatency(g_notifyLatency, doneUs - snap.sampledUs);
+  recordLatency(g_fleetRefreshTime, doneUs - startUs);
+
+  Serial.printf("📲 BLE TX fleet #%u %s: %d records in %u frames (MTU %u) | Fleet=%.1f lbs (%d/%u within %u ms, skew %.1f ms) | %.1f ms\n",
+               refresh, full ? "heartbeat" : "changes", records, index + 1, mtu, fleetTotalWeight,
+               inTotal, devices, config.coherenceMs,
+               inTotal >= 2 && latestSample > earliest ? (latestSample - earliest) / 1000.0 : 0.0,
+               (doneUs - startUs) / 1000.0);
 }
 
 // ============================================================
-// SENSOR FUNCTIONS
+// PRESSURE SCENARIOS
 // ============================================================
 
-// Pressure simulation - creates realistic loading/unloading patterns
-// Channel 1 and Channel 2 follow different patterns with phase offsets
+// Without transducers the acquisition task is fed from a scenario: one of the
+// synthetic profiles in pressure_scenario.h, or a CSV trace replayed from SPIFFS.
+// Scenario time advances with the simulated sample stream rather than millis(), so a
+// run is repeatable for a given seed, and the speed multiplier plays a long trace
+// through the filter and estimator faster than real time.
+
+static PressureScenario g_scenario;          // Used only by the acquisition task
+static PressureScenario g_scenarioPending;   // Staged by setScenario()
+static float g_scenarioPendingSpeed = 1.0f;
+static std::atomic<bool> g_scenarioSwap(false);
+static ScenarioTrace g_scenarioTrace;        // Loaded once at boot, read-only afterwards
+static double g_scenarioTime = 0;            // s, acquisition task only
+static float g_scenarioStep = 0;             // Scenario seconds per simulated sample
+static std::atomic<float> g_scenarioAmbient(NAN);  // From the trace, NAN when it has none
+static std::atomic<float> g_scenarioTempF(NAN);
+
+static void loadScenarioTrace() {
+  if (!SPIFFS.exists(SCENARIO_TRACE_PATH)) return;
+
+  uint32_t rows = psramFound() ? SCENARIO_TRACE_MAX_ROWS : SCENARIO_TRACE_MAX_ROWS_NO_PSRAM;
+  size_t bytes = (size_t)rows * 5 * sizeof(float);
+  float* storage = nullptr;
+  if (psramFound()) {
+    storage = (float*)heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM);
+  }
+  if (!storage) {
+    rows = SCENARIO_TRACE_MAX_ROWS_NO_PSRAM;
+    storage = (float*)malloc((size_t)rows * 5 * sizeof(float));
+  }
+  if (!storage) {
+    Serial.println("❌ Scenario trace allocation failed");
+    return;
+  }
+  g_scenarioTrace.attach(storage, rows);
+
+  File f = SPIFFS.open(SCENARIO_TRACE_PATH, "r");
+  char line[96];
+  while (f && f.available() && g_scenarioTrace.count < rows) {
+    size_t n = f.readBytesUntil('\n', line, sizeof(line) - 1);
+    line[n] = '\0';
+    g_scenarioTrace.parseLine(line);
+  }
+  if (f) f.close();
+
+  Serial.printf("📼 Scenario trace %s: %u rows, %.0f s%s\n", SCENARIO_TRACE_PATH,
+                g_scenarioTrace.count, g_scenarioTrace.duration(),
+                g_scenarioTrace.hasEnvironment ? " (with ambient/temperature)" : "");
+}
+
+// Stage a new scenario ("trace" or a built-in profile name). The acquisition task
+// swaps it in at its next frame. Returns false for an unknown name or while a
+// previous change is still pending.
+bool setScenario(const char* name, float speed, uint32_t seed) {
+  if (g_scenarioSwap.load()) return false;
+
+  ScenarioProfile profile;
+  bool trace = strcmp(name, "trace") == 0;
+  if (trace) {
+    if (g_scenarioTrace.count < 2) return false;
+  } else if (!scenarioProfileByName(name, &profile)) {
+    return false;
+  }
+
+  if (speed <= 0) speed = 1.0f;
+  if (speed > SCENARIO_MAX_SPEED) speed = SCENARIO_MAX_SPEED;
+  profile.seed = seed;
+
+  g_scenarioPending.setProfile(profile);
+  if (trace) g_scenarioPending.setTrace(&g_scenarioTrace);
+  g_scenarioPendingSpeed = speed;
+  strlcpy(g_scenarioName, name, sizeof(g_scenarioName));
+  g_scenarioSpeed = speed;
+  g_scenarioSeed = seed;
+  g_scenarioSwap.store(true);
+  return true;
+}
+
+void initScenario() {
+  loadScenarioTrace();
+
+  // An uploaded trace replays by default; the web API can pick another profile
+  const char* fallback = g_scenarioTrace.count > 1 ? "trace" : SCENARIO_DEFAULT;
+  String name = preferences.getString("scenario", fallback);
+  float speed = preferences.getFloat("scenario_speed", 1.0f);
+  uint32_t seed = preferences.getUInt("scenario_seed", 1);
+  if (!setScenario(name.c_str(), speed, seed)) {
+    setScenario(fallback, 1.0f, 1);
+  }
+
+  Serial.printf("🎬 Pressure scenario: %s @ %.1fx, seed %u\n", g_scenarioName, g_scenarioSpeed, g_scenarioSeed);
+}
+
+// Called by the acquisition task at the start of each simulated frame
+static void beginScenarioFrame() {
+  if (g_scenarioSwap.load(std::memory_order_acquire)) {
+    g_scenario = g_scenarioPending;
+    g_scenarioStep = g_scenarioPendingSpeed / ADC_SAMPLE_RATE_HZ;
+    g_scenarioTime = 0;
+    g_scenarioSwap.store(false, std::memory_order_release);
+  }
+
+  float ambient = NAN, tempF = NAN;
+  if (g_scenario.replaying()) {
+    g_scenario.environment((float)g_scenarioTime, &ambient, &tempF);
+  }
+  g_scenarioAmbient.store(ambient, std::memory_order_relaxed);
+  g_scenarioTempF.store(tempF, std::memory_order_relaxed);
+  g_scenarioSeconds.store((float)g_scenarioTime, std::memory_order_relaxed);
+}
+
+// Simulated pressure for channel 1 or 2 at the current scenario time
 float simulatePressure(int channel) {
-  // Total cycle is about 12 minutes, with different segments
-  // Channel 2 is offset by 90 seconds (phase shift)
-  unsigned long timeMs = millis();
-  if (channel == 2) {
-    timeMs += 90000;  // 90 second phase offset for channel 2
+  return g_scenario.pressure(channel, (float)g_scenarioTime);
+}
+
+static inline void advanceScenarioClock() {
+  g_scenarioTime += g_scenarioStep;
+}
+
+// ============================================================
+// ADC ACQUISITION
+// ============================================================
+
+// The acquisition task owns the ADC and both CIC decimators. The DMA driver fills
+// its ring of conversion frames at ADC_SAMPLE_RATE_HZ per channel; the task drains
+// it, decimates, and publishes one pressure per channel that any core can read.
+// Without ADC-capable pins the simulator feeds the same path at the same rate.
+
+static CicDecimator<ADC_CIC_STAGES> g_cic[2];
+static int8_t g_adcChannel[2] = {-1, -1};  // ADC1 channel per pressure channel
+static esp_adc_cal_characteristics_t g_adcChars;
+
+// One estimator per channel, stepped on every decimated pressure sample
+static WeightEstimator g_estimator[2];
+static ChannelEstimate g_estimate[2];
+static portMUX_TYPE g_estimateMux = portMUX_INITIALIZER_UNLOCKED;
+
+static float adcCodeToMillivolts(float code) {
+  if (!g_adcHardware) {
+    return code * ADC_FULL_SCALE_MV / 4095.0f;
+  }
+
+  // Interpolate the calibration curve so oversampled sub-LSB resolution is kept
+  if (code < 0) code = 0;
+  uint32_t lo = (uint32_t)code;
+  float frac = code - (float)lo;
+  float mvLo = (float)esp_adc_cal_raw_to_voltage(lo, &g_adcChars);
+  float mvHi = (float)esp_adc_cal_raw_to_voltage(lo + 1, &g_adcChars);
+  return mvLo + (mvHi - mvLo) * frac;
+}
+
+static float millivoltsToPsi(float mv) {
+  float psi = (mv - PRESSURE_SENSOR_ZERO_MV) * (float)PRESSURE_SENSOR_FULL_PSI /
+              (float)(PRESSURE_SENSOR_FULL_MV - PRESSURE_SENSOR_ZERO_MV);
+  return psi < 0 ? 0 : psi;
+}
+
+// Inverse of the conversion above, used to push simulated pressures through the filter
+static uint16_t psiToAdcCode(float psi) {
+  float mv = PRESSURE_SENSOR_ZERO_MV +
+             psi * (PRESSURE_SENSOR_FULL_MV - PRESSURE_SENSOR_ZERO_MV) / (float)PRESSURE_SENSOR_FULL_PSI;
+  float code = mv * 4095.0f / ADC_FULL_SCALE_MV;
+  if (code < 0) code = 0;
+  if (code > 4095) code = 4095;
+  return (uint16_t)(code + 0.5f);
+}
+
+static void updateEstimate(int idx, float psi) {
+  // Simulated samples step scenario time, which runs at the chosen speed-up; the
+  // estimator's process noise has to see the same clock
+  float dt = g_adcHardware ? (float)ADC_DECIMATION / ADC_SAMPLE_RATE_HZ : ADC_DECIMATION * g_scenarioStep;
+
+  EnvSample env = getEnvironment();
+  RegressionCoeffs coeffs = liveCoeffs(idx + 1);
+  float z = computeChannelWeight(coeffs, psi, env.atmosphericPressure, env.temperature);
+
+  WeightEstimator& est = g_estimator[idx];
+  uint8_t bit = 1 << idx;
+  if (g_estimatorReset.load(std::memory_order_relaxed) & bit) {
+    g_estimatorReset.fetch_and((uint8_t)~bit);
+    est.reset(z);  // Restarts on this measurement
+  }
+  est.update(z, dt);
+
+  ChannelEstimate out;
+  out.weight = est.weight() < 0 ? 0 : est.weight();
+  out.stdDev = est.stdDev();
+  out.settled = est.settled();
+
+  portENTER_CRITICAL(&g_estimateMux);
+  g_estimate[idx] = out;
+  portEXIT_CRITICAL(&g_estimateMux);
+}
+
+// Hand the newest sample pair to the radio and BLE tasks
+static void publishSnapshot() {
+  static uint32_t seq = 0;
+
+  SensorSnapshot snap;
+  snap.seq = ++seq;
+  snap.sampledUs = esp_timer_get_time();
+  snap.ch1AirPressure = getChannelPressure(1);
+  snap.ch2AirPressure = getChannelPressure(2);
+  snap.ch1Weight = g_estimate[0].weight;  // This task is the only writer, no lock needed
+  snap.ch2Weight = g_estimate[1].weight;
+  snap.ch1WeightStdDev = g_estimate[0].stdDev;
+  snap.ch2WeightStdDev = g_estimate[1].stdDev;
+  snap.settledFlags = (g_estimate[0].settled ? SETTLED_CH1 : 0) | (g_estimate[1].settled ? SETTLED_CH2 : 0);
+
+  if (!g_radioSnapshots.push(snap)) g_snapshotDrops++;
+  if (!g_bleSnapshots.push(snap)) g_snapshotDrops++;
+  if (g_radioTaskHandle) xTaskNotifyGive(g_radioTaskHandle);
+  if (g_bleTaskHandle) xTaskNotifyGive(g_bleTaskHandle);
+}
+
+static inline void pushAdcSample(int idx, uint16_t raw) {
+  g_adcStats[idx].record(raw);
+  if (g_cic[idx].push(raw)) {
+    float psi = millivoltsToPsi(adcCodeToMillivolts(g_cic[idx].output()));
+    g_pressurePsi[idx].store(psi, std::memory_order_relaxed);
+    g_adcStats[idx].decimatedSamples++;
+    updateEstimate(idx, psi);
+    if (idx == 1) {
+      recordHistorySample();
+      publishSnapshot();
+    }
+  }
+}
+
+static bool initAdcDma() {
+  g_adcChannel[0] = digitalPinToAnalogChannel(PRESSURE_SENSOR_CH1_PIN);
+  g_adcChannel[1] = digitalPinToAnalogChannel(PRESSURE_SENSOR_CH2_PIN);
+
+  // Continuous mode is ADC1-only while WiFi is running
+  for (int i = 0; i < 2; i++) {
+    if (g_adcChannel[i] < 0 || g_adcChannel[i] >= ADC1_CHANNEL_MAX) {
+      Serial.printf("⚠️ CH%d pin is not an ADC1 pin - using simulated pressure\n", i + 1);
+      return false;
+    }
+  }
+
+  adc_digi_init_config_t initCfg = {};
+  initCfg.max_store_buf_size = ADC_DMA_FRAME_BYTES * 4;
+  initCfg.conv_num_each_intr = ADC_DMA_FRAME_BYTES;
+  initCfg.adc1_chan_mask = BIT(g_adcChannel[0]) | BIT(g_adcChannel[1]);
+  initCfg.adc2_chan_mask = 0;
+  if (adc_digi_initialize(&initCfg) != ESP_OK) {
+    Serial.println("❌ ADC DMA init failed");
+    return false;
+  }
+
+  adc_digi_pattern_config_t pattern[2] = {};
+  for (int i = 0; i < 2; i++) {
+    pattern[i].atten = ADC_ATTEN_DB_11;
+    pattern[i].channel = g_adcChannel[i];
+    pattern[i].unit = 0;  // ADC1
+    pattern[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+  }
+
+  adc_digi_configuration_t digCfg = {};
+  digCfg.conv_limit_en = false;
+  digCfg.conv_limit_num = 250;
+  digCfg.pattern_num = 2;
+  digCfg.adc_pattern = pattern;
+  digCfg.sample_freq_hz = ADC_SAMPLE_RATE_HZ * 2;  // Pattern alternates CH1/CH2
+  digCfg.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+  digCfg.format = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+  if (adc_digi_controller_configure(&digCfg) != ESP_OK) {
+    Serial.println("❌ ADC DMA configure failed");
+    adc_digi_deinitialize();
+    return false;
+  }
+
+  esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12, 1100, &g_adcChars);
+
+  if (adc_digi_start() != ESP_OK) {
+    Serial.println("❌ ADC DMA start failed");
+    adc_digi_deinitialize();
+    return false;
+  }
+  return true;
+}
+
+static void adcAcquisitionTask(void* arg) {
+  uint8_t frame[ADC_DMA_FRAME_BYTES];
+  const uint32_t samplesPerFrame = ADC_DMA_FRAME_BYTES / SOC_ADC_DIGI_RESULT_BYTES / 2;
+  const TickType_t framePeriod = pdMS_TO_TICKS(samplesPerFrame * 1000 / ADC_SAMPLE_RATE_HZ);
+
+  for (;;) {
+    if (!g_adcHardware) {
+      beginScenarioFrame();
+      for (uint32_t i = 0; i < samplesPerFrame; i++) {
+        pushAdcSample(0, psiToAdcCode(simulatePressure(1)));
+        pushAdcSample(1, psiToAdcCode(simulatePressure(2)));
+        advanceScenarioClock();
+      }
+      vTaskDelay(framePeriod);
+      continue;
+    }
+
+    uint32_t got = 0;
+    esp_err_t err = adc_digi_read_bytes(frame, sizeof(frame), &got, ADC_MAX_DELAY);
+    if (err == ESP_ERR_INVALID_STATE) {
+      g_adcOverruns++;  // Driver dropped old frames, what we got is still valid
+    } else if (err != ESP_OK) {
+      continue;
+    }
+
+    for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= got; i += SOC_ADC_DIGI_RESULT_BYTES) {
+      adc_digi_output_data_t* p = (adc_digi_output_data_t*)&frame[i];
+      if (p->type2.unit != 0) continue;
+      if (p->type2.channel == (uint32_t)g_adcChannel[0]) {
+        pushAdcSample(0, p->type2.data);
+      } else if (p->type2.channel == (uint32_t)g_adcChannel[1]) {
+        pushAdcSample(1, p->type2.data);
+      }
+    }
+  }
+}
+
+void initAdcAcquisition() {
+  Serial.println("🎚️ Initializing pressure acquisition...");
+
+  for (int i = 0; i < 2; i++) {
+    g_cic[i].reset(ADC_DECIMATION);
+    g_pressurePsi[i].store(NAN);
+  }
+
+  g_adcHardware = initAdcDma();
+
+  xTaskCreatePinnedToCore(adcAcquisitionTask, "adc_acq", ACQ_TASK_STACK, nullptr,
+                          ACQ_TASK_PRIORITY, &g_adcTaskHandle, ACQ_TASK_CORE);
+
+  Serial.printf("✅ Pressure acquisition: %s | %d Hz/ch, CIC%d R=%d -> %.1f Hz\n",
+                g_adcHardware ? "DMA ADC" : "SIMULATED",
+                ADC_SAMPLE_RATE_HZ, ADC_CIC_STAGES, ADC_DECIMATION,
+                (float)ADC_SAMPLE_RATE_HZ / ADC_DECIMATION);
+}
+
+// Latest decimated pressure for channel 1 or 2 (0 until the filter has settled)
+float getChannelPressure(int channel) {
+  float psi = g_pressurePsi[channel == 2 ? 1 : 0].load(std::memory_order_relaxed);
+  return isnan(psi) ? 0.0f : psi;
+}
+
+// Latest filtered weight for channel 1 or 2
+ChannelEstimate getChannelEstimate(int channel) {
+  portENTER_CRITICAL(&g_estimateMux);
+  ChannelEstimate est = g_estimate[channel == 2 ? 1 : 0];
+  portEXIT_CRITICAL(&g_estimateMux);
+  return est;
+}
+
+// ============================================================
+// SAMPLE HISTORY
+// ============================================================
+
+// The acquisition task pushes a quantized sample into a PSRAM ring at 10 Hz. The loop
+// appends delta/varint-compressed blocks of it to an append-only SPIFFS log every
+// minute, and streams flash blocks plus the not-yet-flushed tail over BLE on request.
+
+static HistoryRing g_history;
+static portMUX_TYPE g_historyMux = portMUX_INITIALIZER_UNLOCKED;
+static uint16_t g_bootId = 0;
+static uint32_t g_historyFlushed = 0;        // Ring index up to which samples are in flash
+static uint32_t g_historyBytesLogged = 0;
+// Held by the flush while it appends a block and moves g_historyFlushed, and by the
+// download while it opens or reads a log, so the download sees whole blocks and
+// picks up the RAM tail exactly where the log it read ends
+static SemaphoreHandle_t g_historyFileLock = nullptr;
+static volatile bool g_historyLogsBusy = false;  // Download reading the logs: rotation waits
+static HistorySample* g_historyBatch = nullptr;  // HISTORY_BLOCK_SAMPLES scratch
+static uint8_t* g_historyBlock = nullptr;        // Encoded block scratch (flush)
+static uint8_t* g_downloadBlock = nullptr;       // Encoded block scratch (download)
+
+static const size_t HISTORY_BLOCK_BYTES =
+    sizeof(HistoryBlockHeader) + HISTORY_BLOCK_SAMPLES * HISTORY_MAX_ENCODED_SAMPLE;
+
+// Hub: versions for pushed coefficients. The boot id in the high half keeps them
+// increasing across reboots without an NVS write per push.
+uint32_t nextCoeffVersion() {
+  static uint16_t counter = 0;
+  if (++counter == 0) counter = 1;
+  return ((uint32_t)g_bootId << 16) | counter;
+}
+
+void initHistory() {
+  g_historyFileLock = xSemaphoreCreateMutex();
+
+  // Boot counter keeps timestamps (millis since boot) from different boots apart in the log
+  g_bootId = preferences.getUShort("boot_id", 0) + 1;
+  preferences.putUShort("boot_id", g_bootId);
+
+  uint32_t capacity = HISTORY_RING_SAMPLES;
+  HistorySample* storage = nullptr;
+  if (psramFound()) {
+    storage = (HistorySample*)heap_caps_malloc(capacity * sizeof(HistorySample), MALLOC_CAP_SPIRAM);
+    g_historyBatch = (HistorySample*)heap_caps_malloc(HISTORY_BLOCK_SAMPLES * sizeof(HistorySample), MALLOC_CAP_SPIRAM);
+    g_historyBlock = (uint8_t*)heap_caps_malloc(HISTORY_BLOCK_BYTES, MALLOC_CAP_SPIRAM);
+    g_downloadBlock = (uint8_t*)heap_caps_malloc(HISTORY_BLOCK_BYTES, MALLOC_CAP_SPIRAM);
   }
+  if (!storage) {
+    capacity = HISTORY_RING_SAMPLES_NO_PSRAM;
+    storage = (HistorySample*)malloc(capacity * sizeof(HistorySample));
+  }
+  if (!g_historyBatch) g_historyBatch = (HistorySample*)malloc(HISTORY_BLOCK_SAMPLES * sizeof(HistorySample));
+  if (!g_historyBlock) g_historyBlock = (uint8_t*)malloc(HISTORY_BLOCK_BYTES);
+  if (!g_downloadBlock) g_downloadBlock = (uint8_t*)malloc(HISTORY_BLOCK_BYTES);
+
+  if (!storage || !g_historyBatch || !g_historyBlock || !g_downloadBlock) {
+    Serial.println("❌ History buffers allocation failed - history disabled");
+    return;
+  }
+  g_history.attach(storage, capacity);
+
+  if (SPIFFS.exists(HISTORY_LOG_PATH)) {
+    File f = SPIFFS.open(HISTORY_LOG_PATH, FILE_READ);
+    g_historyBytesLogged = f.size();
+    f.close();
+  }
+
+  Serial.printf("✅ History: boot #%u | ring %u samples (%u KB %s) | log %u bytes\n",
+                g_bootId, capacity, (unsigned)(capacity * sizeof(HistorySample) / 1024),
+                capacity == HISTORY_RING_SAMPLES ? "PSRAM" : "heap",
+                g_historyBytesLogged);
+}
 
-  // Convert to seconds for easier calculation
-  float timeSec = (timeMs / 1000.0);
+// Called from the acquisition task after each CH2 decimation step
+void recordHistorySample() {
+  static uint32_t lastSample = 0;
+  if (!g_history.ready() || millis() - lastSample < HISTORY_SAMPLE_INTERVAL_MS) return;
+  lastSample = millis();
+
+  ChannelEstimate ch1 = getChannelEstimate(1);
+  ChannelEstimate ch2 = getChannelEstimate(2);
+  EnvSample env = getEnvironment();
+
+  HistorySample s;
+  s.timestamp = lastSample;
+  s.ch1Weight = (int32_t)lroundf(ch1.weight);
+  s.ch2Weight = (int32_t)lroundf(ch2.weight);
+  s.ch1Pressure = (uint16_t)lroundf(getChannelPressure(1) * 100.0f);
+  s.ch2Pressure = (uint16_t)lroundf(getChannelPressure(2) * 100.0f);
+  s.ambientPressure = (uint16_t)lroundf(env.atmosphericPressure * 100.0f);
+  s.temperature = (int16_t)lroundf(env.temperature * 10.0f);
+
+  portENTER_CRITICAL(&g_historyMux);
+  g_history.push(s);
+  portEXIT_CRITICAL(&g_historyMux);
+}
+
+// Copy samples out of the ring under the lock (the acquisition task keeps writing)
+static uint32_t readHistory(uint32_t& from, HistorySample* out, uint32_t maxOut) {
+  portENTER_CRITICAL(&g_historyMux);
+  uint32_t n = g_history.read(from, out, maxOut);
+  portEXIT_CRITICAL(&g_historyMux);
+  return n;
+}
+
+static uint32_t historyEndIndex() {
+  portENTER_CRITICAL(&g_historyMux);
+  uint32_t end = g_history.endIndex();
+  portEXIT_CRITICAL(&g_historyMux);
+  return end;
+}
 
-  // Full cycle period (about 12 minutes = 720 seconds)
-  float cycleTime = fmod(timeSec, 720.0);
+static bool appendHistoryBlock(const uint8_t* block, size_t len) {
+  if (g_historyBytesLogged + len > HISTORY_LOG_MAX_BYTES && !g_historyLogsBusy) {
+    SPIFFS.remove(HISTORY_OLD_PATH);
+    SPIFFS.rename(HISTORY_LOG_PATH, HISTORY_OLD_PATH);
+    g_historyBytesLogged = 0;
+    Serial.println("🗂️ History log rotated");
+  }
 
-  float pressure;
+  File f = SPIFFS.open(HISTORY_LOG_PATH, FILE_APPEND);
+  if (!f) return false;
+  size_t written = f.write(block, len);
+  f.close();
+  g_historyBytesLogged += written;
+  return written == len;
+}
 
-  // Segment 1: 0-300s (5 min) - Slow descent from 110 to 40 PSI (loading trailer)
-  if (cycleTime < 300.0) {
-    float progress = cycleTime / 300.0;
-    // Smooth sinusoidal transition
-    float easedProgress = (1.0 - cos(progress * PI)) / 2.0;
-    pressure = 110.0 - (70.0 * easedProgress);
+// Called every HISTORY_FLUSH_INTERVAL_MS by the housekeeping scheduler
+void serviceHistoryLog() {
+  if (!g_history.ready()) return;
+
+  uint32_t end = historyEndIndex();
+  size_t rawBytes = 0, logBytes = 0;
+
+  while (g_historyFlushed < end) {
+    uint32_t from = g_historyFlushed;
+    uint32_t maxOut = end - from < HISTORY_BLOCK_SAMPLES ? end - from : HISTORY_BLOCK_SAMPLES;
+    uint32_t n = readHistory(from, g_historyBatch, maxOut);
+    if (n == 0) break;
+
+    size_t len = encodeHistoryBlock(g_historyBatch, n, g_bootId, g_historyBlock, HISTORY_BLOCK_BYTES);
+    xSemaphoreTake(g_historyFileLock, portMAX_DELAY);
+    bool ok = len > 0 && appendHistoryBlock(g_historyBlock, len);
+    if (ok) g_historyFlushed = from + n;
+    xSemaphoreGive(g_historyFileLock);
+    if (!ok) {
+      Serial.println("❌ History flush failed");
+      break;
+    }
+    rawBytes += n * sizeof(HistorySample);
+    logBytes += len;
   }
-  // Segment 2: 300-420s (2 min) - Stabilize around 40 PSI (loaded, stationary)
-  else if (cycleTime < 420.0) {
-    pressure = 40.0;
+
+  if (logBytes > 0) {
+    Serial.printf("🗂️ History flushed: %u -> %u bytes | log %u bytes\n",
+                  (unsigned)rawBytes, (unsigned)logBytes, g_historyBytesLogged);
   }
-  // Segment 3: 420-480s (1 min) - Quick rise to 80 PSI (partial unload)
-  else if (cycleTime < 480.0) {
-    float segmentTime = cycleTime - 420.0;
-    float progress = segmentTime / 60.0;
-    float easedProgress = (1.0 - cos(progress * PI)) / 2.0;
-    pressure = 40.0 + (40.0 * easedProgress);
+}
+
+// ------------------------------------------------------------
+// BLE bulk download
+// ------------------------------------------------------------
+// Notification = [u16 seq][payload]. Payloads concatenate into a stream of
+// HistoryBlockHeader + payload blocks (old log, current log, then the unflushed
+// RAM tail). The last notification has seq 0xFFFF followed by
+// [u32 totalBytes][u16 blockCount]. The phone watches seq for gaps and asks again
+// from the last block it has whole: the log only grows, so the blocks up to there
+// come out the same, and skipping them resumes the stream. A block it had in the
+// RAM tail may be in the log by then, cut differently, so the first block that
+// runs past the resume point is sent whole and the phone drops what it already has.
+
+enum HistoryStage { HIST_IDLE, HIST_OLD_LOG, HIST_LOG, HIST_RAM, HIST_END };
+
+static struct {
+  volatile bool requested;
+  volatile bool cancel;
+  HistoryStage stage;
+  uint16_t bootId;
+  uint32_t fromTs, toTs;
+  uint16_t resumeBoot;        // Skipping blocks up to resumeTs of this boot (0: not resuming)
+  uint32_t resumeTs;
+  File file;
+  size_t fileEnd;             // Log size when opened: blocks appended after it come from RAM
+  uint32_t logFlushed;        // g_historyFlushed as of that size
+  uint32_t ringIndex;
+  size_t pendingLen, pendingPos;
+  uint16_t seq;
+  uint32_t totalBytes;
+  uint16_t blocks;
+} g_download;
+
+void requestHistoryDownload(uint16_t bootId, uint32_t fromTs, uint32_t toTs, uint16_t resumeBoot, uint32_t resumeTs) {
+  g_download.bootId = bootId;
+  g_download.fromTs = fromTs;
+  g_download.toTs = toTs;
+  g_download.resumeBoot = resumeBoot;
+  g_download.resumeTs = resumeTs;
+  g_download.cancel = false;
+  g_download.requested = true;
+}
+
+void cancelHistoryDownload() {
+  g_download.cancel = true;
+}
+
+// Open a log for the download with its size and the flush position to go with it
+static void openHistoryFile(const char* path) {
+  xSemaphoreTake(g_historyFileLock, portMAX_DELAY);
+  g_download.file = SPIFFS.exists(path) ? SPIFFS.open(path, FILE_READ) : File();
+  g_download.fileEnd = g_download.file ? g_download.file.size() : 0;
+  g_download.logFlushed = g_historyFlushed;
+  xSemaphoreGive(g_historyFileLock);
+}
+
+static bool blockMatches(const HistoryBlockHeader& hdr) {
+  if (g_download.bootId != 0 && hdr.bootId != g_download.bootId) return false;
+  return hdr.lastTimestamp >= g_download.fromTs && hdr.firstTimestamp <= g_download.toTs;
+}
+
+// Resuming: false for the blocks the phone already has. Boot ids only grow, so the
+// first block of a later boot, or past resumeTs in the same one, ends the skipping.
+static bool pastResumePoint(const HistoryBlockHeader& hdr) {
+  if (g_download.resumeBoot == 0) return true;
+  if (hdr.bootId < g_download.resumeBoot ||
+      (hdr.bootId == g_download.resumeBoot && hdr.lastTimestamp <= g_download.resumeTs)) {
+    return false;
   }
-  // Segment 4: 480-500s (20 sec) - Hold at 80 PSI
-  else if (cycleTime < 500.0) {
-    pressure = 80.0;
+  g_download.resumeBoot = 0;
+  return true;
+}
+
+// Load the next matching block of the current file, up to the size it was opened
+// at, into g_downloadBlock
+static bool nextFileBlock() {
+  if (!g_download.file) return false;
+  xSemaphoreTake(g_historyFileLock, portMAX_DELAY);
+  bool found = false;
+  while (g_download.file.position() + sizeof(HistoryBlockHeader) <= g_download.fileEnd) {
+    HistoryBlockHeader hdr;
+    g_download.file.read((uint8_t*)&hdr, sizeof(hdr));
+    if (hdr.magic != HISTORY_BLOCK_MAGIC || sizeof(hdr) + hdr.payloadLen > HISTORY_BLOCK_BYTES ||
+        g_download.file.position() + hdr.payloadLen > g_download.fileEnd) {
+      break;  // Torn tail from a power loss - nothing after it is trustworthy
+    }
+    if (!blockMatches(hdr) || !pastResumePoint(hdr)) {
+      g_download.file.seek(hdr.payloadLen, SeekCur);
+      continue;
+    }
+    memcpy(g_downloadBlock, &hdr, sizeof(hdr));
+    if (g_download.file.read(g_downloadBlock + sizeof(hdr), hdr.payloadLen) != hdr.payloadLen) break;
+    g_download.pendingLen = sizeof(hdr) + hdr.payloadLen;
+    found = true;
+    break;
   }
-  // Segment 5: 500-620s (2 min) - Slow descent to 20 PSI (heavy load)
-  else if (cycleTime < 620.0) {
-    float segmentTime = cycleTime - 500.0;
-    float progress = segmentTime / 120.0;
-    float easedProgress = (1.0 - cos(progress * PI)) / 2.0;
-    pressure = 80.0 - (60.0 * easedProgress);
+  xSemaphoreGive(g_historyFileLock);
+  return found;
+}
+
+// Encode the next block of unflushed RAM samples (current boot only)
+static bool nextRamBlock() {
+  if (g_download.bootId != 0 && g_download.bootId != g_bootId) return false;
+
+  uint32_t end = historyEndIndex();
+  uint32_t from = g_download.ringIndex;
+  uint32_t n = readHistory(from, g_historyBatch, HISTORY_BLOCK_SAMPLES);
+
+  // Trim to the requested window
+  uint32_t keep = 0;
+  while (keep < n && g_historyBatch[keep].timestamp <= g_download.toTs) keep++;
+  if (keep == 0 || from >= end) return false;
+
+  g_download.ringIndex = from + keep;
+  g_download.pendingLen = encodeHistoryBlock(g_historyBatch, keep, g_bootId, g_downloadBlock, HISTORY_BLOCK_BYTES);
+  return g_download.pendingLen > 0;
+}
+
+// Advance through the stages until a block is pending or the stream is done
+static bool loadNextDownloadBlock() {
+  for (;;) {
+    switch (g_download.stage) {
+      case HIST_OLD_LOG:
+      case HIST_LOG:
+        if (nextFileBlock()) return true;
+        if (g_download.file) g_download.file.close();
+        if (g_download.stage == HIST_OLD_LOG) {
+          g_download.stage = HIST_LOG;
+          openHistoryFile(HISTORY_LOG_PATH);
+        } else {
+          g_download.stage = HIST_RAM;
+          g_historyLogsBusy = false;
+          uint32_t fromTs = g_download.fromTs;
+          if (g_download.resumeBoot == g_bootId && g_download.resumeTs >= fromTs) fromTs = g_download.resumeTs + 1;
+          g_download.resumeBoot = 0;
+          portENTER_CRITICAL(&g_historyMux);
+          uint32_t start = g_history.lowerBound(fromTs);
+          portEXIT_CRITICAL(&g_historyMux);
+          g_download.ringIndex = start > g_download.logFlushed ? start : g_download.logFlushed;
+        }
+        break;
+
+      case HIST_RAM:
+        if (nextRamBlock()) return true;
+        g_download.stage = HIST_END;
+        return false;
+
+      default:
+        return false;
+    }
   }
-  // Segment 6: 620-720s (100 sec) - Rise back to 75 PSI (partial unload, end of cycle)
-  else {
-    float segmentTime = cycleTime - 620.0;
-    float progress = segmentTime / 100.0;
-    float easedProgress = (1.0 - cos(progress * PI)) / 2.0;
-    pressure = 20.0 + (55.0 * easedProgress);
+}
+
+void serviceHistoryDownload() {
+  if (g_download.requested) {
+    g_download.requested = false;
+    if (g_download.file) g_download.file.close();
+    g_download.stage = HIST_OLD_LOG;
+    g_historyLogsBusy = true;
+    openHistoryFile(HISTORY_OLD_PATH);
+    g_download.pendingLen = g_download.pendingPos = 0;
+    g_download.seq = 0;
+    g_download.totalBytes = 0;
+    g_download.blocks = 0;
+    Serial.printf("🗂️ History download: boot %u, %u..%u ms", g_download.bootId, g_download.fromTs, g_download.toTs);
+    if (g_download.resumeBoot) {
+      Serial.printf(" | resuming after boot %u %u ms", g_download.resumeBoot, g_download.resumeTs);
+    }
+    Serial.println();
   }
 
-  // Add small noise for realism (+/- 0.5 PSI)
-  pressure += (random(-50, 51) / 100.0);
+  if (g_download.stage == HIST_IDLE) return;
+
+  if (g_download.cancel || !deviceConnected || !pHistoryCharacteristic) {
+    if (g_download.file) g_download.file.close();
+    g_download.stage = HIST_IDLE;
+    g_historyLogsBusy = false;
+    g_download.cancel = false;
+    Serial.println("⚠️ History download cancelled");
+    return;
+  }
 
-  // Clamp to valid range
-  if (pressure < 15.0) pressure = 15.0;
-  if (pressure > 110.0) pressure = 110.0;
+  uint16_t mtu = pServer->getPeerMTU(pServer->getConnId());
+  size_t chunkPayload = (mtu > 23 ? mtu : 23) - 3 - 2;  // ATT header + seq
+  uint8_t chunk[256];
+  if (chunkPayload > sizeof(chunk) - 2) chunkPayload = sizeof(chunk) - 2;
+
+  // A few notifications per loop pass keeps the rest of the loop responsive
+  for (int i = 0; i < 8; i++) {
+    if (g_download.pendingPos >= g_download.pendingLen) {
+      g_download.pendingLen = g_download.pendingPos = 0;
+      if (!loadNextDownloadBlock()) {
+        chunk[0] = 0xFF;
+        chunk[1] = 0xFF;
+        memcpy(chunk + 2, &g_download.totalBytes, 4);
+        memcpy(chunk + 6, &g_download.blocks, 2);
+        pHistoryCharacteristic->setValue(chunk, 8);
+        pHistoryCharacteristic->notify();
+        Serial.printf("🗂️ History download complete: %u blocks, %u bytes\n",
+                      g_download.blocks, g_download.totalBytes);
+        g_download.stage = HIST_IDLE;
+        return;
+      }
+      g_download.blocks++;
+    }
 
-  return pressure;
+    size_t n = g_download.pendingLen - g_download.pendingPos;
+    if (n > chunkPayload) n = chunkPayload;
+    chunk[0] = g_download.seq & 0xFF;
+    chunk[1] = g_download.seq >> 8;
+    memcpy(chunk + 2, g_downloadBlock + g_download.pendingPos, n);
+    pHistoryCharacteristic->setValue(chunk, n + 2);
+    pHistoryCharacteristic->notify();
+
+    g_download.pendingPos += n;
+    g_download.totalBytes += n;
+    g_download.seq = (g_download.seq + 1) & 0x7FFF;  // 0xFFFF stays reserved for the end marker
+  }
 }
 
+// ============================================================
+// SENSOR FUNCTIONS
+// ============================================================
+
 void initBME280() {
   Serial.println("🌡️ Initializing BME280...");
 
@@ -1298,54 +6009,85 @@ void initBME280() {
                     Adafruit_BME280::SAMPLING_X1,
                     Adafruit_BME280::FILTER_X16,
                     Adafruit_BME280::STANDBY_MS_500);
-    
-    float temp = bme.readTemperature() * 9.0/5.0 + 32.0;
-    float pressure = bme.readPressure() / 6894.76;
-    
-    Serial.printf("📊 Initial: %.1f°F, %.2f PSI\n", temp, pressure);
+
+    // Wait out the first conversion, then prime the cache
+    delay(BME_MEASURE_MS);
+    serviceEnvironmentSampler();
+    EnvSample env = getEnvironment();
+
+    Serial.printf("📊 Initial: %.1f°F, %.2f PSI (sampled every %d ms)\n",
+                  env.temperature, env.atmosphericPressure, BME_STANDBY_MS + BME_MEASURE_MS);
   } else {
     Serial.println("❌ BME280 not found - using dummy data");
   }
 }
 
-SensorData readSensors() {
-  SensorData data;
-
+// One burst read per BME280 conversion cycle. The sensor free-runs in normal mode, so
+// reading more often than t_standby + t_measure only returns the same result again.
+// Called once per BME280 conversion cycle by the housekeeping scheduler
+void serviceEnvironmentSampler() {
+  EnvSample env;
   if (bmeInitialized) {
-    data.temperature = bme.readTemperature() * 9.0/5.0 + 32.0;
-    data.atmosphericPressure = bme.readPressure() / 6894.76;
-    data.elevation = bme.readAltitude(1013.25) * 3.28084;
+    float tempC, pressurePa;
+    g_envI2cTransactions++;
+    if (!bme.readBurst(&tempC, &pressurePa)) {
+      g_envReadErrors++;
+      return;  // Keep serving the previous sample
+    }
+    env.temperature = tempC * 9.0/5.0 + 32.0;
+    env.atmosphericPressure = pressurePa / 6894.76;
+    // Same barometric formula as Adafruit_BME280::readAltitude(), without another bus read
+    env.elevation = 44330.0 * (1.0 - pow((pressurePa / 100.0) / 1013.25, 0.1903)) * 3.28084;
+  } else if (!isnan(g_scenarioAmbient.load(std::memory_order_relaxed))) {
+    // Replayed trace carries its own ambient pressure / temperature
+    env.atmosphericPressure = g_scenarioAmbient.load(std::memory_order_relaxed);
+    env.temperature = g_scenarioTempF.load(std::memory_order_relaxed);
+    env.elevation = 44330.0 * (1.0 - pow((env.atmosphericPressure * 68.9476) / 1013.25, 0.1903)) * 3.28084;
   } else {
     // Dummy environmental data for testing
-    data.atmosphericPressure = 14.7 + (random(-10, 10)/100.0);
-    data.temperature = 72.0 + (random(-30, 30)/10.0);
-    data.elevation = 1000 + random(-50, 50);
-  }
-
-  // TODO: Replace with actual ADC reads from pressure sensors
-  // Channel 1 air pressure (Axle Group 1)
-  // data.ch1AirPressure = analogRead(PRESSURE_SENSOR_CH1_PIN) * conversion_factor;
-  // Channel 2 air pressure (Axle Group 2)
-  // data.ch2AirPressure = analogRead(PRESSURE_SENSOR_CH2_PIN) * conversion_factor;
-
-  // Simulate realistic pressure patterns for testing
-  // Channel 1 and Channel 2 have different phase offsets (90 sec apart)
-  data.ch1AirPressure = simulatePressure(1);
-  data.ch2AirPressure = simulatePressure(2);
-
-  // Calculate weight for Channel 1 using ch1 coefficients
-  data.ch1Weight = ch1Coeffs.intercept +
-                   (data.ch1AirPressure * ch1Coeffs.airPressureCoeff) +
-                   (data.atmosphericPressure * ch1Coeffs.ambientPressureCoeff) +
-                   (data.temperature * ch1Coeffs.airTempCoeff);
-  if (data.ch1Weight < 0) data.ch1Weight = 0;
-
-  // Calculate weight for Channel 2 using ch2 coefficients
-  data.ch2Weight = ch2Coeffs.intercept +
-                   (data.ch2AirPressure * ch2Coeffs.airPressureCoeff) +
-                   (data.atmosphericPressure * ch2Coeffs.ambientPressureCoeff) +
-                   (data.temperature * ch2Coeffs.airTempCoeff);
-  if (data.ch2Weight < 0) data.ch2Weight = 0;
+    env.atmosphericPressure = 14.7 + (random(-10, 10)/100.0);
+    env.temperature = 72.0 + (random(-30, 30)/10.0);
+    env.elevation = 1000 + random(-50, 50);
+  }
+  env.timestamp = millis();
+  env.valid = true;
+
+  portENTER_CRITICAL(&g_envMux);
+  g_env = env;
+  portEXIT_CRITICAL(&g_envMux);
+}
+
+// Copy of the latest environment sample (never touches the I2C bus)
+EnvSample getEnvironment() {
+  portENTER_CRITICAL(&g_envMux);
+  EnvSample env = g_env;
+  portEXIT_CRITICAL(&g_envMux);
+  return env;
+}
+
+// Battery percent for the sensor frame and the fleet record
+uint8_t readBatteryLevel() {
+  return BATTERY_LEVEL_UNKNOWN;  // TODO: Real battery reading
+}
+
+// Full reading for one acquisition snapshot (environment from the sampler cache)
+SensorData readSensors(const SensorSnapshot& snap) {
+  SensorData data;
+
+  // Environment comes from the sampler cache - no I2C traffic here
+  EnvSample env = getEnvironment();
+  data.temperature = env.temperature;
+  data.atmosphericPressure = env.atmosphericPressure;
+  data.elevation = env.elevation;
+
+  // Decimated pressure and filtered weight, as published by the acquisition task
+  data.ch1AirPressure = snap.ch1AirPressure;
+  data.ch2AirPressure = snap.ch2AirPressure;
+  data.ch1Weight = snap.ch1Weight;
+  data.ch2Weight = snap.ch2Weight;
+  data.ch1WeightStdDev = snap.ch1WeightStdDev;
+  data.ch2WeightStdDev = snap.ch2WeightStdDev;
+  data.settledFlags = snap.settledFlags;
 
   // Total weight is sum of both axle groups
   data.totalWeight = data.ch1Weight + data.ch2Weight;
@@ -1355,6 +6097,14 @@ SensorData readSensors() {
   return data;
 }
 
+// Calibrated linear model: weight from air pressure, ambient pressure and temperature
+float computeChannelWeight(const RegressionCoeffs& coeffs, float airPressure, float ambientPressure, float temperature) {
+  return coeffs.intercept +
+         (airPressure * coeffs.airPressureCoeff) +
+         (ambientPressure * coeffs.ambientPressureCoeff) +
+         (temperature * coeffs.airTempCoeff);
+}
+
 String getCurrentTimestamp() {
   return String(millis());
 }
@@ -1396,52 +6146,349 @@ void tryConnectWiFi() {
 void setupWebServer() {
   if (!server) return;  // Guard against null
 
-  server->on("/", HTTP_GET, []() {
+  server->on("/", HTTP_GET, [](AsyncWebServerRequest* request) {
     String html = "<html><head><title>AirScale</title></head><body>";
     html += "<h1>AirScale Device</h1>";
     html += "<p><b>MAC:</b> " + deviceMAC + "</p>";
     html += "<p><b>Role:</b> " + String(isHub ? "HUB (BLE Connected)" : "DEVICE") + "</p>";
     html += "<p><b>BLE:</b> " + String(deviceConnected ? "Connected" : "Waiting") + "</p>";
     html += "<p><b>BME280:</b> " + String(bmeInitialized ? "OK" : "Not Found") + "</p>";
-    html += "<p><b>Known Devices:</b> " + String(deviceCount) + "</p>";
+    html += "<p><b>Known Devices:</b> " + String(deviceCount.load()) + "</p>";
+    RegressionCoeffs coeffs1 = liveCoeffs(1);
+    RegressionCoeffs coeffs2 = liveCoeffs(2);
     html += "<p><b>Channel 1 Coefficients (Axle Group 1):</b><br>";
-    html += "Intercept: " + String(ch1Coeffs.intercept, 4) + "<br>";
-    html += "Air Pressure: " + String(ch1Coeffs.airPressureCoeff, 4) + "<br>";
-    html += "Ambient: " + String(ch1Coeffs.ambientPressureCoeff, 4) + "<br>";
-    html += "Temp: " + String(ch1Coeffs.airTempCoeff, 4) + "</p>";
+    html += "Intercept: " + String(coeffs1.intercept, 4) + "<br>";
+    html += "Air Pressure: " + String(coeffs1.airPressureCoeff, 4) + "<br>";
+    html += "Ambient: " + String(coeffs1.ambientPressureCoeff, 4) + "<br>";
+    html += "Temp: " + String(coeffs1.airTempCoeff, 4) + "</p>";
     html += "<p><b>Channel 2 Coefficients (Axle Group 2):</b><br>";
-    html += "Intercept: " + String(ch2Coeffs.intercept, 4) + "<br>";
-    html += "Air Pressure: " + String(ch2Coeffs.airPressureCoeff, 4) + "<br>";
-    html += "Ambient: " + String(ch2Coeffs.ambientPressureCoeff, 4) + "<br>";
-    html += "Temp: " + String(ch2Coeffs.airTempCoeff, 4) + "</p>";
+    html += "Intercept: " + String(coeffs2.intercept, 4) + "<br>";
+    html += "Air Pressure: " + String(coeffs2.airPressureCoeff, 4) + "<br>";
+    html += "Ambient: " + String(coeffs2.ambientPressureCoeff, 4) + "<br>";
+    html += "Temp: " + String(coeffs2.airTempCoeff, 4) + "</p>";
     html += "</body></html>";
-    server->send(200, "text/html", html);
+    request->send(200, "text/html", html);
   });
 
-  server->on("/api/status", HTTP_GET, []() {
-    DynamicJsonDocument doc(768);
+  server->on("/api/status", HTTP_GET, [](AsyncWebServerRequest* request) {
+    DynamicJsonDocument doc(4864 + 192 * deviceCount.load());  // Plus one link entry per device
     doc["mac_address"] = deviceMAC;
     doc["is_hub"] = isHub;
     doc["ble_connected"] = deviceConnected;
     doc["wifi_connected"] = isConnectedToWiFi;
-    doc["known_devices"] = deviceCount;
+    doc["known_devices"] = deviceCount.load();
+    doc["device_capacity"] = MAX_DEVICES;
+    doc["devices_evicted"] = g_devicesEvicted;
+    doc["devices_rejected"] = g_devicesRejected;
+
+    JsonObject espnowObj = doc.createNestedObject("espnow");
+    espnowObj["frame_version"] = ESPNOW_FRAME_VERSION;
+    espnowObj["rx_compact"] = g_framesCompactRx;
+    espnowObj["rx_legacy"] = g_framesLegacyRx;
+    espnowObj["rx_rejected"] = g_framesRejected;
+    espnowObj["frames_lost"] = g_framesLost;
+    espnowObj["tx_bytes"] = g_espnowTxBytes;
+    espnowObj["legacy_peers"] = legacyPeersPresent();
+
+    // Per-sender link statistics, devices heard directly
+    JsonArray linksArr = doc.createNestedArray("links");
+    int linkSlots = deviceSlotsInUse();
+    for (int i = 0; i < linkSlots; i++) {
+      DeviceData device;
+      if (!readDevice(i, device) || device.link.received == 0) continue;
+      JsonObject link = linksArr.createNestedObject();
+      link["mac"] = device.macAddress;
+      link["rssi"] = device.link.rssi;
+      link["loss"] = device.link.loss;
+      link["jitter_ms"] = device.link.jitterUs / 1000.0;
+      link["last_seen_ms"] = (long)((esp_timer_get_time() - device.link.lastRxUs) / 1000);
+      link["received"] = device.link.received;
+      link["lost"] = device.link.lost;
+      link["hops"] = device.hops;
+    }
+
+    JsonObject broadcastObj = doc.createNestedObject("broadcasts");
+    uint32_t broadcastsSent = g_broadcastsBy[BROADCAST_CHANGE] + g_broadcastsBy[BROADCAST_LOADING] +
+                              g_broadcastsBy[BROADCAST_HEARTBEAT];
+    double broadcastsFixed = g_broadcastFixedMicro / 1e6;
+    broadcastObj["change"] = g_broadcastsBy[BROADCAST_CHANGE];
+    broadcastObj["loading"] = g_broadcastsBy[BROADCAST_LOADING];
+    broadcastObj["heartbeat"] = g_broadcastsBy[BROADCAST_HEARTBEAT];
+    broadcastObj["fixed_interval_equivalent"] = broadcastsFixed;
+    broadcastObj["saved"] = broadcastsFixed - broadcastsSent;
+    broadcastObj["heartbeat_ms"] = g_broadcastHeartbeatMs;
+    broadcastObj["rate_lbs_s"] = g_broadcastRate;
+
+    JsonObject airtimeObj = doc.createNestedObject("airtime");
+    AirtimePlan plan(g_airtimeConfig);
+    int64_t planNow;
+    airtimeObj["mesh_clock"] = airtimePlan(esp_timer_get_time(), plan, planNow);
+    airtimeObj["frame_ms"] = AIRTIME_FRAME_MS;
+    airtimeObj["espnow_ms"] = plan.espnowUs() / 1000.0;
+    airtimeObj["slots"] = plan.slots();
+    if (plan.slot() == AIRTIME_HUB_SLOT) airtimeObj["slot"] = "hub";
+    else airtimeObj["slot"] = plan.slot();
+    airtimeObj["listed"] = plan.listed();
+    airtimeObj["relay_held"] = g_airtimeHeld;
+    airtimeObj["relay_off_slot"] = g_airtimeOffSlot;
+    airtimeObj["coex_switches"] = g_coexSwitches;
+    airtimeObj["coex_errors"] = g_coexErrors;
+    airtimeObj["ble_window_holds"] = g_bleWindowHolds;
+    airtimeObj["unicast_sent"] = g_espnowUnicastSent.load();
+    airtimeObj["unicast_failed"] = g_espnowUnicastFailed.load();
+    airtimeObj["direct_frame_loss"] = directFrameLoss();
+    LatencyStats discovery = readLatency(g_discoveryTime);
+    airtimeObj["discoveries"] = discovery.count;
+    airtimeObj["discovery_ms_mean"] = discovery.mean / 1000.0;
+    airtimeObj["discovery_ms_max"] = discovery.maxUs / 1000.0;
+
+    JsonObject otaObj = doc.createNestedObject("ota");
+    otaObj["state"] = (int)g_otaState;
+    otaObj["total"] = g_otaStaging.total();
+    otaObj["committed"] = (uint32_t)g_otaCommitted;
+    otaObj["resumed_from"] = g_otaResumedFrom;
+    otaObj["resumable"] = g_otaCrc != 0;
+    otaObj["flash_ms"] = g_otaFlashMs;
+    otaObj["full_stalls"] = g_otaFullStalls;
+    otaObj["rewinds"] = g_otaRewinds;
+    otaObj["image"] = g_otaContainer ? g_otaHeader.imageSize : g_otaStaging.total();
+
+    JsonObject meshOtaObj = doc.createNestedObject("mesh_ota");
+    portENTER_CRITICAL(&g_meshOtaMux);
+    bool meshPushing = g_meshOtaTx.running();
+    uint8_t meshTargets = g_meshOtaTx.count();
+    uint8_t meshDone = g_meshOtaTx.countIn(MESH_OTA_DONE);
+    uint8_t meshFailed = g_meshOtaTx.countIn(MESH_OTA_FAILED);
+    uint32_t meshRounds = g_meshOtaTx.rounds();
+    uint32_t meshSent = g_meshOtaTx.chunksSent();
+    uint8_t meshState = g_meshOtaRx.state();
+    uint16_t meshWindow = g_meshOtaRx.window();
+    portEXIT_CRITICAL(&g_meshOtaMux);
+    meshOtaObj["pushing"] = meshPushing;
+    meshOtaObj["targets"] = meshTargets;
+    meshOtaObj["targets_done"] = meshDone;
+    meshOtaObj["targets_failed"] = meshFailed;
+    meshOtaObj["rounds"] = meshRounds;
+    meshOtaObj["chunks_sent"] = meshSent;
+    meshOtaObj["state"] = meshState;
+    meshOtaObj["window"] = meshWindow;
+    meshOtaObj["send_errors"] = g_meshOtaSendErrors;
+    meshOtaObj["chunks"] = g_meshOtaChunks;
+    meshOtaObj["duplicates"] = g_meshOtaDuplicates;
+    meshOtaObj["statuses_sent"] = g_meshOtaStatusSent;
+    meshOtaObj["foreign"] = g_meshOtaForeign;
+
+    JsonObject coeffObj = doc.createNestedObject("coeff_delivery");
+    LatencyStats ack = readLatency(g_coeffDeliveryLatency);
+    coeffObj["pending"] = g_coeffDeliveries.pending();
+    coeffObj["in_flight"] = g_coeffDeliveries.inFlight();
+    coeffObj["delivered"] = g_coeffDeliveries.delivered();
+    coeffObj["failed"] = g_coeffDeliveries.failed();
+    coeffObj["retransmits"] = g_coeffDeliveries.retransmits();
+    coeffObj["ack_ms_mean"] = ack.mean / 1000.0;
+    coeffObj["ack_ms_max"] = ack.maxUs / 1000.0;
+    coeffObj["last_push_delivered"] = g_lastCoeffPush.delivered;
+    coeffObj["last_push_failed"] = g_lastCoeffPush.failed;
+    coeffObj["last_push_ms"] = (long)(g_lastCoeffPush.durationUs / 1000);
+    coeffObj["peers"] = g_peerCache.size();
+    coeffObj["peer_evictions"] = g_peerCache.evictions();
+    coeffObj["applied_ch1"] = g_appliedCoeffVersion[0];
+    coeffObj["applied_ch2"] = g_appliedCoeffVersion[1];
+    coeffObj["batches"] = g_coeffBatches;
+    coeffObj["batch_records"] = g_coeffBatchRecords;
+
+    JsonObject weighObj = doc.createNestedObject("weigh_now");
+    LatencyStats weigh = readLatency(g_weighLatency);
+    weighObj["rounds"] = g_weighRounds;
+    weighObj["complete"] = g_weighComplete;
+    weighObj["busy"] = g_weighBusy;
+    weighObj["late_replies"] = g_weighLateReplies;
+    weighObj["last_answered"] = g_weighLastAnswered;
+    weighObj["last_expected"] = g_weighLastExpected;
+    weighObj["latency_ms_mean"] = weigh.mean / 1000.0;
+    weighObj["latency_ms_max"] = weigh.maxUs / 1000.0;
+    weighObj["replies_sent"] = g_weighReplies;
+
+    JsonObject relayObj = doc.createNestedObject("relay");
+    MeshRoute route = lastMeshRoute();
+    uint32_t nowMs = millis();
+    portENTER_CRITICAL(&g_relayMux);
+    uint8_t neighbors = g_neighbors.live(nowMs);
+    uint8_t routes = g_routes.live(nowMs);
+    portEXIT_CRITICAL(&g_relayMux);
+    char parent[18] = "";
+    if (route.parent) formatMacKey(route.parent, parent);
+    relayObj["parent"] = parent;
+    relayObj["hops"] = route.hops;
+    relayObj["cost"] = route.cost;
+    relayObj["neighbors"] = neighbors;
+    relayObj["reverse_routes"] = routes;
+    relayObj["originated"] = g_relayOriginated;
+    relayObj["forwarded"] = g_relayForwarded;
+    relayObj["delivered"] = g_relayDelivered;
+    relayObj["duplicates"] = g_relayDuplicates;
+    relayObj["expired"] = g_relayExpired;
+    relayObj["budget_drops"] = g_relayBudgetDrops;
+    relayObj["drops"] = g_relayDrops.load();
     doc["bme280"] = bmeInitialized;
 
+    JsonObject adcObj = doc.createNestedObject("adc");
+    adcObj["source"] = g_adcHardware ? "dma" : "simulated";
+    adcObj["sample_rate_hz"] = ADC_SAMPLE_RATE_HZ;
+    adcObj["decimation"] = ADC_DECIMATION;
+    adcObj["ch1_psi"] = getChannelPressure(1);
+    adcObj["ch2_psi"] = getChannelPressure(2);
+    adcObj["raw_samples"] = g_adcStats[0].rawSamples + g_adcStats[1].rawSamples;
+    adcObj["overruns"] = g_adcOverruns;
+    if (!g_adcHardware) {
+      adcObj["scenario"] = g_scenarioName;
+      adcObj["scenario_speed"] = g_scenarioSpeed;
+      adcObj["scenario_seed"] = g_scenarioSeed;
+      adcObj["scenario_time_s"] = g_scenarioSeconds.load(std::memory_order_relaxed);
+    }
+
+    ChannelEstimate est1 = getChannelEstimate(1);
+    ChannelEstimate est2 = getChannelEstimate(2);
+    JsonObject estObj = doc.createNestedObject("estimator");
+    estObj["ch1_weight"] = est1.weight;
+    estObj["ch1_std_dev"] = est1.stdDev;
+    estObj["ch1_settled"] = est1.settled;
+    estObj["ch2_weight"] = est2.weight;
+    estObj["ch2_std_dev"] = est2.stdDev;
+    estObj["ch2_settled"] = est2.settled;
+
+    EnvSample env = getEnvironment();
+    JsonObject envObj = doc.createNestedObject("environment");
+    envObj["temperature_f"] = env.temperature;
+    envObj["pressure_psi"] = env.atmosphericPressure;
+    envObj["age_ms"] = millis() - env.timestamp;
+    envObj["i2c_transactions"] = g_envI2cTransactions;
+    envObj["read_errors"] = g_envReadErrors;
+
+    LatencyStats notify = readLatency(g_notifyLatency);
+    LatencyStats late = readLatency(g_notifyLateness);
+    LatencyStats bcast = readLatency(g_broadcastLatency);
+    JsonObject taskObj = doc.createNestedObject("tasks");
+    taskObj["notify_latency_mean_us"] = notify.mean;
+    taskObj["notify_latency_jitter_us"] = notify.stdDev();
+    taskObj["notify_latency_p99_us"] = notify.percentile(0.99);
+    taskObj["notify_latency_max_us"] = notify.maxUs;
+    taskObj["notify_count"] = notify.count;
+    LatencyStats refresh = readLatency(g_fleetRefreshTime);
+    taskObj["fleet_refresh_mean_us"] = refresh.mean;
+    taskObj["fleet_refresh_max_us"] = refresh.maxUs;
+    taskObj["fleet_frames"] = g_fleetFramesSent;
+    taskObj["ble_notify_stalls"] = g_bleNotifyStalls;
+    taskObj["publish_on_change"] = g_publishOnChange;
+    taskObj["publish_heartbeats"] = g_publishHeartbeats;
+    JsonObject syncObj = doc.createNestedObject("time_sync");
+    syncObj["role"] = isHub ? "master" : "slave";
+    syncObj["beacons_sent"] = g_timeSyncBeaconsSent;
+    {
+      int64_t now = esp_timer_get_time();
+      portENTER_CRITICAL(&g_timeSyncMux);
+      bool synced = g_timeSync.synced(now);
+      int64_t offset = g_timeSync.offsetAt(now);
+      float drift = g_timeSync.driftPpm();
+      uint32_t jitter = g_timeSync.jitterUs();
+      uint32_t beacons = g_timeSync.beacons();
+      uint32_t outliers = g_timeSync.outliers();
+      uint32_t restarts = g_timeSync.restarts();
+      portEXIT_CRITICAL(&g_timeSyncMux);
+      syncObj["synced"] = isHub || synced;
+      syncObj["offset_ms"] = offset / 1000.0;
+      syncObj["drift_ppm"] = drift;
+      syncObj["fit_jitter_us"] = jitter;
+      syncObj["beacons_received"] = beacons;
+      syncObj["outliers"] = outliers;
+      syncObj["restarts"] = restarts;
+    }
+    LatencyStats skew = readLatency(g_fleetSkew);
+    syncObj["coherence_ms"] = readPublishConfig().coherenceMs;
+    syncObj["fleet_in_window"] = g_fleetInTotal;
+    syncObj["fleet_out_of_window"] = g_fleetOutOfWindow;
+    syncObj["fleet_unaligned"] = g_fleetUnaligned;
+    syncObj["fleet_skew_mean_us"] = skew.mean;
+    syncObj["fleet_skew_max_us"] = skew.maxUs;
+    PublishConfig policy = readPublishConfig();
+    taskObj["publish_min_ms"] = policy.minIntervalMs;
+    taskObj["publish_max_ms"] = policy.maxIntervalMs;
+    taskObj["notify_lateness_mean_us"] = late.mean;
+    taskObj["notify_lateness_jitter_us"] = late.stdDev();
+    taskObj["broadcast_latency_mean_us"] = bcast.mean;
+    taskObj["broadcast_latency_jitter_us"] = bcast.stdDev();
+    taskObj["snapshot_drops"] = g_snapshotDrops;
+    taskObj["radio_command_drops"] = g_radioCommandDrops;
+    taskObj["deferred_processed"] = g_deferredProcessed;
+    taskObj["deferred_drops"] = g_deferredDrops.load();
+    taskObj["deferred_pool_peak"] = g_deferredPool.peakInUse();
+    taskObj["device_read_retries"] = g_deviceReadRetries.load();
+
+    LatencyStats wake = readLatency(g_wakeLatency);
+    JsonObject schedObj = doc.createNestedObject("scheduler");
+    schedObj["wakeups"] = g_housekeepingWakeups;
+    schedObj["dispatched"] = g_scheduler.dispatched();
+    schedObj["wake_latency_mean_us"] = wake.mean;
+    schedObj["wake_latency_p99_us"] = wake.percentile(0.99);
+    schedObj["wake_latency_max_us"] = wake.maxUs;
+    schedObj["light_sleep"] = g_lightSleepEnabled;
+    JsonArray jobsArr = schedObj.createNestedArray("jobs");
+    for (uint8_t i = 0; i < g_scheduler.count(); i++) {
+      JsonObject jobObj = jobsArr.createNestedObject();
+      jobObj["name"] = g_scheduler.job(i).name;
+      jobObj["runs"] = g_scheduler.job(i).runs;
+      jobObj["max_late_us"] = g_scheduler.job(i).maxLatenessUs;
+    }
+
+    JsonObject histObj = doc.createNestedObject("history");
+    histObj["boot_id"] = g_bootId;
+    histObj["ring_capacity"] = g_history.capacity();
+    histObj["samples"] = historyEndIndex();
+    histObj["flushed"] = g_historyFlushed;
+    histObj["log_bytes"] = g_historyBytesLogged;
+
+    RegressionCoeffs coeffs1 = liveCoeffs(1);
+    RegressionCoeffs coeffs2 = liveCoeffs(2);
     JsonObject ch1CoeffsObj = doc.createNestedObject("ch1_coefficients");
-    ch1CoeffsObj["intercept"] = ch1Coeffs.intercept;
-    ch1CoeffsObj["air_pressure"] = ch1Coeffs.airPressureCoeff;
-    ch1CoeffsObj["ambient_pressure"] = ch1Coeffs.ambientPressureCoeff;
-    ch1CoeffsObj["temperature"] = ch1Coeffs.airTempCoeff;
+    ch1CoeffsObj["intercept"] = coeffs1.intercept;
+    ch1CoeffsObj["air_pressure"] = coeffs1.airPressureCoeff;
+    ch1CoeffsObj["ambient_pressure"] = coeffs1.ambientPressureCoeff;
+    ch1CoeffsObj["temperature"] = coeffs1.airTempCoeff;
 
     JsonObject ch2CoeffsObj = doc.createNestedObject("ch2_coefficients");
-    ch2CoeffsObj["intercept"] = ch2Coeffs.intercept;
-    ch2CoeffsObj["air_pressure"] = ch2Coeffs.airPressureCoeff;
-    ch2CoeffsObj["ambient_pressure"] = ch2Coeffs.ambientPressureCoeff;
-    ch2CoeffsObj["temperature"] = ch2Coeffs.airTempCoeff;
+    ch2CoeffsObj["intercept"] = coeffs2.intercept;
+    ch2CoeffsObj["air_pressure"] = coeffs2.airPressureCoeff;
+    ch2CoeffsObj["ambient_pressure"] = coeffs2.ambientPressureCoeff;
+    ch2CoeffsObj["temperature"] = coeffs2.airTempCoeff;
+
+    String response;
+    serializeJson(doc, response);
+    request->send(200, "application/json", response);
+  });
+
+  // Pick the simulated pressure scenario: profile=cycle|ramp|leak|dropout|vibration|trace,
+  // optional speed (1-100x) and seed. Persisted so it survives a reboot.
+  server->on("/api/scenario", HTTP_POST, [](AsyncWebServerRequest* request) {
+    String name = request->hasArg("profile") ? request->arg("profile") : String(g_scenarioName);
+    float speed = request->hasArg("speed") ? request->arg("speed").toFloat() : g_scenarioSpeed;
+    uint32_t seed = request->hasArg("seed") ? (uint32_t)request->arg("seed").toInt() : g_scenarioSeed;
 
+    if (!setScenario(name.c_str(), speed, seed)) {
+      request->send(400, "application/json", "{\"error\":\"unknown profile, no trace loaded, or change pending\"}");
+      return;
+    }
+    preferences.putString("scenario", g_scenarioName);
+    preferences.putFloat("scenario_speed", g_scenarioSpeed);
+    preferences.putUInt("scenario_seed", g_scenarioSeed);
+
+    DynamicJsonDocument doc(256);
+    doc["scenario"] = g_scenarioName;
+    doc["speed"] = g_scenarioSpeed;
+    doc["seed"] = seed;
+    doc["trace_rows"] = g_scenarioTrace.count;
     String response;
     serializeJson(doc, response);
-    server->send(200, "application/json", response);
+    request->send(200, "application/json", response);
   });
 
   server->begin();
@@ -1452,10 +6499,23 @@ void setupWebServer() {
 // LED FUNCTIONS
 // ============================================================
 
+// Safe from any task or callback: once the housekeeping task runs, it does the rendering
 void setLEDStatus(LEDStatus status) {
-  if (!pixel) return;  // Guard against early calls before init
-
   currentLEDStatus = status;
+  g_ledDirty = true;
+  if (!g_housekeepingTaskHandle) showLEDStatus(status);  // Still single-threaded setup()
+  signalHousekeeping(HK_EVENT_LED);
+}
+
+// Brief white flash on transmit, then back to the current status
+void flashLED() {
+  g_ledFlashUntil = millis() + LED_FLASH_MS;
+  g_ledDirty = true;
+  signalHousekeeping(HK_EVENT_LED);
+}
+
+static void showLEDStatus(LEDStatus status) {
+  if (!pixel) return;  // Guard against early calls before init
 
   switch (status) {
     case LED_OFF:
@@ -1486,8 +6546,20 @@ void updateLED() {
   static unsigned long lastUpdate = 0;
   static uint8_t brightness = 0;
   static bool increasing = true;
+  static bool flashing = false;
+
+  if ((int32_t)(g_ledFlashUntil - millis()) > 0) {
+    if (!flashing) showLEDStatus(LED_TRANSMITTING);
+    flashing = true;
+    return;
+  }
+  if (flashing || g_ledDirty) {
+    flashing = false;
+    g_ledDirty = false;
+    showLEDStatus(currentLEDStatus);
+  }
 
-  if (millis() - lastUpdate > 30) {
+  if (millis() - lastUpdate >= LED_PULSE_MS) {
     // Pulse effect for hub and standalone modes
     if (currentLEDStatus == LED_HUB_MODE || currentLEDStatus == LED_STANDALONE) {
       if (increasing) {
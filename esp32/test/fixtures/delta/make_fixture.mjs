@@ -0,0 +1,40 @@
+// Delta OTA fixture for test/test_delta_patch: two app images built from this tree
+// and the container the web app would send to turn one into the other.
+//
+//   pio run -e esp32s3_n16r8 && cp .pio/build/esp32s3_n16r8/firmware.bin /tmp/base.bin
+//   (change something, build again)
+//   node test/fixtures/delta/make_fixture.mjs /tmp/base.bin .pio/build/esp32s3_n16r8/firmware.bin
+//
+// writes base.bin, new.bin and delta.ota next to this script.
+
+import { readFileSync, writeFileSync } from 'node:fs';
+import { createHash } from 'node:crypto';
+import { dirname, join } from 'node:path';
+import { fileURLToPath } from 'node:url';
+import { OTA_CODEC_DELTA, lzssCompress, otaContainer, espImageDigest, deltaPatch } from '../../../../webapp/assets/js/ota_codec.js';
+
+const [basePath, newPath] = process.argv.slice(2);
+if (!basePath || !newPath) {
+  console.error('usage: node make_fixture.mjs <base.bin> <new.bin>');
+  process.exit(1);
+}
+
+const base = new Uint8Array(readFileSync(basePath));
+const image = new Uint8Array(readFileSync(newPath));
+const baseSha256 = espImageDigest(base);
+if (!baseSha256) {
+  console.error(`${basePath}: not an app image with an appended SHA-256`);
+  process.exit(1);
+}
+
+const patch = deltaPatch(base, image, baseSha256);
+const payload = lzssCompress(patch);
+const sha256 = createHash('sha256').update(image).digest();
+const container = otaContainer(OTA_CODEC_DELTA, payload, image.length, sha256);
+
+const here = dirname(fileURLToPath(import.meta.url));
+writeFileSync(join(here, 'base.bin'), base);
+writeFileSync(join(here, 'new.bin'), image);
+writeFileSync(join(here, 'delta.ota'), container);
+console.log(`delta.ota: ${container.length} bytes for a ${image.length}-byte image ` +
+            `(${(100 * container.length / image.length).toFixed(1)}%)`);
@@ -0,0 +1,86 @@
+// CicDecimator and AdcChannelStats (adc_decimator.h)
+
+#include <unity.h>
+#include "adc_decimator.h"
+
+void setUp() {}
+void tearDown() {}
+
+// A constant input comes out unchanged once the start-up transient is past
+static void test_dc_passes_with_unity_gain() {
+  CicDecimator<3> cic(64);
+  int outputs = 0;
+  for (int i = 0; i < 64 * 10; i++) {
+    if (cic.push(2048)) {
+      outputs++;
+      TEST_ASSERT_EQUAL_FLOAT(2048.0f, cic.output());
+    }
+  }
+  TEST_ASSERT_EQUAL_INT(10 - 3, outputs);  // The first STAGES outputs are held back
+}
+
+// Full-scale 12-bit input with 3 stages at R = 64 uses 30 bits: no wrap-around
+static void test_full_scale_does_not_overflow() {
+  CicDecimator<3> cic(64);
+  for (int i = 0; i < 64 * 8; i++) {
+    if (cic.push(4095)) TEST_ASSERT_EQUAL_FLOAT(4095.0f, cic.output());
+  }
+}
+
+// A step settles to the new level within STAGES outputs
+static void test_step_settles() {
+  CicDecimator<3> cic(16);
+  for (int i = 0; i < 16 * 8; i++) cic.push(1000);
+  int after = 0;
+  for (int i = 0; i < 16 * 8; i++) {
+    if (cic.push(3000)) after++;
+    if (after > 3) TEST_ASSERT_EQUAL_FLOAT(3000.0f, cic.output());
+  }
+  TEST_ASSERT_EQUAL_INT(8, after);
+}
+
+// Noise averages out: alternating samples decimate to their mean
+static void test_alternating_input_averages() {
+  CicDecimator<2> cic(32);
+  bool any = false;
+  for (int i = 0; i < 32 * 10; i++) {
+    if (cic.push(i & 1 ? 1100 : 900)) {
+      any = true;
+      TEST_ASSERT_FLOAT_WITHIN(0.5f, 1000.0f, cic.output());
+    }
+  }
+  TEST_ASSERT_TRUE(any);
+}
+
+static void test_reset_restarts_and_guards_zero_ratio() {
+  CicDecimator<1> cic(4);
+  for (int i = 0; i < 40; i++) cic.push(500);
+  cic.reset(0);
+  TEST_ASSERT_EQUAL_UINT16(1, cic.ratio());
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, cic.output());
+  TEST_ASSERT_FALSE(cic.push(7));  // Transient again
+  TEST_ASSERT_TRUE(cic.push(7));
+  TEST_ASSERT_EQUAL_FLOAT(7.0f, cic.output());
+}
+
+static void test_channel_stats() {
+  AdcChannelStats stats;
+  stats.record(300);
+  stats.record(100);
+  stats.record(200);
+  TEST_ASSERT_EQUAL_UINT32(3, stats.rawSamples);
+  TEST_ASSERT_EQUAL_UINT16(200, stats.lastRaw);
+  TEST_ASSERT_EQUAL_UINT16(100, stats.minRaw);
+  TEST_ASSERT_EQUAL_UINT16(300, stats.maxRaw);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_dc_passes_with_unity_gain);
+  RUN_TEST(test_full_scale_does_not_overflow);
+  RUN_TEST(test_step_settles);
+  RUN_TEST(test_alternating_input_averages);
+  RUN_TEST(test_reset_restarts_and_guards_zero_ratio);
+  RUN_TEST(test_channel_stats);
+  return UNITY_END();
+}
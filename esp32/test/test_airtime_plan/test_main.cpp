@@ -0,0 +1,119 @@
+// Superframe airtime plan (airtime_plan.h)
+
+#include <unity.h>
+#include "airtime_plan.h"
+
+void setUp() {}
+void tearDown() {}
+
+// 100 ms superframe: 10 ms hub slot, 5 ms per slave, 1 ms guard, 2 spare slots
+static AirtimeConfig config() {
+  AirtimeConfig c;
+  c.frameUs = 100000;
+  c.hubSlotUs = 10000;
+  c.slotUs = 5000;
+  c.guardUs = 1000;
+  c.maxSlots = 8;
+  c.spareSlots = 2;
+  return c;
+}
+
+static void tails(uint8_t* out, const uint16_t* t, uint8_t n) {
+  for (uint8_t i = 0; i < n; i++) framePutU16(out + 2 * i, t[i]);
+}
+
+static void test_listed_slave_gets_its_position() {
+  AirtimePlan plan(config());
+  const uint16_t list[3] = {0x1111, 0x2222, 0x3333};
+  uint8_t buf[6];
+  tails(buf, list, 3);
+  plan.assign(buf, 3, 0x2222);
+  TEST_ASSERT_EQUAL_UINT8(1, plan.slot());
+  TEST_ASSERT_TRUE(plan.listed());
+  TEST_ASSERT_EQUAL_UINT8(5, plan.slots());  // 3 listed + 2 spare
+  TEST_ASSERT_EQUAL_UINT32(10000 + 5 * 5000, plan.espnowUs());
+}
+
+static void test_unlisted_slave_shares_a_spare_slot() {
+  AirtimePlan plan(config());
+  const uint16_t list[2] = {0x1111, 0x2222};
+  uint8_t buf[4];
+  tails(buf, list, 2);
+  plan.assign(buf, 2, 0x0005);
+  TEST_ASSERT_FALSE(plan.listed());
+  TEST_ASSERT_EQUAL_UINT8(2 + 0x0005 % 2, plan.slot());
+}
+
+// More slaves listed than maxSlots allows: the list is cut so the spares remain
+static void test_slots_capped() {
+  AirtimePlan plan(config());
+  uint16_t list[10];
+  for (uint8_t i = 0; i < 10; i++) list[i] = (uint16_t)(0x100 + i);
+  uint8_t buf[20];
+  tails(buf, list, 10);
+  plan.assign(buf, 10, 0x109);  // Last in the list, past the cut
+  TEST_ASSERT_EQUAL_UINT8(8, plan.slots());
+  TEST_ASSERT_FALSE(plan.listed());
+  TEST_ASSERT_TRUE(plan.slot() >= 6 && plan.slot() < 8);
+}
+
+static void test_phases_and_changes() {
+  AirtimePlan plan(config());
+  plan.assignHub(2);  // 4 slave slots: ESP-NOW part 30 ms
+  TEST_ASSERT_EQUAL(AIRTIME_ESPNOW, plan.phase(200000));
+  TEST_ASSERT_EQUAL(AIRTIME_ESPNOW, plan.phase(229999));
+  TEST_ASSERT_EQUAL(AIRTIME_BLE, plan.phase(230000));
+  TEST_ASSERT_EQUAL(AIRTIME_BLE, plan.phase(299999));
+  TEST_ASSERT_EQUAL_INT64(230000, plan.nextPhaseChange(205000));
+  TEST_ASSERT_EQUAL_INT64(300000, plan.nextPhaseChange(250000));
+  TEST_ASSERT_EQUAL(AIRTIME_BLE, plan.phase(-1));  // Before the clock's zero
+}
+
+static void test_hub_tx_waits_for_guard_and_fit() {
+  AirtimePlan plan(config());
+  plan.assignHub(0);
+  TEST_ASSERT_EQUAL_INT64(101000, plan.txAt(100000, 2000));  // Guard first
+  TEST_ASSERT_EQUAL_INT64(105000, plan.txAt(105000, 2000));  // Fits
+  TEST_ASSERT_TRUE(plan.inSlot(105000, 2000));
+  TEST_ASSERT_EQUAL_INT64(201000, plan.txAt(109000, 2000));  // Would overrun: next superframe
+  TEST_ASSERT_EQUAL_INT64(201000, plan.txAt(150000, 100));   // BLE window
+}
+
+static void test_slave_slot_position() {
+  AirtimePlan plan(config());
+  const uint16_t list[3] = {0x1111, 0x2222, 0x3333};
+  uint8_t buf[6];
+  tails(buf, list, 3);
+  plan.assign(buf, 3, 0x3333);  // Slot 2: 20..25 ms
+  TEST_ASSERT_EQUAL_INT64(21000, plan.txAt(0, 1000));
+  TEST_ASSERT_EQUAL_INT64(23000, plan.txAt(23000, 2000));
+  TEST_ASSERT_EQUAL_INT64(121000, plan.txAt(23500, 2000));
+  TEST_ASSERT_FALSE(plan.inSlot(12000, 500));  // Someone else's slot
+}
+
+// A frame longer than the slot goes at the slot's opening instead of never
+static void test_oversized_frame_starts_at_opening() {
+  AirtimePlan plan(config());
+  plan.assignHub(0);
+  TEST_ASSERT_EQUAL_INT64(101000, plan.txAt(100500, 20000));
+  TEST_ASSERT_EQUAL_INT64(101000, plan.txAt(101000, 20000));
+  TEST_ASSERT_EQUAL_INT64(201000, plan.txAt(101001, 20000));
+}
+
+static void test_espnow_air_time() {
+  TEST_ASSERT_EQUAL_UINT32(192 + 43 * 8, espnowAirUs(0));
+  TEST_ASSERT_EQUAL_UINT32(192 + (43 + 250) * 8, espnowAirUs(250));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_listed_slave_gets_its_position);
+  RUN_TEST(test_unlisted_slave_shares_a_spare_slot);
+  RUN_TEST(test_slots_capped);
+  RUN_TEST(test_phases_and_changes);
+  RUN_TEST(test_hub_tx_waits_for_guard_and_fit);
+  RUN_TEST(test_slave_slot_position);
+  RUN_TEST(test_oversized_frame_starts_at_opening);
+  RUN_TEST(test_espnow_air_time);
+  return UNITY_END();
+}
@@ -0,0 +1,116 @@
+// Change-driven broadcast decisions (broadcast_policy.h)
+
+#include <unity.h>
+#include "broadcast_policy.h"
+
+void setUp() {}
+void tearDown() {}
+
+static BroadcastPolicyConfig config() {
+  BroadcastPolicyConfig c;
+  c.deadband[0] = 0.5f;
+  c.deadband[1] = 0.5f;
+  c.rateLbsPerSec = 5.0f;
+  c.rateWindowUs = 200000;
+  c.fastUs = 100000;
+  c.heartbeatMinUs = 1000000;
+  c.heartbeatMaxUs = 8000000;
+  return c;
+}
+
+static void test_first_sample_goes_out() {
+  BroadcastScheduler s(config());
+  TEST_ASSERT_EQUAL(BROADCAST_NONE, s.pending());
+  s.sample(100.0f, 200.0f, 0);
+  TEST_ASSERT_EQUAL(BROADCAST_CHANGE, s.pending());
+  s.sent(BROADCAST_CHANGE);
+  TEST_ASSERT_EQUAL(BROADCAST_NONE, s.pending());
+}
+
+static void test_deadband_per_channel() {
+  BroadcastScheduler s(config());
+  s.sample(100.0f, 200.0f, 0);
+  s.sent(BROADCAST_CHANGE);
+  s.sample(100.4f, 199.6f, 20000);  // Inside both deadbands
+  TEST_ASSERT_EQUAL(BROADCAST_NONE, s.pending());
+  s.sample(100.4f, 199.5f, 40000);  // Channel 2 reaches its deadband
+  TEST_ASSERT_EQUAL(BROADCAST_CHANGE, s.pending());
+  s.sent(BROADCAST_CHANGE);
+  s.sample(100.4f, 199.9f, 60000);  // Measured from what was sent, not the first value
+  TEST_ASSERT_EQUAL(BROADCAST_NONE, s.pending());
+}
+
+static void test_zero_deadband_reports_any_change() {
+  BroadcastPolicyConfig c = config();
+  c.deadband[0] = 0.0f;
+  BroadcastScheduler s(c);
+  s.sample(1.0f, 0.0f, 0);
+  s.sent(BROADCAST_CHANGE);
+  s.sample(1.0f, 0.0f, 10000);
+  TEST_ASSERT_EQUAL(BROADCAST_NONE, s.pending());
+  s.sample(1.001f, 0.0f, 20000);
+  TEST_ASSERT_EQUAL(BROADCAST_CHANGE, s.pending());
+}
+
+// Loading starts at the rate threshold, measured over the window, and ends below
+// half of it
+static void test_loading_hysteresis() {
+  BroadcastScheduler s(config());
+  int64_t t = 0;
+  float w = 100.0f;
+  for (int i = 0; i < 20; i++, t += 20000) {  // 10 lbs/s
+    s.sample(w, 0.0f, t);
+    s.sent(BROADCAST_LOADING);
+    w += 0.2f;
+  }
+  TEST_ASSERT_TRUE(s.loading());
+  TEST_ASSERT_FLOAT_WITHIN(0.5f, 10.0f, s.rate());
+  TEST_ASSERT_EQUAL(BROADCAST_LOADING, s.pending());
+
+  for (int i = 0; i < 20; i++, t += 20000) {  // 3 lbs/s: above half the threshold
+    s.sample(w, 0.0f, t);
+    s.sent(BROADCAST_LOADING);
+    w += 0.06f;
+  }
+  TEST_ASSERT_TRUE(s.loading());
+  for (int i = 0; i < 20; i++, t += 20000) {  // Still
+    s.sample(w, 0.0f, t);
+  }
+  TEST_ASSERT_FALSE(s.loading());
+}
+
+// A single noisy sample inside the window doesn't count as loading
+static void test_rate_is_measured_across_the_window() {
+  BroadcastScheduler s(config());
+  s.sample(100.0f, 0.0f, 0);
+  s.sample(100.4f, 0.0f, 20000);  // 20 lbs/s sample to sample
+  s.sample(100.0f, 0.0f, 200000);
+  TEST_ASSERT_FALSE(s.loading());
+}
+
+static void test_heartbeat_backs_off_and_change_resets() {
+  BroadcastScheduler s(config());
+  s.sample(1.0f, 1.0f, 0);
+  s.sent(BROADCAST_CHANGE);
+  TEST_ASSERT_EQUAL_UINT32(1000000, s.heartbeatUs());
+  s.sent(BROADCAST_HEARTBEAT);
+  TEST_ASSERT_EQUAL_UINT32(2000000, s.heartbeatUs());
+  s.sent(BROADCAST_HEARTBEAT);
+  s.sent(BROADCAST_HEARTBEAT);
+  TEST_ASSERT_EQUAL_UINT32(8000000, s.heartbeatUs());
+  s.sent(BROADCAST_HEARTBEAT);
+  TEST_ASSERT_EQUAL_UINT32(8000000, s.heartbeatUs());  // Capped
+  s.sent(BROADCAST_CHANGE);
+  TEST_ASSERT_EQUAL_UINT32(1000000, s.heartbeatUs());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_first_sample_goes_out);
+  RUN_TEST(test_deadband_per_channel);
+  RUN_TEST(test_zero_deadband_reports_any_change);
+  RUN_TEST(test_loading_hysteresis);
+  RUN_TEST(test_rate_is_measured_across_the_window);
+  RUN_TEST(test_heartbeat_backs_off_and_change_resets);
+  return UNITY_END();
+}
@@ -0,0 +1,115 @@
+// Calibration batches (coeff_batch.h): chunks assembled into a batch, a new batch
+// never appending to what an interrupted one left, and the status split by MTU
+
+#include <unity.h>
+#include "coeff_batch.h"
+
+void setUp() {}
+void tearDown() {}
+
+// One write of 'n' records, numbered from 'first' (the record's version)
+static size_t chunk(uint8_t* out, uint8_t id, uint8_t flags, uint8_t n, uint32_t first) {
+  out[0] = COEFF_BATCH_OP_RECORDS;
+  out[1] = id;
+  out[2] = flags;
+  out[3] = n;
+  uint8_t* p = out + COEFF_BATCH_HEADER_SIZE;
+  for (uint8_t i = 0; i < n; i++, p += COEFF_BATCH_RECORD_SIZE) {
+    macKeyToBytes(0x24D7EB000000ull + first + i, p);
+    p[6] = 1 + (i & 1);
+    framePutF32(p + 7, 1.5f);
+    framePutF32(p + 11, 2.5f);
+    framePutF32(p + 15, 3.5f);
+    framePutF32(p + 19, 4.5f);
+    framePutU32(p + 23, first + i);
+  }
+  return COEFF_BATCH_HEADER_SIZE + (size_t)n * COEFF_BATCH_RECORD_SIZE;
+}
+
+static void test_chunks_assemble_into_one_batch() {
+  static uint8_t buf[COEFF_BATCH_HEADER_SIZE + COEFF_BATCH_MAX * COEFF_BATCH_RECORD_SIZE];
+  CoeffBatch b;
+  b.clear();
+  TEST_ASSERT_EQUAL(COEFF_BATCH_PARTIAL, b.feed(buf, chunk(buf, 7, COEFF_BATCH_FIRST, 3, 100)));
+  TEST_ASSERT_EQUAL(COEFF_BATCH_COMPLETE, b.feed(buf, chunk(buf, 7, COEFF_BATCH_LAST, 2, 103)));
+  TEST_ASSERT_EQUAL_UINT8(5, b.count);
+  for (uint8_t i = 0; i < 5; i++) TEST_ASSERT_EQUAL_UINT32(100 + i, b.records[i].version);
+  TEST_ASSERT_EQUAL_UINT64(0x24D7EB000000ull + 104, b.records[4].target);
+  TEST_ASSERT_EQUAL_UINT8(2, b.records[4].channel);
+  TEST_ASSERT_EQUAL_FLOAT(4.5f, b.records[4].airTempCoeff);
+  TEST_ASSERT_EQUAL_UINT8(COEFF_REC_QUEUED, b.records[4].status);
+
+  TEST_ASSERT_EQUAL(COEFF_BATCH_MALFORMED, b.feed(buf, 3));
+  TEST_ASSERT_EQUAL(COEFF_BATCH_MALFORMED, b.feed(buf, chunk(buf, 7, 0, 2, 0) - 1));  // Short of its count
+}
+
+// The app's batch ids restart with its session, so an interrupted batch's id comes
+// back: the first chunk of the next batch must not append to it
+static void test_first_chunk_discards_a_stale_partial() {
+  static uint8_t buf[COEFF_BATCH_HEADER_SIZE + COEFF_BATCH_MAX * COEFF_BATCH_RECORD_SIZE];
+  CoeffBatch b;
+  b.clear();
+  TEST_ASSERT_EQUAL(COEFF_BATCH_PARTIAL, b.feed(buf, chunk(buf, 1, COEFF_BATCH_FIRST, 4, 200)));
+  // Disconnected here; the next session starts over with id 1
+  TEST_ASSERT_EQUAL(COEFF_BATCH_COMPLETE, b.feed(buf, chunk(buf, 1, COEFF_BATCH_FIRST | COEFF_BATCH_LAST, 2, 300)));
+  TEST_ASSERT_EQUAL_UINT8(2, b.count);
+  TEST_ASSERT_EQUAL_UINT32(300, b.records[0].version);
+
+  // Without the flag (an older app), only a new id starts over
+  TEST_ASSERT_EQUAL(COEFF_BATCH_PARTIAL, b.feed(buf, chunk(buf, 2, 0, 4, 400)));
+  TEST_ASSERT_EQUAL(COEFF_BATCH_COMPLETE, b.feed(buf, chunk(buf, 3, COEFF_BATCH_LAST, 1, 500)));
+  TEST_ASSERT_EQUAL_UINT8(1, b.count);
+
+  // Over COEFF_BATCH_MAX in total: refused, nothing kept
+  for (int i = 0; i < 3; i++) TEST_ASSERT_EQUAL(COEFF_BATCH_PARTIAL, b.feed(buf, chunk(buf, 4, i == 0 ? COEFF_BATCH_FIRST : 0, 10, 0)));
+  TEST_ASSERT_EQUAL(COEFF_BATCH_MALFORMED, b.feed(buf, chunk(buf, 4, COEFF_BATCH_LAST, 3, 0)));
+  TEST_ASSERT_EQUAL_UINT8(0, b.count);
+}
+
+// Every notification fits the MTU, and together they carry each record once, in order
+static void test_status_splits_by_mtu() {
+  static uint8_t buf[COEFF_BATCH_HEADER_SIZE + COEFF_BATCH_MAX * COEFF_BATCH_RECORD_SIZE];
+  CoeffBatch b;
+  b.clear();
+  b.feed(buf, chunk(buf, 9, COEFF_BATCH_FIRST, 16, 1000));
+  b.feed(buf, chunk(buf, 9, COEFF_BATCH_LAST, 16, 1016));
+  TEST_ASSERT_TRUE(b.settle(0x24D7EB000000ull + 1000, 1, 1000, COEFF_REC_DELIVERED));
+
+  const uint16_t mtus[] = {23, 64, 185, 247, 517};
+  for (size_t m = 0; m < sizeof(mtus) / sizeof(mtus[0]); m++) {
+    size_t cap = mtus[m] - 3;
+    uint8_t out[512];
+    uint8_t next = 0;
+    int notifications = 0;
+    do {
+      uint8_t first = next;
+      size_t len = b.encodeStatus(out, cap, next);
+      TEST_ASSERT_TRUE(len > COEFF_BATCH_STATUS_HEADER_SIZE);
+      TEST_ASSERT_TRUE(len <= cap);
+      TEST_ASSERT_EQUAL_UINT8(9, out[0]);
+      TEST_ASSERT_EQUAL_UINT8(0, out[1]);  // Records still in progress
+      TEST_ASSERT_EQUAL_UINT8(32, out[2]);
+      TEST_ASSERT_EQUAL_UINT8(first, out[3]);
+      for (uint8_t i = first; i < next; i++) {
+        const uint8_t* p = out + COEFF_BATCH_STATUS_HEADER_SIZE + (i - first) * COEFF_BATCH_STATUS_SIZE;
+        TEST_ASSERT_EQUAL_UINT8(i == 0 ? COEFF_REC_DELIVERED : COEFF_REC_QUEUED, p[0]);
+        TEST_ASSERT_EQUAL_UINT32(1000 + i, frameGetU32(p + 1));
+      }
+      notifications++;
+    } while (next < b.count);
+    size_t perNotification = (cap - COEFF_BATCH_STATUS_HEADER_SIZE) / COEFF_BATCH_STATUS_SIZE;
+    TEST_ASSERT_EQUAL_INT((32 + perNotification - 1) / perNotification, notifications);
+  }
+
+  uint8_t out[8];
+  uint8_t next = 0;
+  TEST_ASSERT_EQUAL_size_t(0, b.encodeStatus(out, COEFF_BATCH_STATUS_HEADER_SIZE + COEFF_BATCH_STATUS_SIZE - 1, next));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_chunks_assemble_into_one_batch);
+  RUN_TEST(test_first_chunk_discards_a_stale_partial);
+  RUN_TEST(test_status_splits_by_mtu);
+  return UNITY_END();
+}
@@ -0,0 +1,378 @@
+// Delta firmware update (delta_patch.h) through the same LZSS container and
+// buffers as the OTA writer: hand-made patches against an app-image-shaped base,
+// and a real image pair from test/fixtures/delta, which must be there
+
+#include <unity.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "delta_patch.h"
+#include "ota_image.h"
+#include "ota_stream.h"
+
+#ifndef DELTA_FIXTURES
+#define DELTA_FIXTURES "test/fixtures/delta/"
+#endif
+
+typedef std::vector<uint8_t> Bytes;
+
+void setUp() {}
+void tearDown() {}
+
+static void put32(Bytes& b, uint32_t v) {
+  for (int i = 0; i < 4; i++) b.push_back((uint8_t)(v >> (8 * i)));
+}
+
+// The digest esptool appends to an app image, found the way the web app does
+static const uint8_t* imageDigest(const Bytes& image) {
+  if (image.size() < 24 || image[0] != 0xE9 || image[23] != 1) return nullptr;
+  size_t offset = 24;
+  for (int i = 0; i < image[1]; i++) {
+    if (offset + 8 > image.size()) return nullptr;
+    offset += 8 + otaImageLe32(&image[offset + 4]);
+  }
+  offset = (offset + 16) & ~(size_t)15;
+  return offset + 32 <= image.size() ? &image[offset] : nullptr;
+}
+
+// App image laid out as esptool writes it: header, two segments, checksum and
+// padding, then a digest (made up here; only where it sits matters)
+static Bytes appImage(const Bytes& code, uint8_t tag) {
+  Bytes b(24, 0);
+  b[0] = 0xE9;
+  b[1] = 2;
+  b[23] = 1;
+  size_t half = code.size() / 2;
+  put32(b, 0x3C000020);
+  put32(b, (uint32_t)half);
+  b.insert(b.end(), code.begin(), code.begin() + half);
+  put32(b, 0x40380000);
+  put32(b, (uint32_t)(code.size() - half));
+  b.insert(b.end(), code.begin() + half, code.end());
+  b.resize(((b.size() + 16) & ~(size_t)15) - 1, 0);
+  b.push_back(0xEF);  // Checksum
+  for (int i = 0; i < 32; i++) b.push_back((uint8_t)(tag + i * 13));
+  return b;
+}
+
+static Bytes code(size_t n, uint32_t seed) {
+  Bytes b(n);
+  for (size_t i = 0; i < n; i++) {
+    seed = seed * 1103515245u + 12345u;
+    b[i] = (uint8_t)(seed >> 16);
+  }
+  return b;
+}
+
+static void record(Bytes& patch, uint32_t diffLen, uint32_t extraLen, int32_t seek) {
+  put32(patch, diffLen);
+  put32(patch, extraLen);
+  put32(patch, (uint32_t)seek);
+}
+
+static Bytes patchHeader(const Bytes& base, const uint8_t* sha) {
+  Bytes p;
+  put32(p, DELTA_PATCH_MAGIC);
+  put32(p, (uint32_t)base.size());
+  p.insert(p.end(), sha, sha + 32);
+  return p;
+}
+
+// Diff bytes turning base[from, from + n) into image[at, at + n)
+static void diff(Bytes& patch, const Bytes& base, size_t from, const Bytes& image, size_t at, size_t n) {
+  for (size_t i = 0; i < n; i++) patch.push_back((uint8_t)(image[at + i] - base[from + i]));
+}
+
+// LZSS payload of all literals, which LzssDecoder reads like any other
+static Bytes stored(const Bytes& data) {
+  Bytes out;
+  for (size_t i = 0; i < data.size(); i++) {
+    if (i % 8 == 0) out.push_back((uint8_t)(data.size() - i >= 8 ? 0xFF : (1u << (data.size() - i)) - 1));
+    out.push_back(data[i]);
+  }
+  return out;
+}
+
+static Bytes container(const Bytes& payload, uint32_t imageSize) {
+  Bytes c;
+  put32(c, OTA_IMAGE_MAGIC);
+  c.push_back(OTA_IMAGE_VERSION);
+  c.push_back(OTA_CODEC_DELTA);
+  c.push_back(OTA_LZSS_WINDOW_BITS);
+  c.push_back(0);
+  put32(c, (uint32_t)payload.size());
+  put32(c, imageSize);
+  c.resize(OTA_IMAGE_HEADER_SIZE, 0);
+  c.insert(c.end(), payload.begin(), payload.end());
+  return c;
+}
+
+struct Base {
+  const Bytes* image;
+  uint32_t reads;
+  bool fail;
+};
+
+static bool readBase(void* ctx, uint32_t offset, uint8_t* out, size_t len) {
+  Base* b = (Base*)ctx;
+  b->reads++;
+  if (b->fail || offset + len > b->image->size()) return false;
+  memcpy(out, &(*b->image)[offset], len);
+  return true;
+}
+
+// The OTA writer's loop: container in 'step'-byte pieces, LZSS into a 1 KB patch
+// buffer, the patch applied into a 4 KB output block, the base checked against
+// the running image's digest once the patch header is in
+static uint8_t expand(const Bytes& ota, Base& base, Bytes& out, size_t step) {
+  OtaImageHeader header;
+  if (!parseOtaImageHeader(ota.data(), ota.size(), header) || header.codec != OTA_CODEC_DELTA) return OTA_ERR_CONTAINER;
+  static uint8_t window[OTA_LZSS_WINDOW];
+  static uint8_t patch[1024];
+  static uint8_t block[4096];
+  LzssDecoder decoder;
+  DeltaPatcher patcher;
+  decoder.begin(window);
+  patcher.begin(readBase, &base);
+  size_t patchAt = 0, patchLen = 0;
+  size_t in = OTA_IMAGE_HEADER_SIZE;
+  out.clear();
+  while (in < ota.size() || decoder.busy() || patchAt < patchLen) {
+    size_t len = ota.size() - in < step ? ota.size() - in : step;
+    size_t produced = 0;
+    if (patchAt == patchLen) {
+      size_t patched;
+      in += decoder.decode(&ota[in], len, patch, sizeof(patch), patched);
+      patchAt = 0;
+      patchLen = patched;
+    }
+    bool ready = patcher.ready();
+    patchAt += patcher.apply(patch + patchAt, patchLen - patchAt, block, sizeof(block), produced);
+    if (!ready && patcher.ready()) {
+      const uint8_t* running = imageDigest(*base.image);
+      if (!running || patcher.baseSize() > base.image->size() || memcmp(patcher.baseSha256(), running, 32) != 0)
+        return OTA_ERR_BASE;
+    }
+    if (decoder.failed() || patcher.failed()) return OTA_ERR_CONTAINER;
+    out.insert(out.end(), block, block + produced);
+    if (out.size() > header.imageSize) return OTA_ERR_CONTAINER;
+  }
+  if (!patcher.atBoundary() || out.size() != header.imageSize) return OTA_ERR_CONTAINER;
+  return OTA_OK;
+}
+
+struct Pair {
+  Bytes base;
+  Bytes image;
+  Bytes patch;
+};
+
+// New image: a changed constant, 300 bytes of new code in the middle and the
+// tail moved back by 64 bytes
+static Pair handMade() {
+  Pair p;
+  Bytes c = code(20000, 1);
+  p.base = appImage(c, 0x10);
+  Bytes n(c.begin(), c.begin() + 9000);
+  n[100] ^= 0x5A;
+  Bytes added = code(300, 2);
+  n.insert(n.end(), added.begin(), added.end());
+  n.insert(n.end(), c.begin() + 9064, c.end());
+  p.image = appImage(n, 0x20);
+
+  const uint8_t* digest = imageDigest(p.base);
+  TEST_ASSERT_NOT_NULL(digest);
+  p.patch = patchHeader(p.base, digest);
+  size_t head = 24 + 8 + 9000;  // Same layout up to the insert
+  record(p.patch, (uint32_t)head, 300, 64);
+  diff(p.patch, p.base, 0, p.image, 0, head);
+  p.patch.insert(p.patch.end(), added.begin(), added.end());
+  size_t moved = p.image.size() - head - 300 - 48;  // All but the checksum and digest
+  record(p.patch, (uint32_t)moved, (uint32_t)(p.image.size() - head - 300 - moved), 0);
+  diff(p.patch, p.base, head + 64, p.image, head + 300, moved);
+  p.patch.insert(p.patch.end(), p.image.end() - 48, p.image.end());
+  return p;
+}
+
+static void test_hand_made_patch_split_anywhere() {
+  Pair p = handMade();
+  Bytes ota = container(stored(p.patch), (uint32_t)p.image.size());
+  Base base = {&p.base, 0, false};
+  Bytes out;
+  for (size_t step : {(size_t)1, (size_t)7, (size_t)244, ota.size()}) {
+    TEST_ASSERT_EQUAL_UINT8(OTA_OK, expand(ota, base, out, step));
+    TEST_ASSERT_TRUE(out == p.image);
+  }
+}
+
+// The patch header alone reads nothing from the base, so a wrong base is caught
+// before a byte of it is used
+static void test_wrong_base_refused_before_reading_it() {
+  Pair p = handMade();
+  Bytes other = appImage(code(20000, 3), 0x30);
+  Bytes ota = container(stored(p.patch), (uint32_t)p.image.size());
+  Base base = {&other, 0, false};
+  Bytes out;
+  TEST_ASSERT_EQUAL_UINT8(OTA_ERR_BASE, expand(ota, base, out, 244));
+  TEST_ASSERT_EQUAL_UINT32(0, base.reads);
+  TEST_ASSERT_EQUAL(0, out.size());
+}
+
+static void test_bad_magic_fails() {
+  Pair p = handMade();
+  p.patch[0] ^= 1;
+  Base base = {&p.base, 0, false};
+  Bytes out;
+  TEST_ASSERT_EQUAL_UINT8(OTA_ERR_CONTAINER, expand(container(stored(p.patch), (uint32_t)p.image.size()), base, out, 244));
+}
+
+// A diff reaching past the base, or a seek back before its start, is corrupt
+static void test_out_of_range_diff_fails() {
+  Pair p = handMade();
+  Bytes far = patchHeader(p.base, imageDigest(p.base));
+  record(far, 100, 0, (int32_t)p.base.size());
+  diff(far, p.base, 0, p.image, 0, 100);
+  record(far, 1, 0, 0);
+  far.push_back(0);
+  Base base = {&p.base, 0, false};
+  Bytes out;
+  TEST_ASSERT_EQUAL_UINT8(OTA_ERR_CONTAINER, expand(container(stored(far), 200), base, out, 244));
+
+  Bytes back = patchHeader(p.base, imageDigest(p.base));
+  record(back, 10, 0, -20);
+  diff(back, p.base, 0, p.image, 0, 10);
+  record(back, 1, 0, 0);
+  back.push_back(0);
+  TEST_ASSERT_EQUAL_UINT8(OTA_ERR_CONTAINER, expand(container(stored(back), 11), base, out, 244));
+}
+
+// Cut inside a record: the output may be the right length, but not complete
+static void test_truncated_patch_fails() {
+  Pair p = handMade();
+  Bytes cut(p.patch.begin(), p.patch.end() - 5);
+  DeltaPatcher patcher;
+  Base base = {&p.base, 0, false};
+  patcher.begin(readBase, &base);
+  Bytes out(p.image.size());
+  size_t at = 0, done = 0, produced;
+  while (at < cut.size()) {
+    at += patcher.apply(&cut[at], cut.size() - at, &out[done], out.size() - done, produced);
+    done += produced;
+  }
+  TEST_ASSERT_FALSE(patcher.failed());
+  TEST_ASSERT_FALSE(patcher.atBoundary());
+  Bytes ota = container(stored(cut), (uint32_t)p.image.size());
+  TEST_ASSERT_EQUAL_UINT8(OTA_ERR_CONTAINER, expand(ota, base, out, 244));
+}
+
+static void test_base_read_error_fails() {
+  Pair p = handMade();
+  Base base = {&p.base, 0, true};
+  Bytes out;
+  TEST_ASSERT_EQUAL_UINT8(OTA_ERR_CONTAINER, expand(container(stored(p.patch), (uint32_t)p.image.size()), base, out, 244));
+}
+
+static bool load(const char* name, Bytes& out) {
+  FILE* f = fopen((std::string(DELTA_FIXTURES) + name).c_str(), "rb");
+  if (!f) return false;
+  uint8_t buf[4096];
+  size_t n;
+  out.clear();
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) out.insert(out.end(), buf, buf + n);
+  fclose(f);
+  return true;
+}
+
+static bool loadPair(Pair& p) {
+  return load("base.bin", p.base) && load("new.bin", p.image) && load("delta.ota", p.patch);
+}
+
+// A missing pair fails: these cases are what shows the patch applies to real builds
+#define REQUIRE_FIXTURES(p) \
+  if (!loadPair(p)) TEST_FAIL_MESSAGE("no ESP32 image pair in " DELTA_FIXTURES ", make one with make_fixture.mjs")
+
+// Two builds of this firmware and the container the web app makes for them
+static void test_real_pair_applies() {
+  Pair p;
+  REQUIRE_FIXTURES(p);
+  TEST_ASSERT_NOT_NULL(imageDigest(p.base));
+  Base base = {&p.base, 0, false};
+  Bytes out;
+  TEST_ASSERT_EQUAL_UINT8(OTA_OK, expand(p.patch, base, out, 244));
+  TEST_ASSERT_TRUE(out == p.image);
+  TEST_ASSERT_EQUAL_UINT8(OTA_OK, expand(p.patch, base, out, 1));
+  TEST_ASSERT_TRUE(out == p.image);
+}
+
+// The new image as the running one: refused on its digest
+static void test_real_pair_wrong_base() {
+  Pair p;
+  REQUIRE_FIXTURES(p);
+  Base base = {&p.image, 0, false};
+  Bytes out;
+  TEST_ASSERT_EQUAL_UINT8(OTA_ERR_BASE, expand(p.patch, base, out, 244));
+  TEST_ASSERT_EQUAL_UINT32(0, base.reads);
+}
+
+// The patch inside a container
+static Bytes unpack(const Bytes& ota) {
+  static uint8_t window[OTA_LZSS_WINDOW];
+  LzssDecoder decoder;
+  decoder.begin(window);
+  Bytes patch;
+  uint8_t buf[4096];
+  size_t in = OTA_IMAGE_HEADER_SIZE, produced;
+  while (in < ota.size() || decoder.busy()) {
+    in += decoder.decode(&ota[in], ota.size() - in, buf, sizeof(buf), produced);
+    patch.insert(patch.end(), buf, buf + produced);
+  }
+  return patch;
+}
+
+// Records that don't fit the base, and a patch cut short, are refused; a byte
+// flipped in the compressed payload never runs the pipeline out of bounds, and
+// what it lets through is left to the image digest the writer checks next
+static void test_real_pair_corrupt_patch() {
+  Pair p;
+  REQUIRE_FIXTURES(p);
+  Base base = {&p.base, 0, false};
+  Bytes out;
+  uint32_t size = (uint32_t)p.image.size();
+  Bytes patch = unpack(p.patch);
+  TEST_ASSERT_TRUE(patch.size() > DELTA_PATCH_HEADER_SIZE + DELTA_PATCH_RECORD_SIZE);
+
+  Bytes bad = patch;
+  bad[DELTA_PATCH_HEADER_SIZE + 3] = 0x7F;  // First diff far past the base
+  TEST_ASSERT_EQUAL_UINT8(OTA_ERR_CONTAINER, expand(container(stored(bad), size), base, out, 244));
+
+  bad = patch;
+  size_t second = DELTA_PATCH_HEADER_SIZE + DELTA_PATCH_RECORD_SIZE + otaImageLe32(&patch[DELTA_PATCH_HEADER_SIZE]) +
+                  otaImageLe32(&patch[DELTA_PATCH_HEADER_SIZE + 4]);
+  bad[DELTA_PATCH_HEADER_SIZE + 11] = 0x80;  // Seek back before the base
+  if (second + DELTA_PATCH_RECORD_SIZE <= patch.size() && otaImageLe32(&patch[second]) > 0)
+    TEST_ASSERT_EQUAL_UINT8(OTA_ERR_CONTAINER, expand(container(stored(bad), size), base, out, 244));
+
+  Bytes cut(patch.begin(), patch.end() - 3);
+  TEST_ASSERT_EQUAL_UINT8(OTA_ERR_CONTAINER, expand(container(stored(cut), size), base, out, 244));
+
+  size_t payload = p.patch.size() - OTA_IMAGE_HEADER_SIZE;
+  for (int k = 0; k < 64; k++) {
+    Bytes flipped = p.patch;
+    flipped[OTA_IMAGE_HEADER_SIZE + payload * k / 64] ^= 0x24;
+    if (expand(flipped, base, out, 244) == OTA_OK) TEST_ASSERT_EQUAL(size, out.size());
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_hand_made_patch_split_anywhere);
+  RUN_TEST(test_wrong_base_refused_before_reading_it);
+  RUN_TEST(test_bad_magic_fails);
+  RUN_TEST(test_out_of_range_diff_fails);
+  RUN_TEST(test_truncated_patch_fails);
+  RUN_TEST(test_base_read_error_fails);
+  RUN_TEST(test_real_pair_applies);
+  RUN_TEST(test_real_pair_wrong_base);
+  RUN_TEST(test_real_pair_corrupt_patch);
+  return UNITY_END();
+}
@@ -0,0 +1,403 @@
+// Compact ESP-NOW frames (espnow_frame.h): every frame type through encode and
+// decode, TLVs, header validation against short and inconsistent frames, the
+// legacy struct telling itself apart, and what encode/decode cost on a host
+
+#include <unity.h>
+#include <stdio.h>
+#include <chrono>
+#include "espnow_frame.h"
+
+void setUp() {}
+void tearDown() {}
+
+static FrameHeader header(const uint8_t* frame, size_t len) {
+  FrameHeader h;
+  TEST_ASSERT_TRUE(decodeFrameHeader(frame, len, h));
+  TEST_ASSERT_EQUAL_UINT8(ESPNOW_FRAME_VERSION, h.version);
+  TEST_ASSERT_EQUAL_size_t(len, ESPNOW_FRAME_HEADER_SIZE + h.length);
+  return h;
+}
+
+static SensorReport sampleReport() {
+  SensorReport r = {};
+  r.ch1AirPressure = 87.25f;
+  r.ch2AirPressure = 91.5f;
+  r.atmosphericPressure = 14.696f;
+  r.temperature = -12.34f;
+  r.elevation = 1234.0f;
+  r.ch1Weight = 17123.4f;
+  r.ch2Weight = -5.6f;
+  r.ch1WeightStdDev = 42.1f;
+  r.ch2WeightStdDev = 0.3f;
+  r.timestamp = 0xDEADBEEF;
+  r.batteryLevel = 0xFF;
+  r.settledFlags = 0x03;
+  r.isCharging = true;
+  return r;
+}
+
+static void test_sensor_round_trip() {
+  uint8_t frame[ESPNOW_FRAME_MAX];
+  SensorReport in = sampleReport();
+  size_t len = encodeSensorFrame(frame, sizeof(frame), 0xBEEF, in);
+  TEST_ASSERT_EQUAL_size_t(ESPNOW_FRAME_HEADER_SIZE + SENSOR_FIXED_SIZE, len);
+  FrameHeader h = header(frame, len);
+  TEST_ASSERT_EQUAL_UINT8(FRAME_SENSOR, h.type);
+  TEST_ASSERT_EQUAL_UINT16(0xBEEF, h.seq);
+
+  SensorReport out;
+  TEST_ASSERT_TRUE(decodeSensorFrame(frame, h, out));
+  TEST_ASSERT_FLOAT_WITHIN(0.005f, in.ch1AirPressure, out.ch1AirPressure);
+  TEST_ASSERT_FLOAT_WITHIN(0.005f, in.ch2AirPressure, out.ch2AirPressure);
+  TEST_ASSERT_FLOAT_WITHIN(0.0005f, in.atmosphericPressure, out.atmosphericPressure);
+  TEST_ASSERT_FLOAT_WITHIN(0.005f, in.temperature, out.temperature);
+  TEST_ASSERT_EQUAL_FLOAT(in.elevation, out.elevation);
+  TEST_ASSERT_FLOAT_WITHIN(0.05f, in.ch1Weight, out.ch1Weight);
+  TEST_ASSERT_FLOAT_WITHIN(0.05f, in.ch2Weight, out.ch2Weight);
+  TEST_ASSERT_FLOAT_WITHIN(0.05f, in.ch1WeightStdDev, out.ch1WeightStdDev);
+  TEST_ASSERT_FLOAT_WITHIN(0.05f, in.ch2WeightStdDev, out.ch2WeightStdDev);
+  TEST_ASSERT_EQUAL_UINT32(in.timestamp, out.timestamp);
+  TEST_ASSERT_EQUAL_UINT8(in.batteryLevel, out.batteryLevel);
+  TEST_ASSERT_EQUAL_UINT8(in.settledFlags, out.settledFlags);
+  TEST_ASSERT_TRUE(out.isCharging);
+
+  // Other decoders refuse it
+  CoeffsAck ack;
+  TEST_ASSERT_FALSE(decodeCoeffsAckFrame(frame, h, ack));
+}
+
+// Out-of-range values saturate, NaN goes to 0, negative pressures to 0
+static void test_sensor_quantization_saturates() {
+  uint8_t frame[ESPNOW_FRAME_MAX];
+  SensorReport in = sampleReport();
+  in.ch1AirPressure = -3.0f;
+  in.ch2AirPressure = 1000.0f;
+  in.temperature = NAN;
+  in.elevation = 99999.0f;
+  in.ch1Weight = 1e12f;
+  in.ch1WeightStdDev = 1e9f;
+  size_t len = encodeSensorFrame(frame, sizeof(frame), 1, in);
+  SensorReport out;
+  TEST_ASSERT_TRUE(decodeSensorFrame(frame, header(frame, len), out));
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, out.ch1AirPressure);
+  TEST_ASSERT_EQUAL_FLOAT(655.35f, out.ch2AirPressure);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, out.temperature);
+  TEST_ASSERT_EQUAL_FLOAT(32767.0f, out.elevation);
+  TEST_ASSERT_EQUAL_FLOAT(200000000.0f, out.ch1Weight);
+  TEST_ASSERT_EQUAL_FLOAT(6553.5f, out.ch1WeightStdDev);
+}
+
+static void test_coeffs_round_trip_and_crc() {
+  uint8_t frame[ESPNOW_FRAME_MAX];
+  CoeffsReport in = {2, 123.456f, -0.001234f, 7.5e-7f, 3.25f, 0x01020304};
+  size_t len = encodeCoeffsFrame(frame, sizeof(frame), 9, in);
+  FrameHeader h = header(frame, len);
+  CoeffsReport out;
+  bool crcOk = false;
+  TEST_ASSERT_TRUE(decodeCoeffsFrame(frame, h, out, crcOk));
+  TEST_ASSERT_TRUE(crcOk);
+  TEST_ASSERT_EQUAL_UINT8(2, out.channel);
+  TEST_ASSERT_EQUAL_FLOAT(in.intercept, out.intercept);  // Full float precision
+  TEST_ASSERT_EQUAL_FLOAT(in.airPressureCoeff, out.airPressureCoeff);
+  TEST_ASSERT_EQUAL_FLOAT(in.ambientPressureCoeff, out.ambientPressureCoeff);
+  TEST_ASSERT_EQUAL_FLOAT(in.airTempCoeff, out.airTempCoeff);
+  TEST_ASSERT_EQUAL_UINT32(in.version, out.version);
+
+  frame[ESPNOW_FRAME_HEADER_SIZE + 3] ^= 0x10;
+  TEST_ASSERT_TRUE(decodeCoeffsFrame(frame, h, out, crcOk));
+  TEST_ASSERT_FALSE(crcOk);
+
+  // No partial coefficients from a short sender
+  frame[6] = COEFFS_FIXED_SIZE - 1;
+  TEST_ASSERT_FALSE(decodeCoeffsFrame(frame, header(frame, len), out, crcOk));
+}
+
+static void test_small_frames_round_trip() {
+  uint8_t frame[ESPNOW_FRAME_MAX];
+
+  CoeffsAck ack = {1, 77, COEFFS_BAD_CRC}, ackOut;
+  size_t len = encodeCoeffsAckFrame(frame, sizeof(frame), 2, ack);
+  TEST_ASSERT_TRUE(decodeCoeffsAckFrame(frame, header(frame, len), ackOut));
+  TEST_ASSERT_EQUAL_UINT8(1, ackOut.channel);
+  TEST_ASSERT_EQUAL_UINT32(77, ackOut.version);
+  TEST_ASSERT_EQUAL_UINT8(COEFFS_BAD_CRC, ackOut.status);
+
+  int64_t masterUs = 0;
+  len = encodeTimeSyncFrame(frame, sizeof(frame), 3, 0x0123456789ABCDEFll);
+  TEST_ASSERT_TRUE(decodeTimeSyncFrame(frame, header(frame, len), masterUs));
+  TEST_ASSERT_TRUE(masterUs == 0x0123456789ABCDEFll);
+
+  WeighTrigger t = {42, 1234567890123ll, -5ll, 250, 6000, 17}, tOut;
+  len = encodeWeighTriggerFrame(frame, sizeof(frame), 4, t);
+  TEST_ASSERT_TRUE(decodeWeighTriggerFrame(frame, header(frame, len), tOut));
+  TEST_ASSERT_EQUAL_UINT8(42, tOut.id);
+  TEST_ASSERT_TRUE(tOut.masterUs == t.masterUs);
+  TEST_ASSERT_TRUE(tOut.sampleAtUs == t.sampleAtUs);
+  TEST_ASSERT_EQUAL_UINT16(250, tOut.replyAfterMs);
+  TEST_ASSERT_EQUAL_UINT16(6000, tOut.slotUs);
+  TEST_ASSERT_EQUAL_UINT8(17, tOut.slots);
+
+  WeighReply r = {42, 15000.04f, -20.0f, 12.3f, 0.0f, 0x07}, rOut;
+  len = encodeWeighReplyFrame(frame, sizeof(frame), 5, r);
+  TEST_ASSERT_TRUE(decodeWeighReplyFrame(frame, header(frame, len), rOut));
+  TEST_ASSERT_EQUAL_UINT8(42, rOut.id);
+  TEST_ASSERT_FLOAT_WITHIN(0.05f, r.ch1Weight, rOut.ch1Weight);
+  TEST_ASSERT_FLOAT_WITHIN(0.05f, r.ch2Weight, rOut.ch2Weight);
+  TEST_ASSERT_FLOAT_WITHIN(0.05f, r.ch1WeightStdDev, rOut.ch1WeightStdDev);
+  TEST_ASSERT_EQUAL_UINT8(0x07, rOut.flags);
+
+  // Too small a buffer: nothing written
+  TEST_ASSERT_EQUAL_size_t(0, encodeWeighTriggerFrame(frame, ESPNOW_FRAME_HEADER_SIZE + 3, 6, t));
+}
+
+static void test_relay_round_trip_and_step() {
+  uint8_t inner[ESPNOW_FRAME_MAX];
+  size_t innerLen = encodeSensorFrame(inner, sizeof(inner), 11, sampleReport());
+  RelayHeader r = {{1, 2, 3, 4, 5, 6}, {0xA, 0xB, 0xC, 0xD, 0xE, 0xF}, 300, 4, 0};
+  uint8_t frame[ESPNOW_FRAME_MAX];
+  size_t len = encodeRelayFrame(frame, sizeof(frame), 12, r, inner, innerLen);
+  TEST_ASSERT_TRUE(len > 0);
+
+  relayFrameStep(frame);
+  RelayHeader out;
+  const uint8_t* payload;
+  uint8_t payloadLen;
+  TEST_ASSERT_TRUE(decodeRelayFrame(frame, header(frame, len), out, &payload, &payloadLen));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(r.origin, out.origin, 6);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(r.target, out.target, 6);
+  TEST_ASSERT_EQUAL_UINT16(300, out.seq);
+  TEST_ASSERT_EQUAL_UINT8(3, out.ttl);
+  TEST_ASSERT_EQUAL_UINT8(1, out.hops);
+  TEST_ASSERT_EQUAL_size_t(innerLen, payloadLen);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(inner, payload, innerLen);
+
+  // The largest payload fits exactly, one more byte doesn't
+  uint8_t big[RELAY_MAX_PAYLOAD + 1] = {};
+  TEST_ASSERT_EQUAL_size_t(ESPNOW_FRAME_MAX, encodeRelayFrame(frame, sizeof(frame), 13, r, big, RELAY_MAX_PAYLOAD));
+  TEST_ASSERT_EQUAL_size_t(0, encodeRelayFrame(frame, sizeof(frame), 13, r, big, RELAY_MAX_PAYLOAD + 1));
+}
+
+static void test_ota_frames_round_trip() {
+  uint8_t frame[ESPNOW_FRAME_MAX];
+
+  OtaOffer o = {}, oOut;
+  o.session = 0x1234;
+  o.imageSize = 1500000;
+  o.chunkSize = OTA_CHUNK_MAX;
+  o.windowChunks = 128;
+  o.slotUs = 5000;
+  for (int i = 0; i < 32; i++) o.sha256[i] = (uint8_t)(i * 7);
+  o.firmware[0] = 1;
+  o.firmware[1] = 2;
+  o.firmware[2] = 3;
+  size_t len = encodeOtaOfferFrame(frame, sizeof(frame), 1, o);
+  TEST_ASSERT_TRUE(decodeOtaOfferFrame(frame, header(frame, len), oOut));
+  TEST_ASSERT_EQUAL_UINT16(o.session, oOut.session);
+  TEST_ASSERT_EQUAL_UINT32(o.imageSize, oOut.imageSize);
+  TEST_ASSERT_EQUAL_UINT8(o.chunkSize, oOut.chunkSize);
+  TEST_ASSERT_EQUAL_UINT8(o.windowChunks, oOut.windowChunks);
+  TEST_ASSERT_EQUAL_UINT16(o.slotUs, oOut.slotUs);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(o.sha256, oOut.sha256, 32);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(o.firmware, oOut.firmware, 3);
+
+  uint8_t chunk[OTA_CHUNK_MAX];
+  for (int i = 0; i < OTA_CHUNK_MAX; i++) chunk[i] = (uint8_t)(255 - i);
+  len = encodeOtaDataFrame(frame, sizeof(frame), 2, 0x1234, 999, chunk, sizeof(chunk));
+  TEST_ASSERT_EQUAL_size_t(ESPNOW_FRAME_MAX, len);
+  uint16_t session, index;
+  const uint8_t* data;
+  uint8_t dataLen;
+  TEST_ASSERT_TRUE(decodeOtaDataFrame(frame, header(frame, len), session, index, &data, &dataLen));
+  TEST_ASSERT_EQUAL_UINT16(0x1234, session);
+  TEST_ASSERT_EQUAL_UINT16(999, index);
+  TEST_ASSERT_EQUAL_UINT8(OTA_CHUNK_MAX, dataLen);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(chunk, data, OTA_CHUNK_MAX);
+  TEST_ASSERT_EQUAL_size_t(0, encodeOtaDataFrame(frame, sizeof(frame), 2, 1, 1, chunk, OTA_CHUNK_MAX + 1));
+
+  OtaPoll p = {0x1234, 77}, pOut;
+  len = encodeOtaPollFrame(frame, sizeof(frame), 3, p);
+  TEST_ASSERT_TRUE(decodeOtaPollFrame(frame, header(frame, len), pOut));
+  TEST_ASSERT_EQUAL_UINT16(0x1234, pOut.session);
+  TEST_ASSERT_EQUAL_UINT16(77, pOut.window);
+
+  OtaStatus s = {}, sOut;
+  s.session = 0x1234;
+  s.window = 5;
+  s.state = 2;
+  s.error = 9;
+  s.missing[0] = 0x81;
+  s.missing[OTA_STATUS_BITMAP_SIZE - 1] = 0x40;
+  len = encodeOtaStatusFrame(frame, sizeof(frame), 4, s);
+  TEST_ASSERT_TRUE(decodeOtaStatusFrame(frame, header(frame, len), sOut));
+  TEST_ASSERT_EQUAL_UINT16(5, sOut.window);
+  TEST_ASSERT_EQUAL_UINT8(2, sOut.state);
+  TEST_ASSERT_EQUAL_UINT8(9, sOut.error);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(s.missing, sOut.missing, OTA_STATUS_BITMAP_SIZE);
+}
+
+static void test_tlv_append_and_lookup() {
+  uint8_t frame[ESPNOW_FRAME_MAX];
+  size_t len = encodeSensorFrame(frame, sizeof(frame), 1, sampleReport());
+  const char name[] = "Trailer 7";
+  uint8_t versions[8] = {1, 0, 0, 0, 2, 0, 0, 0};
+  len = frameAppendTlv(frame, len, sizeof(frame), TLV_DEVICE_NAME, name, sizeof(name) - 1);
+  len = frameAppendTlv(frame, len, sizeof(frame), 0xEE, "?", 1);  // Unknown to everyone
+  len = frameAppendTlv(frame, len, sizeof(frame), TLV_COEFF_VERSIONS, versions, sizeof(versions));
+  TEST_ASSERT_EQUAL_size_t(ESPNOW_FRAME_HEADER_SIZE + SENSOR_FIXED_SIZE + 2 + 9 + 2 + 1 + 2 + 8, len);
+
+  FrameHeader h = header(frame, len);
+  TEST_ASSERT_EQUAL_UINT8(SENSOR_FIXED_SIZE, h.fixedLength);
+  const uint8_t* value;
+  uint8_t valueLen;
+  TEST_ASSERT_TRUE(findFrameTlv(frame, h, TLV_COEFF_VERSIONS, &value, &valueLen));  // Past the unknown one
+  TEST_ASSERT_EQUAL_UINT8(8, valueLen);
+  TEST_ASSERT_EQUAL_UINT32(2, frameGetU32(value + 4));
+  TEST_ASSERT_TRUE(findFrameTlv(frame, h, TLV_DEVICE_NAME, &value, &valueLen));
+  TEST_ASSERT_EQUAL_UINT8(9, valueLen);
+  TEST_ASSERT_EQUAL_MEMORY(name, value, 9);
+  TEST_ASSERT_FALSE(findFrameTlv(frame, h, TLV_SAMPLE_TIME, &value, &valueLen));
+
+  // A TLV that doesn't fit the cap (or the ESP-NOW limit) leaves the frame alone
+  uint8_t filler[ESPNOW_FRAME_MAX] = {};
+  TEST_ASSERT_EQUAL_size_t(0, frameAppendTlv(frame, len, len + 5, TLV_SAMPLE_TIME, filler, 8));
+  TEST_ASSERT_EQUAL_size_t(0, frameAppendTlv(frame, len, 1000, TLV_SAMPLE_TIME, filler,
+                                             (uint8_t)(ESPNOW_FRAME_MAX - len - 1)));
+  TEST_ASSERT_EQUAL_UINT8(len - ESPNOW_FRAME_HEADER_SIZE, frame[5]);
+  TEST_ASSERT_EQUAL_size_t(ESPNOW_FRAME_MAX, frameAppendTlv(frame, len, sizeof(frame), TLV_SAMPLE_TIME, filler,
+                                                            (uint8_t)(ESPNOW_FRAME_MAX - len - 2)));
+
+  // A TLV running past the frame is malformed: lookups stop there
+  len = encodeSensorFrame(frame, sizeof(frame), 1, sampleReport());
+  len = frameAppendTlv(frame, len, sizeof(frame), TLV_DEVICE_NAME, name, sizeof(name) - 1);
+  frame[ESPNOW_FRAME_HEADER_SIZE + SENSOR_FIXED_SIZE + 1] = 40;
+  TEST_ASSERT_FALSE(findFrameTlv(frame, header(frame, len), TLV_DEVICE_NAME, &value, &valueLen));
+}
+
+static void test_header_rejects_bad_frames() {
+  uint8_t frame[ESPNOW_FRAME_MAX];
+  size_t len = encodeSensorFrame(frame, sizeof(frame), 1, sampleReport());
+  FrameHeader h;
+
+  for (size_t n = 0; n < ESPNOW_FRAME_HEADER_SIZE; n++) TEST_ASSERT_FALSE(decodeFrameHeader(frame, n, h));
+  TEST_ASSERT_FALSE(decodeFrameHeader(frame, len - 1, h));  // Truncated body
+  TEST_ASSERT_TRUE(decodeFrameHeader(frame, len + 5, h));   // Trailing bytes past 'length' are ignored
+
+  frame[6] = (uint8_t)(frame[5] + 1);  // Fixed fields longer than the frame
+  TEST_ASSERT_FALSE(decodeFrameHeader(frame, len, h));
+  frame[6] = SENSOR_FIXED_SIZE;
+
+  frame[5] = 0xFF;  // Claims more than ESP-NOW ever carries
+  TEST_ASSERT_FALSE(decodeFrameHeader(frame, ESPNOW_FRAME_MAX, h));
+  frame[5] = SENSOR_FIXED_SIZE;
+
+  frame[1] = 0;
+  TEST_ASSERT_FALSE(decodeFrameHeader(frame, len, h));
+  frame[1] = ESPNOW_FRAME_VERSION;
+  frame[0] = ESPNOW_FRAME_MAGIC ^ 1;
+  TEST_ASSERT_FALSE(decodeFrameHeader(frame, len, h));
+}
+
+// Compatibility rules: an older sender's missing fields read as zero, a newer
+// sender's extra fields and unknown TLVs are skipped
+static void test_older_and_newer_senders() {
+  uint8_t frame[ESPNOW_FRAME_MAX];
+  size_t len = encodeSensorFrame(frame, sizeof(frame), 1, sampleReport());
+
+  uint8_t older[ESPNOW_FRAME_MAX];
+  memcpy(older, frame, ESPNOW_FRAME_HEADER_SIZE + 18);  // Up to the std devs
+  older[5] = older[6] = 18;
+  SensorReport r;
+  TEST_ASSERT_TRUE(decodeSensorFrame(older, header(older, ESPNOW_FRAME_HEADER_SIZE + 18), r));
+  TEST_ASSERT_FLOAT_WITHIN(0.05f, 17123.4f, r.ch1Weight);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, r.ch1WeightStdDev);
+  TEST_ASSERT_EQUAL_UINT32(0, r.timestamp);
+  TEST_ASSERT_FALSE(r.isCharging);
+
+  uint8_t newer[ESPNOW_FRAME_MAX];
+  memcpy(newer, frame, len);
+  memset(newer + len, 0x5A, 6);  // Six bytes of fields we don't know yet
+  newer[1] = ESPNOW_FRAME_VERSION + 1;
+  newer[5] = newer[6] = SENSOR_FIXED_SIZE + 6;
+  size_t newerLen = frameAppendTlv(newer, len + 6, sizeof(newer), TLV_SAMPLE_TIME, "12345678", 8);
+  FrameHeader h;
+  TEST_ASSERT_TRUE(decodeFrameHeader(newer, newerLen, h));
+  TEST_ASSERT_TRUE(decodeSensorFrame(newer, h, r));
+  TEST_ASSERT_EQUAL_UINT32(0xDEADBEEF, r.timestamp);
+  const uint8_t* value;
+  uint8_t valueLen;
+  TEST_ASSERT_TRUE(findFrameTlv(newer, h, TLV_SAMPLE_TIME, &value, &valueLen));
+  TEST_ASSERT_EQUAL_MEMORY("12345678", value, 8);
+}
+
+// ESPNowData (main.cpp) starts with the sender's MAC as text, "AA:BB:...": its first
+// byte is an ASCII hex digit (or NUL), never the magic, so receivers can tell the two
+// formats apart on the first byte alone
+static void test_legacy_struct_never_starts_with_magic() {
+  char mac[18];
+  for (int b = 0; b < 256; b++) {
+    snprintf(mac, sizeof(mac), "%02X:00:00:00:00:00", b);
+    TEST_ASSERT_NOT_EQUAL(ESPNOW_FRAME_MAGIC, (uint8_t)mac[0]);
+    snprintf(mac, sizeof(mac), "%02x:00:00:00:00:00", b);
+    TEST_ASSERT_NOT_EQUAL(ESPNOW_FRAME_MAGIC, (uint8_t)mac[0]);
+  }
+  TEST_ASSERT_TRUE(ESPNOW_FRAME_MAGIC > 0x7F);  // Outside ASCII altogether
+  uint8_t legacy[92] = {'2', '4', ':'};
+  TEST_ASSERT_FALSE(isCompactFrame(legacy, sizeof(legacy)));
+}
+
+// Not a pass/fail on speed, beyond a generous ceiling: reports what a sensor frame
+// with its usual TLVs costs to build and to parse
+static void test_encode_decode_timing() {
+  const int rounds = 200000;
+  uint8_t frame[ESPNOW_FRAME_MAX];
+  SensorReport in = sampleReport();
+  uint8_t versions[8] = {1, 0, 0, 0, 2, 0, 0, 0};
+  uint8_t sampleTime[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+  volatile size_t sink = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  size_t len = 0;
+  for (int i = 0; i < rounds; i++) {
+    in.timestamp = (uint32_t)i;
+    len = encodeSensorFrame(frame, sizeof(frame), (uint16_t)i, in);
+    len = frameAppendTlv(frame, len, sizeof(frame), TLV_COEFF_VERSIONS, versions, 8);
+    len = frameAppendTlv(frame, len, sizeof(frame), TLV_SAMPLE_TIME, sampleTime, 8);
+    sink += len;
+  }
+  auto mid = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; i++) {
+    FrameHeader h;
+    SensorReport out;
+    const uint8_t* value;
+    uint8_t valueLen;
+    frame[3] = (uint8_t)i;
+    if (decodeFrameHeader(frame, len, h) && decodeSensorFrame(frame, h, out) &&
+        findFrameTlv(frame, h, TLV_SAMPLE_TIME, &value, &valueLen)) {
+      sink += out.timestamp + valueLen;
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  double encodeNs = std::chrono::duration<double, std::nano>(mid - start).count() / rounds;
+  double decodeNs = std::chrono::duration<double, std::nano>(end - mid).count() / rounds;
+  printf("  sensor frame + 2 TLVs (%u bytes): encode %.0f ns, decode %.0f ns\n", (unsigned)len, encodeNs, decodeNs);
+  TEST_ASSERT_TRUE(sink > 0);
+  TEST_ASSERT_TRUE(encodeNs < 5000.0);
+  TEST_ASSERT_TRUE(decodeNs < 5000.0);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_sensor_round_trip);
+  RUN_TEST(test_sensor_quantization_saturates);
+  RUN_TEST(test_coeffs_round_trip_and_crc);
+  RUN_TEST(test_small_frames_round_trip);
+  RUN_TEST(test_relay_round_trip_and_step);
+  RUN_TEST(test_ota_frames_round_trip);
+  RUN_TEST(test_tlv_append_and_lookup);
+  RUN_TEST(test_header_rejects_bad_frames);
+  RUN_TEST(test_older_and_newer_senders);
+  RUN_TEST(test_legacy_struct_never_starts_with_magic);
+  RUN_TEST(test_encode_decode_timing);
+  return UNITY_END();
+}
@@ -0,0 +1,112 @@
+// Per-sender link statistics (link_stats.h) and their fleet record fields
+// (ble_fleet_frame.h)
+
+#include <unity.h>
+#include "link_stats.h"
+#include "ble_fleet_frame.h"
+
+void setUp() {}
+void tearDown() {}
+
+static void test_rssi_ewma_skips_missing_readings() {
+  LinkStats s;
+  linkStatsReset(s);
+  linkStatsUpdate(s, LINK_RSSI_NONE, true, 1, 0, 1000);
+  TEST_ASSERT_EQUAL_FLOAT(LINK_RSSI_NONE, s.rssi);
+  linkStatsUpdate(s, -60, true, 2, 100, 101000);
+  TEST_ASSERT_EQUAL_FLOAT(-60.0f, s.rssi);  // First reading taken as is
+  linkStatsUpdate(s, -76, true, 3, 200, 201000);
+  TEST_ASSERT_EQUAL_FLOAT(-62.0f, s.rssi);  // 1/8 of the way
+  linkStatsUpdate(s, LINK_RSSI_NONE, true, 4, 300, 301000);
+  TEST_ASSERT_EQUAL_FLOAT(-62.0f, s.rssi);
+}
+
+static void test_loss_counts_gaps_and_decays() {
+  LinkStats s;
+  linkStatsReset(s);
+  linkStatsUpdate(s, -50, true, 10, 0, 1000);
+  linkStatsUpdate(s, -50, true, 14, 400, 401000);  // 3 missed
+  TEST_ASSERT_EQUAL_UINT32(3, s.lost);
+  TEST_ASSERT_EQUAL_UINT32(2, s.received);
+  float afterGap = s.loss;
+  TEST_ASSERT_TRUE(afterGap > 0.1f);
+  for (uint16_t seq = 15; seq < 115; seq++) linkStatsUpdate(s, -50, true, seq, seq * 100, seq * 100000LL);
+  TEST_ASSERT_TRUE(s.loss < afterGap / 100);
+}
+
+static void test_duplicates_and_reboots_are_not_loss() {
+  LinkStats s;
+  linkStatsReset(s);
+  linkStatsUpdate(s, -50, true, 500, 0, 1000);
+  linkStatsUpdate(s, -50, true, 500, 0, 2000);  // Relayed copy of the same frame
+  TEST_ASSERT_EQUAL_UINT32(1, s.received);
+  linkStatsUpdate(s, -50, true, 0xFFFF, 100, 101000);  // Wraps past 500 by far: restart
+  TEST_ASSERT_EQUAL_UINT32(0, s.lost);
+  linkStatsUpdate(s, -50, true, 0, 200, 201000);  // Sequence wraps to 0: no gap
+  TEST_ASSERT_EQUAL_UINT32(0, s.lost);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, s.loss);
+}
+
+static void test_jitter_follows_arrival_spread() {
+  LinkStats s;
+  linkStatsReset(s);
+  int64_t rx = 1000000;
+  for (uint16_t i = 0; i < 200; i++) {
+    linkStatsUpdate(s, -50, false, 0, i * 100u, rx);
+    rx += 100000;
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, s.jitterUs);  // Perfectly even
+
+  for (uint16_t i = 200; i < 600; i++) {
+    linkStatsUpdate(s, -50, false, 0, i * 100u, rx + (i & 1 ? 4000 : 0));  // +-4 ms alternate
+    rx += 100000;
+  }
+  TEST_ASSERT_UINT32_WITHIN(400, 4000, s.jitterUs);
+}
+
+// The sender's millisecond clock wrapping doesn't make a jitter spike
+static void test_jitter_survives_sender_clock_wrap() {
+  LinkStats s;
+  linkStatsReset(s);
+  uint32_t sender = 0xFFFFFF00u;
+  int64_t rx = 5000000;
+  for (int i = 0; i < 10; i++) {
+    linkStatsUpdate(s, -50, true, (uint16_t)i, sender, rx);
+    sender += 100;
+    rx += 100000;
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, s.jitterUs);
+}
+
+static void test_fleet_record_carries_link_fields() {
+  uint8_t frame[BLE_FLEET_MAX_FRAME];
+  size_t len = fleetFrameBegin(frame, 1, 0, 2, 0.0f);
+  FleetRecord r;
+  memset(&r, 0, sizeof(r));
+  r.linkLoss = 0.125f;
+  r.linkJitterMs = 300.0f;  // Capped at 254
+  len = fleetFrameAppend(frame, len, sizeof(frame), r);
+  r.linkLoss = -1.0f;  // The hub: unknown
+  r.linkJitterMs = -1.0f;
+  len = fleetFrameAppend(frame, len, sizeof(frame), r);
+  TEST_ASSERT_GREATER_THAN(0, len);
+
+  FleetRecord back;
+  TEST_ASSERT_TRUE(fleetFrameRecord(frame, len, 0, back));
+  TEST_ASSERT_FLOAT_WITHIN(0.005f, 0.125f, back.linkLoss);
+  TEST_ASSERT_EQUAL_FLOAT(254.0f, back.linkJitterMs);
+  TEST_ASSERT_TRUE(fleetFrameRecord(frame, len, 1, back));
+  TEST_ASSERT_TRUE(back.linkLoss < 0.0f);
+  TEST_ASSERT_TRUE(back.linkJitterMs < 0.0f);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_rssi_ewma_skips_missing_readings);
+  RUN_TEST(test_loss_counts_gaps_and_decays);
+  RUN_TEST(test_duplicates_and_reboots_are_not_loss);
+  RUN_TEST(test_jitter_follows_arrival_spread);
+  RUN_TEST(test_jitter_survives_sender_clock_wrap);
+  RUN_TEST(test_fleet_record_carries_link_fields);
+  return UNITY_END();
+}
@@ -0,0 +1,156 @@
+// MacIndex and the MAC key helpers (mac_index.h), checked against a plain map
+// through random churn, and timed at the registry sizes
+
+#include <unity.h>
+#include <stdio.h>
+#include <chrono>
+#include <map>
+#include <random>
+#include "mac_index.h"
+
+void setUp() {}
+void tearDown() {}
+
+static void test_key_round_trips() {
+  const uint8_t mac[6] = {0xAA, 0xBB, 0xCC, 0x01, 0x02, 0x03};
+  MacKey key = macKeyFromBytes(mac);
+  TEST_ASSERT_EQUAL_UINT64(0xAABBCC010203ull, key);
+  uint8_t back[6];
+  macKeyToBytes(key, back);
+  TEST_ASSERT_EQUAL_MEMORY(mac, back, 6);
+  TEST_ASSERT_EQUAL_UINT64(key, macKeyFromString("AA:BB:CC:01:02:03"));
+  TEST_ASSERT_EQUAL_UINT64(key, macKeyFromString("aa:bb:cc:01:02:03"));
+}
+
+static void test_malformed_strings_give_zero() {
+  TEST_ASSERT_EQUAL_UINT64(0, macKeyFromString(nullptr));
+  TEST_ASSERT_EQUAL_UINT64(0, macKeyFromString(""));
+  TEST_ASSERT_EQUAL_UINT64(0, macKeyFromString("AA:BB:CC:01:02"));
+  TEST_ASSERT_EQUAL_UINT64(0, macKeyFromString("AA-BB-CC-01-02-03"));
+  TEST_ASSERT_EQUAL_UINT64(0, macKeyFromString("AA:BB:CC:01:02:0G"));
+}
+
+static void test_insert_find_replace_erase() {
+  MacIndex<8> index;
+  TEST_ASSERT_EQUAL_INT(-1, index.find(0x112233445566ull));
+  TEST_ASSERT_TRUE(index.insert(0x112233445566ull, 3));
+  TEST_ASSERT_EQUAL_INT(3, index.find(0x112233445566ull));
+  TEST_ASSERT_TRUE(index.insert(0x112233445566ull, 5));  // Replaces
+  TEST_ASSERT_EQUAL_INT(5, index.find(0x112233445566ull));
+  TEST_ASSERT_EQUAL_UINT16(1, index.size());
+  TEST_ASSERT_TRUE(index.erase(0x112233445566ull));
+  TEST_ASSERT_FALSE(index.erase(0x112233445566ull));
+  TEST_ASSERT_EQUAL_INT(-1, index.find(0x112233445566ull));
+  TEST_ASSERT_EQUAL_UINT16(0, index.size());
+}
+
+static void test_full_index_refuses_new_keys_only() {
+  MacIndex<4> index;
+  for (uint16_t i = 0; i < 4; i++) TEST_ASSERT_TRUE(index.insert(0x100 + i, i));
+  TEST_ASSERT_FALSE(index.insert(0x200, 9));
+  TEST_ASSERT_TRUE(index.insert(0x101, 7));  // An existing key still moves
+  TEST_ASSERT_EQUAL_INT(7, index.find(0x101));
+}
+
+// Backward-shift deletion keeps every probe run intact, however the keys collide
+static void test_random_churn_matches_a_map() {
+  const uint16_t SLOTS = 64;
+  MacIndex<SLOTS> index;
+  std::map<MacKey, uint16_t> expected;
+  std::mt19937 rng(1234);
+  // A small key space (OUI fixed, few device bytes), so keys come back often
+  std::uniform_int_distribution<int> pick(0, 199);
+  for (int step = 0; step < 50000; step++) {
+    MacKey key = 0x24D7EB000000ull | (MacKey)pick(rng) * 0x10101ull;
+    if (expected.count(key) || (rng() & 1) == 0) {
+      TEST_ASSERT_EQUAL(expected.erase(key) > 0, index.erase(key));
+    } else if (expected.size() < SLOTS) {
+      uint16_t slot = (uint16_t)(rng() % SLOTS);
+      TEST_ASSERT_TRUE(index.insert(key, slot));
+      expected[key] = slot;
+    }
+    if (step % 97 == 0) {
+      for (int k = 0; k < 200; k++) {
+        MacKey probe = 0x24D7EB000000ull | (MacKey)k * 0x10101ull;
+        std::map<MacKey, uint16_t>::const_iterator it = expected.find(probe);
+        TEST_ASSERT_EQUAL_INT(it == expected.end() ? -1 : it->second, index.find(probe));
+      }
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT16(expected.size(), index.size());
+  TEST_ASSERT_TRUE(index.meanProbes() < 4.0f);  // At most half full
+}
+
+// Full index of random MACs: hits, misses, and an erase + insert pair (a device
+// leaving and another taking its slot), against the linear scan over the slots
+// the index stands in for
+template <uint16_t SLOTS>
+static void benchmarkIndex() {
+  const int rounds = 200000;
+  static MacIndex<SLOTS> index;
+  index.clear();
+  MacKey keys[SLOTS];
+  MacKey spare[SLOTS];
+  std::mt19937_64 rng(SLOTS);
+  for (uint16_t i = 0; i < SLOTS; i++) {
+    keys[i] = rng() & 0xFFFFFFFFFFFFull;
+    spare[i] = rng() & 0xFFFFFFFFFFFFull;
+    TEST_ASSERT_TRUE(index.insert(keys[i], i));
+  }
+  volatile int sink = 0;
+
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++) sink += index.find(keys[(r * 7) % SLOTS]);
+  std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+  float hitProbes = index.meanProbes();
+  for (int r = 0; r < rounds; r++) sink += index.find(spare[(r * 7) % SLOTS]);
+  std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++) {
+    uint16_t slot = (uint16_t)((r * 7) % SLOTS);
+    index.erase(keys[slot]);
+    index.insert(spare[slot], slot);
+    MacKey swap = keys[slot];
+    keys[slot] = spare[slot];
+    spare[slot] = swap;
+  }
+  std::chrono::steady_clock::time_point t3 = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++) {
+    MacKey key = keys[(r * 7) % SLOTS];
+    int found = -1;
+    for (uint16_t i = 0; i < SLOTS; i++) {
+      if (keys[i] == key) { found = i; break; }
+    }
+    sink += found;
+  }
+  std::chrono::steady_clock::time_point t4 = std::chrono::steady_clock::now();
+
+  double hitNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / rounds;
+  double missNs = std::chrono::duration<double, std::nano>(t2 - t1).count() / rounds;
+  double churnNs = std::chrono::duration<double, std::nano>(t3 - t2).count() / rounds;
+  double scanNs = std::chrono::duration<double, std::nano>(t4 - t3).count() / rounds;
+  printf("  %3u entries: find hit %5.1f ns (%.2f probes), miss %5.1f ns, erase+insert %5.1f ns, linear scan %6.1f ns\n",
+         SLOTS, hitNs, hitProbes, missNs, churnNs, scanNs);
+
+  TEST_ASSERT_EQUAL_UINT16(SLOTS, index.size());
+  for (uint16_t i = 0; i < SLOTS; i++) TEST_ASSERT_EQUAL_INT(i, index.find(keys[i]));
+  TEST_ASSERT_TRUE(hitProbes < 2.5f);  // Half full at most
+  TEST_ASSERT_TRUE(hitNs < 1000.0 && missNs < 1000.0 && churnNs < 2000.0);  // Ceiling only, not a target
+}
+
+// Registry sizes main.cpp allows (MAX_DEVICES 64..128)
+static void test_timing_at_registry_sizes() {
+  benchmarkIndex<64>();
+  benchmarkIndex<96>();
+  benchmarkIndex<128>();
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_key_round_trips);
+  RUN_TEST(test_malformed_strings_give_zero);
+  RUN_TEST(test_insert_find_replace_erase);
+  RUN_TEST(test_full_index_refuses_new_keys_only);
+  RUN_TEST(test_random_churn_matches_a_map);
+  RUN_TEST(test_timing_at_registry_sizes);
+  return UNITY_END();
+}
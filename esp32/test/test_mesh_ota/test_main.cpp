@@ -0,0 +1,276 @@
+// Mesh firmware update (mesh_ota.h) and its frames (espnow_frame.h): the layout,
+// one slave's window bookkeeping, and whole pushes over a lossy simulated link
+
+#include <unity.h>
+#include <vector>
+#include "espnow_frame.h"
+#include "mesh_ota.h"
+
+void setUp() {}
+void tearDown() {}
+
+static const MacKey HUB = 0x0A00000000FFull;
+static const MeshOtaConfig CONFIG = {500000, 20000000, 2600, 3000, 20000, 16, 15000000};
+
+static void test_frames_round_trip() {
+  OtaOffer o = {7, 1200000, 232, 128, 3000, {0}, {1, 4, 2}};
+  for (int i = 0; i < 32; i++) o.sha256[i] = (uint8_t)(i * 7);
+  uint8_t frame[ESPNOW_FRAME_MAX];
+  size_t len = encodeOtaOfferFrame(frame, sizeof(frame), 1, o);
+  FrameHeader h;
+  OtaOffer back;
+  TEST_ASSERT_TRUE(decodeFrameHeader(frame, len, h));
+  TEST_ASSERT_TRUE(decodeOtaOfferFrame(frame, h, back));
+  TEST_ASSERT_EQUAL_UINT16(7, back.session);
+  TEST_ASSERT_EQUAL_UINT32(1200000, back.imageSize);
+  TEST_ASSERT_EQUAL_UINT8(232, back.chunkSize);
+  TEST_ASSERT_EQUAL_UINT8(128, back.windowChunks);
+  TEST_ASSERT_EQUAL_UINT16(3000, back.slotUs);
+  TEST_ASSERT_EQUAL_MEMORY(o.sha256, back.sha256, 32);
+  TEST_ASSERT_EQUAL_MEMORY(o.firmware, back.firmware, 3);
+
+  uint8_t chunk[OTA_CHUNK_MAX];
+  for (size_t i = 0; i < sizeof(chunk); i++) chunk[i] = (uint8_t)i;
+  len = encodeOtaDataFrame(frame, sizeof(frame), 2, 7, 513, chunk, sizeof(chunk));
+  TEST_ASSERT_TRUE(len > 0);
+  TEST_ASSERT_EQUAL(0, encodeOtaDataFrame(frame, sizeof(frame), 2, 7, 513, chunk, OTA_CHUNK_MAX + 1));
+  uint16_t session, n;
+  const uint8_t* data;
+  uint8_t dataLen;
+  TEST_ASSERT_TRUE(decodeFrameHeader(frame, len, h));
+  TEST_ASSERT_TRUE(decodeOtaDataFrame(frame, h, session, n, &data, &dataLen));
+  TEST_ASSERT_EQUAL_UINT16(513, n);
+  TEST_ASSERT_EQUAL(OTA_CHUNK_MAX, dataLen);
+  TEST_ASSERT_EQUAL_MEMORY(chunk, data, dataLen);
+
+  OtaStatus s = {7, 3, MESH_OTA_RECEIVING, OTA_OK, {0}};
+  s.missing[0] = 0x81;
+  s.missing[15] = 0x40;
+  len = encodeOtaStatusFrame(frame, sizeof(frame), 3, s);
+  OtaStatus sBack;
+  TEST_ASSERT_TRUE(decodeFrameHeader(frame, len, h));
+  TEST_ASSERT_FALSE(decodeOtaOfferFrame(frame, h, back));  // Wrong type
+  TEST_ASSERT_TRUE(decodeOtaStatusFrame(frame, h, sBack));
+  TEST_ASSERT_EQUAL_UINT16(3, sBack.window);
+  TEST_ASSERT_EQUAL_MEMORY(s.missing, sBack.missing, OTA_STATUS_BITMAP_SIZE);
+}
+
+static void test_compare_version() {
+  const uint8_t a[3] = {1, 4, 2}, b[3] = {1, 4, 10}, c[3] = {2, 0, 0};
+  TEST_ASSERT_TRUE(meshOtaCompareVersion(a, b) < 0);
+  TEST_ASSERT_TRUE(meshOtaCompareVersion(c, b) > 0);
+  TEST_ASSERT_EQUAL(0, meshOtaCompareVersion(a, a));
+}
+
+static void test_layout_last_chunk_and_window() {
+  MeshOtaLayout l = {1000, 100, 4};
+  TEST_ASSERT_TRUE(l.valid());
+  TEST_ASSERT_EQUAL_UINT16(10, l.chunks());
+  TEST_ASSERT_EQUAL_UINT16(3, l.windows());
+  TEST_ASSERT_EQUAL_UINT16(2, l.chunksIn(2));
+  TEST_ASSERT_EQUAL_UINT16(0, l.chunksIn(3));
+  l.imageSize = 950;
+  TEST_ASSERT_EQUAL_UINT8(50, l.length(9));
+  uint8_t missing[OTA_STATUS_BITMAP_SIZE] = {0x02};  // Chunk 5 still to come
+  TEST_ASSERT_EQUAL_UINT32(700, l.received(1, missing));
+  TEST_ASSERT_EQUAL_UINT32(950, l.received(3, missing));
+  l.windowChunks = MESH_OTA_WINDOW_MAX + 1;
+  TEST_ASSERT_FALSE(l.valid());
+}
+
+// Chunks of the next window only count once the current one is complete; a
+// poll for the window after the last finishes the image
+static void test_receiver_moves_window_by_window() {
+  OtaOffer o = {9, 950, 100, 4, 3000, {0}, {1, 0, 0}};
+  MeshOtaReceiver r;
+  TEST_ASSERT_TRUE(r.begin(HUB, o, 2));
+  TEST_ASSERT_TRUE(r.is(HUB, 9));
+  TEST_ASSERT_FALSE(r.take(0, 100));  // Still PREPARING
+  r.setState(MESH_OTA_RECEIVING);
+
+  TEST_ASSERT_TRUE(r.take(0, 100));
+  TEST_ASSERT_FALSE(r.take(0, 100));  // Duplicate
+  TEST_ASSERT_FALSE(r.take(1, 99));   // Wrong length
+  TEST_ASSERT_TRUE(r.take(2, 100));
+  TEST_ASSERT_FALSE(r.take(4, 100));  // Window 0 has a hole
+  OtaStatus s;
+  r.status(s);
+  TEST_ASSERT_EQUAL_UINT16(0, s.window);
+  TEST_ASSERT_EQUAL_HEX8(0x0A, s.missing[0]);
+  TEST_ASSERT_EQUAL_UINT32(200, r.received());
+
+  TEST_ASSERT_TRUE(r.take(1, 100));
+  TEST_ASSERT_TRUE(r.take(3, 100));
+  TEST_ASSERT_TRUE(r.take(4, 100));   // Moves to window 1
+  TEST_ASSERT_EQUAL_UINT16(1, r.window());
+  for (uint16_t c = 5; c < 8; c++) TEST_ASSERT_TRUE(r.take(c, 100));
+  TEST_ASSERT_FALSE(r.poll(1));
+  TEST_ASSERT_FALSE(r.poll(2));       // Window 2 started, empty
+  TEST_ASSERT_TRUE(r.take(8, 100));
+  TEST_ASSERT_TRUE(r.take(9, 50));
+  TEST_ASSERT_TRUE(r.poll(3));
+  TEST_ASSERT_TRUE(r.complete());
+  TEST_ASSERT_EQUAL_UINT32(950, r.received());
+
+  o.chunkSize = 0;
+  TEST_ASSERT_FALSE(r.begin(HUB, o, 0));
+  TEST_ASSERT_EQUAL_UINT8(MESH_OTA_FAILED, r.state());
+}
+
+struct Slave {
+  MacKey mac;
+  MeshOtaReceiver rx;
+  std::vector<uint8_t> image;
+  int64_t readyAt;
+  int64_t doneAt;
+  bool dead;
+};
+
+static uint32_t g_rand;
+static bool lost(uint32_t percent) {
+  g_rand = g_rand * 1103515245u + 12345u;
+  return (g_rand >> 16) % 100 < percent;
+}
+
+// A push over a link losing 'loss' percent of frames each way, as the radio
+// task drives it: send what next() asks for, deliver statuses in their slots
+static void push(std::vector<Slave>& slaves, const std::vector<uint8_t>& image, uint32_t loss,
+                 MeshOtaSender<8>& tx, int64_t& now) {
+  g_rand = 42;
+  tx.begin(7, (uint32_t)image.size(), 232, 128, now);
+  OtaOffer offer = {7, (uint32_t)image.size(), 232, 128, (uint16_t)CONFIG.slotUs, {0}, {1, 0, 0}};
+  for (size_t i = 0; i < slaves.size(); i++) {
+    slaves[i].image.assign(image.size(), 0);
+    tx.add(slaves[i].mac);
+  }
+  struct Pending { int64_t at; size_t i; };
+  std::vector<Pending> pending;
+  while (tx.running() && now < 600000000) {
+    for (size_t k = 0; k < pending.size();) {
+      if (pending[k].at > now) {
+        k++;
+        continue;
+      }
+      Slave& s = slaves[pending[k].i];
+      if (!lost(loss)) {
+        OtaStatus st;
+        s.rx.status(st);
+        tx.status(s.mac, st);
+      }
+      pending.erase(pending.begin() + k);
+    }
+    for (size_t i = 0; i < slaves.size(); i++) {  // Erase, then verify, take time
+      MeshOtaReceiver& r = slaves[i].rx;
+      if (r.state() == MESH_OTA_PREPARING && now >= slaves[i].readyAt) r.setState(MESH_OTA_RECEIVING);
+      if (r.state() == MESH_OTA_VERIFYING && now >= slaves[i].doneAt) {
+        bool ok = slaves[i].image == image;
+        r.setState(ok ? MESH_OTA_DONE : MESH_OTA_FAILED, ok ? OTA_OK : OTA_ERR_DIGEST);
+      }
+    }
+    uint16_t arg = 0;
+    MeshOtaSend what = tx.next(now, arg);
+    if (what == MESH_OTA_SEND_NONE) {
+      int64_t wake = now + 1000;
+      if (tx.dueUs() > now && tx.dueUs() < wake) wake = tx.dueUs();
+      for (size_t k = 0; k < pending.size(); k++) {
+        if (pending[k].at > now && pending[k].at < wake) wake = pending[k].at;
+      }
+      now = wake;
+      continue;
+    }
+    for (size_t i = 0; i < slaves.size(); i++) {
+      Slave& s = slaves[i];
+      if (s.dead || lost(loss)) continue;
+      int64_t slot = now + (int64_t)(i + 1) * CONFIG.slotUs;
+      if (what == MESH_OTA_SEND_OFFER) {
+        if (!s.rx.is(HUB, 7)) {
+          s.rx.begin(HUB, offer, (uint8_t)i);
+          s.readyAt = now + 3000000;
+        }
+        pending.push_back({slot, i});
+      } else if (what == MESH_OTA_SEND_DATA) {
+        uint32_t offset = tx.layout().offset(arg);
+        uint8_t len = tx.layout().length(arg);
+        if (s.rx.take(arg, len)) memcpy(&s.image[offset], &image[offset], len);
+      } else {
+        if (s.rx.poll(arg) && s.rx.state() == MESH_OTA_RECEIVING) {
+          s.rx.setState(MESH_OTA_VERIFYING);
+          s.doneAt = now + 1500000;
+        }
+        if (s.rx.active()) pending.push_back({slot, i});
+      }
+    }
+    now += what == MESH_OTA_SEND_DATA ? CONFIG.chunkGapUs : 800;
+  }
+}
+
+static std::vector<Slave> makeSlaves(size_t n) {
+  std::vector<Slave> slaves(n);
+  for (size_t i = 0; i < n; i++) {
+    slaves[i].mac = 0x0A0000000100ull + i;
+    slaves[i].dead = false;
+  }
+  return slaves;
+}
+
+static std::vector<uint8_t> makeImage(size_t n) {
+  std::vector<uint8_t> image(n);
+  for (size_t i = 0; i < n; i++) image[i] = (uint8_t)(i * 2654435761u >> 24);
+  return image;
+}
+
+// Every slave ends up with the image despite 10% loss, and repairs stay a
+// fraction of the image
+static void test_push_survives_loss() {
+  static MeshOtaSender<8> tx(CONFIG);
+  std::vector<Slave> slaves = makeSlaves(4);
+  std::vector<uint8_t> image = makeImage(200000);
+  int64_t now = 0;
+  push(slaves, image, 10, tx, now);
+  TEST_ASSERT_FALSE(tx.running());
+  for (uint8_t i = 0; i < tx.count(); i++) {
+    TEST_ASSERT_EQUAL_UINT8(MESH_OTA_DONE, tx.target(i).state);
+    TEST_ASSERT_TRUE(slaves[i].image == image);
+  }
+  uint16_t chunks = tx.layout().chunks();
+  TEST_ASSERT_TRUE(tx.chunksSent() < chunks * 3u / 2u);
+}
+
+// A slave that never answers is given up on; the others finish
+static void test_silent_slave_is_given_up() {
+  static MeshOtaSender<8> tx(CONFIG);
+  std::vector<Slave> slaves = makeSlaves(3);
+  slaves[1].dead = true;
+  std::vector<uint8_t> image = makeImage(50000);
+  int64_t now = 0;
+  push(slaves, image, 5, tx, now);
+  TEST_ASSERT_FALSE(tx.running());
+  TEST_ASSERT_EQUAL_UINT8(MESH_OTA_DONE, tx.target(0).state);
+  TEST_ASSERT_EQUAL_UINT8(MESH_OTA_FAILED, tx.target(1).state);
+  TEST_ASSERT_EQUAL_UINT8(OTA_ERR_NO_ANSWER, tx.target(1).error);
+  TEST_ASSERT_EQUAL_UINT8(MESH_OTA_DONE, tx.target(2).state);
+}
+
+// A status for another session, or from a slave not in the push, is ignored
+static void test_sender_ignores_strangers() {
+  static MeshOtaSender<8> tx(CONFIG);
+  tx.begin(5, 10000, 200, 16, 0);
+  tx.add(0x0A0000000100ull);
+  OtaStatus s = {6, 0, MESH_OTA_RECEIVING, OTA_OK, {0}};
+  TEST_ASSERT_FALSE(tx.status(0x0A0000000100ull, s));
+  s.session = 5;
+  TEST_ASSERT_FALSE(tx.status(0x0A0000000200ull, s));
+  TEST_ASSERT_TRUE(tx.status(0x0A0000000100ull, s));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_frames_round_trip);
+  RUN_TEST(test_compare_version);
+  RUN_TEST(test_layout_last_chunk_and_window);
+  RUN_TEST(test_receiver_moves_window_by_window);
+  RUN_TEST(test_push_survives_loss);
+  RUN_TEST(test_silent_slave_is_given_up);
+  RUN_TEST(test_sender_ignores_strangers);
+  return UNITY_END();
+}
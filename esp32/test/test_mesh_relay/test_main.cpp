@@ -0,0 +1,361 @@
+// Multi-hop relay (mesh_relay.h) and its frame (espnow_frame.h)
+
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include "espnow_frame.h"
+#include "mesh_relay.h"
+
+void setUp() {}
+void tearDown() {}
+
+static const MacKey SELF = 0x0A0000000001ull;
+static const MacKey HUB = 0x0A00000000FFull;
+static const MacKey A = 0x0A0000000002ull;
+static const MacKey B = 0x0A0000000003ull;
+
+// Neighbor heard every 'period' ms for 'count' frames, from sequence 'seq' on
+static void hear(NeighborTable<8>& t, MacKey mac, uint16_t seq, int count, uint32_t& now, uint16_t step = 1) {
+  for (int i = 0; i < count; i++) {
+    t.heard(mac, (uint16_t)(seq + i * step), now);
+    now += 100;
+  }
+}
+
+static void test_quality_follows_delivery_ratio() {
+  NeighborTable<8> t(5000, 4);
+  uint32_t now = 1000;
+  hear(t, A, 0, 40, now);
+  hear(t, B, 0, 40, now, 2);  // Every other frame lost
+  Neighbor a, b;
+  TEST_ASSERT_TRUE(t.entry(0, a));
+  TEST_ASSERT_TRUE(t.entry(1, b));
+  TEST_ASSERT_FLOAT_WITHIN(0.02f, 1.0f, a.quality);
+  TEST_ASSERT_TRUE(b.quality < 0.7f);
+  TEST_ASSERT_TRUE(b.quality > 0.3f);
+}
+
+static void test_route_prefers_lowest_path_cost() {
+  NeighborTable<8> t(5000, 4);
+  uint32_t now = 1000;
+  hear(t, A, 0, 30, now);
+  hear(t, HUB, 0, 30, now);
+  t.advertised(A, HUB, 2, 3.0f);
+  t.advertised(HUB, HUB, 0, 0.0f);  // The hub in range
+  MeshRoute r = t.route(SELF, now);
+  TEST_ASSERT_EQUAL_UINT64(HUB, r.hub);
+  TEST_ASSERT_EQUAL_UINT64(HUB, r.parent);
+  TEST_ASSERT_EQUAL_UINT8(1, r.hops);
+  TEST_ASSERT_FLOAT_WITHIN(0.05f, 1.0f, r.cost);
+}
+
+// A slightly cheaper neighbor doesn't take over from a live parent
+static void test_parent_switch_needs_margin() {
+  NeighborTable<8> t(5000, 4);
+  uint32_t now = 1000;
+  hear(t, A, 0, 30, now);
+  hear(t, B, 0, 30, now);
+  t.advertised(A, HUB, 1, 1.0f);
+  t.advertised(B, HUB, 1, 2.0f);
+  TEST_ASSERT_EQUAL_UINT64(A, t.route(SELF, now).parent);
+  t.advertised(B, HUB, 1, 0.8f);  // Cheaper, but within RELAY_SWITCH_MARGIN
+  TEST_ASSERT_EQUAL_UINT64(A, t.route(SELF, now).parent);
+  t.advertised(B, HUB, 1, 0.2f);  // Clearly cheaper
+  TEST_ASSERT_EQUAL_UINT64(B, t.route(SELF, now).parent);
+}
+
+static void test_no_route_past_hop_limit_cost_cap_or_silence() {
+  NeighborTable<8> t(5000, 3);
+  uint32_t now = 1000;
+  hear(t, A, 0, 10, now);
+  t.advertised(A, HUB, 3, 1.0f);  // 4 hops from here
+  TEST_ASSERT_EQUAL_UINT64(0, t.route(SELF, now).hub);
+  t.advertised(A, HUB, 1, RELAY_MAX_COST);
+  TEST_ASSERT_EQUAL_UINT64(0, t.route(SELF, now).hub);
+  t.advertised(A, SELF, 1, 1.0f);  // A route through ourselves
+  TEST_ASSERT_EQUAL_UINT64(0, t.route(SELF, now).hub);
+  t.advertised(A, HUB, 1, 1.0f);
+  TEST_ASSERT_EQUAL_UINT64(HUB, t.route(SELF, now).hub);
+  TEST_ASSERT_EQUAL_UINT64(0, t.route(SELF, now + 6000).hub);
+  TEST_ASSERT_EQUAL_UINT8(0, t.live(now + 6000));
+}
+
+static void test_full_table_evicts_longest_silent() {
+  NeighborTable<2> t(5000, 4);
+  t.heard(A, 0, 1000);
+  t.heard(B, 0, 2000);
+  t.heard(HUB, 0, 3000);  // Replaces A
+  Neighbor n;
+  TEST_ASSERT_TRUE(t.entry(0, n));
+  TEST_ASSERT_EQUAL_UINT64(HUB, n.mac);
+  TEST_ASSERT_TRUE(t.entry(1, n));
+  TEST_ASSERT_EQUAL_UINT64(B, n.mac);
+}
+
+static void test_route_table_learns_and_expires() {
+  RouteTable<2> routes(10000);
+  routes.learn(A, B, 2, 1000);
+  TEST_ASSERT_EQUAL_UINT64(B, routes.nextHop(A, 5000));
+  TEST_ASSERT_EQUAL_UINT64(0, routes.nextHop(A, 12000));
+  routes.learn(A, HUB, 1, 12000);  // Same origin: updated in place
+  TEST_ASSERT_EQUAL_UINT64(HUB, routes.nextHop(A, 12000));
+  routes.learn(B, A, 1, 13000);
+  routes.learn(HUB, A, 1, 14000);  // Full: the oldest (A) goes
+  TEST_ASSERT_EQUAL_UINT64(0, routes.nextHop(A, 14000));
+  TEST_ASSERT_EQUAL_UINT8(2, routes.live(14000));
+}
+
+static void test_dedup_remembers_the_last_n() {
+  RelayDedup<4> dedup;
+  TEST_ASSERT_FALSE(dedup.seen(A, 1));
+  TEST_ASSERT_TRUE(dedup.seen(A, 1));
+  TEST_ASSERT_FALSE(dedup.seen(B, 1));  // Another origin
+  for (uint16_t s = 2; s < 6; s++) dedup.seen(A, s);
+  TEST_ASSERT_FALSE(dedup.seen(A, 1));  // Pushed out
+}
+
+static void test_budget_bursts_then_refills_at_rate() {
+  RelayBudget budget(100, 250);  // 100 B/s, 250 B burst
+  TEST_ASSERT_TRUE(budget.take(250, 0));
+  TEST_ASSERT_FALSE(budget.take(1, 0));
+  TEST_ASSERT_FALSE(budget.take(50, 400));  // 40 B back
+  TEST_ASSERT_TRUE(budget.take(50, 500));
+  TEST_ASSERT_TRUE(budget.take(250, 60000));  // Capped at the burst
+  TEST_ASSERT_FALSE(budget.take(1, 60000));
+}
+
+static void test_relay_frame_round_trip_and_step() {
+  RelayHeader r;
+  macKeyToBytes(A, r.origin);
+  macKeyToBytes(HUB, r.target);
+  r.seq = 0xBEEF;
+  r.ttl = 3;
+  r.hops = 0;
+  const uint8_t payload[5] = {1, 2, 3, 4, 5};
+  uint8_t frame[ESPNOW_FRAME_MAX];
+  size_t len = encodeRelayFrame(frame, sizeof(frame), 7, r, payload, sizeof(payload));
+  TEST_ASSERT_GREATER_THAN(0, len);
+  relayFrameStep(frame);
+
+  FrameHeader h;
+  TEST_ASSERT_TRUE(decodeFrameHeader(frame, len, h));
+  RelayHeader back;
+  const uint8_t* inner = nullptr;
+  uint8_t innerLen = 0;
+  TEST_ASSERT_TRUE(decodeRelayFrame(frame, h, back, &inner, &innerLen));
+  TEST_ASSERT_EQUAL_MEMORY(r.origin, back.origin, 6);
+  TEST_ASSERT_EQUAL_MEMORY(r.target, back.target, 6);
+  TEST_ASSERT_EQUAL_UINT16(0xBEEF, back.seq);
+  TEST_ASSERT_EQUAL_UINT8(2, back.ttl);
+  TEST_ASSERT_EQUAL_UINT8(1, back.hops);
+  TEST_ASSERT_EQUAL_UINT8(sizeof(payload), innerLen);
+  TEST_ASSERT_EQUAL_MEMORY(payload, inner, sizeof(payload));
+
+  static uint8_t big[RELAY_MAX_PAYLOAD + 1];
+  TEST_ASSERT_EQUAL(0, encodeRelayFrame(frame, sizeof(frame), 8, r, big, sizeof(big)));
+}
+
+// Lossy multi-hop simulation: a chain hub <- n1 <- n2 ... each node hearing only
+// its two neighbors, every transmission lost with probability 'loss'. Nodes
+// beacon (sensor broadcasts with their route advertisement) and choose parents
+// through NeighborTable; frames go up by parent and back down by the RouteTable
+// the relays learned, with RelayDedup, TTL and the no-bounce rule on every hop,
+// as handleRelayFrame and meshSend do. A unicast hop gets 'attempts' tries
+// (MAC retries; the receiver's MAC drops repeats). That count is a model
+// parameter, not a measurement of the radio. RelayBudget isn't in play.
+
+#define SIM_MAX_HOPS    4            // RELAY_MAX_HOPS in main.cpp
+#define SIM_NODES       (SIM_MAX_HOPS + 2)  // Hub, SIM_MAX_HOPS relays, one node too far out
+#define SIM_FRAMES      2000         // Frames each way per node
+#define SIM_TIMEOUT_MS  85000        // RELAY_NEIGHBOR_TIMEOUT_MS, RELAY_ROUTE_TIMEOUT_MS
+
+struct SimNode {
+  SimNode() : neighbors(SIM_TIMEOUT_MS, SIM_MAX_HOPS), routes(SIM_TIMEOUT_MS), beaconSeq(0), relaySeq(0) {
+    memset(&route, 0, sizeof(route));
+  }
+  MacKey mac;
+  NeighborTable<8> neighbors;
+  RouteTable<8> routes;
+  RelayDedup<32> dedup;
+  MeshRoute route;
+  uint16_t beaconSeq;
+  uint16_t relaySeq;
+};
+
+struct SimFrame {
+  MacKey origin;
+  MacKey target;
+  uint16_t seq;
+  uint8_t ttl;
+  uint8_t hops;
+};
+
+class MeshSim {
+ public:
+  MeshSim(float loss, uint8_t attempts) : _loss(loss), _attempts(attempts), _rng(12345), _now(1000),
+                                          _delivered(0), _duplicates(0), _expired(0), _bounced(0) {
+    for (int i = 0; i < SIM_NODES; i++) _n[i].mac = HUB - (MacKey)i;
+    _n[0].route.hub = _n[0].route.parent = HUB;
+  }
+
+  // Every node broadcasts once, then the non-hubs choose their parents
+  void beaconRound() {
+    for (int i = 0; i < SIM_NODES; i++) {
+      SimNode& s = _n[i];
+      uint16_t seq = s.beaconSeq++;
+      float cost = frameQuantize(s.route.cost, 10.0f, 0, 255) / 10.0f;  // As on the wire
+      for (int j = i - 1; j <= i + 1; j += 2) {
+        if (j < 0 || j >= SIM_NODES || lost()) continue;
+        _n[j].neighbors.heard(s.mac, seq, _now);
+        _n[j].neighbors.advertised(s.mac, s.route.hub, s.route.hops, cost);
+      }
+      _now += 50;
+    }
+    for (int i = 1; i < SIM_NODES; i++) _n[i].route = _n[i].neighbors.route(_n[i].mac, _now);
+  }
+
+  // meshSend: one frame from node 'from' to node 'to'; true if it got there
+  bool send(int from, int to) {
+    SimNode& s = _n[from];
+    MacKey dest = _n[to].mac;
+    MacKey next = nextHop(s, dest);
+    _delivered = 0;
+    if (next == dest) {
+      if (hop(from, to)) _delivered++;  // Direct, not wrapped
+    } else {
+      SimFrame f = {s.mac, dest, s.relaySeq++, SIM_MAX_HOPS, 0};
+      int nextIndex = index(next);
+      if (nextIndex >= 0 && hop(from, nextIndex)) receive(nextIndex, from, f);
+    }
+    _now += 10;
+    return _delivered == 1;
+  }
+
+  const SimNode& node(int i) const { return _n[i]; }
+  uint32_t duplicates() const { return _duplicates; }
+  uint32_t expired() const { return _expired; }
+  uint32_t bounced() const { return _bounced; }
+
+ private:
+  // handleRelayFrame at node i, the frame having come from neighbor 'from'
+  void receive(int i, int from, SimFrame f) {
+    SimNode& s = _n[i];
+    if (f.origin == s.mac || s.dedup.seen(f.origin, f.seq)) {
+      _duplicates++;
+      return;
+    }
+    s.routes.learn(f.origin, _n[from].mac, (uint8_t)(f.hops + 1), _now);
+    if (f.target == s.mac) {
+      _delivered++;
+      return;
+    }
+    if (f.ttl <= 1) {
+      _expired++;
+      return;
+    }
+    MacKey next = nextHop(s, f.target);
+    int nextIndex = index(next);
+    if (next == _n[from].mac || nextIndex < 0) {
+      _bounced++;
+      return;
+    }
+    f.ttl--;
+    f.hops++;
+    if (hop(i, nextIndex)) receive(nextIndex, i, f);
+  }
+
+  // meshNextHop
+  MacKey nextHop(const SimNode& s, MacKey dest) const {
+    MacKey next = dest == s.route.hub && s.route.parent ? s.route.parent : s.routes.nextHop(dest, _now);
+    return next ? next : dest;
+  }
+
+  // A unicast between neighbors, retried up to 'attempts' times
+  bool hop(int from, int to) {
+    if (to != from - 1 && to != from + 1) return false;  // Out of range
+    for (uint8_t a = 0; a < _attempts; a++) {
+      if (!lost()) return true;
+    }
+    return false;
+  }
+
+  int index(MacKey mac) const {
+    for (int i = 0; i < SIM_NODES; i++) {
+      if (_n[i].mac == mac) return i;
+    }
+    return -1;
+  }
+
+  bool lost() {
+    _rng = _rng * 1103515245u + 12345u;
+    return ((_rng >> 8) & 0xFFFF) / 65536.0f < _loss;
+  }
+
+  SimNode _n[SIM_NODES];
+  float _loss;
+  uint8_t _attempts;
+  uint32_t _rng;
+  uint32_t _now;
+  int _delivered;
+  uint32_t _duplicates;
+  uint32_t _expired;
+  uint32_t _bounced;
+};
+
+// Delivery up and down falls with hops as the per-hop success compounds, and
+// nothing is lost to routing itself: no duplicate drops, expiries or bounces
+// on a chain, and the node past the hop limit gets no route at all
+static void test_lossy_chain_delivery_by_hops() {
+  struct Case {
+    float loss;
+    uint8_t attempts;
+  };
+  const Case cases[] = {{0.0f, 1}, {0.1f, 1}, {0.3f, 1}, {0.3f, 4}, {0.5f, 4}};
+  printf("  loss  tries  hops  expected    up   down\n");
+  for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+    MeshSim sim(cases[c].loss, cases[c].attempts);
+    for (int r = 0; r < 20; r++) sim.beaconRound();
+
+    int up[SIM_NODES] = {0}, down[SIM_NODES] = {0};
+    for (int f = 0; f < SIM_FRAMES; f++) {
+      if (f % 50 == 0) sim.beaconRound();  // Routes stay fresh as they would
+      for (int k = 1; k < SIM_NODES; k++) up[k] += sim.send(k, 0);
+      for (int k = 1; k < SIM_NODES; k++) down[k] += sim.send(0, k);
+    }
+
+    float hopSuccess = 1.0f - powf(cases[c].loss, cases[c].attempts);
+    for (int k = 1; k <= SIM_MAX_HOPS; k++) {
+      const MeshRoute& route = sim.node(k).route;
+      TEST_ASSERT_EQUAL_UINT64(HUB, route.hub);
+      TEST_ASSERT_EQUAL_UINT64(sim.node(k - 1).mac, route.parent);
+      TEST_ASSERT_EQUAL_UINT8(k, route.hops);
+
+      float expected = powf(hopSuccess, (float)k);
+      float upRatio = (float)up[k] / SIM_FRAMES;
+      float downRatio = (float)down[k] / SIM_FRAMES;
+      printf("  %4.1f  %5u  %4d  %8.3f  %.3f  %.3f\n", cases[c].loss, cases[c].attempts, k, expected, upRatio, downRatio);
+      TEST_ASSERT_FLOAT_WITHIN(0.04f, expected, upRatio);
+      TEST_ASSERT_FLOAT_WITHIN(0.04f, expected, downRatio);
+    }
+    TEST_ASSERT_EQUAL_UINT64(0, sim.node(SIM_NODES - 1).route.hub);
+    TEST_ASSERT_EQUAL_INT(0, up[SIM_NODES - 1]);
+    TEST_ASSERT_EQUAL_UINT32(0, sim.duplicates());
+    TEST_ASSERT_EQUAL_UINT32(0, sim.expired());
+    TEST_ASSERT_EQUAL_UINT32(0, sim.bounced());
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_quality_follows_delivery_ratio);
+  RUN_TEST(test_route_prefers_lowest_path_cost);
+  RUN_TEST(test_parent_switch_needs_margin);
+  RUN_TEST(test_no_route_past_hop_limit_cost_cap_or_silence);
+  RUN_TEST(test_full_table_evicts_longest_silent);
+  RUN_TEST(test_route_table_learns_and_expires);
+  RUN_TEST(test_dedup_remembers_the_last_n);
+  RUN_TEST(test_budget_bursts_then_refills_at_rate);
+  RUN_TEST(test_relay_frame_round_trip_and_step);
+  RUN_TEST(test_lossy_chain_delivery_by_hops);
+  return UNITY_END();
+}
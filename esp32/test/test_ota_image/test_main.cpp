@@ -0,0 +1,184 @@
+// Compressed OTA container (ota_image.h): header parsing and the streaming LZSS
+// decoder, whole, split at every byte and resumed from a checkpoint
+
+#include <unity.h>
+#include <vector>
+#include "ota_image.h"
+
+void setUp() {}
+void tearDown() {}
+
+static uint8_t g_window[OTA_LZSS_WINDOW];
+
+// Greedy reference encoder for the format in ota_image.h; slow, but plain
+static std::vector<uint8_t> compress(const std::vector<uint8_t>& src) {
+  std::vector<uint8_t> out;
+  size_t flagPos = 0;
+  int flagBit = 8;
+  size_t p = 0;
+  while (p < src.size()) {
+    if (flagBit == 8) {
+      flagPos = out.size();
+      out.push_back(0);
+      flagBit = 0;
+    }
+    size_t best = 0, dist = 0;
+    size_t maxLen = src.size() - p < OTA_LZSS_MAX_MATCH ? src.size() - p : OTA_LZSS_MAX_MATCH;
+    for (size_t d = 1; d <= OTA_LZSS_WINDOW && d <= p; d++) {
+      size_t len = 0;
+      while (len < maxLen && src[p - d + len] == src[p + len]) len++;
+      if (len > best) {
+        best = len;
+        dist = d;
+      }
+    }
+    if (best >= OTA_LZSS_MIN_MATCH) {
+      size_t code = best >= OTA_LZSS_LONG_MATCH ? 15 : best - OTA_LZSS_MIN_MATCH;
+      uint16_t v = (uint16_t)((dist - 1) | (code << 12));
+      out.push_back((uint8_t)v);
+      out.push_back((uint8_t)(v >> 8));
+      if (code == 15) out.push_back((uint8_t)(best - OTA_LZSS_LONG_MATCH));
+      p += best;
+    } else {
+      out[flagPos] |= (uint8_t)(1 << flagBit);
+      out.push_back(src[p++]);
+    }
+    flagBit++;
+  }
+  return out;
+}
+
+// Text-like data with repeats near and far, runs and some noise
+static std::vector<uint8_t> sample(size_t n) {
+  std::vector<uint8_t> s;
+  uint32_t x = 12345;
+  while (s.size() < n) {
+    x = x * 1103515245u + 12345u;
+    switch ((x >> 16) % 4) {
+      case 0: s.insert(s.end(), 40, (uint8_t)(x >> 8)); break;
+      case 1: for (int i = 0; i < 20; i++) s.push_back((uint8_t)((x >> (i % 24)) & 0xFF)); break;
+      default: {
+        size_t back = 1 + (x >> 8) % (s.size() + 1);
+        if (back > s.size()) back = s.size();
+        size_t start = s.size() - back;
+        for (size_t i = 0; i < 30 && start + i < s.size(); i++) s.push_back(s[start + i]);
+        s.push_back((uint8_t)x);
+      }
+    }
+  }
+  s.resize(n);
+  return s;
+}
+
+static void test_parses_header() {
+  uint8_t h[OTA_IMAGE_HEADER_SIZE] = {0x41, 0x53, 0x5A, 0x31, OTA_IMAGE_VERSION, OTA_CODEC_LZSS, OTA_LZSS_WINDOW_BITS, 0,
+                                      0x10, 0x20, 0, 0, 0x00, 0x00, 0x10, 0};
+  for (int i = 0; i < 32; i++) h[16 + i] = (uint8_t)i;
+  OtaImageHeader header;
+  TEST_ASSERT_TRUE(isOtaImage(h, sizeof(h)));
+  TEST_ASSERT_TRUE(parseOtaImageHeader(h, sizeof(h), header));
+  TEST_ASSERT_EQUAL_UINT8(OTA_CODEC_LZSS, header.codec);
+  TEST_ASSERT_EQUAL_UINT32(0x2010, header.payloadSize);
+  TEST_ASSERT_EQUAL_UINT32(0x100000, header.imageSize);
+  TEST_ASSERT_EQUAL_MEMORY(h + 16, header.sha256, 32);
+
+  TEST_ASSERT_FALSE(parseOtaImageHeader(h, sizeof(h) - 1, header));  // Short
+  h[6] = 11;
+  TEST_ASSERT_FALSE(parseOtaImageHeader(h, sizeof(h), header));      // Other window
+  h[6] = OTA_LZSS_WINDOW_BITS;
+  h[5] = 7;
+  TEST_ASSERT_FALSE(parseOtaImageHeader(h, sizeof(h), header));      // Unknown codec
+  h[5] = OTA_CODEC_LZSS;
+  h[4] = 2;
+  TEST_ASSERT_FALSE(parseOtaImageHeader(h, sizeof(h), header));      // Newer version
+  const uint8_t raw[4] = {0xE9, 0x05, 0x02, 0x20};
+  TEST_ASSERT_FALSE(isOtaImage(raw, sizeof(raw)));                   // An app image
+}
+
+// Literals, an overlapping run (distance 1) and a long match with its extra byte
+static void test_decodes_hand_made_stream() {
+  const uint8_t in[] = {0x03, 'a', 'b', 0x00, 0xF0, 10};  // a b, then distance 1 length 28
+  uint8_t out[64];
+  size_t produced;
+  LzssDecoder d;
+  d.begin(g_window);
+  TEST_ASSERT_EQUAL(sizeof(in), d.decode(in, sizeof(in), out, sizeof(out), produced));
+  TEST_ASSERT_EQUAL(30, produced);
+  TEST_ASSERT_EQUAL_UINT8('a', out[0]);
+  for (int i = 1; i < 30; i++) TEST_ASSERT_EQUAL_UINT8('b', out[i]);
+  TEST_ASSERT_FALSE(d.failed());
+  TEST_ASSERT_TRUE(d.atBoundary());
+}
+
+static void test_match_before_start_fails() {
+  const uint8_t in[] = {0x01, 'a', 0x01, 0x00};  // Distance 2 with one byte out
+  uint8_t out[16];
+  size_t produced;
+  LzssDecoder d;
+  d.begin(g_window);
+  d.decode(in, sizeof(in), out, sizeof(out), produced);
+  TEST_ASSERT_TRUE(d.failed());
+}
+
+// Round trip with the input fed a byte at a time into a small output buffer
+static void test_round_trip_split_anywhere() {
+  std::vector<uint8_t> src = sample(20000);
+  std::vector<uint8_t> packed = compress(src);
+  TEST_ASSERT_TRUE(packed.size() < src.size());
+  std::vector<uint8_t> out;
+  uint8_t buf[7];
+  LzssDecoder d;
+  d.begin(g_window);
+  size_t i = 0;
+  while (i < packed.size() || d.busy()) {
+    size_t produced;
+    size_t used = d.decode(&packed[i], i < packed.size() ? 1 : 0, buf, sizeof(buf), produced);
+    out.insert(out.end(), buf, buf + produced);
+    i += used;
+    TEST_ASSERT_FALSE(d.failed());
+  }
+  TEST_ASSERT_EQUAL(src.size(), out.size());
+  TEST_ASSERT_EQUAL_MEMORY(src.data(), out.data(), src.size());
+  TEST_ASSERT_EQUAL_UINT32(src.size(), d.expanded());
+}
+
+// Checkpoint at an input boundary, then restore into a fresh decoder with the
+// window reloaded from the output so far, as a resumed transfer does
+static void test_resume_from_checkpoint() {
+  std::vector<uint8_t> src = sample(30000);
+  std::vector<uint8_t> packed = compress(src);
+  std::vector<uint8_t> out(src.size());
+  LzssDecoder d;
+  d.begin(g_window);
+  size_t in = 0, done = 0, produced;
+  while (in < packed.size() / 2 || !d.atBoundary() || d.busy()) {
+    size_t chunk = packed.size() - in < 100 ? packed.size() - in : 100;
+    in += d.decode(&packed[in], chunk, &out[done], out.size() - done, produced);
+    done += produced;
+  }
+  uint32_t saved = d.save();
+
+  static uint8_t window2[OTA_LZSS_WINDOW];
+  memset(window2, 0x5A, sizeof(window2));
+  for (size_t k = done > OTA_LZSS_WINDOW ? done - OTA_LZSS_WINDOW : 0; k < done; k++)
+    window2[k & (OTA_LZSS_WINDOW - 1)] = out[k];
+  LzssDecoder resumed;
+  resumed.restore(window2, done, saved);
+  while (in < packed.size() || resumed.busy()) {
+    in += resumed.decode(&packed[in], packed.size() - in, &out[done], out.size() - done, produced);
+    done += produced;
+    TEST_ASSERT_FALSE(resumed.failed());
+  }
+  TEST_ASSERT_EQUAL(src.size(), done);
+  TEST_ASSERT_EQUAL_MEMORY(src.data(), out.data(), src.size());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_parses_header);
+  RUN_TEST(test_decodes_hand_made_stream);
+  RUN_TEST(test_match_before_start_fails);
+  RUN_TEST(test_round_trip_split_anywhere);
+  RUN_TEST(test_resume_from_checkpoint);
+  return UNITY_END();
+}
@@ -0,0 +1,147 @@
+// Streamed BLE OTA (ota_stream.h): notifications, CRC-32 and the staging double
+// buffer, alone and with a drainer thread
+
+#include <unity.h>
+#include <thread>
+#include <vector>
+#include "ota_stream.h"
+
+void setUp() {}
+void tearDown() {}
+
+static void test_notify_layout() {
+  OtaNotify n = {OTA_EVT_ACK, OTA_OK, OTA_FEATURE_IMAGE, 0x01020304, 0x11121314, 0x21222324, 0x31323334};
+  uint8_t buf[OTA_NOTIFY_SIZE];
+  TEST_ASSERT_EQUAL(OTA_NOTIFY_SIZE, encodeOtaNotify(buf, n));
+  TEST_ASSERT_EQUAL_HEX8(OTA_NOTIFY_MAGIC, buf[0]);
+  TEST_ASSERT_EQUAL_UINT8(OTA_EVT_ACK, buf[1]);
+  TEST_ASSERT_EQUAL_UINT8(OTA_FEATURE_IMAGE, buf[3]);
+  TEST_ASSERT_EQUAL_UINT32(0x01020304, otaGetU32(buf + 4));
+  TEST_ASSERT_EQUAL_UINT32(0x11121314, otaGetU32(buf + 8));
+  TEST_ASSERT_EQUAL_UINT32(0x21222324, otaGetU32(buf + 12));
+  TEST_ASSERT_EQUAL_UINT32(0x31323334, otaGetU32(buf + 16));
+}
+
+// zlib's check value, in one go and in pieces
+static void test_crc32_matches_zlib() {
+  const uint8_t* s = (const uint8_t*)"123456789";
+  TEST_ASSERT_EQUAL_HEX32(0xCBF43926, otaCrc32(0, s, 9));
+  TEST_ASSERT_EQUAL_HEX32(0xCBF43926, otaCrc32(otaCrc32(0, s, 4), s + 4, 5));
+  TEST_ASSERT_EQUAL_HEX32(0, otaCrc32(0, s, 0));
+}
+
+struct Staging {
+  uint8_t a[64];
+  uint8_t b[64];
+  OtaStaging s;
+  Staging() { s.init(a, b, sizeof(a)); }
+};
+
+static void test_fills_blocks_and_grants_credit() {
+  Staging st;
+  st.s.begin(200, 0);
+  uint8_t data[200];
+  for (int i = 0; i < 200; i++) data[i] = (uint8_t)i;
+  uint32_t taken;
+  TEST_ASSERT_EQUAL_UINT32(128, st.s.limit());  // Two free blocks
+  TEST_ASSERT_EQUAL(OTA_ACCEPTED, st.s.accept(0, data, 70, taken));
+  TEST_ASSERT_EQUAL_UINT32(70, taken);
+  TEST_ASSERT_EQUAL_UINT32(70, st.s.received());
+  TEST_ASSERT_EQUAL_UINT32(128, st.s.limit());  // Block 0 published, block 1 partly filled
+
+  OtaStaging::Block block;
+  TEST_ASSERT_TRUE(st.s.next(block));
+  TEST_ASSERT_EQUAL_UINT32(0, block.offset);
+  TEST_ASSERT_EQUAL_UINT32(64, block.length);
+  TEST_ASSERT_EQUAL_MEMORY(data, block.data, 64);
+
+  // Block 1 fills; block 0 is still the drainer's
+  TEST_ASSERT_EQUAL(OTA_NO_ROOM, st.s.accept(70, data + 70, 100, taken));
+  TEST_ASSERT_EQUAL_UINT32(58, taken);
+  TEST_ASSERT_EQUAL_UINT32(128, st.s.received());
+  TEST_ASSERT_EQUAL_UINT32(128, st.s.limit());  // No credit until the drainer frees one
+  st.s.release();
+  TEST_ASSERT_EQUAL_UINT32(192, st.s.limit());
+}
+
+static void test_duplicate_overlap_and_gap() {
+  Staging st;
+  st.s.begin(100, 0);
+  uint8_t data[100];
+  for (int i = 0; i < 100; i++) data[i] = (uint8_t)(i * 3);
+  uint32_t taken;
+  st.s.accept(0, data, 30, taken);
+  TEST_ASSERT_EQUAL(OTA_DUPLICATE, st.s.accept(10, data + 10, 20, taken));
+  TEST_ASSERT_EQUAL(OTA_OUT_OF_ORDER, st.s.accept(40, data + 40, 10, taken));
+  TEST_ASSERT_EQUAL(OTA_ACCEPTED, st.s.accept(20, data + 20, 20, taken));  // New part only
+  TEST_ASSERT_EQUAL_UINT32(10, taken);
+  TEST_ASSERT_EQUAL_UINT32(40, st.s.received());
+}
+
+// The last block goes out short, and nothing past the total is staged
+static void test_final_partial_block_and_clamp() {
+  Staging st;
+  st.s.begin(100, 64);  // Resumed at a block boundary
+  uint8_t data[50];
+  memset(data, 0xAB, sizeof(data));
+  uint32_t taken;
+  TEST_ASSERT_EQUAL(OTA_ACCEPTED, st.s.accept(64, data, 50, taken));
+  TEST_ASSERT_EQUAL_UINT32(36, taken);
+  TEST_ASSERT_EQUAL_UINT32(100, st.s.received());
+  TEST_ASSERT_EQUAL_UINT32(100, st.s.limit());
+  OtaStaging::Block block;
+  TEST_ASSERT_TRUE(st.s.next(block));
+  TEST_ASSERT_EQUAL_UINT32(64, block.offset);
+  TEST_ASSERT_EQUAL_UINT32(36, block.length);
+  st.s.release();
+  TEST_ASSERT_TRUE(st.s.drained());
+}
+
+// A filler and a drainer thread, the filler resending from 'received' whenever it
+// runs out of room, reproduce the image byte for byte
+static void test_threaded_transfer_is_exact() {
+  const uint32_t total = 300000;
+  std::vector<uint8_t> image(total), flash(total, 0);
+  for (uint32_t i = 0; i < total; i++) image[i] = (uint8_t)(i * 2654435761u >> 24);
+  std::vector<uint8_t> a(4096), b(4096);
+  OtaStaging s;
+  s.init(a.data(), b.data(), 4096);
+  s.begin(total, 0);
+
+  std::thread drainer([&]() {
+    uint32_t done = 0;
+    while (done < total) {
+      OtaStaging::Block block;
+      if (!s.next(block)) {
+        std::this_thread::yield();
+        continue;
+      }
+      memcpy(&flash[block.offset], block.data, block.length);
+      done = block.offset + block.length;
+      s.release();
+    }
+  });
+
+  uint32_t offset = 0;
+  while (offset < total) {
+    uint32_t n = total - offset < 244 ? total - offset : 244;
+    uint32_t taken;
+    OtaAccept r = s.accept(offset, &image[offset], n, taken);
+    if (r == OTA_NO_ROOM) std::this_thread::yield();
+    offset = s.received();
+  }
+  drainer.join();
+  TEST_ASSERT_TRUE(s.drained());
+  TEST_ASSERT_EQUAL_MEMORY(image.data(), flash.data(), total);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_notify_layout);
+  RUN_TEST(test_crc32_matches_zlib);
+  RUN_TEST(test_fills_blocks_and_grants_credit);
+  RUN_TEST(test_duplicate_overlap_and_gap);
+  RUN_TEST(test_final_partial_block_and_clamp);
+  RUN_TEST(test_threaded_transfer_is_exact);
+  return UNITY_END();
+}
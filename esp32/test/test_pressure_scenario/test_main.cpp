@@ -0,0 +1,203 @@
+// Scenario engine (pressure_scenario.h): a CSV trace loaded line by line as
+// loadScenarioTrace() does, the same seed giving the same samples, and the speed
+// multiplier scaling scenario time the way the acquisition task steps it
+
+#include <unity.h>
+#include <string.h>
+#include "pressure_scenario.h"
+
+void setUp() {}
+void tearDown() {}
+
+#define SAMPLE_RATE_HZ 4000  // ADC_SAMPLE_RATE_HZ in main.cpp
+
+// A header, a comment, rows with and without environment columns, and a row
+// going back in time, which the parser drops
+static const char TRACE_CSV[] =
+    "t_s,ch1_psi,ch2_psi,ambient_psi,temp_f\n"
+    "# recorded parked, then loading\n"
+    "0,20,22,14.70,60\n"
+    "10,20,22,14.70,61\n"
+    "20,60,64,14.68,62\n"
+    "15,99,99,14.00,99\n"
+    "30, 80 ,\t84,14.66,63\n"
+    "40,80,84\n";
+
+// The acquisition task's side: scenario time advances speed / sample rate per sample
+struct Driver {
+  PressureScenario scenario;
+  double time = 0;
+  float step = 0;
+
+  void start(const ScenarioProfile& profile, const ScenarioTrace* trace, float speed) {
+    scenario.setProfile(profile);
+    if (trace) scenario.setTrace(trace);
+    step = speed / SAMPLE_RATE_HZ;
+    time = 0;
+  }
+
+  void sample(float* ch1, float* ch2) {
+    *ch1 = scenario.pressure(1, (float)time);
+    *ch2 = scenario.pressure(2, (float)time);
+    time += step;
+  }
+};
+
+static float g_storage[5 * 16];
+
+static ScenarioTrace loadTrace() {
+  ScenarioTrace trace;
+  trace.attach(g_storage, 16);
+  const char* p = TRACE_CSV;
+  char line[96];
+  while (*p) {
+    size_t n = strcspn(p, "\n");
+    memcpy(line, p, n);
+    line[n] = '\0';
+    trace.parseLine(line);
+    p += n + (p[n] ? 1 : 0);
+  }
+  return trace;
+}
+
+static void test_csv_loads_through_parse_line() {
+  ScenarioTrace trace = loadTrace();
+  TEST_ASSERT_EQUAL_UINT32(5, trace.count);
+  TEST_ASSERT_TRUE(trace.hasEnvironment);
+  TEST_ASSERT_EQUAL_FLOAT(40.0f, trace.duration());
+  TEST_ASSERT_EQUAL_FLOAT(80.0f, trace.ch1[3]);  // Spaces and tabs around fields
+  TEST_ASSERT_EQUAL_FLOAT(84.0f, trace.ch2[3]);
+  TEST_ASSERT_EQUAL_FLOAT(14.7f, trace.ambient[4]);  // Defaults for a short row
+  TEST_ASSERT_EQUAL_FLOAT(72.0f, trace.temp[4]);
+
+  // parseCsv gives the same rows from the whole buffer
+  float storage[5 * 16];
+  ScenarioTrace whole;
+  whole.attach(storage, 16);
+  TEST_ASSERT_EQUAL_UINT32(5, whole.parseCsv(TRACE_CSV, sizeof(TRACE_CSV) - 1));
+  TEST_ASSERT_EQUAL_MEMORY(trace.ch1, whole.ch1, 5 * sizeof(float));
+
+  // A full trace refuses more rows
+  ScenarioTrace small;
+  small.attach(storage, 2);
+  TEST_ASSERT_TRUE(small.parseLine("0,1,1"));
+  TEST_ASSERT_TRUE(small.parseLine("1,1,1"));
+  TEST_ASSERT_FALSE(small.parseLine("2,1,1"));
+}
+
+// Replay interpolates between rows, loops over the trace, and reads the
+// environment columns
+static void test_trace_drives_the_scenario() {
+  ScenarioTrace trace = loadTrace();
+  ScenarioProfile quiet;
+  quiet.noisePsi = 0;
+  Driver d;
+  d.start(quiet, &trace, 1.0f);
+  TEST_ASSERT_TRUE(d.scenario.replaying());
+  TEST_ASSERT_EQUAL_FLOAT(40.0f, d.scenario.duration());
+
+  float ch1 = 0, ch2 = 0;
+  for (int i = 0; i <= 15 * SAMPLE_RATE_HZ; i++) d.sample(&ch1, &ch2);  // t = 15 s
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 40.0f, ch1);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 43.0f, ch2);
+  float ambient, temp;
+  d.scenario.environment(25.0f, &ambient, &temp);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 14.67f, ambient);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 62.5f, temp);
+
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, d.scenario.pressure(1, 15.0f), d.scenario.pressure(1, 55.0f));  // Looped
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 20.0f, d.scenario.pressure(1, 80.0f));
+
+  // Fewer than two rows: no replay, back to the profile
+  ScenarioTrace one;
+  one.attach(g_storage, 16);
+  one.parseLine("0,1,1");
+  d.scenario.setTrace(&one);
+  TEST_ASSERT_FALSE(d.scenario.replaying());
+}
+
+// Noise is the only randomness; the seed and the call order fix it
+static void test_same_seed_same_samples() {
+  ScenarioProfile profile;
+  TEST_ASSERT_TRUE(scenarioProfileByName("vibration", &profile));
+  ScenarioTrace trace = loadTrace();
+
+  for (int replay = 0; replay < 2; replay++) {
+    profile.seed = 42;
+    Driver a, b, c;
+    a.start(profile, replay ? &trace : nullptr, 10.0f);
+    b.start(profile, replay ? &trace : nullptr, 10.0f);
+    profile.seed = 43;
+    c.start(profile, replay ? &trace : nullptr, 10.0f);
+
+    int differ = 0;
+    for (int i = 0; i < 20000; i++) {
+      float a1, a2, b1, b2, c1, c2;
+      a.sample(&a1, &a2);
+      b.sample(&b1, &b2);
+      c.sample(&c1, &c2);
+      TEST_ASSERT_EQUAL_FLOAT(a1, b1);
+      TEST_ASSERT_EQUAL_FLOAT(a2, b2);
+      if (a1 != c1) differ++;
+    }
+    TEST_ASSERT_TRUE(differ > 19000);  // Another seed, other noise
+  }
+
+  // Restarting the same profile restarts the sequence
+  profile.seed = 42;
+  Driver d;
+  d.start(profile, nullptr, 1.0f);
+  float first1, first2, x1, x2;
+  d.sample(&first1, &first2);
+  d.sample(&x1, &x2);
+  d.start(profile, nullptr, 1.0f);
+  d.sample(&x1, &x2);
+  TEST_ASSERT_EQUAL_FLOAT(first1, x1);
+  TEST_ASSERT_EQUAL_FLOAT(first2, x2);
+}
+
+// At speed k, sample n sits at the scenario time sample n * k does at speed 1,
+// for the synthetic profile and for the trace alike
+static void test_speed_scales_scenario_time() {
+  ScenarioProfile profile;
+  TEST_ASSERT_TRUE(scenarioProfileByName("ramp", &profile));
+  profile.noisePsi = 0;
+  ScenarioTrace trace = loadTrace();
+  const float speeds[] = {2.0f, 10.0f, 100.0f};
+
+  for (int replay = 0; replay < 2; replay++) {
+    for (size_t s = 0; s < sizeof(speeds) / sizeof(speeds[0]); s++) {
+      int k = (int)speeds[s];
+      Driver slow, fast;
+      slow.start(profile, replay ? &trace : nullptr, 1.0f);
+      fast.start(profile, replay ? &trace : nullptr, speeds[s]);
+      float s1 = 0, s2 = 0, f1, f2;
+      const int samples = 360 * SAMPLE_RATE_HZ / k;  // 360 scenario seconds
+      for (int n = 0; n < samples; n++) {
+        fast.sample(&f1, &f2);
+        for (int i = 0; i < k; i++) {
+          if (i == 0) {
+            slow.sample(&s1, &s2);
+          } else {
+            slow.time += slow.step;
+          }
+        }
+        if (n % 997 == 0) {
+          TEST_ASSERT_FLOAT_WITHIN(0.05f, s1, f1);
+          TEST_ASSERT_FLOAT_WITHIN(0.05f, s2, f2);
+        }
+      }
+      TEST_ASSERT_FLOAT_WITHIN(0.01, 360.0, fast.time);
+      TEST_ASSERT_FLOAT_WITHIN(0.01, 360.0, slow.time);
+    }
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_csv_loads_through_parse_line);
+  RUN_TEST(test_trace_drives_the_scenario);
+  RUN_TEST(test_same_seed_same_samples);
+  RUN_TEST(test_speed_scales_scenario_time);
+  return UNITY_END();
+}
@@ -0,0 +1,97 @@
+// Seqlock (seqlock.h): copies, versions and torn-read freedom under a racing writer
+
+#include <unity.h>
+#include <thread>
+#include <atomic>
+#include "seqlock.h"
+
+void setUp() {}
+void tearDown() {}
+
+struct Record {
+  uint32_t a;
+  uint32_t b;
+  uint16_t c;
+  uint8_t d;                  // 11 bytes: the last word is partly padding
+};
+
+static void test_read_returns_published_record() {
+  Seqlock<Record> lock;
+  Record r;
+  TEST_ASSERT_TRUE(lock.tryRead(r));
+  TEST_ASSERT_EQUAL_UINT32(0, r.a);
+
+  lock.edit().a = 7;
+  lock.edit().b = 8;
+  lock.edit().c = 9;
+  lock.edit().d = 10;
+  lock.read(r);
+  TEST_ASSERT_EQUAL_UINT32(0, r.a);  // Not published yet
+  lock.publish();
+  TEST_ASSERT_EQUAL_UINT32(0, lock.read(r));
+  TEST_ASSERT_EQUAL_UINT32(7, r.a);
+  TEST_ASSERT_EQUAL_UINT32(8, r.b);
+  TEST_ASSERT_EQUAL_UINT16(9, r.c);
+  TEST_ASSERT_EQUAL_UINT8(10, r.d);
+  TEST_ASSERT_EQUAL_UINT32(7, lock.current().a);
+}
+
+static void test_version_moves_by_two_per_publish() {
+  Seqlock<Record> lock;
+  uint32_t v0 = lock.version();
+  Record r = {1, 2, 3, 4};
+  lock.write(r);
+  TEST_ASSERT_EQUAL_UINT32(v0 + 2, lock.version());
+  lock.publish();
+  TEST_ASSERT_EQUAL_UINT32(v0 + 4, lock.version());
+}
+
+// A reader racing the writer only ever sees records the writer published: every
+// field of one record carries the same counter
+static void test_no_torn_reads_under_a_racing_writer() {
+  Seqlock<Record> lock;
+  Record first = {0, ~0u, 0, 0};
+  lock.write(first);
+  std::atomic<bool> done(false);
+  const uint32_t writes = 200000;
+  std::thread writer([&]() {
+    for (uint32_t i = 1; i <= writes; i++) {
+      Record& r = lock.edit();
+      r.a = i;
+      r.b = ~i;
+      r.c = (uint16_t)i;
+      r.d = (uint8_t)i;
+      lock.publish();
+    }
+    done = true;
+  });
+
+  uint32_t reads = 0;
+  uint32_t torn = 0;
+  uint32_t last = 0;
+  bool backwards = false;
+  while (!done) {
+    Record r;
+    lock.read(r);
+    reads++;
+    if (r.b != ~r.a || r.c != (uint16_t)r.a || r.d != (uint8_t)r.a) torn++;
+    if (r.a < last) backwards = true;
+    last = r.a;
+  }
+  writer.join();
+
+  TEST_ASSERT_GREATER_THAN(0, reads);
+  TEST_ASSERT_EQUAL_UINT32(0, torn);
+  TEST_ASSERT_FALSE(backwards);
+  Record r;
+  lock.read(r);
+  TEST_ASSERT_EQUAL_UINT32(writes, r.a);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_read_returns_published_record);
+  RUN_TEST(test_version_moves_by_two_per_publish);
+  RUN_TEST(test_no_torn_reads_under_a_racing_writer);
+  return UNITY_END();
+}
@@ -0,0 +1,137 @@
+// WeightEstimator (weight_estimator.h) replayed over step loads at several noise
+// levels, at the firmware's decimated rate: time to settle after the load stops
+// changing, and how close and how sure the settled estimate is
+
+#include <unity.h>
+#include <stdio.h>
+#include <math.h>
+#include "weight_estimator.h"
+
+void setUp() {}
+void tearDown() {}
+
+static const float DT = 1.0f / 62.5f;  // ADC_DECIMATION / ADC_SAMPLE_RATE_HZ
+
+// Deterministic gaussian noise (LCG + Box-Muller), so every run sees the same trace
+struct Noise {
+  uint32_t state;
+  explicit Noise(uint32_t seed) : state(seed) {}
+  float uniform() {
+    state = state * 1664525u + 1013904223u;
+    return ((state >> 8) + 0.5f) / 16777216.0f;
+  }
+  float gauss(float sigma) {
+    float u1 = uniform(), u2 = uniform();
+    return sigma * sqrtf(-2.0f * logf(u1)) * cosf(6.2831853f * u2);
+  }
+};
+
+struct StepRun {
+  float settleS;     // From the end of the ramp to settled(), < 0 = never
+  float rmsError;    // Over the last 10 s, estimate vs the true load
+  float stdDev;      // Estimator's own 1-sigma at the end
+};
+
+// Hold `from` for 20 s, ramp to `to` over rampS, hold for 40 s
+static StepRun replayStep(float from, float to, float rampS, float noiseLbs, uint32_t seed) {
+  WeightEstimator est;
+  Noise noise(seed);
+  StepRun run = {-1.0f, 0.0f, 0.0f};
+  const float holdS = 20.0f, afterS = 40.0f;
+  int steps = (int)((holdS + rampS + afterS) / DT);
+  double sumSq = 0;
+  int n = 0;
+  for (int i = 0; i < steps; i++) {
+    float t = i * DT;
+    float truth = t < holdS ? from : (t < holdS + rampS ? from + (to - from) * (t - holdS) / rampS : to);
+    est.update(truth + noise.gauss(noiseLbs), DT);
+    float sinceRamp = t - holdS - rampS;
+    if (sinceRamp >= 0 && run.settleS < 0 && est.settled()) run.settleS = sinceRamp;
+    if (sinceRamp >= afterS - 10.0f) {
+      sumSq += (est.weight() - truth) * (est.weight() - truth);
+      n++;
+    }
+  }
+  run.rmsError = (float)sqrt(sumSq / n);
+  run.stdDev = est.stdDev();
+  return run;
+}
+
+// Latency to settle grows with the noise, the settled estimate's error stays within
+// what the estimator itself reports. 5 s ramps up and down, 8 noise seeds each.
+static void test_settle_time_versus_noise() {
+  struct Level { float noise, maxSettleS, maxStdDev; };
+  const Level levels[] = {{50.0f, 6.0f, 15.0f}, {100.0f, 7.0f, 20.0f}, {200.0f, 9.0f, 30.0f}, {400.0f, 12.0f, 50.0f}};
+  float lastMean = 0.0f;
+  printf("  noise lbs | settle s (mean / max) | rms error lbs | std dev lbs\n");
+  for (const Level& level : levels) {
+    float sumSettle = 0.0f, maxSettle = 0.0f, sumRms = 0.0f, sumStdDev = 0.0f;
+    int runs = 0;
+    for (uint32_t seed = 1; seed <= 8; seed++) {
+      for (int down = 0; down < 2; down++) {
+        StepRun run = down ? replayStep(20000.0f, 10000.0f, 5.0f, level.noise, seed)
+                           : replayStep(10000.0f, 20000.0f, 5.0f, level.noise, seed);
+        TEST_ASSERT_TRUE_MESSAGE(run.settleS >= 0.0f, "never settled");
+        TEST_ASSERT_TRUE(run.settleS <= level.maxSettleS);
+        TEST_ASSERT_TRUE(run.stdDev <= level.maxStdDev);
+        TEST_ASSERT_TRUE(run.rmsError <= 1.5f * run.stdDev);
+        sumSettle += run.settleS;
+        if (run.settleS > maxSettle) maxSettle = run.settleS;
+        sumRms += run.rmsError;
+        sumStdDev += run.stdDev;
+        runs++;
+      }
+    }
+    float meanSettle = sumSettle / runs;
+    printf("  %9.0f | %8.2f / %8.2f   | %13.1f | %11.1f\n", level.noise, meanSettle, maxSettle, sumRms / runs,
+           sumStdDev / runs);
+    TEST_ASSERT_TRUE(meanSettle >= lastMean);
+    lastMean = meanSettle;
+  }
+}
+
+// A sudden load (1 s ramp) is followed, not smoothed over
+static void test_fast_ramp_settles() {
+  for (uint32_t seed = 1; seed <= 8; seed++) {
+    StepRun run = replayStep(10000.0f, 20000.0f, 1.0f, 100.0f, seed);
+    TEST_ASSERT_TRUE(run.settleS >= 0.0f && run.settleS <= 9.0f);
+    TEST_ASSERT_TRUE(run.rmsError <= 25.0f);
+  }
+}
+
+// Loading at ~330 lb/s is never reported as settled
+static void test_not_settled_while_loading() {
+  WeightEstimator est;
+  Noise noise(3);
+  for (int i = 0; i < (int)(20.0f / DT); i++) est.update(10000.0f + noise.gauss(100.0f), DT);
+  TEST_ASSERT_TRUE(est.settled());
+  bool settledWhileLoading = false;
+  for (int i = 0; i < (int)(30.0f / DT); i++) {
+    est.update(10000.0f + 10000.0f * i * DT / 30.0f + noise.gauss(100.0f), DT);
+    if (i * DT > 3.0f && est.settled()) settledWhileLoading = true;
+  }
+  TEST_ASSERT_FALSE(settledWhileLoading);
+  TEST_ASSERT_FLOAT_WITHIN(150.0f, 20000.0f, est.weight());
+}
+
+// New coefficients restart the estimator: the next measurement takes over at once
+static void test_reset_takes_next_measurement() {
+  WeightEstimator est;
+  for (int i = 0; i < (int)(10.0f / DT); i++) est.update(10000.0f, DT);
+  TEST_ASSERT_TRUE(est.settled());
+  est.reset(25000.0f);
+  TEST_ASSERT_FALSE(est.initialized());
+  est.update(25000.0f, DT);
+  TEST_ASSERT_EQUAL_FLOAT(25000.0f, est.weight());
+  TEST_ASSERT_FALSE(est.settled());
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, est.rate());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_settle_time_versus_noise);
+  RUN_TEST(test_fast_ramp_settles);
+  RUN_TEST(test_not_settled_while_loading);
+  RUN_TEST(test_reset_takes_next_measurement);
+  return UNITY_END();
+}
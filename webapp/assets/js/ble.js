@@ -2,17 +2,61 @@
 // Capacitor Bluetooth Module for Air Scales
 
 import { BleClient } from '@capacitor-community/bluetooth-le';
+import { OTA_IMAGE_HEADER_SIZE, OTA_CODEC_LZSS, OTA_CODEC_DELTA, crc32, lzssCompress, otaContainer, espImageDigest, deltaPatch } from './ota_codec.js';
 
 const BLE_SERVICE_UUID = '12345678-1234-1234-1234-123456789abc';
 const BLE_SENSOR_CHAR_UUID = '87654321-4321-4321-4321-cba987654321';
 const BLE_COEFFS_CHAR_UUID = '11111111-2222-3333-4444-555555555555';
 const BLE_OTA_CHAR_UUID = '22222222-3333-4444-5555-666666666666';
+const BLE_HISTORY_CHAR_UUID = '33333333-4444-5555-6666-777777777777';
+const BLE_PUBLISH_CHAR_UUID = '44444444-5555-6666-7777-888888888888';
+const BLE_COEFF_BATCH_CHAR_UUID = '55555555-6666-7777-8888-999999999999';
+const BLE_WEIGH_NOW_CHAR_UUID = '66666666-7777-8888-9999-aaaaaaaaaaaa';
+
+// BLESensorPacket sizes: firmware before the weight estimator sends the first 45
+// bytes, later firmware adds the std devs and settled flags
+const BLE_SENSOR_PACKET_V0_SIZE = 45;
+const BLE_SENSOR_PACKET_SIZE = 54;
+
+const BATTERY_LEVEL_UNKNOWN = 255;  // Firmware without a battery reading; shown as unknown (null)
 
 // OTA Command bytes
 const OTA_CMD_START = 0x01;
 const OTA_CMD_DATA = 0x02;
 const OTA_CMD_END = 0x03;
 const OTA_CMD_ABORT = 0x04;
+const OTA_CMD_DATA_AT = 0x05;
+const OTA_CMD_INFO = 0x06;
+
+// OTA notifications (firmware ota_stream.h): magic, event, status, features,
+// u32 received, u32 limit, u32 committed, u32 total
+const OTA_NOTIFY_MAGIC = 0xF3;
+const OTA_EVT_READY = 1;
+const OTA_EVT_ACK = 2;
+const OTA_EVT_REWIND = 3;
+const OTA_EVT_DONE = 4;
+const OTA_EVT_ERROR = 5;
+const OTA_EVT_RELAY = 6;
+const OTA_FEATURE_IMAGE = 0x01;
+const OTA_FEATURE_DELTA = 0x02;
+const OTA_START_RELAY = 0x01;  // Hub passes the image on to its slaves (firmware with OTA_FEATURE_RELAY)
+const OTA_ERR_BASE = 9;
+const OTA_ERRORS = ['ok', 'image too large', 'no memory', 'flash write failed', 'CRC mismatch',
+  'not a valid image', 'no update in progress', 'container corrupt', 'SHA-256 mismatch',
+  'delta made for another firmware', 'slave stopped answering', 'older than the firmware it runs'];
+
+// Mesh update progress, one slave per notification (firmware mesh_ota.h): magic,
+// index, slaves, state, mac[6], error, reserved, u32 received, u32 total
+const MESH_OTA_NOTIFY_MAGIC = 0xF5;
+const MESH_OTA_NOTIFY_SIZE = 20;
+const MESH_OTA_DONE = 4;
+const MESH_OTA_FAILED = 5;
+const MESH_OTA_STATES = ['waiting', 'erasing', 'receiving', 'verifying', 'updated', 'failed'];
+
+// Answer to OTA_CMD_INFO: magic, features, u16 reserved, u32 running partition
+// size, running image SHA-256
+const OTA_INFO_MAGIC = 0xF4;
+const OTA_INFO_SIZE = 40;
 
 const AirScalesBLE = {
   isCapacitor: false,
@@ -390,24 +434,28 @@ extractMacFromName(name) {
         BLE_SERVICE_UUID,
         BLE_SENSOR_CHAR_UUID,
         (value) => {
-          const data = this.parseDataView(value);
-
-          // If ESP32 includes RSSI in data, update it (though unlikely)
-          if (data && data.rssi !== undefined) {
-            this.currentRssi = data.rssi;
-          }
+          // Fleet frames carry several devices; listeners still get one record each
+          const parsed = this.parseDataView(value);
+          const records = Array.isArray(parsed) ? parsed : [parsed];
+
+          records.forEach(data => {
+            // If ESP32 includes RSSI in data, update it (though unlikely)
+            if (data && data.rssi !== undefined) {
+              this.currentRssi = data.rssi;
+            }
 
-          // Add current RSSI to data for UI display
-          if (data && this.currentRssi !== null) {
-            data.rssi = this.currentRssi;
-          }
+            // Add current RSSI to data for UI display
+            if (data && this.currentRssi !== null) {
+              data.rssi = this.currentRssi;
+            }
 
-          // Store last sensor data (includes firmware_version for OTA checks)
-          if (data) {
-            this.lastSensorData = data;
-          }
+            // Store last sensor data (includes firmware_version for OTA checks)
+            if (data && data.role === 'hub') {
+              this.lastSensorData = data;
+            }
 
-          this.notifyListeners('data', data);
+            this.notifyListeners('data', data);
+          });
         }
       );
       console.log('📡 Sensor notifications started');
@@ -416,8 +464,94 @@ extractMacFromName(name) {
     }
   },
 
-  // Parse DataView - handles both binary (45 bytes) and legacy JSON formats
-  // Binary packet structure (45 bytes, little-endian, packed):
+  // Fleet frame (hub notifications): 12-byte header, then fixed-size records.
+  // Layout documented in esp32/include/ble_fleet_frame.h. Returns an array of
+  // records shaped like the single-packet format below.
+  //   0: uint8 magic 0xF1, 1: version, 2: refresh, 3: frame index
+  //   4: flags (bit0 = last frame, bit1 = delta: only changed records plus the hub)
+  //   5: uint8 record count, 6: uint8 record size, 7: uint8 devices, 8-11: float32 fleet total
+  // Record (little-endian, fixed point):
+  //   0: flags (bit0 hub, bit1 CH1 settled, bit2 CH2 settled, bit3 changed,
+  //      bit4 counted in the fleet total, bit5 unaligned: no sample time of its own), 1-6: mac
+  //   7/9: uint16 ch1/ch2 air pressure (0.01 psi), 11: uint16 ambient (0.001 psi)
+  //   13: int16 temperature (0.01 F), 15/19: int32 ch1/ch2 weight (0.1 lb)
+  //   23/25: uint16 ch1/ch2 std dev (0.1 lb), 27: battery (255 = unknown), 28: int8 rssi (EWMA, -127 = unknown)
+  //   29-31: fw major/minor/patch, 32: uint16 age (0.1 s)
+  //   34: int16 sample time vs the fleet total's reference (ms, -32768 = unknown;
+  //       36-byte records and up)
+  //   36: uint8 link loss (0.5 %), 37: uint8 link jitter (ms); 255 = unknown
+  //       (38-byte records)
+  parseFleetFrame(dataView) {
+    const littleEndian = true;
+    const count = dataView.getUint8(5);
+    const recordSize = dataView.getUint8(6);
+    const deviceCount = dataView.getUint8(7);
+    const fleetTotalWeight = dataView.getFloat32(8, littleEndian);
+    const records = [];
+
+    for (let i = 0; i < count; i++) {
+      const o = 12 + i * recordSize;
+      if (o + 34 > dataView.byteLength) break;
+
+      const flags = dataView.getUint8(o);
+      const isHub = (flags & 0x01) !== 0;
+      const macBytes = [];
+      for (let b = 0; b < 6; b++) {
+        macBytes.push(dataView.getUint8(o + 1 + b).toString(16).padStart(2, '0').toUpperCase());
+      }
+      const ch1Weight = dataView.getInt32(o + 15, littleEndian) / 10;
+      const ch2Weight = dataView.getInt32(o + 19, littleEndian) / 10;
+      const battery = dataView.getUint8(o + 27);
+
+      const data = {
+        mac_address: macBytes.join(':'),
+        ch1_air_pressure: dataView.getUint16(o + 7, littleEndian) / 100,
+        ch2_air_pressure: dataView.getUint16(o + 9, littleEndian) / 100,
+        atmospheric_pressure: dataView.getUint16(o + 11, littleEndian) / 1000,
+        temperature: dataView.getInt16(o + 13, littleEndian) / 100,
+        ch1_weight: ch1Weight,
+        ch2_weight: ch2Weight,
+        total_weight: ch1Weight + ch2Weight,
+        ch1_weight_std_dev: dataView.getUint16(o + 23, littleEndian) / 10,
+        ch2_weight_std_dev: dataView.getUint16(o + 25, littleEndian) / 10,
+        ch1_settled: (flags & 0x02) !== 0,
+        ch2_settled: (flags & 0x04) !== 0,
+        battery_level: battery === BATTERY_LEVEL_UNKNOWN ? null : battery,
+        firmware_version: `${dataView.getUint8(o + 29)}.${dataView.getUint8(o + 30)}.${dataView.getUint8(o + 31)}`,
+        age_ms: dataView.getUint16(o + 32, littleEndian) * 100,
+        changed: (flags & 0x08) !== 0,
+        in_fleet_total: (flags & 0x10) !== 0,
+        unaligned: (flags & 0x20) !== 0,  // Summed without a sample time (legacy or unsynced sender)
+        role: isHub ? 'hub' : 'device'
+      };
+      if (recordSize >= 36 && o + 36 <= dataView.byteLength) {
+        const skew = dataView.getInt16(o + 34, littleEndian);
+        data.sample_skew_ms = skew === -32768 ? null : skew;
+      }
+      if (recordSize >= 38 && o + 38 <= dataView.byteLength) {
+        const loss = dataView.getUint8(o + 36);
+        const jitter = dataView.getUint8(o + 37);
+        data.espnow_loss = loss === 255 ? null : loss / 200;
+        data.espnow_jitter_ms = jitter === 255 ? null : jitter;
+      }
+
+      if (isHub) {
+        data.device_count = deviceCount;
+        data.fleet_total_weight = fleetTotalWeight;
+      } else {
+        const rssi = dataView.getInt8(o + 28);
+        data.espnow_rssi = rssi === -127 ? null : rssi;
+        if (data.firmware_version === '0.0.0') data.firmware_version = null;  // Slave hasn't reported its own
+      }
+      records.push(data);
+    }
+
+    console.log(`📦 Fleet frame ${dataView.getUint8(2)}/${dataView.getUint8(3)} (${dataView.byteLength} bytes): ${records.length} records`);
+    return records;
+  },
+
+  // Parse DataView - handles fleet frames, single binary packets (45/54 bytes) and legacy JSON
+  // Binary packet structure (54 bytes, little-endian, packed; older firmware sends the first 45):
   //   0: uint8  packetType (0=hub, 1=device)
   //   1-6: uint8[6] mac address bytes
   //   7-10: float32 ch1AirPressure
@@ -434,10 +568,18 @@ extractMacFromName(name) {
   //   42: uint8 fwMinor
   //   43: uint8 fwPatch
   //   44: int8 espnowRssi (device only)
+  //   45-48: float32 ch1WeightStdDev (estimator 1-sigma, lbs)
+  //   49-52: float32 ch2WeightStdDev
+  //   53: uint8 settledFlags (bit0 = CH1 settled, bit1 = CH2 settled)
   parseDataView(dataView) {
     try {
-      // Check if this is a binary packet (45 bytes) or JSON
-      if (dataView.byteLength === 45) {
+      if (dataView.byteLength >= 12 && dataView.getUint8(0) === 0xF1) {
+        return this.parseFleetFrame(dataView);
+      }
+
+      // Check if this is a binary packet (45 or 54 bytes) or JSON
+      const packetSize = dataView.byteLength;
+      if (packetSize === BLE_SENSOR_PACKET_V0_SIZE || packetSize === BLE_SENSOR_PACKET_SIZE) {
         // Binary packet - parse it
         const littleEndian = true;
 
@@ -460,7 +602,7 @@ extractMacFromName(name) {
         const ch2Weight = dataView.getFloat32(27, littleEndian);
         const totalWeight = dataView.getFloat32(31, littleEndian);
 
-        const batteryLevel = dataView.getUint8(35);
+        const batteryLevel = dataView.getUint8(35);  // 255: no battery reading
         const deviceCount = dataView.getUint8(36);
         const fleetTotalWeight = dataView.getFloat32(37, littleEndian);
 
@@ -469,7 +611,7 @@ extractMacFromName(name) {
         const fwPatch = dataView.getUint8(43);
         const firmwareVersion = `${fwMajor}.${fwMinor}.${fwPatch}`;
 
-        const espnowRssi = dataView.getInt8(44);
+        const espnowRssi = dataView.getInt8(44);  // -127: not reported (firmware on IDF 4.4, relayed)
 
         // Build object matching the old JSON format for compatibility
         const data = {
@@ -481,18 +623,27 @@ extractMacFromName(name) {
           ch1_weight: ch1Weight,
           ch2_weight: ch2Weight,
           total_weight: totalWeight,
-          battery_level: batteryLevel,
+          battery_level: batteryLevel === BATTERY_LEVEL_UNKNOWN ? null : batteryLevel,
           firmware_version: firmwareVersion,
           role: isHub ? 'hub' : 'device'
         };
 
+        // Weight estimator fields (firmware with the dynamic weighing filter)
+        if (packetSize === BLE_SENSOR_PACKET_SIZE) {
+          const settledFlags = dataView.getUint8(53);
+          data.ch1_weight_std_dev = dataView.getFloat32(45, littleEndian);
+          data.ch2_weight_std_dev = dataView.getFloat32(49, littleEndian);
+          data.ch1_settled = (settledFlags & 0x01) !== 0;
+          data.ch2_settled = (settledFlags & 0x02) !== 0;
+        }
+
         // Hub-specific fields
         if (isHub) {
           data.device_count = deviceCount;
           data.fleet_total_weight = fleetTotalWeight;
         } else {
           // Device-specific fields
-          data.espnow_rssi = espnowRssi;
+          data.espnow_rssi = espnowRssi === -127 ? null : espnowRssi;
         }
 
         console.log(`📦 Binary BLE packet (${dataView.byteLength} bytes): ${data.role} ${macAddress} v${firmwareVersion}`);
@@ -550,6 +701,360 @@ extractMacFromName(name) {
   }
 },
 
+  // Publish policy: the hub notifies as soon as a channel moves by its deadband (lbs),
+  // at most every minIntervalMs, and otherwise sends a full heartbeat every maxIntervalMs.
+  // The fleet total only sums samples taken within coherenceMs of each other (0 = all).
+  async setPublishPolicy({ minIntervalMs = 250, maxIntervalMs = 5000, ch1DeadbandLbs = 20, ch2DeadbandLbs = 20, coherenceMs = 500 } = {}) {
+    if (!this.connectedDeviceId) {
+      throw new Error('No device connected');
+    }
+
+    const policy = new DataView(new ArrayBuffer(10));
+    policy.setUint16(0, minIntervalMs, true);
+    policy.setUint16(2, maxIntervalMs, true);
+    policy.setUint16(4, Math.round(ch1DeadbandLbs * 10), true);
+    policy.setUint16(6, Math.round(ch2DeadbandLbs * 10), true);
+    policy.setUint16(8, coherenceMs, true);
+    await BleClient.write(this.connectedDeviceId, BLE_SERVICE_UUID, BLE_PUBLISH_CHAR_UUID, policy);
+    console.log(`🎚️ Publish policy: ${minIntervalMs}..${maxIntervalMs} ms, deadband ${ch1DeadbandLbs}/${ch2DeadbandLbs} lbs, coherence ${coherenceMs} ms`);
+  },
+
+  // Calibrate several devices at once. records: [{ mac, channel, intercept,
+  // air_pressure_coeff, ambient_pressure_coeff, air_temp_coeff, version }], mac null =
+  // hub, version 0/omitted = assigned by the hub. Written as binary chunks sized to
+  // the MTU; resolves once the hub reports every record settled, to
+  // [{ status, version }, ...] in record order.
+  async sendCoefficientBatch(records, { timeoutMs = 30000 } = {}) {
+    if (!this.connectedDeviceId) {
+      throw new Error('No device connected');
+    }
+    if (records.length === 0 || records.length > 32) {
+      throw new Error('A coefficient batch holds 1 to 32 records');
+    }
+
+    const deviceId = this.connectedDeviceId;
+    const batchId = this.coeffBatchId = ((this.coeffBatchId || 0) + 1) & 0xFF;
+    const statusNames = ['applied', 'queued', 'delivered', 'failed', 'sent', 'invalid', 'dropped', 'superseded'];
+
+    let settle;
+    const done = new Promise((resolve, reject) => {
+      const timer = setTimeout(() => reject(new Error('Coefficient batch timed out')), timeoutMs);
+      settle = (results) => {
+        clearTimeout(timer);
+        resolve(results);
+      };
+    });
+    done.catch(() => {});  // Awaited below; a timeout before the writes finish isn't unhandled
+
+    // Subscribed before the first write, so an ack to it can't slip past. A status
+    // comes split by the MTU: 4-byte header (id, flags, count, first record), then
+    // 5 bytes per record; it is whole once the notification ending at the last
+    // record is in.
+    const results = [];
+    await BleClient.startNotifications(deviceId, BLE_SERVICE_UUID, BLE_COEFF_BATCH_CHAR_UUID, (value) => {
+      if (value.getUint8(0) !== batchId) return;
+      const count = value.getUint8(2);
+      const first = value.getUint8(3);
+      const n = Math.floor((value.byteLength - 4) / 5);
+      for (let i = 0; i < n; i++) {
+        const off = 4 + i * 5;
+        results[first + i] = { status: statusNames[value.getUint8(off)] || 'unknown', version: value.getUint32(off + 1, true) };
+      }
+      if (first + n < count) return;
+      results.length = count;
+      console.log(`🧮 Coefficient batch ${batchId}:`, results.map((r) => (r ? r.status : 'unknown')).join(', '));
+      if (value.getUint8(1) & 0x01) settle(results.slice());
+    });
+
+    // 4-byte header + 27-byte records per write; the first chunk is flagged so the
+    // hub drops whatever an interrupted batch left behind
+    const perChunk = Math.max(1, Math.floor(((this.negotiatedMtu || 23) - 3 - 4) / 27));
+    try {
+      for (let first = 0; first < records.length; first += perChunk) {
+        const chunk = records.slice(first, first + perChunk);
+        const view = new DataView(new ArrayBuffer(4 + chunk.length * 27));
+        view.setUint8(0, 0x01);
+        view.setUint8(1, batchId);
+        view.setUint8(2, (first === 0 ? 0x02 : 0x00) | (first + chunk.length >= records.length ? 0x01 : 0x00));
+        view.setUint8(3, chunk.length);
+        chunk.forEach((r, i) => {
+          const off = 4 + i * 27;
+          const mac = (r.mac || '').split(':').map((h) => parseInt(h, 16));
+          for (let b = 0; b < 6; b++) view.setUint8(off + b, mac.length === 6 ? mac[b] : 0);
+          view.setUint8(off + 6, r.channel);
+          view.setFloat32(off + 7, r.intercept || 0, true);
+          view.setFloat32(off + 11, r.air_pressure_coeff || 0, true);
+          view.setFloat32(off + 15, r.ambient_pressure_coeff || 0, true);
+          view.setFloat32(off + 19, r.air_temp_coeff || 0, true);
+          view.setUint32(off + 23, r.version || 0, true);
+        });
+        await BleClient.write(deviceId, BLE_SERVICE_UUID, BLE_COEFF_BATCH_CHAR_UUID, view);
+      }
+      return await done;
+    } finally {
+      await BleClient.stopNotifications(deviceId, BLE_SERVICE_UUID, BLE_COEFF_BATCH_CHAR_UUID).catch(() => {});
+    }
+  },
+
+  // Weigh now: the hub triggers every slave to take its weights at one instant and
+  // collects the answers. Resolves to { complete, expected, answered, total_weight,
+  // elapsed_ms, devices: [{ mac_address, is_hub, answered, ch1_weight, ... }],
+  // missing: [mac, ...] } - slaves that were asked but didn't answer.
+  async weighNow({ timeoutMs = 3000 } = {}) {
+    if (!this.connectedDeviceId) {
+      throw new Error('No device connected');
+    }
+
+    const deviceId = this.connectedDeviceId;
+    const requestId = this.weighRequestId = ((this.weighRequestId || 0) + 1) & 0xFF;
+    const devices = [];
+
+    const done = new Promise((resolve, reject) => {
+      const timer = setTimeout(() => reject(new Error('Weigh now timed out')), timeoutMs);
+
+      BleClient.startNotifications(deviceId, BLE_SERVICE_UUID, BLE_WEIGH_NOW_CHAR_UUID, (value) => {
+        if (value.getUint8(0) !== 0xF2 || value.getUint8(1) !== requestId) return;
+        const flags = value.getUint8(3);
+        const recordSize = value.getUint8(5);
+        for (let i = 0; i < value.getUint8(4); i++) {
+          const o = 16 + i * recordSize;
+          if (o + 19 > value.byteLength) break;
+          const recFlags = value.getUint8(o);
+          const macBytes = [];
+          for (let b = 0; b < 6; b++) {
+            macBytes.push(value.getUint8(o + 1 + b).toString(16).padStart(2, '0').toUpperCase());
+          }
+          const ch1Weight = value.getInt32(o + 7, true) / 10;
+          const ch2Weight = value.getInt32(o + 11, true) / 10;
+          devices.push({
+            mac_address: macBytes.join(':'),
+            is_hub: (recFlags & 0x01) !== 0,
+            answered: (recFlags & 0x02) !== 0,
+            ch1_weight: ch1Weight,
+            ch2_weight: ch2Weight,
+            total_weight: ch1Weight + ch2Weight,
+            ch1_weight_std_dev: value.getUint16(o + 15, true) / 10,
+            ch2_weight_std_dev: value.getUint16(o + 17, true) / 10,
+            ch1_settled: (recFlags & 0x04) !== 0,
+            ch2_settled: (recFlags & 0x08) !== 0,
+            synced: (recFlags & 0x10) !== 0,
+            stale: (recFlags & 0x20) !== 0,
+            unlisted: (recFlags & 0x40) !== 0
+          });
+        }
+        if (flags & 0x01) {
+          clearTimeout(timer);
+          const result = {
+            complete: (flags & 0x02) !== 0,
+            expected: value.getUint8(6),
+            answered: value.getUint8(7),
+            total_weight: value.getFloat32(8, true),
+            elapsed_ms: value.getUint16(12, true),
+            devices,
+            missing: devices.filter((d) => !d.answered).map((d) => d.mac_address)
+          };
+          console.log(`⚖️ Weigh now: ${result.answered}/${result.expected} answered, ${result.total_weight.toFixed(1)} lbs in ${result.elapsed_ms} ms`);
+          resolve(result);
+        }
+      }).catch(reject);
+    });
+
+    try {
+      await BleClient.write(deviceId, BLE_SERVICE_UUID, BLE_WEIGH_NOW_CHAR_UUID, new DataView(new Uint8Array([0x01, requestId]).buffer));
+      return await done;
+    } finally {
+      await BleClient.stopNotifications(deviceId, BLE_SERVICE_UUID, BLE_WEIGH_NOW_CHAR_UUID).catch(() => {});
+    }
+  },
+
+  // Download sample history (flash log + unflushed RAM tail) for a time range.
+  // bootId 0 = any boot; timestamps are device millis() within that boot.
+  // A notification lost on the way shows as a gap in seq (or a short total at the
+  // end, or nothing for idleMs): the blocks before it are kept and the device asked
+  // to go on after the last whole one, up to maxResumes times.
+  // Resolves to [{ boot_id, timestamp, ch1_weight, ch2_weight, ch1_air_pressure,
+  //   ch2_air_pressure, atmospheric_pressure, temperature }, ...]
+  async downloadHistory({ bootId = 0, fromTs = 0, toTs = 0xFFFFFFFF, timeoutMs = 60000, idleMs = 3000, maxResumes = 5 } = {}) {
+    if (!this.connectedDeviceId) {
+      throw new Error('No device connected');
+    }
+
+    const deviceId = this.connectedDeviceId;
+    const samples = [];
+    let resume = null;  // { bootId, timestamp } of the last block kept
+    let pass = null;    // { chunks, bytes, nextSeq, started, idle, finish }
+
+    const request = () => {
+      const view = new DataView(new ArrayBuffer(resume ? 17 : 11));
+      view.setUint8(0, 0x01);
+      view.setUint16(1, bootId, true);
+      view.setUint32(3, fromTs >>> 0, true);
+      view.setUint32(7, toTs >>> 0, true);
+      if (resume) {
+        view.setUint16(11, resume.bootId, true);
+        view.setUint32(13, resume.timestamp >>> 0, true);
+      }
+      return BleClient.write(deviceId, BLE_SERVICE_UUID, BLE_HISTORY_CHAR_UUID, view);
+    };
+
+    // Keep the whole blocks of this pass, minus samples an earlier pass already had
+    const keep = (done, complete) => {
+      const stream = new Uint8Array(done.bytes);
+      let offset = 0;
+      for (const c of done.chunks) {
+        stream.set(c, offset);
+        offset += c.length;
+      }
+      const whole = complete ? stream.length : this.wholeHistoryBlocks(stream);
+      const after = resume;
+      for (const s of this.decodeHistoryStream(stream.subarray(0, whole))) {
+        if (after && s.boot_id === after.bootId && s.timestamp <= after.timestamp) continue;
+        samples.push(s);
+      }
+      if (whole >= 16) {
+        const view = new DataView(stream.buffer, 0, whole);
+        let pos = 0;
+        let last = 0;
+        while (pos + 16 <= whole) {
+          last = pos;
+          pos += 16 + view.getUint16(pos + 6, true);
+        }
+        resume = { bootId: view.getUint16(last + 2, true), timestamp: view.getUint32(last + 12, true) };
+      }
+    };
+
+    // A lost end marker looks like silence
+    const watch = () => {
+      clearTimeout(pass.idle);
+      const current = pass;
+      pass.idle = setTimeout(() => {
+        if (pass !== current) return;
+        pass = null;
+        current.finish({ gap: true });
+      }, idleMs);
+    };
+    const runPass = () => new Promise((resolve) => {
+      pass = { chunks: [], bytes: 0, nextSeq: 0, started: false, idle: null, finish: resolve };
+      watch();
+    });
+    const endPass = (result) => {
+      clearTimeout(pass.idle);
+      pass.finish(result);
+      pass = null;
+    };
+
+    let timeout = null;
+    const timer = new Promise((_, reject) => {
+      timeout = setTimeout(() => reject(new Error('History download timed out')), timeoutMs);
+    });
+
+    await BleClient.startNotifications(deviceId, BLE_SERVICE_UUID, BLE_HISTORY_CHAR_UUID, (value) => {
+      if (!pass) return;
+      const seq = value.getUint16(0, true);
+      // Until seq 0 comes, what arrives is the tail of the stream this pass replaced
+      if (!pass.started) {
+        if (seq !== 0) return;
+        pass.started = true;
+      }
+      if (seq === 0xFFFF) {
+        const totalBytes = value.getUint32(2, true);
+        endPass({ gap: totalBytes !== pass.bytes, blocks: value.getUint16(6, true), totalBytes });
+        return;
+      }
+      if (seq !== pass.nextSeq) {
+        endPass({ gap: true });
+        return;
+      }
+      watch();
+      pass.nextSeq = (seq + 1) & 0x7FFF;
+      const chunk = new Uint8Array(value.buffer, value.byteOffset + 2, value.byteLength - 2).slice();
+      pass.chunks.push(chunk);
+      pass.bytes += chunk.length;
+    });
+
+    try {
+      for (let attempt = 0; ; attempt++) {
+        const done = runPass();
+        const current = pass;
+        await request();
+        const result = await Promise.race([done, timer]);
+        keep(current, !result.gap);
+        if (!result.gap) {
+          console.log(`🗂️ History: ${samples.length} samples` +
+                      (attempt ? ` after ${attempt} resume(s)` : '') +
+                      `, last pass ${result.blocks} blocks, ${result.totalBytes} bytes`);
+          return samples;
+        }
+        if (attempt >= maxResumes) {
+          throw new Error('History download kept losing notifications');
+        }
+        console.warn(`⚠️ History gap after ${samples.length} samples, resuming`);
+      }
+    } finally {
+      if (pass) clearTimeout(pass.idle);
+      pass = null;
+      clearTimeout(timeout);
+      await BleClient.stopNotifications(deviceId, BLE_SERVICE_UUID, BLE_HISTORY_CHAR_UUID).catch(() => {});
+    }
+  },
+
+  // Bytes of the stream taken by whole blocks (16-byte header + payloadLen)
+  wholeHistoryBlocks(bytes) {
+    const view = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+    let pos = 0;
+    while (pos + 16 <= bytes.length && view.getUint16(pos, true) === 0x4853) {
+      const end = pos + 16 + view.getUint16(pos + 6, true);
+      if (end > bytes.length) break;
+      pos = end;
+    }
+    return pos;
+  },
+
+  // Decode a stream of history blocks (16-byte header + zigzag varint deltas per field)
+  decodeHistoryStream(bytes) {
+    const view = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+    const samples = [];
+    let pos = 0;
+
+    const readVarint = () => {
+      let result = 0;
+      let shift = 0;
+      for (;;) {
+        const b = bytes[pos++];
+        result += (b & 0x7F) * 2 ** shift;
+        if (!(b & 0x80)) return result;
+        shift += 7;
+      }
+    };
+    const unzigzag = (v) => (v % 2 === 0 ? v / 2 : -(v + 1) / 2);
+
+    while (pos + 16 <= bytes.length) {
+      if (view.getUint16(pos, true) !== 0x4853) break;
+      const bootId = view.getUint16(pos + 2, true);
+      const count = view.getUint16(pos + 4, true);
+      const payloadLen = view.getUint16(pos + 6, true);
+      const end = pos + 16 + payloadLen;
+      pos += 16;
+
+      const prev = [0, 0, 0, 0, 0, 0, 0];
+      for (let i = 0; i < count && pos < end; i++) {
+        for (let f = 0; f < 7; f++) prev[f] += unzigzag(readVarint());
+        samples.push({
+          boot_id: bootId,
+          timestamp: prev[0] >>> 0,
+          ch1_weight: prev[1],
+          ch2_weight: prev[2],
+          ch1_air_pressure: prev[3] / 100,
+          ch2_air_pressure: prev[4] / 100,
+          atmospheric_pressure: prev[5] / 100,
+          temperature: prev[6] / 10
+        });
+      }
+      pos = end;
+    }
+    return samples;
+  },
+
   // Disconnect
   async disconnect() {
     if (!this.connectedDeviceId) return;
@@ -1025,6 +1530,7 @@ extractMacFromName(name) {
   // OTA state
   otaInProgress: false,
   otaAborted: false,
+  otaStreamAnswered: false,  // The device answered a streamed START: it keeps the transfer to resume
 
   /**
    * Perform OTA firmware update via BLE
@@ -1043,6 +1549,8 @@ extractMacFromName(name) {
 
     this.otaInProgress = true;
     this.otaAborted = false;
+    this.otaStreamAnswered = false;
+    let streamed = false;
 
     // Disable auto-switch during OTA to prevent background scanning from interfering
     const previousAutoSwitch = this.autoSwitchEnabled;
@@ -1063,144 +1571,25 @@ extractMacFromName(name) {
 
       const firmwareData = await response.arrayBuffer();
       const firmwareSize = firmwareData.byteLength;
+      // Only a known version is passed on to the slaves, and only to older ones
+      const version = (response.headers.get('X-Firmware-Version') || '').match(/^v?(\d+)\.(\d+)\.(\d+)/);
+      const firmwareVersion = version ? version.slice(1, 4).map(Number) : null;
       console.log(`📦 Firmware downloaded: ${firmwareSize} bytes`);
 
       onProgress({ phase: 'download', percent: 100, message: `Downloaded ${this.formatBytes(firmwareSize)}` });
 
-      // Phase 2: Send start command
-      onProgress({ phase: 'prepare', percent: 0, message: 'Preparing device for update...' });
-
-      // Build start packet: [0x01, size (4 bytes little-endian)]
-      const startPacket = new Uint8Array(5);
-      startPacket[0] = OTA_CMD_START;
-      startPacket[1] = firmwareSize & 0xFF;
-      startPacket[2] = (firmwareSize >> 8) & 0xFF;
-      startPacket[3] = (firmwareSize >> 16) & 0xFF;
-      startPacket[4] = (firmwareSize >> 24) & 0xFF;
-
-      await BleClient.write(
-        this.connectedDeviceId,
-        BLE_SERVICE_UUID,
-        BLE_OTA_CHAR_UUID,
-        startPacket
-      );
-
-      console.log('✅ OTA start command sent');
-      await this.delay(100); // Small delay after start
-
-      // Phase 3: Send firmware data in chunks
-      // Compute optimal chunk size from negotiated MTU
-      // MTU - 3 (ATT header) - 1 (OTA command byte) = usable payload
-      const mtu = this.negotiatedMtu || 23;
-      const maxChunk = Math.max(20, mtu - 3 - 1); // At least 20 bytes
-      const chunkSize = Math.min(240, maxChunk);  // Cap at 240 for cross-stack safety
-      const totalChunks = Math.ceil(firmwareSize / chunkSize);
-      let sentBytes = 0;
-
-      // Use writeWithoutResponse only if available AND we have high MTU
-      // The ESP32 BLE stack can get overwhelmed even with high MTU if we send
-      // too fast. With ~6000 chunks for a 1.4MB firmware, we need careful pacing.
-      // Actually, for reliability, let's default to regular write() with ACK
-      // and only use writeWithoutResponse if MTU is very high (250+)
-      const hasWriteNoResponse = typeof BleClient.writeWithoutResponse === 'function';
-      const useWriteNoResponse = hasWriteNoResponse && mtu >= 250;
-      console.log(`📤 Sending ${totalChunks} chunks of ${chunkSize} bytes each (MTU: ${mtu}, writeNoResponse: ${useWriteNoResponse})...`);
-
-      for (let i = 0; i < totalChunks; i++) {
-        if (this.otaAborted) {
-          throw new Error('OTA update aborted by user');
-        }
-
-        const start = i * chunkSize;
-        const end = Math.min(start + chunkSize, firmwareSize);
-        const chunk = new Uint8Array(firmwareData.slice(start, end));
-
-        // Build data packet: [0x02, ...data]
-        const dataPacket = new Uint8Array(1 + chunk.length);
-        dataPacket[0] = OTA_CMD_DATA;
-        dataPacket.set(chunk, 1);
-
-        // Use writeWithoutResponse for data packets if available AND MTU is good
-        if (useWriteNoResponse) {
-          await BleClient.writeWithoutResponse(
-            this.connectedDeviceId,
-            BLE_SERVICE_UUID,
-            BLE_OTA_CHAR_UUID,
-            dataPacket
-          );
-          // Tiny delay after each write to prevent rapid-fire flooding
-          // This gives the ESP32 BLE stack time to queue the packet
-          await this.delay(2);
-        } else {
-          await BleClient.write(
-            this.connectedDeviceId,
-            BLE_SERVICE_UUID,
-            BLE_OTA_CHAR_UUID,
-            dataPacket
-          );
-        }
-
-        sentBytes += chunk.length;
-        const percent = Math.round((sentBytes / firmwareSize) * 100);
-
-        // Update progress every 5% or on last chunk
-        if (percent % 5 === 0 || i === totalChunks - 1) {
-          onProgress({
-            phase: 'upload',
-            percent,
-            message: `Uploading... ${percent}% (${this.formatBytes(sentBytes)} / ${this.formatBytes(firmwareSize)})`
-          });
-        }
-
-        // Flow control: pace writes to prevent ESP32 BLE queue overflow
-        // The ESP32 writes each chunk to flash, which takes time. Without pacing,
-        // the BLE stack buffer overflows and returns GATT_INTERNAL_ERROR (201).
-        //
-        // Strategy: use a small delay every N chunks. The ESP32 flash write is
-        // about 10-20ms for 4KB pages. With 240-byte chunks, that's ~17 chunks per page.
-        // We add a pause every 10 chunks to let flash writes complete.
-        if (useWriteNoResponse) {
-          // writeWithoutResponse is fast but can overwhelm the ESP32
-          // Delay every 10 chunks to match flash page write timing
-          if (i % 10 === 0 && i > 0) {
-            await this.delay(25); // 25ms every 10 chunks (~250KB/s effective)
-          }
-        } else {
-          // Regular write() has built-in ACK which provides natural pacing
-          // But still add occasional delays for very long transfers
-          if (i % 50 === 0 && i > 0) {
-            await this.delay(10);
-          }
-        }
-      }
-
-      console.log('✅ All firmware data sent');
-
-      // Phase 4: Send end command
-      onProgress({ phase: 'verify', percent: 0, message: 'Verifying and installing...' });
-
-      const endPacket = new Uint8Array([OTA_CMD_END]);
-
-      // The ESP32 reboots immediately after receiving the end command,
-      // which causes the write to fail with a timeout or disconnect error.
-      // This is actually expected behavior - treat these errors as success.
+      // Streamed protocol (acks over notify, resumable); firmware without it has no
+      // notifications on the OTA characteristic and gets the original paced upload.
+      // A delta the device turns down as made for another build goes again whole.
       try {
-        await BleClient.write(
-          this.connectedDeviceId,
-          BLE_SERVICE_UUID,
-          BLE_OTA_CHAR_UUID,
-          endPacket
-        );
-        console.log('✅ OTA end command acknowledged');
-      } catch (endError) {
-        // Timeout or disconnect during end command is expected - device is rebooting
-        const errorMsg = endError?.message?.toLowerCase() || '';
-        if (errorMsg.includes('timeout') || errorMsg.includes('disconnect') || errorMsg.includes('not connected')) {
-          console.log('✅ OTA end command sent - device rebooting (connection lost as expected)');
-        } else {
-          // Unexpected error - rethrow
-          throw endError;
-        }
+        streamed = await this.streamOtaImage(new Uint8Array(firmwareData), onProgress, firmwareUrl, firmwareVersion);
+      } catch (error) {
+        if (error.otaStatus !== OTA_ERR_BASE) throw error;
+        console.log('📦 Device runs another build than the delta was made for - sending the full image');
+        streamed = await this.streamOtaImage(new Uint8Array(firmwareData), onProgress, null, firmwareVersion);
+      }
+      if (!streamed) {
+        await this.sendOtaImagePaced(firmwareData, onProgress);
       }
 
       console.log('✅ OTA update complete - device will reboot');
@@ -1228,8 +1617,9 @@ extractMacFromName(name) {
     } catch (error) {
       console.error('❌ OTA update failed:', error);
 
-      // Try to abort the OTA on the device
-      if (this.connectedDeviceId) {
+      // Try to abort the OTA on the device. A streamed transfer that merely failed is
+      // left for the next attempt to resume, also when it failed before it returned.
+      if (this.connectedDeviceId && ((!streamed && !this.otaStreamAnswered) || this.otaAborted)) {
         try {
           const abortPacket = new Uint8Array([OTA_CMD_ABORT]);
           await BleClient.write(
@@ -1250,6 +1640,7 @@ extractMacFromName(name) {
     } finally {
       this.otaInProgress = false;
       this.otaAborted = false;
+      this.otaStreamAnswered = false;
 
       // Restore auto-switch setting
       if (previousAutoSwitch) {
@@ -1259,6 +1650,421 @@ extractMacFromName(name) {
     }
   },
 
+  /**
+   * Compressed OTA container: the image LZSS-compressed behind a header with both
+   * sizes and its SHA-256, which the device checks once it has expanded it.
+   * @returns {Promise<Uint8Array|null>} - null if compression doesn't pay or SHA-256 is unavailable
+   */
+  async buildOtaContainer(image) {
+    if (!globalThis.crypto || !crypto.subtle) return null;
+    const startedAt = Date.now();
+    const payload = lzssCompress(image);
+    if (OTA_IMAGE_HEADER_SIZE + payload.length >= image.length) return null;
+    const sha256 = new Uint8Array(await crypto.subtle.digest('SHA-256', image));
+    const container = otaContainer(OTA_CODEC_LZSS, payload, image.length, sha256);
+    console.log(`📦 Firmware compressed: ${image.length} -> ${container.length} bytes ` +
+      `(${(100 - container.length * 100 / image.length).toFixed(1)}% less to send, ${Date.now() - startedAt} ms)`);
+    return container;
+  },
+
+  /**
+   * Delta OTA container: a patch from the build the device runs to this one. The
+   * server finds that build by the image digest the device reports (esptool appends
+   * it to every image, espImageDigest).
+   * @param {Uint8Array} baseSha256 - running image digest, from OTA_CMD_INFO
+   * @returns {Promise<Uint8Array|null>} - null if the build isn't on the server or SHA-256 is unavailable
+   */
+  async buildOtaDelta(image, baseSha256, firmwareUrl) {
+    if (!globalThis.crypto || !crypto.subtle) return null;
+    const digest = Array.from(baseSha256, (b) => b.toString(16).padStart(2, '0')).join('');
+    let base;
+    try {
+      const response = await fetch(new URL(`/api/firmware/base/${digest}`, new URL(firmwareUrl, window.location.href)));
+      if (!response.ok) {
+        console.log(`📦 Running build ${digest.slice(0, 12)} not on the server (${response.status}) - no delta`);
+        return null;
+      }
+      base = new Uint8Array(await response.arrayBuffer());
+    } catch (e) {
+      console.log('📦 Running build could not be downloaded - no delta:', e.message);
+      return null;
+    }
+    const baseDigest = espImageDigest(base);
+    if (!baseDigest || baseDigest.some((b, i) => b !== baseSha256[i])) return null;
+
+    const startedAt = Date.now();
+    const payload = lzssCompress(deltaPatch(base, image, baseSha256));
+    const sha256 = new Uint8Array(await crypto.subtle.digest('SHA-256', image));
+    const container = otaContainer(OTA_CODEC_DELTA, payload, image.length, sha256);
+    console.log(`📦 Delta against the running build: ${image.length} -> ${container.length} bytes ` +
+      `(${(100 - container.length * 100 / image.length).toFixed(1)}% less to send, ${Date.now() - startedAt} ms)`);
+    return container;
+  },
+
+  /**
+   * Streamed OTA: the device stages the image in RAM, programs it from a task of its
+   * own and answers with acks; data is sent up to the limit it grants instead of at
+   * a fixed pace. Resumes where an earlier attempt at the same image stopped.
+   * @param {string|null} firmwareUrl - where the image came from, to look up the running build for a delta; null for none
+   * @param {number[]|null} version - the image's [major, minor, patch], for a hub to pass it on to older slaves; null for none
+   * @returns {Promise<boolean>} - false if the device doesn't speak this protocol
+   */
+  async streamOtaImage(image, onProgress, firmwareUrl = null, version = null) {
+    const deviceId = this.connectedDeviceId;
+    const ota = { event: 0, status: 0, features: 0, received: 0, limit: 0, committed: 0, rewindTo: null, info: null, slaves: [], waiter: null };
+
+    const wait = (timeoutMs, what) => new Promise((resolve, reject) => {
+      const timer = setTimeout(() => {
+        ota.waiter = null;
+        reject(new Error(`OTA: no ${what} from the device`));
+      }, timeoutMs);
+      ota.waiter = () => {
+        clearTimeout(timer);
+        resolve();
+      };
+    });
+
+    try {
+      await BleClient.startNotifications(deviceId, BLE_SERVICE_UUID, BLE_OTA_CHAR_UUID, (value) => {
+        if (value.byteLength >= OTA_INFO_SIZE && value.getUint8(0) === OTA_INFO_MAGIC) {
+          ota.info = {
+            features: value.getUint8(1),
+            sha256: new Uint8Array(value.buffer.slice(value.byteOffset + 8, value.byteOffset + 40))
+          };
+        } else if (value.byteLength >= 20 && value.getUint8(0) === OTA_NOTIFY_MAGIC) {
+          ota.event = value.getUint8(1);
+          ota.status = value.getUint8(2);
+          ota.features = value.getUint8(3);
+          ota.received = value.getUint32(4, true);
+          ota.limit = value.getUint32(8, true);
+          ota.committed = value.getUint32(12, true);
+          if (ota.event === OTA_EVT_REWIND) ota.rewindTo = ota.received;
+        } else if (value.byteLength >= MESH_OTA_NOTIFY_SIZE && value.getUint8(0) === MESH_OTA_NOTIFY_MAGIC) {
+          const mac = [];
+          for (let i = 4; i < 10; i++) mac.push(value.getUint8(i).toString(16).padStart(2, '0').toUpperCase());
+          ota.slaves.length = value.getUint8(2);
+          ota.slaves[value.getUint8(1)] = {
+            mac: mac.join(':'),
+            state: value.getUint8(3),
+            error: value.getUint8(10),
+            received: value.getUint32(12, true),
+            total: value.getUint32(16, true)
+          };
+          this.reportMeshOta(ota.slaves, onProgress);
+        } else {
+          return;
+        }
+        if (ota.waiter) {
+          const waiter = ota.waiter;
+          ota.waiter = null;
+          waiter();
+        }
+      });
+    } catch (e) {
+      console.log('📦 OTA characteristic has no notifications - original upload protocol');
+      return false;
+    }
+
+    const failed = () => {
+      const error = new Error(`Device refused the update: ${OTA_ERRORS[ota.status] || 'error ' + ota.status}`);
+      error.otaStatus = ota.status;
+      return error;
+    };
+    // Asks for the slaves running older firmware to be updated too when the version
+    // is known; firmware without relay ignores the flags
+    const start = async (bytes) => {
+      const crc = crc32(bytes);
+      const packet = new DataView(new ArrayBuffer(version ? 13 : 9));
+      packet.setUint8(0, OTA_CMD_START);
+      packet.setUint32(1, bytes.length, true);
+      packet.setUint32(5, crc, true);
+      if (version) {
+        packet.setUint8(9, OTA_START_RELAY);
+        version.forEach((v, i) => packet.setUint8(10 + i, v));
+      }
+      const ready = wait(5000, 'answer to START');
+      await BleClient.write(deviceId, BLE_SERVICE_UUID, BLE_OTA_CHAR_UUID, packet);
+      await ready;
+      this.otaStreamAnswered = true;
+      if (ota.event === OTA_EVT_ERROR) throw failed();
+      return crc;
+    };
+
+    try {
+      onProgress({ phase: 'prepare', percent: 0, message: 'Preparing device for update...' });
+      // A delta against the running build when the device takes one and the server
+      // has that build, else the compressed container when it pays. The same image
+      // gives the same container, so an interrupted full transfer still resumes.
+      let data = null;
+      if (firmwareUrl) {
+        const info = wait(2000, 'running image').catch(() => {});  // Firmware before delta updates doesn't answer
+        await BleClient.write(deviceId, BLE_SERVICE_UUID, BLE_OTA_CHAR_UUID, new DataView(new Uint8Array([OTA_CMD_INFO]).buffer));
+        await info;
+        if (ota.info && (ota.info.features & OTA_FEATURE_DELTA)) {
+          data = await this.buildOtaDelta(image, ota.info.sha256, firmwareUrl);
+        }
+      }
+      const full = await this.buildOtaContainer(image);
+      if (!data || (full && full.length < data.length)) data = full;
+      let crc = await start(data || image);
+      if (data && !(ota.features & OTA_FEATURE_IMAGE)) {
+        console.log('📦 Device takes raw images only - sending uncompressed');
+        await BleClient.write(deviceId, BLE_SERVICE_UUID, BLE_OTA_CHAR_UUID, new DataView(new Uint8Array([OTA_CMD_ABORT]).buffer));
+        data = null;
+        crc = await start(image);
+      }
+      data = data || image;
+      const size = data.length;
+      if (ota.received > 0) {
+        console.log(`📦 OTA resuming at ${ota.received} of ${size} bytes`);
+      }
+
+      // MTU - 3 (ATT header) - 5 (command + offset) = payload per write
+      const mtu = this.negotiatedMtu || 23;
+      const chunkSize = Math.max(16, Math.min(240, mtu - 3 - 5));
+      const useWriteNoResponse = typeof BleClient.writeWithoutResponse === 'function';
+      const resumedFrom = ota.received;
+      const startedAt = Date.now();
+      let offset = ota.received;
+      let lastPercent = -1;
+      console.log(`📤 Streaming ${size - offset} bytes in ${chunkSize}-byte writes (MTU: ${mtu}, CRC ${crc.toString(16)})`);
+
+      for (;;) {
+        while (offset < size) {
+          if (this.otaAborted) throw new Error('OTA update aborted by user');
+          if (ota.event === OTA_EVT_ERROR) throw failed();
+          if (ota.rewindTo !== null) {
+            offset = ota.rewindTo;
+            ota.rewindTo = null;
+          }
+          if (offset >= ota.limit) {
+            await wait(15000, 'ack');  // Both staging blocks full: the next ack frees one
+            continue;
+          }
+
+          const end = Math.min(offset + chunkSize, size, ota.limit);
+          const packet = new Uint8Array(5 + end - offset);
+          packet[0] = OTA_CMD_DATA_AT;
+          new DataView(packet.buffer).setUint32(1, offset, true);
+          packet.set(data.subarray(offset, end), 5);
+          const view = new DataView(packet.buffer);
+          if (useWriteNoResponse) {
+            await BleClient.writeWithoutResponse(deviceId, BLE_SERVICE_UUID, BLE_OTA_CHAR_UUID, view);
+          } else {
+            await BleClient.write(deviceId, BLE_SERVICE_UUID, BLE_OTA_CHAR_UUID, view);
+          }
+          offset = end;
+
+          const percent = Math.floor((offset / size) * 100);
+          if (percent !== lastPercent) {
+            lastPercent = percent;
+            const kbps = (offset - resumedFrom) / 1.024 / Math.max(1, Date.now() - startedAt);
+            onProgress({
+              phase: 'upload',
+              percent,
+              message: `Uploading... ${percent}% (${this.formatBytes(offset)} / ${this.formatBytes(size)}, ${kbps.toFixed(1)} KB/s)`
+            });
+          }
+        }
+
+        // END: the device answers DONE once the image is verified and set to boot,
+        // or REWIND if something is still missing. A hub with slaves to update answers
+        // RELAY first and reports each slave until it is done with them.
+        onProgress({ phase: 'verify', percent: 0, message: 'Verifying and installing...' });
+        const answer = wait(30000, 'verification result');
+        await BleClient.write(deviceId, BLE_SERVICE_UUID, BLE_OTA_CHAR_UUID, new DataView(new Uint8Array([OTA_CMD_END]).buffer));
+        await answer;
+        while (ota.event === OTA_EVT_ACK || ota.event === OTA_EVT_RELAY) {
+          await wait(ota.event === OTA_EVT_RELAY ? 60000 : 30000, ota.event === OTA_EVT_RELAY ? 'slave progress' : 'verification result');
+        }
+        if (ota.event === OTA_EVT_DONE) break;
+        if (ota.event === OTA_EVT_ERROR) throw failed();
+        if (ota.rewindTo !== null) {
+          offset = ota.rewindTo;
+          ota.rewindTo = null;
+        }
+      }
+
+      const seconds = (Date.now() - startedAt) / 1000;
+      console.log(`✅ OTA image verified on the device: ${size - resumedFrom} bytes in ${seconds.toFixed(1)} s (${((size - resumedFrom) / 1024 / seconds).toFixed(1)} KB/s)`);
+      const slavesFailed = ota.slaves.filter((slave) => slave && slave.state === MESH_OTA_FAILED);
+      if (slavesFailed.length > 0) {
+        console.warn(`⚠️ ${slavesFailed.length} of ${ota.slaves.length} slave(s) not updated: ` +
+          slavesFailed.map((slave) => `${slave.mac} (${OTA_ERRORS[slave.error] || 'error ' + slave.error})`).join(', '));
+      }
+      return true;
+    } finally {
+      await BleClient.stopNotifications(deviceId, BLE_SERVICE_UUID, BLE_OTA_CHAR_UUID).catch(() => {});
+    }
+  },
+
+  /**
+   * Mesh update progress from the hub: overall percent across the slaves, and each
+   * slave's state for the caller to list
+   * @param {Array} slaves - by offer order, {mac, state, error, received, total}; gaps not heard of yet
+   */
+  reportMeshOta(slaves, onProgress) {
+    let received = 0;
+    let total = 0;
+    let finished = 0;
+    for (const slave of slaves) {
+      if (!slave) continue;
+      received += slave.state === MESH_OTA_DONE ? slave.total : slave.received;
+      total += slave.total;
+      if (slave.state >= MESH_OTA_DONE) finished++;
+    }
+    const percent = total > 0 ? Math.floor(received * 100 / total) : 0;
+    onProgress({
+      phase: 'relay',
+      percent,
+      message: `Updating slaves... ${finished} of ${slaves.length} finished (${percent}%)`,
+      slaves: slaves.map((slave) => slave && { ...slave, stateName: MESH_OTA_STATES[slave.state] || 'unknown' })
+    });
+  },
+
+  /**
+   * Original OTA upload: fixed pacing, no acks (firmware before the streamed protocol)
+   */
+  async sendOtaImagePaced(firmwareData, onProgress) {
+    const firmwareSize = firmwareData.byteLength;
+
+    // Phase 2: Send start command
+    onProgress({ phase: 'prepare', percent: 0, message: 'Preparing device for update...' });
+
+    // Build start packet: [0x01, size (4 bytes little-endian)]
+    const startPacket = new Uint8Array(5);
+    startPacket[0] = OTA_CMD_START;
+    startPacket[1] = firmwareSize & 0xFF;
+    startPacket[2] = (firmwareSize >> 8) & 0xFF;
+    startPacket[3] = (firmwareSize >> 16) & 0xFF;
+    startPacket[4] = (firmwareSize >> 24) & 0xFF;
+
+    await BleClient.write(
+      this.connectedDeviceId,
+      BLE_SERVICE_UUID,
+      BLE_OTA_CHAR_UUID,
+      startPacket
+    );
+
+    console.log('✅ OTA start command sent');
+    await this.delay(100); // Small delay after start
+
+    // Phase 3: Send firmware data in chunks
+    // Compute optimal chunk size from negotiated MTU
+    // MTU - 3 (ATT header) - 1 (OTA command byte) = usable payload
+    const mtu = this.negotiatedMtu || 23;
+    const maxChunk = Math.max(20, mtu - 3 - 1); // At least 20 bytes
+    const chunkSize = Math.min(240, maxChunk);  // Cap at 240 for cross-stack safety
+    const totalChunks = Math.ceil(firmwareSize / chunkSize);
+    let sentBytes = 0;
+
+    // Use writeWithoutResponse only if available AND we have high MTU
+    // The ESP32 BLE stack can get overwhelmed even with high MTU if we send
+    // too fast. With ~6000 chunks for a 1.4MB firmware, we need careful pacing.
+    // Actually, for reliability, let's default to regular write() with ACK
+    // and only use writeWithoutResponse if MTU is very high (250+)
+    const hasWriteNoResponse = typeof BleClient.writeWithoutResponse === 'function';
+    const useWriteNoResponse = hasWriteNoResponse && mtu >= 250;
+    console.log(`📤 Sending ${totalChunks} chunks of ${chunkSize} bytes each (MTU: ${mtu}, writeNoResponse: ${useWriteNoResponse})...`);
+
+    for (let i = 0; i < totalChunks; i++) {
+      if (this.otaAborted) {
+        throw new Error('OTA update aborted by user');
+      }
+
+      const start = i * chunkSize;
+      const end = Math.min(start + chunkSize, firmwareSize);
+      const chunk = new Uint8Array(firmwareData.slice(start, end));
+
+      // Build data packet: [0x02, ...data]
+      const dataPacket = new Uint8Array(1 + chunk.length);
+      dataPacket[0] = OTA_CMD_DATA;
+      dataPacket.set(chunk, 1);
+
+      // Use writeWithoutResponse for data packets if available AND MTU is good
+      if (useWriteNoResponse) {
+        await BleClient.writeWithoutResponse(
+          this.connectedDeviceId,
+          BLE_SERVICE_UUID,
+          BLE_OTA_CHAR_UUID,
+          dataPacket
+        );
+        // Tiny delay after each write to prevent rapid-fire flooding
+        // This gives the ESP32 BLE stack time to queue the packet
+        await this.delay(2);
+      } else {
+        await BleClient.write(
+          this.connectedDeviceId,
+          BLE_SERVICE_UUID,
+          BLE_OTA_CHAR_UUID,
+          dataPacket
+        );
+      }
+
+      sentBytes += chunk.length;
+      const percent = Math.round((sentBytes / firmwareSize) * 100);
+
+      // Update progress every 5% or on last chunk
+      if (percent % 5 === 0 || i === totalChunks - 1) {
+        onProgress({
+          phase: 'upload',
+          percent,
+          message: `Uploading... ${percent}% (${this.formatBytes(sentBytes)} / ${this.formatBytes(firmwareSize)})`
+        });
+      }
+
+      // Flow control: pace writes to prevent ESP32 BLE queue overflow
+      // The ESP32 writes each chunk to flash, which takes time. Without pacing,
+      // the BLE stack buffer overflows and returns GATT_INTERNAL_ERROR (201).
+      //
+      // Strategy: use a small delay every N chunks. The ESP32 flash write is
+      // about 10-20ms for 4KB pages. With 240-byte chunks, that's ~17 chunks per page.
+      // We add a pause every 10 chunks to let flash writes complete.
+      if (useWriteNoResponse) {
+        // writeWithoutResponse is fast but can overwhelm the ESP32
+        // Delay every 10 chunks to match flash page write timing
+        if (i % 10 === 0 && i > 0) {
+          await this.delay(25); // 25ms every 10 chunks (~250KB/s effective)
+        }
+      } else {
+        // Regular write() has built-in ACK which provides natural pacing
+        // But still add occasional delays for very long transfers
+        if (i % 50 === 0 && i > 0) {
+          await this.delay(10);
+        }
+      }
+    }
+
+    console.log('✅ All firmware data sent');
+
+    // Phase 4: Send end command
+    onProgress({ phase: 'verify', percent: 0, message: 'Verifying and installing...' });
+
+    const endPacket = new Uint8Array([OTA_CMD_END]);
+
+    // The ESP32 reboots immediately after receiving the end command,
+    // which causes the write to fail with a timeout or disconnect error.
+    // This is actually expected behavior - treat these errors as success.
+    try {
+      await BleClient.write(
+        this.connectedDeviceId,
+        BLE_SERVICE_UUID,
+        BLE_OTA_CHAR_UUID,
+        endPacket
+      );
+      console.log('✅ OTA end command acknowledged');
+    } catch (endError) {
+      // Timeout or disconnect during end command is expected - device is rebooting
+      const errorMsg = endError?.message?.toLowerCase() || '';
+      if (errorMsg.includes('timeout') || errorMsg.includes('disconnect') || errorMsg.includes('not connected')) {
+        console.log('✅ OTA end command sent - device rebooting (connection lost as expected)');
+      } else {
+        // Unexpected error - rethrow
+        throw endError;
+      }
+    }
+  },
+
   /**
    * Abort an in-progress OTA update
    */
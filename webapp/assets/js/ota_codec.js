@@ -0,0 +1,306 @@
+// assets/js/ota_codec.js
+// Firmware update encoding for BLE OTA, as the device decodes it (ota_image.h,
+// delta_patch.h): CRC-32, the LZSS container and delta patches. No BLE in here, so
+// the firmware's host tests can make their fixtures with it under Node.
+
+// Compressed OTA container (firmware ota_image.h): 48-byte header, then the payload
+const OTA_IMAGE_MAGIC = 0x315A5341;  // "ASZ1"
+const OTA_IMAGE_VERSION = 1;
+export const OTA_IMAGE_HEADER_SIZE = 48;
+export const OTA_CODEC_LZSS = 1;
+export const OTA_CODEC_DELTA = 2;
+const OTA_LZSS_WINDOW_BITS = 12;
+const OTA_LZSS_WINDOW = 1 << OTA_LZSS_WINDOW_BITS;
+const OTA_LZSS_MIN_MATCH = 3;
+const OTA_LZSS_LONG_MATCH = 18;
+const OTA_LZSS_MAX_MATCH = OTA_LZSS_LONG_MATCH + 255;
+const OTA_LZSS_HASH_BITS = 15;
+const OTA_LZSS_CHAIN = 64;  // Candidates tried per position
+
+// Delta patch against the running image (firmware delta_patch.h)
+const DELTA_PATCH_MAGIC = 0x31505341;  // "ASP1"
+const DELTA_PATCH_HEADER_SIZE = 40;
+const DELTA_PATCH_RECORD_SIZE = 12;
+
+// CRC-32 as zlib computes it, which the device checks the programmed image against
+let crc32Table = null;
+export function crc32(bytes) {
+  if (!crc32Table) {
+    crc32Table = new Uint32Array(256);
+    for (let i = 0; i < 256; i++) {
+      let c = i;
+      for (let k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320 ^ (c >>> 1) : c >>> 1;
+      crc32Table[i] = c >>> 0;
+    }
+  }
+  let crc = 0xFFFFFFFF;
+  for (let i = 0; i < bytes.length; i++) crc = crc32Table[(crc ^ bytes[i]) & 0xFF] ^ (crc >>> 8);
+  return (crc ^ 0xFFFFFFFF) >>> 0;
+}
+
+// LZSS as the device's LzssDecoder reads it: a flag byte (LSB first, 1 = literal)
+// before every eight items, matches as u16 (distance - 1, length - 3 in the top
+// four bits; 15 = a length byte follows). Hash chains over three bytes, and a
+// match is put off by one byte when the next position has a longer one.
+export function lzssCompress(src) {
+  const n = src.length;
+  const out = new Uint8Array(n + Math.ceil(n / 8) + 16);
+  const head = new Int32Array(1 << OTA_LZSS_HASH_BITS).fill(-1);
+  const prev = new Int32Array(OTA_LZSS_WINDOW).fill(-1);
+  const hashMask = (1 << OTA_LZSS_HASH_BITS) - 1;
+  let o = 0;
+  let flagPos = 0;
+  let flagBit = 8;
+  let matchDist = 0;
+
+  const hash = (p) => ((src[p] << 10) ^ (src[p + 1] << 5) ^ src[p + 2]) & hashMask;
+  const insert = (p) => {
+    if (p + 2 >= n) return;
+    const h = hash(p);
+    prev[p & (OTA_LZSS_WINDOW - 1)] = head[h];
+    head[h] = p;
+  };
+  // Longest match for position p, its distance left in matchDist
+  const find = (p) => {
+    let best = 0;
+    matchDist = 0;
+    if (p + 2 >= n) return 0;
+    const maxLen = Math.min(n - p, OTA_LZSS_MAX_MATCH);
+    let cand = head[hash(p)];
+    for (let tries = OTA_LZSS_CHAIN; cand >= 0 && tries > 0 && p - cand <= OTA_LZSS_WINDOW; tries--) {
+      let len = 0;
+      while (len < maxLen && src[cand + len] === src[p + len]) len++;
+      if (len > best) {
+        best = len;
+        matchDist = p - cand;
+        if (len === maxLen) break;
+      }
+      const next = prev[cand & (OTA_LZSS_WINDOW - 1)];
+      if (next >= cand) break;
+      cand = next;
+    }
+    return best >= OTA_LZSS_MIN_MATCH ? best : 0;
+  };
+  const flag = (literal) => {
+    if (flagBit === 8) {
+      flagPos = o;
+      out[o++] = 0;
+      flagBit = 0;
+    }
+    if (literal) out[flagPos] |= 1 << flagBit;
+    flagBit++;
+  };
+
+  let i = 0;
+  while (i < n) {
+    let len = find(i);
+    const dist = matchDist;
+    insert(i);
+    if (len && i + 1 < n && find(i + 1) > len) len = 0;
+    if (!len) {
+      flag(true);
+      out[o++] = src[i++];
+      continue;
+    }
+    flag(false);
+    const code = len >= OTA_LZSS_LONG_MATCH ? 15 : len - OTA_LZSS_MIN_MATCH;
+    const v = (dist - 1) | (code << 12);
+    out[o++] = v & 0xFF;
+    out[o++] = v >> 8;
+    if (code === 15) out[o++] = len - OTA_LZSS_LONG_MATCH;
+    for (let k = 1; k < len; k++) insert(i + k);
+    i += len;
+  }
+  return out.subarray(0, o);
+}
+
+export function otaContainer(codec, payload, imageSize, sha256) {
+  const container = new Uint8Array(OTA_IMAGE_HEADER_SIZE + payload.length);
+  const header = new DataView(container.buffer);
+  header.setUint32(0, OTA_IMAGE_MAGIC, true);
+  header.setUint8(4, OTA_IMAGE_VERSION);
+  header.setUint8(5, codec);
+  header.setUint8(6, OTA_LZSS_WINDOW_BITS);
+  header.setUint32(8, payload.length, true);
+  header.setUint32(12, imageSize, true);
+  container.set(sha256, 16);
+  container.set(payload, OTA_IMAGE_HEADER_SIZE);
+  return container;
+}
+
+// The SHA-256 esptool appends to an app image: after the header and the segments,
+// past the checksum byte padded to 16 bytes; signed builds put their signature
+// block after it. Null if the bytes aren't an image with one.
+export function espImageDigest(image) {
+  if (image.length < 24 || image[0] !== 0xE9 || image[23] !== 1) return null;
+  const view = new DataView(image.buffer, image.byteOffset, image.byteLength);
+  let offset = 24;
+  for (let i = 0; i < image[1]; i++) {
+    if (offset + 8 > image.length) return null;
+    offset += 8 + view.getUint32(offset + 4, true);
+  }
+  offset = (offset + 16) & ~15;
+  return offset + 32 <= image.length ? image.subarray(offset, offset + 32) : null;
+}
+
+// Suffix array of s plus the empty suffix (sa[0] = s.length), by prefix doubling
+// with radix sorts
+function suffixArray(s) {
+  const count = s.length + 1;
+  let sa = new Int32Array(count);
+  let rank = new Int32Array(count);
+  let next = new Int32Array(count);
+  const bySecond = new Int32Array(count);
+  const buckets = new Int32Array(Math.max(257, count));
+  for (let i = 0; i < s.length; i++) rank[i] = s[i] + 1;
+  rank[s.length] = 0;
+  let classes = 257;
+  for (let i = 0; i < count; i++) buckets[rank[i]]++;
+  for (let c = 1; c < classes; c++) buckets[c] += buckets[c - 1];
+  for (let i = count - 1; i >= 0; i--) sa[--buckets[rank[i]]] = i;
+
+  for (let k = 1; classes < count; k <<= 1) {
+    // Ordered by the rank k on: those running off the end first, then the rest as sa has them
+    let p = 0;
+    for (let i = Math.max(0, count - k); i < count; i++) bySecond[p++] = i;
+    for (let j = 0; j < count; j++) if (sa[j] >= k) bySecond[p++] = sa[j] - k;
+    buckets.fill(0, 0, classes);
+    for (let i = 0; i < count; i++) buckets[rank[i]]++;
+    for (let c = 1; c < classes; c++) buckets[c] += buckets[c - 1];
+    for (let j = count - 1; j >= 0; j--) sa[--buckets[rank[bySecond[j]]]] = bySecond[j];
+
+    next[sa[0]] = 0;
+    classes = 1;
+    for (let j = 1; j < count; j++) {
+      const a = sa[j - 1];
+      const b = sa[j];
+      const same = rank[a] === rank[b] &&
+        (a + k < count ? rank[a + k] : -1) === (b + k < count ? rank[b + k] : -1);
+      next[b] = same ? classes - 1 : classes++;
+    }
+    [rank, next] = [next, rank];
+  }
+  return sa;
+}
+
+// bsdiff's search: longest match of image[at..] in base, through its suffix array
+function deltaSearch(sa, base, image, at) {
+  const matchLen = (from) => {
+    let len = 0;
+    while (from + len < base.length && at + len < image.length && base[from + len] === image[at + len]) len++;
+    return len;
+  };
+  let lo = 0;
+  let hi = base.length;
+  while (hi - lo >= 2) {
+    const mid = (lo + hi) >> 1;
+    const from = sa[mid];
+    let i = 0;
+    while (from + i < base.length && at + i < image.length && base[from + i] === image[at + i]) i++;
+    const baseFirst = from + i === base.length || (at + i < image.length && base[from + i] < image[at + i]);
+    if (baseFirst) lo = mid;
+    else hi = mid;
+  }
+  const loLen = matchLen(sa[lo]);
+  const hiLen = matchLen(sa[hi]);
+  return loLen > hiLen ? { len: loLen, pos: sa[lo] } : { len: hiLen, pos: sa[hi] };
+}
+
+// Patch turning base into image (delta_patch.h), by bsdiff's algorithm: exact
+// matches found through a suffix array, widened into approximate ones that keep
+// more than half their bytes, the rest sent as extra bytes
+export function deltaPatch(base, image, baseSha256) {
+  const sa = suffixArray(base);
+  const parts = [];
+  const header = new Uint8Array(DELTA_PATCH_HEADER_SIZE);
+  const headerView = new DataView(header.buffer);
+  headerView.setUint32(0, DELTA_PATCH_MAGIC, true);
+  headerView.setUint32(4, base.length, true);
+  header.set(baseSha256, 8);
+  parts.push(header);
+
+  const baseAt = (i) => (i >= 0 && i < base.length ? base[i] : -1);
+  let scan = 0;
+  let len = 0;
+  let pos = 0;
+  let lastScan = 0;
+  let lastPos = 0;
+  let lastOffset = 0;
+  while (scan < image.length) {
+    let oldScore = 0;
+    let scsc = scan += len;
+    for (; scan < image.length; scan++) {
+      ({ len, pos } = deltaSearch(sa, base, image, scan));
+      for (; scsc < scan + len; scsc++) {
+        if (baseAt(scsc + lastOffset) === image[scsc]) oldScore++;
+      }
+      if ((len === oldScore && len !== 0) || len > oldScore + 8) break;
+      if (baseAt(scan + lastOffset) === image[scan]) oldScore--;
+    }
+    if (len === oldScore && scan !== image.length) continue;
+
+    // Extend the last match forward and this one back while more than half agrees
+    let s = 0;
+    let best = 0;
+    let lenF = 0;
+    for (let i = 0; lastScan + i < scan && lastPos + i < base.length;) {
+      if (base[lastPos + i] === image[lastScan + i]) s++;
+      i++;
+      if (s * 2 - i > best * 2 - lenF) {
+        best = s;
+        lenF = i;
+      }
+    }
+    let lenB = 0;
+    if (scan < image.length) {
+      s = 0;
+      best = 0;
+      for (let i = 1; scan >= lastScan + i && pos >= i; i++) {
+        if (base[pos - i] === image[scan - i]) s++;
+        if (s * 2 - i > best * 2 - lenB) {
+          best = s;
+          lenB = i;
+        }
+      }
+    }
+    if (lastScan + lenF > scan - lenB) {
+      const overlap = lastScan + lenF - (scan - lenB);
+      s = 0;
+      best = 0;
+      let lenS = 0;
+      for (let i = 0; i < overlap; i++) {
+        if (image[lastScan + lenF - overlap + i] === base[lastPos + lenF - overlap + i]) s++;
+        if (image[scan - lenB + i] === base[pos - lenB + i]) s--;
+        if (s > best) {
+          best = s;
+          lenS = i + 1;
+        }
+      }
+      lenF += lenS - overlap;
+      lenB -= lenS;
+    }
+
+    const extraLen = scan - lenB - (lastScan + lenF);
+    const record = new Uint8Array(DELTA_PATCH_RECORD_SIZE + lenF);
+    const recordView = new DataView(record.buffer);
+    recordView.setUint32(0, lenF, true);
+    recordView.setUint32(4, extraLen, true);
+    recordView.setInt32(8, pos - lenB - (lastPos + lenF), true);
+    for (let i = 0; i < lenF; i++) {
+      record[DELTA_PATCH_RECORD_SIZE + i] = image[lastScan + i] - base[lastPos + i];
+    }
+    parts.push(record, image.subarray(lastScan + lenF, scan - lenB));
+
+    lastScan = scan - lenB;
+    lastPos = pos - lenB;
+    lastOffset = pos - scan;
+  }
+
+  const patch = new Uint8Array(parts.reduce((total, part) => total + part.length, 0));
+  let at = 0;
+  for (const part of parts) {
+    patch.set(part, at);
+    at += part.length;
+  }
+  return patch;
+}
@@ -208,6 +208,79 @@ class FirmwareController extends AbstractController
         return $response;
     }
 
+    /**
+     * Download the firmware a device is running, by its image digest
+     *
+     * GET /api/firmware/base/{digest}
+     *
+     * For delta BLE OTA: the device reports the SHA-256 of its running image, which
+     * esptool appends after the image's segments (followed by the signature block in
+     * signed builds, so not always the last 32 bytes); the phone builds the patch
+     * against the binary returned here. Deprecated versions included, since devices
+     * may still run them. Not counted as a download.
+     */
+    #[Route('/base/{digest}', name: 'base', methods: ['GET'], requirements: ['digest' => '[0-9a-fA-F]{64}'])]
+    public function base(string $digest): Response
+    {
+        $wanted = hex2bin(strtolower($digest));
+
+        foreach ($this->firmwareRepository->findAll() as $firmware) {
+            $filePath = $this->projectDir . '/public/' . $firmware->getFilePath();
+            if (!is_file($filePath)) {
+                continue;
+            }
+
+            $imageDigest = $this->imageDigest($filePath);
+            if ($imageDigest === null || !hash_equals($imageDigest, $wanted)) {
+                continue;
+            }
+
+            $response = new BinaryFileResponse($filePath);
+            $response->setContentDisposition(
+                ResponseHeaderBag::DISPOSITION_ATTACHMENT,
+                $firmware->getFilename()
+            );
+            $response->headers->set('Content-Type', 'application/octet-stream');
+            $response->headers->set('X-Firmware-Version', $firmware->getVersion());
+
+            return $response;
+        }
+
+        return new JsonResponse(['error' => 'No firmware with that image digest'], 404);
+    }
+
+    /**
+     * The SHA-256 esptool appends to an app image: after the 24-byte header and the
+     * segments (8-byte header each, length at +4), past the checksum byte padded to
+     * 16 bytes. Null if the file isn't an image with one.
+     */
+    private function imageDigest(string $filePath): ?string
+    {
+        $handle = fopen($filePath, 'rb');
+        if ($handle === false) {
+            return null;
+        }
+        $digest = null;
+        $header = fread($handle, 24);
+        if (strlen($header) === 24 && ord($header[0]) === 0xE9 && ord($header[23]) === 1) {
+            $offset = 24;
+            $segments = ord($header[1]);
+            for ($i = 0; $i < $segments && $offset !== null; $i++) {
+                fseek($handle, $offset);
+                $segment = fread($handle, 8);
+                $offset = strlen($segment) === 8 ? $offset + 8 + unpack('V', $segment, 4)[1] : null;
+            }
+            if ($offset !== null) {
+                fseek($handle, ($offset + 16) & ~15);
+                $read = fread($handle, 32);
+                $digest = strlen($read) === 32 ? $read : null;
+            }
+        }
+        fclose($handle);
+
+        return $digest;
+    }
+
     /**
      * Get firmware info by ID (for pre-download verification)
      *